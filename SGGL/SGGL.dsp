@@ -51,7 +51,7 @@ BSC32=bscmake.exe
 # ADD BSC32 /nologo
 LINK32=link.exe
 # ADD BASE LINK32 kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib  kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib /nologo /subsystem:console /machine:I386
-# ADD LINK32 libunicows.lib shlwapi.lib kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib  kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib /nologo /subsystem:console /machine:I386
+# ADD LINK32 libunicows.lib shlwapi.lib wsock32.lib kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib  kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib /nologo /subsystem:console /machine:I386
 
 !ELSEIF  "$(CFG)" == "SGGL - Win32 Debug"
 
@@ -76,7 +76,7 @@ BSC32=bscmake.exe
 # ADD BSC32 /nologo
 LINK32=link.exe
 # ADD BASE LINK32 kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib  kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib /nologo /subsystem:console /debug /machine:I386 /pdbtype:sept
-# ADD LINK32 libunicows.lib shlwapi.lib kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib  kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib /nologo /subsystem:console /debug /machine:I386 /pdbtype:sept
+# ADD LINK32 libunicows.lib shlwapi.lib wsock32.lib kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib  kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib /nologo /subsystem:console /debug /machine:I386 /pdbtype:sept
 
 !ENDIF 
 
@@ -101,6 +101,38 @@ SOURCE=.\resource\slashgaming_game_loader.ico
 # PROP Default_Filter "cpp;c;cxx;rc;def;r;odl;idl;hpj;bat"
 # Begin Source File
 
+SOURCE=.\src\admission.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\admission.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\agent_client.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\agent_client.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\agent_protocol.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\agent_ring.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\app_data.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\app_data.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\args_parser.c
 # End Source File
 # Begin Source File
@@ -117,6 +149,30 @@ SOURCE=.\src\args_validator.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\attach.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\attach.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\control_channel.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\control_channel.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\deferred_injector.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\deferred_injector.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\game_loader.c
 # End Source File
 # Begin Source File
@@ -133,6 +189,38 @@ SOURCE=.\src\help_printer.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\instance_boxes.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\instance_boxes.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\instance_job.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\instance_job.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\instance_registry.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\instance_registry.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\instance_result.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\instance_result.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\knowledge_library.c
 # End Source File
 # Begin Source File
@@ -141,6 +229,22 @@ SOURCE=.\src\knowledge_library.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\launch_context.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\launch_context.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\library_discovery.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\library_discovery.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\library_injector.c
 # End Source File
 # Begin Source File
@@ -182,6 +286,14 @@ InputName=library_injector_shim
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\library_set.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\library_set.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\license.c
 # End Source File
 # Begin Source File
@@ -192,6 +304,110 @@ SOURCE=.\src\license.h
 
 SOURCE=.\src\main.c
 # End Source File
+# Begin Source File
+
+SOURCE=.\src\metrics.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\metrics.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\monitor.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\monitor.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\output_capture.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\output_capture.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\pe_file.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\pe_file.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\placement.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\placement.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\platform.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\platform.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\prefetch.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\prefetch.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\remote_exports.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\remote_exports.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\resume_scheduler.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\resume_scheduler.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\resume_scheduler.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\resume_scheduler.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\sggl.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\sggl.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\stack_sampler.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\stack_sampler.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\startup.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\startup.h
+# End Source File
 # End Group
 # End Target
 # End Project
@@ -0,0 +1,669 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "admission.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+#include <mdc/wchar_t/filew.h>
+
+#include "app_data.h"
+
+enum {
+  kValueLength = 32,
+
+  /*
+   * Each run's peaks replace the history if they are higher. Otherwise,
+   * the history decays by an eighth, so that it follows games that
+   * start using less memory.
+   */
+  kDecayDivisor = 8,
+
+  kBytesPerKilobyte = 1024,
+  kBytesPerMegabyte = 1024 * 1024
+};
+
+enum LimitReason {
+  kLimitReason_None,
+  kLimitReason_Commit,
+  kLimitReason_Physical
+};
+
+static const wchar_t* const kProfilesFileName = L"profiles.ini";
+static const wchar_t* const kPeakCommitKey = L"PeakCommitKB";
+static const wchar_t* const kPeakWorkingSetKey = L"PeakWorkingSetKB";
+static const wchar_t* const kNumRunsKey = L"Runs";
+
+/* Mirror of PROCESS_MEMORY_COUNTERS, which is in psapi.h. */
+struct ProcessMemoryCounters {
+  DWORD cb;
+  DWORD page_fault_count;
+  SIZE_T peak_working_set_size;
+  SIZE_T working_set_size;
+  SIZE_T quota_peak_paged_pool_usage;
+  SIZE_T quota_paged_pool_usage;
+  SIZE_T quota_peak_non_paged_pool_usage;
+  SIZE_T quota_non_paged_pool_usage;
+  SIZE_T pagefile_usage;
+  SIZE_T peak_pagefile_usage;
+};
+
+/* Mirror of MEMORYSTATUSEX, which is missing from older SDKs. */
+struct MemoryStatusEx {
+  DWORD length;
+  DWORD memory_load;
+  ULONGLONG total_phys;
+  ULONGLONG avail_phys;
+  ULONGLONG total_page_file;
+  ULONGLONG avail_page_file;
+  ULONGLONG total_virtual;
+  ULONGLONG avail_virtual;
+  ULONGLONG avail_extended_virtual;
+};
+
+typedef BOOL WINAPI GetProcessMemoryInfoFuncType(
+    HANDLE, struct ProcessMemoryCounters*, DWORD);
+typedef BOOL WINAPI GlobalMemoryStatusExFuncType(struct MemoryStatusEx*);
+
+static HMODULE psapi_library;
+static GetProcessMemoryInfoFuncType* get_process_memory_info_func;
+
+static void InitMemoryInfoFunc(void) {
+  /* Windows 7 moved the psapi functions into kernel32. */
+  get_process_memory_info_func =
+      (GetProcessMemoryInfoFuncType*) GetProcAddress(
+          GetModuleHandleW(L"kernel32.dll"),
+          "K32GetProcessMemoryInfo");
+
+  if (get_process_memory_info_func == NULL) {
+    psapi_library = LoadLibraryW(L"psapi.dll");
+
+    if (psapi_library != NULL) {
+      get_process_memory_info_func =
+          (GetProcessMemoryInfoFuncType*) GetProcAddress(
+              psapi_library,
+              "GetProcessMemoryInfo");
+    }
+  }
+}
+
+static void DeinitMemoryInfoFunc(void) {
+  get_process_memory_info_func = NULL;
+
+  if (psapi_library != NULL) {
+    FreeLibrary(psapi_library);
+    psapi_library = NULL;
+  }
+}
+
+static int QueryProcessMemory(
+    HANDLE process,
+    struct ProcessMemoryCounters* counters) {
+  if (get_process_memory_info_func == NULL) {
+    return 0;
+  }
+
+  counters->cb = sizeof(*counters);
+
+  return get_process_memory_info_func(process, counters, sizeof(*counters));
+}
+
+/**
+ * Queries the available commit and physical memory. GlobalMemoryStatus
+ * is used before Windows 2000, which caps the sizes at 4 GB.
+ */
+static void QueryAvailableMemory(
+    ULONGLONG* avail_commit_size,
+    ULONGLONG* avail_phys_size) {
+  GlobalMemoryStatusExFuncType* global_memory_status_ex_func;
+  struct MemoryStatusEx memory_status_ex;
+  MEMORYSTATUS memory_status;
+
+  global_memory_status_ex_func =
+      (GlobalMemoryStatusExFuncType*) GetProcAddress(
+          GetModuleHandleW(L"kernel32.dll"),
+          "GlobalMemoryStatusEx");
+
+  if (global_memory_status_ex_func != NULL) {
+    memory_status_ex.length = sizeof(memory_status_ex);
+
+    if (global_memory_status_ex_func(&memory_status_ex)) {
+      *avail_commit_size = memory_status_ex.avail_page_file;
+      *avail_phys_size = memory_status_ex.avail_phys;
+      return;
+    }
+  }
+
+  memory_status.dwLength = sizeof(memory_status);
+  GlobalMemoryStatus(&memory_status);
+
+  *avail_commit_size = memory_status.dwAvailPageFile;
+  *avail_phys_size = memory_status.dwAvailPhys;
+}
+
+static int IsProcessExited(HANDLE process) {
+  return WaitForSingleObject(process, 0) == WAIT_OBJECT_0;
+}
+
+static DWORD ToMegabytes(ULONGLONG size) {
+  return (DWORD) (size / kBytesPerMegabyte);
+}
+
+static int GetProfilesFilePath(wchar_t* path) {
+  return AppData_GetFilePath(path, kProfilesFileName);
+}
+
+static void ReadProfile(
+    const wchar_t* profiles_file_path,
+    const wchar_t* profile_name,
+    struct AdmissionProfile* profile) {
+  profile->peak_commit_size = (ULONGLONG) GetPrivateProfileIntW(
+      profile_name,
+      kPeakCommitKey,
+      0,
+      profiles_file_path) * kBytesPerKilobyte;
+  profile->peak_working_set_size = (ULONGLONG) GetPrivateProfileIntW(
+      profile_name,
+      kPeakWorkingSetKey,
+      0,
+      profiles_file_path) * kBytesPerKilobyte;
+  profile->num_runs = GetPrivateProfileIntW(
+      profile_name,
+      kNumRunsKey,
+      0,
+      profiles_file_path);
+}
+
+static void WriteProfileValue(
+    const wchar_t* profiles_file_path,
+    const wchar_t* profile_name,
+    const wchar_t* key,
+    DWORD value) {
+  wchar_t value_str[kValueLength];
+
+  _snwprintf(value_str, kValueLength, L"%lu", value);
+  value_str[kValueLength - 1] = L'\0';
+
+  WritePrivateProfileStringW(profile_name, key, value_str, profiles_file_path);
+}
+
+static void WriteProfile(
+    const wchar_t* profiles_file_path,
+    const wchar_t* profile_name,
+    const struct AdmissionProfile* profile) {
+  WriteProfileValue(
+      profiles_file_path,
+      profile_name,
+      kPeakCommitKey,
+      (DWORD) (profile->peak_commit_size / kBytesPerKilobyte));
+  WriteProfileValue(
+      profiles_file_path,
+      profile_name,
+      kPeakWorkingSetKey,
+      (DWORD) (profile->peak_working_set_size / kBytesPerKilobyte));
+  WriteProfileValue(
+      profiles_file_path,
+      profile_name,
+      kNumRunsKey,
+      profile->num_runs);
+}
+
+static ULONGLONG DecayPeak(ULONGLONG history_size, ULONGLONG run_size) {
+  ULONGLONG decayed_size;
+
+  decayed_size = history_size - history_size / kDecayDivisor;
+
+  return (run_size > decayed_size) ? run_size : decayed_size;
+}
+
+static size_t CountFittingInstances(
+    ULONGLONG avail_size,
+    ULONGLONG reserved_size,
+    ULONGLONG instance_size) {
+  if (instance_size == 0) {
+    return (size_t) -1;
+  }
+
+  if (avail_size <= reserved_size) {
+    return 0;
+  }
+
+  return (size_t) ((avail_size - reserved_size) / instance_size);
+}
+
+/**
+ * Adds the memory that a running instance is still expected to take
+ * before it reaches the peaks. The whole peaks are added if the
+ * instance's use cannot be queried.
+ */
+static void AddExpectedGrowth(
+    HANDLE process,
+    ULONGLONG peak_commit_size,
+    ULONGLONG peak_working_set_size,
+    ULONGLONG* growth_commit_size,
+    ULONGLONG* growth_phys_size) {
+  struct ProcessMemoryCounters counters;
+
+  if (process == NULL || !QueryProcessMemory(process, &counters)) {
+    *growth_commit_size += peak_commit_size;
+    *growth_phys_size += peak_working_set_size;
+    return;
+  }
+
+  if (peak_commit_size > counters.pagefile_usage) {
+    *growth_commit_size += peak_commit_size - counters.pagefile_usage;
+  }
+
+  if (peak_working_set_size > counters.working_set_size) {
+    *growth_phys_size += peak_working_set_size - counters.working_set_size;
+  }
+}
+
+/**
+ * Adds the memory that the running instances of other runs are still
+ * expected to take, using the peaks that each run registered.
+ */
+static void AddOtherRunsGrowth(
+    struct InstanceRegistry* instance_registry,
+    ULONGLONG* growth_commit_size,
+    ULONGLONG* growth_phys_size) {
+  struct InstanceRegistry_Entry* entries;
+  size_t num_entries;
+  size_t i_entry;
+  HANDLE process;
+
+  entries = Mdc_malloc(InstanceRegistry_kCapacity * sizeof(entries[0]));
+  if (entries == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    return;
+  }
+
+  num_entries = InstanceRegistry_GetOtherInstances(
+      instance_registry,
+      entries,
+      InstanceRegistry_kCapacity);
+
+  for (i_entry = 0; i_entry < num_entries; ++i_entry) {
+    process = OpenProcess(
+        PROCESS_QUERY_INFORMATION | PROCESS_VM_READ,
+        FALSE,
+        entries[i_entry].process_id);
+
+    AddExpectedGrowth(
+        process,
+        entries[i_entry].expected_commit_size,
+        entries[i_entry].expected_working_set_size,
+        growth_commit_size,
+        growth_phys_size);
+
+    if (process != NULL) {
+      CloseHandle(process);
+    }
+  }
+
+  Mdc_free(entries);
+}
+
+/**
+ * Computes how many more instances fit, and which kind of memory limits
+ * them.
+ */
+static size_t ComputeFittingCount(
+    const struct Admission* admission,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_running,
+    ULONGLONG* avail_commit_size,
+    ULONGLONG* avail_phys_size,
+    enum LimitReason* limit_reason) {
+  size_t i_instance;
+  ULONGLONG growth_commit_size;
+  ULONGLONG growth_phys_size;
+  size_t num_by_commit;
+  size_t num_by_phys;
+
+  QueryAvailableMemory(avail_commit_size, avail_phys_size);
+
+  /*
+   * Running instances have not necessarily reached their peaks yet, so
+   * set aside the memory they are still expected to take.
+   */
+  growth_commit_size = 0;
+  growth_phys_size = 0;
+
+  for (i_instance = 0; i_instance < num_running; ++i_instance) {
+    if (IsProcessExited(processes_infos[i_instance].hProcess)) {
+      continue;
+    }
+
+    AddExpectedGrowth(
+        processes_infos[i_instance].hProcess,
+        admission->profile.peak_commit_size,
+        admission->profile.peak_working_set_size,
+        &growth_commit_size,
+        &growth_phys_size);
+  }
+
+  /* Other runs' instances grow into the same memory. */
+  if (admission->instance_registry != NULL) {
+    AddOtherRunsGrowth(
+        admission->instance_registry,
+        &growth_commit_size,
+        &growth_phys_size);
+  }
+
+  num_by_commit = CountFittingInstances(
+      *avail_commit_size,
+      growth_commit_size + admission->headroom_size,
+      admission->profile.peak_commit_size);
+  num_by_phys = CountFittingInstances(
+      *avail_phys_size,
+      growth_phys_size + admission->headroom_size,
+      admission->profile.peak_working_set_size);
+
+  if (num_by_commit <= num_by_phys) {
+    *limit_reason = kLimitReason_Commit;
+    return num_by_commit;
+  }
+
+  *limit_reason = kLimitReason_Physical;
+  return num_by_phys;
+}
+
+static void PrintLimitReason(
+    const struct Admission* admission,
+    ULONGLONG avail_commit_size,
+    ULONGLONG avail_phys_size,
+    enum LimitReason limit_reason) {
+  wprintf(
+      L"Each instance of profile %ls needs up to %lu MB committed and "
+          L"%lu MB resident. %lu MB of commit and %lu MB of physical "
+          L"memory are available, and %lu MB must remain free.\n",
+      admission->profile_name,
+      ToMegabytes(admission->profile.peak_commit_size),
+      ToMegabytes(admission->profile.peak_working_set_size),
+      ToMegabytes(avail_commit_size),
+      ToMegabytes(avail_phys_size),
+      ToMegabytes(admission->headroom_size));
+  wprintf(
+      L"The instances are limited by %ls.\n",
+      (limit_reason == kLimitReason_Commit)
+          ? L"the commit limit"
+          : L"physical memory");
+}
+
+/**
+ * External
+ */
+
+struct Admission* Admission_Init(
+    struct Admission* admission,
+    const wchar_t* profile_name,
+    DWORD headroom_mb,
+    enum Admission_Policy policy,
+    struct InstanceRegistry* instance_registry) {
+  wchar_t profiles_file_path[MAX_PATH];
+
+  admission->policy = policy;
+  admission->headroom_size = (ULONGLONG) headroom_mb * kBytesPerMegabyte;
+  admission->profile_name = profile_name;
+  admission->instance_registry = instance_registry;
+
+  admission->profile.peak_commit_size = 0;
+  admission->profile.peak_working_set_size = 0;
+  admission->profile.num_runs = 0;
+
+  if (GetProfilesFilePath(profiles_file_path)) {
+    ReadProfile(profiles_file_path, profile_name, &admission->profile);
+  }
+
+  InitMemoryInfoFunc();
+
+  return admission;
+}
+
+void Admission_Deinit(struct Admission* admission) {
+  DeinitMemoryInfoFunc();
+
+  admission->profile_name = NULL;
+  admission->instance_registry = NULL;
+}
+
+size_t Admission_ComputeCount(
+    struct Admission* admission,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_running,
+    size_t num_requested) {
+  size_t num_fitting;
+  ULONGLONG avail_commit_size;
+  ULONGLONG avail_phys_size;
+  enum LimitReason limit_reason;
+
+  if (admission->profile.num_runs == 0) {
+    wprintf(
+        L"Profile %ls has no memory history, so all %u instance(s) are "
+            L"admitted.\n\n",
+        admission->profile_name,
+        num_requested);
+    return num_requested;
+  }
+
+  num_fitting = ComputeFittingCount(
+      admission,
+      processes_infos,
+      num_running,
+      &avail_commit_size,
+      &avail_phys_size,
+      &limit_reason);
+
+  if (num_fitting >= num_requested) {
+    wprintf(
+        L"All %u instance(s) of profile %ls fit in memory, and are "
+            L"admitted.\n\n",
+        num_requested,
+        admission->profile_name);
+    return num_requested;
+  }
+
+  PrintLimitReason(admission, avail_commit_size, avail_phys_size, limit_reason);
+
+  if (admission->policy == Admission_kPolicy_Queue) {
+    wprintf(
+        L"%u of %u instance(s) are admitted now, and the rest are queued "
+            L"until memory frees up.\n\n",
+        num_fitting,
+        num_requested);
+  } else {
+    wprintf(
+        L"%u of %u instance(s) are admitted.\n\n",
+        num_fitting,
+        num_requested);
+  }
+
+  return num_fitting;
+}
+
+int Admission_WaitForRoom(
+    struct Admission* admission,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_running,
+    size_t instance_index) {
+  size_t i_instance;
+  HANDLE processes[MAXIMUM_WAIT_OBJECTS];
+  DWORD num_processes;
+  size_t num_fitting;
+  ULONGLONG avail_commit_size;
+  ULONGLONG avail_phys_size;
+  enum LimitReason limit_reason;
+  int is_waiting;
+
+  if (admission->profile.num_runs == 0) {
+    return 1;
+  }
+
+  is_waiting = 0;
+
+  for (;;) {
+    num_fitting = ComputeFittingCount(
+        admission,
+        processes_infos,
+        num_running,
+        &avail_commit_size,
+        &avail_phys_size,
+        &limit_reason);
+
+    if (num_fitting > 0) {
+      if (is_waiting) {
+        wprintf(L"Instance %u is admitted.\n\n", instance_index);
+      }
+
+      return 1;
+    }
+
+    num_processes = 0;
+    for (i_instance = 0;
+        i_instance < num_running && num_processes < MAXIMUM_WAIT_OBJECTS;
+        ++i_instance) {
+      if (!IsProcessExited(processes_infos[i_instance].hProcess)) {
+        processes[num_processes] = processes_infos[i_instance].hProcess;
+        num_processes += 1;
+      }
+    }
+
+    if (num_processes == 0) {
+      PrintLimitReason(
+          admission,
+          avail_commit_size,
+          avail_phys_size,
+          limit_reason);
+      wprintf(
+          L"Instance %u cannot be admitted, since no running instance is "
+              L"left to free memory.\n\n",
+          instance_index);
+      return 0;
+    }
+
+    if (!is_waiting) {
+      PrintLimitReason(
+          admission,
+          avail_commit_size,
+          avail_phys_size,
+          limit_reason);
+      wprintf(
+          L"Instance %u is queued until memory frees up.\n",
+          instance_index);
+      is_waiting = 1;
+    }
+
+    /* Memory frees up when an instance exits, or as instances trim. */
+    WaitForMultipleObjects(
+        num_processes,
+        processes,
+        FALSE,
+        Admission_kPollMilliseconds);
+  }
+}
+
+void Admission_RecordPeaks(
+    const wchar_t* profile_name,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_instances) {
+  size_t i_instance;
+  struct ProcessMemoryCounters counters;
+  ULONGLONG run_peak_commit_size;
+  ULONGLONG run_peak_working_set_size;
+  size_t num_recorded;
+  wchar_t profiles_file_path[MAX_PATH];
+  struct AdmissionProfile profile;
+
+  InitMemoryInfoFunc();
+
+  /*
+   * Instances that are still running have not necessarily reached
+   * their peaks, so only exited instances are recorded.
+   */
+  run_peak_commit_size = 0;
+  run_peak_working_set_size = 0;
+  num_recorded = 0;
+
+  for (i_instance = 0; i_instance < num_instances; ++i_instance) {
+    if (!IsProcessExited(processes_infos[i_instance].hProcess)) {
+      continue;
+    }
+
+    if (!QueryProcessMemory(processes_infos[i_instance].hProcess, &counters)) {
+      continue;
+    }
+
+    if (counters.peak_pagefile_usage > run_peak_commit_size) {
+      run_peak_commit_size = counters.peak_pagefile_usage;
+    }
+
+    if (counters.peak_working_set_size > run_peak_working_set_size) {
+      run_peak_working_set_size = counters.peak_working_set_size;
+    }
+
+    num_recorded += 1;
+  }
+
+  DeinitMemoryInfoFunc();
+
+  if (num_recorded == 0 || run_peak_commit_size == 0) {
+    return;
+  }
+
+  if (!GetProfilesFilePath(profiles_file_path)) {
+    return;
+  }
+
+  ReadProfile(profiles_file_path, profile_name, &profile);
+
+  profile.peak_commit_size = DecayPeak(
+      profile.peak_commit_size,
+      run_peak_commit_size);
+  profile.peak_working_set_size = DecayPeak(
+      profile.peak_working_set_size,
+      run_peak_working_set_size);
+  profile.num_runs += 1;
+
+  WriteProfile(profiles_file_path, profile_name, &profile);
+
+  wprintf(
+      L"Profile %ls now expects up to %lu MB committed and %lu MB "
+          L"resident per instance, from %u exited instance(s).\n\n",
+      profile_name,
+      ToMegabytes(profile.peak_commit_size),
+      ToMegabytes(profile.peak_working_set_size),
+      num_recorded);
+}
@@ -0,0 +1,128 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_ADMISSION_H_
+#define SGGL_ADMISSION_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#include "instance_registry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum {
+  /* How often a queued instance checks whether memory has freed up. */
+  Admission_kPollMilliseconds = 1000
+};
+
+enum Admission_Policy {
+  /* Opens only the instances that fit. */
+  Admission_kPolicy_Cap,
+
+  /* Opens the rest of the instances as memory frees up. */
+  Admission_kPolicy_Queue
+};
+
+/**
+ * Memory used by one instance of a game profile, learned from previous
+ * runs. Sizes are in bytes.
+ */
+struct AdmissionProfile {
+  ULONGLONG peak_commit_size;
+  ULONGLONG peak_working_set_size;
+  DWORD num_runs;
+};
+
+struct Admission {
+  enum Admission_Policy policy;
+  ULONGLONG headroom_size;
+
+  const wchar_t* profile_name;
+  struct AdmissionProfile profile;
+
+  struct InstanceRegistry* instance_registry;
+};
+
+/**
+ * Loads the profile's history. The headroom is the committed and
+ * physical memory, in megabytes, that must remain available after the
+ * instances reach their peaks. If the instance registry is not NULL,
+ * the growth of other runs' instances is set aside as well. Returns
+ * NULL on failure.
+ */
+struct Admission* Admission_Init(
+    struct Admission* admission,
+    const wchar_t* profile_name,
+    DWORD headroom_mb,
+    enum Admission_Policy policy,
+    struct InstanceRegistry* instance_registry);
+
+void Admission_Deinit(struct Admission* admission);
+
+/**
+ * Returns how many more instances, up to num_requested, fit in memory
+ * while keeping the headroom. Running instances are expected to grow to
+ * the profile's peaks. Prints the reason if fewer than num_requested
+ * fit. All instances fit if the profile has no history.
+ */
+size_t Admission_ComputeCount(
+    struct Admission* admission,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_running,
+    size_t num_requested);
+
+/**
+ * Waits until one more instance fits in memory. Returns zero if every
+ * running instance exits without enough memory becoming available.
+ */
+int Admission_WaitForRoom(
+    struct Admission* admission,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_running,
+    size_t instance_index);
+
+/**
+ * Adds the peak memory use of the instances that have exited to the
+ * profile's history.
+ */
+void Admission_RecordPeaks(
+    const wchar_t* profile_name,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_instances);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_ADMISSION_H_ */
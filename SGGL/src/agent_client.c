@@ -0,0 +1,487 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "agent_client.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+#include <mdc/wchar_t/filew.h>
+
+#include "agent_protocol.h"
+
+enum {
+  kObjectNameLength = 64
+};
+
+static void FormatObjectName(
+    wchar_t* object_name,
+    const wchar_t* name_format,
+    DWORD process_id) {
+  _snwprintf(object_name, kObjectNameLength, name_format, process_id);
+  object_name[kObjectNameLength - 1] = L'\0';
+}
+
+static DWORD PostCommand(
+    struct AgentClient* client,
+    enum AgentCommandType type,
+    ULONGLONG module,
+    const wchar_t* path) {
+  DWORD slot;
+  struct AgentCommand* command;
+
+  if (client->queue == NULL) {
+    return 0;
+  }
+
+  if (!AgentRing_GetWriteSlot(
+      &client->queue->command_indices,
+      Agent_kCommandCapacity,
+      &slot)) {
+    return 0;
+  }
+
+  command = &client->queue->commands[slot];
+
+  command->id = client->next_command_id;
+  command->type = type;
+  command->module = module;
+
+  if (path != NULL) {
+    wcsncpy(command->path, path, Agent_kPathLength - 1);
+    command->path[Agent_kPathLength - 1] = L'\0';
+  } else {
+    command->path[0] = L'\0';
+  }
+
+  AgentRing_CommitWrite(&client->queue->command_indices);
+  SetEvent(client->command_event);
+
+  client->next_command_id += 1;
+
+  return command->id;
+}
+
+/**
+ * External
+ */
+
+struct AgentClient* AgentClient_Init(
+    struct AgentClient* client,
+    DWORD process_id) {
+  wchar_t object_name[kObjectNameLength];
+
+  memset(client, 0, sizeof(*client));
+
+  FormatObjectName(object_name, AGENT_QUEUE_NAME_FORMAT, process_id);
+  client->queue_mapping = CreateFileMappingW(
+      INVALID_HANDLE_VALUE,
+      NULL,
+      PAGE_READWRITE,
+      0,
+      sizeof(*client->queue),
+      object_name);
+  if (client->queue_mapping == NULL) {
+    goto bad_return;
+  }
+
+  client->queue = MapViewOfFile(
+      client->queue_mapping,
+      FILE_MAP_WRITE,
+      0,
+      0,
+      sizeof(*client->queue));
+  if (client->queue == NULL) {
+    goto bad_close_queue_mapping;
+  }
+
+  memset(client->queue, 0, sizeof(*client->queue));
+  client->queue->version = Agent_kVersion;
+
+  FormatObjectName(object_name, AGENT_COMMAND_EVENT_NAME_FORMAT, process_id);
+  client->command_event = CreateEventW(NULL, FALSE, FALSE, object_name);
+  if (client->command_event == NULL) {
+    goto bad_unmap_queue;
+  }
+
+  FormatObjectName(object_name, AGENT_RESULT_EVENT_NAME_FORMAT, process_id);
+  client->result_event = CreateEventW(NULL, FALSE, FALSE, object_name);
+  if (client->result_event == NULL) {
+    goto bad_close_command_event;
+  }
+
+  /* Command ID 0 is reserved to indicate failure. */
+  client->next_command_id = 1;
+
+  return client;
+
+bad_close_command_event:
+  CloseHandle(client->command_event);
+  client->command_event = NULL;
+
+bad_unmap_queue:
+  UnmapViewOfFile(client->queue);
+  client->queue = NULL;
+
+bad_close_queue_mapping:
+  CloseHandle(client->queue_mapping);
+  client->queue_mapping = NULL;
+
+bad_return:
+  return NULL;
+}
+
+void AgentClient_Deinit(struct AgentClient* client) {
+  if (client->result_event != NULL) {
+    CloseHandle(client->result_event);
+    client->result_event = NULL;
+  }
+
+  if (client->command_event != NULL) {
+    CloseHandle(client->command_event);
+    client->command_event = NULL;
+  }
+
+  if (client->queue != NULL) {
+    UnmapViewOfFile(client->queue);
+    client->queue = NULL;
+  }
+
+  if (client->queue_mapping != NULL) {
+    CloseHandle(client->queue_mapping);
+    client->queue_mapping = NULL;
+  }
+
+  client->next_command_id = 0;
+}
+
+int AgentClient_WaitForStart(
+    struct AgentClient* client,
+    DWORD timeout_milliseconds) {
+  DWORD start_tick_count;
+  DWORD elapsed_milliseconds;
+
+  if (client->queue == NULL) {
+    return 0;
+  }
+
+  start_tick_count = GetTickCount();
+
+  /* The agent sets the result event after it writes its process ID. */
+  while (client->queue->agent_process_id == 0) {
+    elapsed_milliseconds = GetTickCount() - start_tick_count;
+    if (elapsed_milliseconds >= timeout_milliseconds) {
+      return 0;
+    }
+
+    WaitForSingleObject(
+        client->result_event,
+        timeout_milliseconds - elapsed_milliseconds);
+  }
+
+  return 1;
+}
+
+DWORD AgentClient_PostLoadLibrary(
+    struct AgentClient* client,
+    const wchar_t* library_path) {
+  return PostCommand(
+      client,
+      Agent_kCommandType_LoadLibrary,
+      0,
+      library_path);
+}
+
+DWORD AgentClient_PostFreeLibrary(
+    struct AgentClient* client,
+    ULONGLONG module) {
+  return PostCommand(client, Agent_kCommandType_FreeLibrary, module, NULL);
+}
+
+DWORD AgentClient_PostGetModuleHandle(
+    struct AgentClient* client,
+    const wchar_t* module_name) {
+  return PostCommand(
+      client,
+      Agent_kCommandType_GetModuleHandle,
+      0,
+      module_name);
+}
+
+DWORD AgentClient_PostStop(struct AgentClient* client) {
+  return PostCommand(client, Agent_kCommandType_Stop, 0, NULL);
+}
+
+int AgentClient_PopResult(
+    struct AgentClient* client,
+    struct AgentResult* result) {
+  DWORD slot;
+
+  if (client->queue == NULL) {
+    return 0;
+  }
+
+  if (!AgentRing_GetReadSlot(
+      &client->queue->result_indices,
+      Agent_kResultCapacity,
+      &slot)) {
+    return 0;
+  }
+
+  *result = client->queue->results[slot];
+  AgentRing_CommitRead(&client->queue->result_indices);
+
+  return 1;
+}
+
+int AgentClient_WaitForResult(
+    struct AgentClient* client,
+    struct AgentResult* result,
+    DWORD timeout_milliseconds) {
+  DWORD start_tick_count;
+  DWORD elapsed_milliseconds;
+
+  start_tick_count = GetTickCount();
+
+  while (!AgentClient_PopResult(client, result)) {
+    elapsed_milliseconds = GetTickCount() - start_tick_count;
+    if (elapsed_milliseconds >= timeout_milliseconds) {
+      return 0;
+    }
+
+    if (WaitForSingleObject(
+        client->result_event,
+        timeout_milliseconds - elapsed_milliseconds) == WAIT_FAILED) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+int AgentClient_LoadLibraries(
+    struct AgentClient* clients,
+    size_t num_instances,
+    const wchar_t** libraries_to_inject,
+    size_t num_libraries,
+    DWORD timeout_milliseconds,
+    struct InstanceResult* results) {
+  size_t i_library;
+  size_t i_process;
+
+  int is_all_success;
+  int* is_libraries_success;
+  size_t* next_libraries;
+  size_t* num_results;
+  DWORD* first_command_ids;
+
+  DWORD start_tick_count;
+  DWORD elapsed_milliseconds;
+  struct AgentResult result;
+
+  is_libraries_success = Mdc_malloc(
+      num_libraries * sizeof(is_libraries_success[0]));
+  next_libraries = Mdc_malloc(num_instances * sizeof(next_libraries[0]));
+  num_results = Mdc_malloc(num_instances * sizeof(num_results[0]));
+  first_command_ids = Mdc_malloc(
+      num_instances * sizeof(first_command_ids[0]));
+
+  if ((num_libraries > 0 && is_libraries_success == NULL)
+      || next_libraries == NULL
+      || num_results == NULL
+      || first_command_ids == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free;
+  }
+
+  for (i_library = 0; i_library < num_libraries; ++i_library) {
+    is_libraries_success[i_library] = 1;
+  }
+
+  /* The agents start in parallel, so they share one deadline. */
+  start_tick_count = GetTickCount();
+
+  for (i_process = 0; i_process < num_instances; ++i_process) {
+    next_libraries[i_process] = 0;
+    num_results[i_process] = 0;
+
+    elapsed_milliseconds = GetTickCount() - start_tick_count;
+
+    /* Instances without a running agent fail all of their libraries. */
+    if (elapsed_milliseconds >= timeout_milliseconds
+        || !AgentClient_WaitForStart(
+            &clients[i_process],
+            timeout_milliseconds - elapsed_milliseconds)) {
+      wprintf(
+          L"Agent did not start in instance %u.\n",
+          results[i_process].instance_number);
+
+      for (i_library = 0; i_library < num_libraries; ++i_library) {
+        is_libraries_success[i_library] = 0;
+      }
+
+      InstanceResult_SetFailed(
+          &results[i_process],
+          InstanceResult_kPhase_Inject,
+          L"AgentClient_WaitForStart",
+          WAIT_TIMEOUT);
+
+      next_libraries[i_process] = num_libraries;
+      num_results[i_process] = num_libraries;
+    }
+
+    first_command_ids[i_process] = clients[i_process].next_command_id;
+  }
+
+  for (;;) {
+    HANDLE pending_result_event;
+
+    /* Fill every instance's command queue before waiting on any result. */
+    for (i_process = 0; i_process < num_instances; ++i_process) {
+      while (next_libraries[i_process] < num_libraries) {
+        DWORD command_id;
+
+        command_id = AgentClient_PostLoadLibrary(
+            &clients[i_process],
+            libraries_to_inject[next_libraries[i_process]]);
+        if (command_id == 0) {
+          break;
+        }
+
+        next_libraries[i_process] += 1;
+      }
+    }
+
+    pending_result_event = NULL;
+
+    for (i_process = 0; i_process < num_instances; ++i_process) {
+      while (AgentClient_PopResult(&clients[i_process], &result)) {
+        i_library = result.command_id - first_command_ids[i_process];
+        if (i_library >= num_libraries) {
+          continue;
+        }
+
+        if (!result.is_success) {
+          wprintf(
+              L"Instance %u failed in LoadLibraryW through the agent, "
+                  L"error 0x%lX.\n",
+              results[i_process].instance_number,
+              result.last_error);
+
+          is_libraries_success[i_library] = 0;
+
+          InstanceResult_SetFailed(
+              &results[i_process],
+              InstanceResult_kPhase_Inject,
+              L"LoadLibraryW",
+              result.last_error);
+        }
+
+        num_results[i_process] += 1;
+      }
+
+      if (pending_result_event == NULL
+          && num_results[i_process] < num_libraries) {
+        pending_result_event = clients[i_process].result_event;
+      }
+    }
+
+    if (pending_result_event == NULL) {
+      break;
+    }
+
+    elapsed_milliseconds = GetTickCount() - start_tick_count;
+    if (elapsed_milliseconds >= timeout_milliseconds) {
+      break;
+    }
+
+    /*
+     * Results from other instances are collected on the next pass, so
+     * waiting on any single pending instance is enough.
+     */
+    WaitForSingleObject(
+        pending_result_event,
+        timeout_milliseconds - elapsed_milliseconds);
+  }
+
+  /* Libraries without a result have timed out. */
+  for (i_process = 0; i_process < num_instances; ++i_process) {
+    if (num_results[i_process] < num_libraries) {
+      wprintf(
+          L"Agent in instance %u timed out.\n",
+          results[i_process].instance_number);
+
+      for (i_library = 0; i_library < num_libraries; ++i_library) {
+        is_libraries_success[i_library] = 0;
+      }
+
+      InstanceResult_SetFailed(
+          &results[i_process],
+          InstanceResult_kPhase_Inject,
+          L"AgentClient_WaitForResult",
+          WAIT_TIMEOUT);
+    }
+  }
+
+  is_all_success = 1;
+
+  for (i_library = 0; i_library < num_libraries; ++i_library) {
+    if (is_libraries_success[i_library]) {
+      wprintf(
+          L"Successfully injected: %ls\n",
+          libraries_to_inject[i_library]);
+    } else {
+      wprintf(L"Failed to inject: %ls\n", libraries_to_inject[i_library]);
+    }
+
+    is_all_success = is_libraries_success[i_library] && is_all_success;
+  }
+
+  wprintf(L"\n");
+
+  Mdc_free(first_command_ids);
+  Mdc_free(num_results);
+  Mdc_free(next_libraries);
+  Mdc_free(is_libraries_success);
+
+  return is_all_success;
+
+bad_free:
+  Mdc_free(first_command_ids);
+  Mdc_free(num_results);
+  Mdc_free(next_libraries);
+  Mdc_free(is_libraries_success);
+
+  return 0;
+}
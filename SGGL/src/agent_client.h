@@ -0,0 +1,125 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_AGENT_CLIENT_H_
+#define SGGL_AGENT_CLIENT_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#include "agent_protocol.h"
+#include "instance_result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Loader side of the agent that runs inside of a game instance. The
+ * client must be initialized before the agent library is injected, so
+ * that the agent finds its queue when it starts.
+ */
+struct AgentClient {
+  HANDLE queue_mapping;
+  HANDLE command_event;
+  HANDLE result_event;
+
+  struct AgentQueue* queue;
+  DWORD next_command_id;
+};
+
+#define AGENT_CLIENT_UNINIT { 0 }
+
+enum {
+  AgentClient_kDefaultTimeoutMilliseconds = 30000
+};
+
+struct AgentClient* AgentClient_Init(
+    struct AgentClient* client,
+    DWORD process_id);
+
+void AgentClient_Deinit(struct AgentClient* client);
+
+/**
+ * Waits until the agent has started running in the game instance.
+ */
+int AgentClient_WaitForStart(
+    struct AgentClient* client,
+    DWORD timeout_milliseconds);
+
+/**
+ * Post functions return the ID of the posted command, or 0 if the
+ * command queue is full.
+ */
+DWORD AgentClient_PostLoadLibrary(
+    struct AgentClient* client,
+    const wchar_t* library_path);
+
+DWORD AgentClient_PostFreeLibrary(
+    struct AgentClient* client,
+    ULONGLONG module);
+
+DWORD AgentClient_PostGetModuleHandle(
+    struct AgentClient* client,
+    const wchar_t* module_name);
+
+DWORD AgentClient_PostStop(struct AgentClient* client);
+
+int AgentClient_PopResult(
+    struct AgentClient* client,
+    struct AgentResult* result);
+
+int AgentClient_WaitForResult(
+    struct AgentClient* client,
+    struct AgentResult* result,
+    DWORD timeout_milliseconds);
+
+/**
+ * Loads the libraries into every game instance through their agents.
+ * Commands are posted to all instances before any result is awaited,
+ * so the instances load their libraries in parallel. The timeout covers
+ * the whole call. An instance whose agent does not start, does not
+ * answer in time or fails to load a library is marked as failed in its
+ * result.
+ */
+int AgentClient_LoadLibraries(
+    struct AgentClient* clients,
+    size_t num_instances,
+    const wchar_t** libraries_to_inject,
+    size_t num_libraries,
+    DWORD timeout_milliseconds,
+    struct InstanceResult* results);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_AGENT_CLIENT_H_ */
@@ -0,0 +1,243 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+/**
+ * Entry point of the agent library, which is built as its own DLL and
+ * injected into every game instance when the loader runs in agent mode.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#include "agent_protocol.h"
+
+enum {
+  kObjectNameLength = 64,
+  kResultRingFullSleepMilliseconds = 10
+};
+
+static HMODULE agent_module;
+
+static void FormatObjectName(
+    wchar_t* object_name,
+    const wchar_t* name_format,
+    DWORD process_id) {
+  _snwprintf(object_name, kObjectNameLength, name_format, process_id);
+  object_name[kObjectNameLength - 1] = L'\0';
+}
+
+static HANDLE OpenAgentEvent(const wchar_t* name_format, DWORD process_id) {
+  wchar_t object_name[kObjectNameLength];
+
+  FormatObjectName(object_name, name_format, process_id);
+
+  return OpenEventW(
+      EVENT_MODIFY_STATE | SYNCHRONIZE,
+      FALSE,
+      object_name);
+}
+
+static void ExecuteCommand(
+    const struct AgentCommand* command,
+    struct AgentResult* result) {
+  HMODULE module;
+  BOOL is_success;
+
+  memset(result, 0, sizeof(*result));
+  result->command_id = command->id;
+  result->type = command->type;
+
+  switch (command->type) {
+    case Agent_kCommandType_LoadLibrary: {
+      module = LoadLibraryW(command->path);
+      result->module = (ULONG_PTR) module;
+      is_success = (module != NULL);
+      break;
+    }
+
+    case Agent_kCommandType_FreeLibrary: {
+      is_success = FreeLibrary((HMODULE) (ULONG_PTR) command->module);
+      break;
+    }
+
+    case Agent_kCommandType_GetModuleHandle: {
+      module = GetModuleHandleW(command->path);
+      result->module = (ULONG_PTR) module;
+      is_success = (module != NULL);
+      break;
+    }
+
+    case Agent_kCommandType_Stop: {
+      is_success = TRUE;
+      break;
+    }
+
+    default: {
+      SetLastError(ERROR_INVALID_FUNCTION);
+      is_success = FALSE;
+      break;
+    }
+  }
+
+  result->is_success = is_success;
+  result->last_error = is_success ? 0 : GetLastError();
+}
+
+static void PushResult(
+    struct AgentQueue* queue,
+    HANDLE result_event,
+    const struct AgentResult* result) {
+  DWORD slot;
+
+  /* Wait for the loader to make room for the result. */
+  while (!AgentRing_GetWriteSlot(
+      &queue->result_indices,
+      Agent_kResultCapacity,
+      &slot)) {
+    Sleep(kResultRingFullSleepMilliseconds);
+  }
+
+  queue->results[slot] = *result;
+  AgentRing_CommitWrite(&queue->result_indices);
+
+  SetEvent(result_event);
+}
+
+static DWORD WINAPI AgentThreadProc(void* parameter) {
+  DWORD process_id;
+  wchar_t object_name[kObjectNameLength];
+
+  HANDLE queue_mapping;
+  struct AgentQueue* queue;
+  HANDLE command_event;
+  HANDLE result_event;
+
+  int is_running;
+  DWORD slot;
+  struct AgentCommand command;
+  struct AgentResult result;
+
+  process_id = GetCurrentProcessId();
+
+  FormatObjectName(object_name, AGENT_QUEUE_NAME_FORMAT, process_id);
+
+  queue_mapping = OpenFileMappingW(FILE_MAP_WRITE, FALSE, object_name);
+  if (queue_mapping == NULL) {
+    goto bad_exit;
+  }
+
+  queue = MapViewOfFile(queue_mapping, FILE_MAP_WRITE, 0, 0, sizeof(*queue));
+  if (queue == NULL) {
+    goto bad_close_queue_mapping;
+  }
+
+  if (queue->version != Agent_kVersion) {
+    goto bad_unmap_queue;
+  }
+
+  command_event = OpenAgentEvent(AGENT_COMMAND_EVENT_NAME_FORMAT, process_id);
+  if (command_event == NULL) {
+    goto bad_unmap_queue;
+  }
+
+  result_event = OpenAgentEvent(AGENT_RESULT_EVENT_NAME_FORMAT, process_id);
+  if (result_event == NULL) {
+    goto bad_close_command_event;
+  }
+
+  /* Signal to the loader that the agent is running. */
+  InterlockedExchange((LONG*) &queue->agent_process_id, process_id);
+  SetEvent(result_event);
+
+  for (is_running = 1; is_running; ) {
+    if (WaitForSingleObject(command_event, INFINITE) == WAIT_FAILED) {
+      break;
+    }
+
+    while (is_running && AgentRing_GetReadSlot(
+        &queue->command_indices,
+        Agent_kCommandCapacity,
+        &slot)) {
+      command = queue->commands[slot];
+      AgentRing_CommitRead(&queue->command_indices);
+
+      ExecuteCommand(&command, &result);
+      PushResult(queue, result_event, &result);
+
+      is_running = (command.type != Agent_kCommandType_Stop);
+    }
+  }
+
+  CloseHandle(result_event);
+
+bad_close_command_event:
+  CloseHandle(command_event);
+
+bad_unmap_queue:
+  UnmapViewOfFile(queue);
+
+bad_close_queue_mapping:
+  CloseHandle(queue_mapping);
+
+bad_exit:
+  FreeLibraryAndExitThread(agent_module, 0);
+  return 0;
+}
+
+/**
+ * External
+ */
+
+BOOL WINAPI DllMain(HINSTANCE instance, DWORD reason, void* reserved) {
+  HANDLE agent_thread;
+
+  if (reason != DLL_PROCESS_ATTACH) {
+    return TRUE;
+  }
+
+  agent_module = instance;
+  DisableThreadLibraryCalls(instance);
+
+  /*
+   * The thread starts running once the loader lock is released, which
+   * happens after the injecting thread's LoadLibraryW returns.
+   */
+  agent_thread = CreateThread(NULL, 0, &AgentThreadProc, NULL, 0, NULL);
+  if (agent_thread == NULL) {
+    return FALSE;
+  }
+
+  CloseHandle(agent_thread);
+
+  return TRUE;
+}
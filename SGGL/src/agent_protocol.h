@@ -0,0 +1,133 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_AGENT_PROTOCOL_H_
+#define SGGL_AGENT_PROTOCOL_H_
+
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * The agent library is injected once into every game instance, and then
+ * runs a thread that executes commands posted by the loader. Commands
+ * and results are passed through two single-producer single-consumer
+ * rings in a named file mapping, where %lu is replaced by the game
+ * instance's process ID.
+ *
+ * All fields have fixed sizes so that a loader and an agent of
+ * different bitness agree on the layout.
+ */
+#define AGENT_QUEUE_NAME_FORMAT L"SGGL.Agent.%lu.Queue"
+#define AGENT_COMMAND_EVENT_NAME_FORMAT L"SGGL.Agent.%lu.Command"
+#define AGENT_RESULT_EVENT_NAME_FORMAT L"SGGL.Agent.%lu.Result"
+
+enum {
+  Agent_kVersion = 1,
+
+  /* Must be powers of two. */
+  Agent_kCommandCapacity = 32,
+  Agent_kResultCapacity = 32,
+
+  Agent_kPathLength = MAX_PATH,
+  Agent_kCacheLineSize = 64
+};
+
+enum AgentCommandType {
+  Agent_kCommandType_LoadLibrary = 1,
+  Agent_kCommandType_FreeLibrary = 2,
+  Agent_kCommandType_GetModuleHandle = 3,
+  Agent_kCommandType_Stop = 4
+};
+
+struct AgentCommand {
+  ULONGLONG module;
+  DWORD id;
+  DWORD type;
+  wchar_t path[Agent_kPathLength];
+};
+
+struct AgentResult {
+  ULONGLONG module;
+  DWORD command_id;
+  DWORD type;
+  DWORD is_success;
+  DWORD last_error;
+};
+
+struct AgentRingIndices {
+  volatile LONG write_index;
+  BYTE padding0[Agent_kCacheLineSize - sizeof(LONG)];
+
+  volatile LONG read_index;
+  BYTE padding1[Agent_kCacheLineSize - sizeof(LONG)];
+};
+
+struct AgentQueue {
+  DWORD version;
+  DWORD agent_process_id;
+  BYTE padding0[Agent_kCacheLineSize - 2 * sizeof(DWORD)];
+
+  /* Written by the loader, read by the agent. */
+  struct AgentRingIndices command_indices;
+  struct AgentCommand commands[Agent_kCommandCapacity];
+
+  /* Written by the agent, read by the loader. */
+  struct AgentRingIndices result_indices;
+  struct AgentResult results[Agent_kResultCapacity];
+};
+
+/**
+ * Ring operations, shared by the loader and the agent. A slot returned
+ * by a Get function is only owned by the caller until the matching
+ * Commit function is called.
+ */
+int AgentRing_GetWriteSlot(
+    const struct AgentRingIndices* indices,
+    DWORD capacity,
+    DWORD* slot);
+
+void AgentRing_CommitWrite(struct AgentRingIndices* indices);
+
+int AgentRing_GetReadSlot(
+    const struct AgentRingIndices* indices,
+    DWORD capacity,
+    DWORD* slot);
+
+void AgentRing_CommitRead(struct AgentRingIndices* indices);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_AGENT_PROTOCOL_H_ */
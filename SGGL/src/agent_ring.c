@@ -0,0 +1,84 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "agent_protocol.h"
+
+#include <windows.h>
+
+/**
+ * External
+ */
+
+int AgentRing_GetWriteSlot(
+    const struct AgentRingIndices* indices,
+    DWORD capacity,
+    DWORD* slot) {
+  LONG write_index;
+  LONG read_index;
+
+  write_index = indices->write_index;
+  read_index = indices->read_index;
+
+  if ((DWORD) (write_index - read_index) >= capacity) {
+    return 0;
+  }
+
+  *slot = (DWORD) write_index & (capacity - 1);
+
+  return 1;
+}
+
+void AgentRing_CommitWrite(struct AgentRingIndices* indices) {
+  /* Publish the slot only after it has been fully written. */
+  InterlockedExchange((LONG*) &indices->write_index, indices->write_index + 1);
+}
+
+int AgentRing_GetReadSlot(
+    const struct AgentRingIndices* indices,
+    DWORD capacity,
+    DWORD* slot) {
+  LONG write_index;
+  LONG read_index;
+
+  read_index = indices->read_index;
+  write_index = indices->write_index;
+
+  if (read_index == write_index) {
+    return 0;
+  }
+
+  *slot = (DWORD) read_index & (capacity - 1);
+
+  return 1;
+}
+
+void AgentRing_CommitRead(struct AgentRingIndices* indices) {
+  /* Release the slot only after it has been fully read. */
+  InterlockedExchange((LONG*) &indices->read_index, indices->read_index + 1);
+}
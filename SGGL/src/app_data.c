@@ -0,0 +1,97 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "app_data.h"
+
+#include <stddef.h>
+#include <windows.h>
+#include <shlwapi.h>
+
+#include <mdc/std/wchar.h>
+
+static const wchar_t* const kDirectoryName = L"SGGL";
+
+static int GetBaseDirectoryPath(wchar_t* path) {
+  DWORD get_environment_variable_result;
+  DWORD get_module_file_name_result;
+
+  /* LOCALAPPDATA is only set from Windows Vista. */
+  get_environment_variable_result = GetEnvironmentVariableW(
+      L"LOCALAPPDATA",
+      path,
+      MAX_PATH);
+  if (get_environment_variable_result > 0
+      && get_environment_variable_result < MAX_PATH) {
+    return 1;
+  }
+
+  get_environment_variable_result = GetEnvironmentVariableW(
+      L"APPDATA",
+      path,
+      MAX_PATH);
+  if (get_environment_variable_result > 0
+      && get_environment_variable_result < MAX_PATH) {
+    return 1;
+  }
+
+  get_module_file_name_result = GetModuleFileNameW(NULL, path, MAX_PATH);
+  if (get_module_file_name_result == 0
+      || get_module_file_name_result >= MAX_PATH) {
+    return 0;
+  }
+
+  PathRemoveFileSpecW(path);
+
+  return 1;
+}
+
+/**
+ * External
+ */
+
+int AppData_GetFilePath(wchar_t* path, const wchar_t* file_name) {
+  wchar_t directory_path[MAX_PATH];
+  BOOL is_create_directory_success;
+
+  if (!GetBaseDirectoryPath(directory_path)) {
+    return 0;
+  }
+
+  if (!PathAppendW(directory_path, kDirectoryName)) {
+    return 0;
+  }
+
+  is_create_directory_success = CreateDirectoryW(directory_path, NULL);
+  if (!is_create_directory_success
+      && GetLastError() != ERROR_ALREADY_EXISTS) {
+    return 0;
+  }
+
+  return PathCombineW(path, directory_path, file_name) != NULL;
+}
@@ -30,9 +30,12 @@
 #include "args_parser.h"
 
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wctype.h>
 #include <windows.h>
+#include <shlwapi.h>
 
 #include <mdc/error/exit_on_error.h>
 #include <mdc/malloc/malloc.h>
@@ -41,11 +44,141 @@
 #include <mdc/wchar_t/filew.h>
 
 #include "game_loader.h"
+#include "monitor.h"
+#include "resume_scheduler.h"
 
 /**
  * Validation function
  */
 
+static void ParseAttachImageName(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Point to the image name of the processes to attach to. */
+  args->attach_image_name = argv[*i_arg + 1];
+
+  ++(*i_arg);
+}
+
+static void ParseAttachProcessIds(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  const wchar_t* process_id_str;
+  wchar_t* process_id_str_end;
+
+  /* Determine the IDs of the processes to attach to. */
+  process_id_str = argv[*i_arg + 1];
+  args->num_attach_process_ids = 0;
+
+  do {
+    args->attach_process_ids[args->num_attach_process_ids] =
+        wcstoul(process_id_str, &process_id_str_end, 10);
+    args->num_attach_process_ids += 1;
+
+    process_id_str = process_id_str_end + 1;
+  } while (*process_id_str_end == L','
+      && args->num_attach_process_ids < Attach_kMaxProcesses);
+
+  ++(*i_arg);
+}
+
+static void ParseBoxDirectoryPath(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Point to the directory that holds the instance boxes. */
+  args->box_directory_path = argv[*i_arg + 1];
+
+  ++(*i_arg);
+}
+
+static void ParseBoxEnvironmentPath(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Point to the path of the environment template. */
+  args->box_environment_path = argv[*i_arg + 1];
+
+  ++(*i_arg);
+}
+
+static void ParseBoxWritableListPath(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Point to the path of the list of writable files. */
+  args->box_writable_list_path = argv[*i_arg + 1];
+
+  ++(*i_arg);
+}
+
+static void ParseCaptureOutputPath(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Point to the directory that the output logs are written into. */
+  args->capture_output_directory_path = argv[*i_arg + 1];
+
+  ++(*i_arg);
+}
+
+static void ParseDeferTrigger(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  const wchar_t* trigger_name;
+
+  /* Determine what the deferred libraries wait for. */
+  trigger_name = argv[*i_arg + 1];
+
+  if (wcscmp(trigger_name, L"window") == 0) {
+    args->defer_trigger = DeferredInjector_kTrigger_Window;
+  } else if (wcscmp(trigger_name, L"ready") == 0) {
+    args->defer_trigger = DeferredInjector_kTrigger_Ready;
+  } else {
+    args->defer_trigger = DeferredInjector_kTrigger_Idle;
+  }
+
+  ++(*i_arg);
+}
+
+static void ParseDeferredLibraryPath(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Manage all points to libraries that will be injected after resume. */
+  if (args->deferred_library_paths_capacity
+      <= args->deferred_library_paths_count) {
+    wprintf(
+        L"Library count changed during execution. Please run the program "
+            L"again.\n\n");
+    args->is_parse_failed = 1;
+    goto bad_return;
+  }
+
+  args->deferred_library_paths[args->deferred_library_paths_count] =
+      argv[*i_arg + 1];
+
+  args->deferred_library_paths_count += 1;
+
+  ++(*i_arg);
+
+  return;
+
+bad_return:
+  return;
+}
+
 static void ParseGamePath(
     struct ParsedArgs* args,
     int* i_arg,
@@ -68,34 +201,243 @@ static void ParseGameArg(
   ++(*i_arg);
 }
 
-static void ParseInjectLibraryPath(
+/**
+ * Adds the library to the instances of the set. A library that is
+ * already listed is only added to the instances it did not have.
+ */
+static void AddInjectLibrary(
     struct ParsedArgs* args,
-    int* i_arg,
-    int argc,
-    const wchar_t* const* argv) {
+    const wchar_t* library_path,
+    const struct LibrarySet* library_set) {
+  size_t i;
+
+  for (i = 0; i < args->inject_library_paths_count; ++i) {
+    if (_wcsicmp(args->inject_library_paths[i], library_path) == 0) {
+      LibrarySet_Merge(&args->inject_library_sets[i], library_set);
+      return;
+    }
+  }
+
   /* Manage all points to libraries that will be injected. */
   if (args->inject_library_paths_capacity
       <= args->inject_library_paths_count) {
-    Mdc_Error_ExitOnGeneralError(
-        L"Error",
+    wprintf(
         L"Library count changed during execution. Please run the program "
-            L"again.",
-        __FILEW__,
-        __LINE__);
+            L"again.\n\n");
+    args->is_parse_failed = 1;
     goto bad_return;
   }
 
   args->inject_library_paths[args->inject_library_paths_count] =
-      argv[*i_arg + 1];
+      library_path;
+  args->inject_library_sets[args->inject_library_paths_count] =
+      *library_set;
 
   args->inject_library_paths_count += 1;
 
+  return;
+
+bad_return:
+  return;
+}
+
+/**
+ * Makes room for libraries that the validator could not count, which
+ * are only known once their directory is listed.
+ */
+static int ReserveInjectLibraries(struct ParsedArgs* args, size_t num_more) {
+  const wchar_t** library_paths;
+  struct LibrarySet* library_sets;
+  size_t capacity;
+
+  capacity = args->inject_library_paths_count + num_more;
+  if (capacity <= args->inject_library_paths_capacity) {
+    return 1;
+  }
+
+  library_paths = Mdc_malloc(capacity * sizeof(library_paths[0]));
+  library_sets = Mdc_malloc(capacity * sizeof(library_sets[0]));
+  if (library_paths == NULL || library_sets == NULL) {
+    Mdc_free(library_paths);
+    Mdc_free(library_sets);
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    return 0;
+  }
+
+  memcpy(
+      library_paths,
+      args->inject_library_paths,
+      args->inject_library_paths_count * sizeof(library_paths[0]));
+  memcpy(
+      library_sets,
+      args->inject_library_sets,
+      args->inject_library_paths_count * sizeof(library_sets[0]));
+
+  Mdc_free(args->inject_library_paths);
+  Mdc_free(args->inject_library_sets);
+
+  args->inject_library_paths = library_paths;
+  args->inject_library_sets = library_sets;
+  args->inject_library_paths_capacity = capacity;
+
+  return 1;
+}
+
+/**
+ * Keeps the listing, which owns the paths of its libraries, until the
+ * args are deinitialized.
+ */
+static int AddLibraryDiscovery(
+    struct ParsedArgs* args,
+    const struct LibraryDiscovery* discovery) {
+  struct LibraryDiscovery* library_discoveries;
+
+  library_discoveries = Mdc_malloc(
+      (args->library_discoveries_count + 1)
+          * sizeof(library_discoveries[0]));
+  if (library_discoveries == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    return 0;
+  }
+
+  if (args->library_discoveries_count > 0) {
+    memcpy(
+        library_discoveries,
+        args->library_discoveries,
+        args->library_discoveries_count * sizeof(library_discoveries[0]));
+  }
+
+  library_discoveries[args->library_discoveries_count] = *discovery;
+
+  Mdc_free(args->library_discoveries);
+  args->library_discoveries = library_discoveries;
+  args->library_discoveries_count += 1;
+
+  return 1;
+}
+
+static void ParseInjectLibraryPath(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  struct LibrarySet library_set;
+
+  LibrarySet_InitAll(&library_set);
+  AddInjectLibrary(args, argv[*i_arg + 1], &library_set);
+
+  ++(*i_arg);
+}
+
+static void ParseLibraryDirectory(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  struct LibraryDiscovery discovery;
+  struct LibraryDiscovery* init_discovery_result;
+  const struct LibraryDiscovery* added_discovery;
+  struct LibrarySet library_set;
+  size_t i_library;
+
+  /* Inject every library found in the directory or pattern. */
+  init_discovery_result = LibraryDiscovery_Init(
+      &discovery,
+      argv[*i_arg + 1]);
+  if (init_discovery_result == NULL) {
+    args->is_parse_failed = 1;
+    goto bad_return;
+  }
+
+  if (!AddLibraryDiscovery(args, &discovery)) {
+    LibraryDiscovery_Deinit(&discovery);
+    goto bad_return;
+  }
+
+  if (!ReserveInjectLibraries(args, discovery.num_libraries)) {
+    goto bad_return;
+  }
+
+  added_discovery =
+      &args->library_discoveries[args->library_discoveries_count - 1];
+
+  LibrarySet_InitAll(&library_set);
+  for (i_library = 0;
+      i_library < added_discovery->num_libraries;
+      ++i_library) {
+    AddInjectLibrary(
+        args,
+        added_discovery->library_paths[i_library],
+        &library_set);
+  }
+
   ++(*i_arg);
 
   return;
 
 bad_return:
-  return;
+  ++(*i_arg);
+}
+
+static void ParseInstanceLibrary(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  struct LibrarySet library_set;
+  const wchar_t* library_path;
+
+  /* Inject the library into only some of the instances. */
+  LibrarySet_InitFromSpec(&library_set, argv[*i_arg + 1], &library_path);
+  AddInjectLibrary(args, library_path, &library_set);
+
+  ++(*i_arg);
+}
+
+static void ParseJobCpuRate(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Determine the percentage of total CPU time the job may use. */
+  args->is_job_enabled = 1;
+  args->job_limits.cpu_rate_percent = wcstoul(argv[*i_arg + 1], NULL, 10);
+
+  ++(*i_arg);
+}
+
+static void ParseJobKillOnClose(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  args->is_job_enabled = 1;
+  args->job_limits.is_kill_on_close = 1;
+}
+
+static void ParseJobMemoryLimit(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Determine the committed memory limit of all instances together. */
+  args->is_job_enabled = 1;
+  args->job_limits.job_memory_limit_mb = wcstoul(argv[*i_arg + 1], NULL, 10);
+
+  ++(*i_arg);
+}
+
+static void ParseJobProcessMemoryLimit(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Determine the committed memory limit of each instance. */
+  args->is_job_enabled = 1;
+  args->job_limits.process_memory_limit_mb =
+      wcstoul(argv[*i_arg + 1], NULL, 10);
+
+  ++(*i_arg);
 }
 
 static void ParseKnowledgeLibraryPath(
@@ -109,6 +451,36 @@ static void ParseKnowledgeLibraryPath(
   ++(*i_arg);
 }
 
+static void ParseAdmissionPolicy(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  const wchar_t* policy_name;
+
+  /* Determine what happens to instances that do not fit in memory. */
+  policy_name = argv[*i_arg + 1];
+
+  if (wcscmp(policy_name, L"queue") == 0) {
+    args->admission_policy = Admission_kPolicy_Queue;
+  } else {
+    args->admission_policy = Admission_kPolicy_Cap;
+  }
+
+  ++(*i_arg);
+}
+
+static void ParseAgentLibraryPath(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Point to the agent library path */
+  args->agent_library_path = argv[*i_arg + 1];
+
+  ++(*i_arg);
+}
+
 static void ParseNumInstances(
     struct ParsedArgs* args,
     int* i_arg,
@@ -125,8 +497,10 @@ static void ParseNumInstances(
       : 1;
 
   /*
-   * Prevent opening more than 8 instances at once. Doing so
-   * prevents the user from accidental resource hogging.
+   * Prevent opening more than 64 instances at once. Doing so
+   * prevents the user from accidental resource hogging. Use
+   * --memory-headroom to limit the instances by available memory, and
+   * --host-max-instances to limit the instances of every run together.
    */
   args->num_instances = (args->num_instances <= GameLoader_kMaxInstances)
       ? args->num_instances
@@ -135,6 +509,240 @@ static void ParseNumInstances(
   ++(*i_arg);
 }
 
+static void ParseInjectMode(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Determine how libraries are placed into the game processes. */
+  args->inject_mode = (wcscmp(argv[*i_arg + 1], L"import-table") == 0)
+      ? LibraryInjector_kMode_ImportTable
+      : LibraryInjector_kMode_RemoteThread;
+
+  ++(*i_arg);
+}
+
+static void ParseHostMaxInstances(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Determine how many instances may run from every run of the loader. */
+  args->host_max_instances = wcstoul(argv[*i_arg + 1], NULL, 10);
+
+  ++(*i_arg);
+}
+
+static void ParseMemoryHeadroom(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Determine how much memory must remain free after admission. */
+  args->memory_headroom_mb = wcstoul(argv[*i_arg + 1], NULL, 10);
+
+  ++(*i_arg);
+}
+
+static void ParseMetricsTextfilePath(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Point to the path of the file to write metrics into. */
+  args->metrics_textfile_path = argv[*i_arg + 1];
+
+  ++(*i_arg);
+}
+
+static void ParseMetricsPort(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Determine the localhost port to serve metrics on. */
+  args->metrics_port = (unsigned short) wcstoul(argv[*i_arg + 1], NULL, 10);
+
+  ++(*i_arg);
+}
+
+static void ParseMonitorCsvPath(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Point to the path of the CSV file to write samples into. */
+  args->monitor_csv_path = argv[*i_arg + 1];
+
+  ++(*i_arg);
+}
+
+static void ParseMonitorInterval(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Determine how often each instance is sampled. */
+  args->monitor_interval_milliseconds = wcstoul(argv[*i_arg + 1], NULL, 10);
+
+  ++(*i_arg);
+}
+
+static void ParsePipelined(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  args->is_pipelined = 1;
+}
+
+static void ParsePlacementPolicy(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  const wchar_t* policy_name;
+
+  /* Determine how instances are assigned to processor cores. */
+  policy_name = argv[*i_arg + 1];
+
+  if (wcscmp(policy_name, L"round-robin") == 0) {
+    args->placement_policy = Placement_kPolicy_RoundRobin;
+  } else if (wcscmp(policy_name, L"packed") == 0) {
+    args->placement_policy = Placement_kPolicy_Packed;
+  } else if (wcscmp(policy_name, L"numa") == 0) {
+    args->placement_policy = Placement_kPolicy_Numa;
+  } else {
+    args->placement_policy = Placement_kPolicy_None;
+  }
+
+  ++(*i_arg);
+}
+
+static void ParsePrefetch(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  args->is_prefetch_enabled = 1;
+}
+
+static void ParsePrefetchListPath(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Point to the path of the list of files to prefetch. */
+  args->is_prefetch_enabled = 1;
+  args->prefetch_list_path = argv[*i_arg + 1];
+
+  ++(*i_arg);
+}
+
+static void ParseProfileName(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Point to the name of the game profile. */
+  args->profile_name = argv[*i_arg + 1];
+
+  ++(*i_arg);
+}
+
+static void ParseReadyTimeout(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Determine how long to wait for instances to report ready. */
+  args->ready_timeout_milliseconds = wcstoul(argv[*i_arg + 1], NULL, 10);
+
+  ++(*i_arg);
+}
+
+static void ParseResumeWaveSize(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Determine how many instances are resumed in the first wave. */
+  args->resume_wave_size = wcstoul(argv[*i_arg + 1], NULL, 10);
+
+  args->resume_wave_size = (args->resume_wave_size >= 1)
+      ? args->resume_wave_size
+      : 1;
+
+  ++(*i_arg);
+}
+
+static void ParseSampleDirectoryPath(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Point to the directory that the sampled stacks are written into. */
+  args->sample_directory_path = argv[*i_arg + 1];
+
+  ++(*i_arg);
+}
+
+static void ParseSampleInstances(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Determine which instances are sampled. */
+  LibrarySet_InitFromList(&args->sample_instance_set, argv[*i_arg + 1]);
+
+  ++(*i_arg);
+}
+
+static void ParseSampleRate(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Determine how many times per second the stacks are sampled. */
+  args->sample_rate = wcstoul(argv[*i_arg + 1], NULL, 10);
+
+  ++(*i_arg);
+}
+
+static void ParseTraceRecordPath(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Point to the path of the trace file to record into. */
+  args->trace_record_path = argv[*i_arg + 1];
+
+  ++(*i_arg);
+}
+
+static void ParseTraceReplayPath(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Point to the path of the trace file to replay from. */
+  args->trace_replay_path = argv[*i_arg + 1];
+
+  ++(*i_arg);
+}
+
+static void ParseWaveTimeout(
+    struct ParsedArgs* args,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  /* Determine how long to wait for a wave to become ready. */
+  args->resume_wave_timeout_milliseconds =
+      wcstoul(argv[*i_arg + 1], NULL, 10);
+
+  ++(*i_arg);
+}
+
 /**
  * Parse table
  */
@@ -163,11 +771,47 @@ static int ArgParseFuncTableEntry_CompareKeyAsVoid(
 }
 
 static const struct ArgParseFuncTableEntry kArgParseFuncSortedTable[] = {
+    { L"--admission", &ParseAdmissionPolicy },
+    { L"--agent", &ParseAgentLibraryPath },
+    { L"--attach-image", &ParseAttachImageName },
+    { L"--attach-pid", &ParseAttachProcessIds },
+    { L"--box-directory", &ParseBoxDirectoryPath },
+    { L"--box-environment", &ParseBoxEnvironmentPath },
+    { L"--box-writable-list", &ParseBoxWritableListPath },
+    { L"--capture-output", &ParseCaptureOutputPath },
+    { L"--defer-until", &ParseDeferTrigger },
+    { L"--deferred-library", &ParseDeferredLibraryPath },
     { L"--game", &ParseGamePath },
     { L"--gameargs", &ParseGameArg },
+    { L"--host-max-instances", &ParseHostMaxInstances },
+    { L"--inject-mode", &ParseInjectMode },
+    { L"--instance-library", &ParseInstanceLibrary },
+    { L"--job-cpu-rate", &ParseJobCpuRate },
+    { L"--job-kill-on-close", &ParseJobKillOnClose },
+    { L"--job-memory", &ParseJobMemoryLimit },
+    { L"--job-process-memory", &ParseJobProcessMemoryLimit },
     { L"--knowledge", &ParseKnowledgeLibraryPath },
     { L"--library", &ParseInjectLibraryPath },
+    { L"--library-dir", &ParseLibraryDirectory },
+    { L"--memory-headroom", &ParseMemoryHeadroom },
+    { L"--metrics-file", &ParseMetricsTextfilePath },
+    { L"--metrics-port", &ParseMetricsPort },
+    { L"--monitor", &ParseMonitorCsvPath },
+    { L"--monitor-interval", &ParseMonitorInterval },
     { L"--num-instances", &ParseNumInstances },
+    { L"--pipeline", &ParsePipelined },
+    { L"--placement", &ParsePlacementPolicy },
+    { L"--prefetch", &ParsePrefetch },
+    { L"--prefetch-list", &ParsePrefetchListPath },
+    { L"--profile", &ParseProfileName },
+    { L"--ready-timeout", &ParseReadyTimeout },
+    { L"--resume-waves", &ParseResumeWaveSize },
+    { L"--sample", &ParseSampleDirectoryPath },
+    { L"--sample-instances", &ParseSampleInstances },
+    { L"--sample-rate", &ParseSampleRate },
+    { L"--trace-record", &ParseTraceRecordPath },
+    { L"--trace-replay", &ParseTraceReplayPath },
+    { L"--wave-timeout", &ParseWaveTimeout },
 
     { L"-a", &ParseGameArg },
     { L"-g", &ParseGamePath },
@@ -227,31 +871,141 @@ struct ParsedArgs* ParsedArgs_InitFromArgv(
     goto bad_return;
   }
 
+  args->inject_library_sets = Mdc_malloc(
+      num_libraries * sizeof(args->inject_library_sets[0]));
+  if (args->inject_library_sets == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_inject_library_paths;
+  }
+
   args->inject_library_paths_capacity = num_libraries;
+
+  args->library_discoveries = NULL;
+  args->library_discoveries_count = 0;
+
+  /*
+   * The deferred libraries are counted with the other libraries, so
+   * that either list can hold all of them.
+   */
+  args->deferred_library_paths_count = 0;
+  args->deferred_library_paths = Mdc_malloc(
+      num_libraries * sizeof(args->deferred_library_paths[0]));
+  if (args->deferred_library_paths == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_inject_library_sets;
+  }
+
+  args->deferred_library_paths_capacity = num_libraries;
+  args->defer_trigger = DeferredInjector_kTrigger_Idle;
   args->num_instances = 1;
+  args->host_max_instances = InstanceRegistry_kDefaultMaxInstances;
+  args->monitor_interval_milliseconds = Monitor_kDefaultIntervalMilliseconds;
+  args->resume_wave_timeout_milliseconds =
+      ResumeScheduler_kDefaultWaveTimeoutMilliseconds;
+  LibrarySet_InitAll(&args->sample_instance_set);
+  args->sample_rate = StackSampler_kDefaultRate;
+  args->is_parse_failed = 0;
 
   for (i_arg = 1; i_arg < argc; ++i_arg) {
     ParseArg(args, &i_arg, argc, argv);
   }
 
+  /* The options are reported as they are parsed. */
+  if (args->is_parse_failed) {
+    ParsedArgs_Deinit(args);
+    goto bad_return;
+  }
+
+  /* Name the profile after the game executable if not specified. */
+  if (args->profile_name == NULL && args->game_path != NULL) {
+    args->profile_name = PathFindFileNameW(args->game_path);
+  }
+
   return args;
 
+bad_free_inject_library_sets:
+  Mdc_free(args->inject_library_sets);
+  args->inject_library_sets = NULL;
+
+bad_free_inject_library_paths:
+  Mdc_free(args->inject_library_paths);
+  args->inject_library_paths = NULL;
+
 bad_return:
   return NULL;
 }
 
 void ParsedArgs_Deinit(struct ParsedArgs* args) {
+  size_t i;
+
   args->game_path = NULL;
   args->game_args = NULL;
 
+  args->num_attach_process_ids = 0;
+  args->attach_image_name = NULL;
+
+  args->box_directory_path = NULL;
+  args->box_writable_list_path = NULL;
+  args->box_environment_path = NULL;
+
+  args->capture_output_directory_path = NULL;
+
   Mdc_free(args->inject_library_paths);
   args->inject_library_paths = NULL;
+  Mdc_free(args->inject_library_sets);
+  args->inject_library_sets = NULL;
   args->inject_library_paths_capacity = 0;
   args->inject_library_paths_count = 0;
 
+  for (i = 0; i < args->library_discoveries_count; ++i) {
+    LibraryDiscovery_Deinit(&args->library_discoveries[i]);
+  }
+  Mdc_free(args->library_discoveries);
+  args->library_discoveries = NULL;
+  args->library_discoveries_count = 0;
+
+  Mdc_free(args->deferred_library_paths);
+  args->deferred_library_paths = NULL;
+  args->deferred_library_paths_capacity = 0;
+  args->deferred_library_paths_count = 0;
+  args->defer_trigger = DeferredInjector_kTrigger_Idle;
+
   args->num_instances = 0;
+  args->host_max_instances = 0;
+  args->memory_headroom_mb = 0;
+  args->admission_policy = Admission_kPolicy_Cap;
+  args->is_prefetch_enabled = 0;
+  args->prefetch_list_path = NULL;
+  args->is_pipelined = 0;
+  args->resume_wave_size = 0;
+  args->resume_wave_timeout_milliseconds = 0;
+  args->placement_policy = Placement_kPolicy_None;
+
+  args->is_job_enabled = 0;
+  args->job_limits.process_memory_limit_mb = 0;
+  args->job_limits.job_memory_limit_mb = 0;
+  args->job_limits.cpu_rate_percent = 0;
+  args->job_limits.is_kill_on_close = 0;
 
   args->knowledge_library_path = NULL;
+  args->agent_library_path = NULL;
+  args->inject_mode = LibraryInjector_kMode_RemoteThread;
+
+  args->profile_name = NULL;
+  args->ready_timeout_milliseconds = 0;
+
+  args->metrics_textfile_path = NULL;
+  args->metrics_port = 0;
+
+  args->monitor_csv_path = NULL;
+  args->monitor_interval_milliseconds = 0;
+
+  args->sample_directory_path = NULL;
+  LibrarySet_InitAll(&args->sample_instance_set);
+  args->sample_rate = 0;
+
+  args->trace_record_path = NULL;
+  args->trace_replay_path = NULL;
 
   *args = ParsedArgs_kUninit;
 }
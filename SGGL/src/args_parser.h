@@ -35,6 +35,17 @@
 
 #include <mdc/std/wchar.h>
 
+#include "admission.h"
+#include "attach.h"
+#include "deferred_injector.h"
+#include "instance_job.h"
+#include "instance_registry.h"
+#include "library_discovery.h"
+#include "library_injector.h"
+#include "library_set.h"
+#include "placement.h"
+#include "stack_sampler.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -43,13 +54,70 @@ struct ParsedArgs {
   const wchar_t* game_path;
   const wchar_t* game_args;
 
+  DWORD attach_process_ids[Attach_kMaxProcesses];
+  size_t num_attach_process_ids;
+  const wchar_t* attach_image_name;
+
+  const wchar_t* box_directory_path;
+  const wchar_t* box_writable_list_path;
+  const wchar_t* box_environment_path;
+
+  const wchar_t* capture_output_directory_path;
+
+  /*
+   * Each library is listed once, with the set of instances that it is
+   * injected into.
+   */
   const wchar_t** inject_library_paths;
+  struct LibrarySet* inject_library_sets;
   size_t inject_library_paths_capacity;
   size_t inject_library_paths_count;
 
+  /* Listings of the library directories, which own their paths. */
+  struct LibraryDiscovery* library_discoveries;
+  size_t library_discoveries_count;
+
+  const wchar_t** deferred_library_paths;
+  size_t deferred_library_paths_capacity;
+  size_t deferred_library_paths_count;
+  enum DeferredInjector_Trigger defer_trigger;
+
   size_t num_instances;
+  size_t host_max_instances;
+  DWORD memory_headroom_mb;
+  enum Admission_Policy admission_policy;
+  int is_prefetch_enabled;
+  const wchar_t* prefetch_list_path;
+  int is_pipelined;
+  size_t resume_wave_size;
+  DWORD resume_wave_timeout_milliseconds;
+  enum Placement_Policy placement_policy;
+
+  int is_job_enabled;
+  struct InstanceJobLimits job_limits;
 
   const wchar_t* knowledge_library_path;
+  const wchar_t* agent_library_path;
+  enum LibraryInjector_Mode inject_mode;
+
+  const wchar_t* profile_name;
+  DWORD ready_timeout_milliseconds;
+
+  const wchar_t* metrics_textfile_path;
+  unsigned short metrics_port;
+
+  const wchar_t* monitor_csv_path;
+  DWORD monitor_interval_milliseconds;
+
+  const wchar_t* sample_directory_path;
+  struct LibrarySet sample_instance_set;
+  DWORD sample_rate;
+
+  const wchar_t* trace_record_path;
+  const wchar_t* trace_replay_path;
+
+  /* Set if an option could not be used, such as an unreadable directory. */
+  int is_parse_failed;
 };
 
 #define PARSED_ARGS_UNINIT { 0 }
@@ -34,108 +34,946 @@
 #include <mdc/std/assert.h>
 #include <mdc/std/wchar.h>
 
+#include "instance_registry.h"
+#include "library_set.h"
+#include "stack_sampler.h"
+
 struct ArgsValidationResults {
   int is_game_path_found;
   int is_game_args_found;
   int is_num_instances_found;
+  int is_host_max_instances_found;
   int is_knowledge_library_path_found;
+  int is_agent_library_path_found;
+  int is_attach_image_name_found;
+  int is_attach_process_ids_found;
+  int is_box_directory_path_found;
+  int is_box_environment_path_found;
+  int is_box_writable_list_path_found;
+  int is_capture_output_path_found;
+  int is_defer_trigger_found;
+  int is_defer_until_ready;
+  int is_deferred_library_path_found;
+  int is_sample_directory_path_found;
+  int is_sample_instances_found;
+  int is_sample_rate_found;
+  int is_trace_record_path_found;
+  int is_trace_replay_path_found;
+  int is_profile_name_found;
+  int is_admission_policy_found;
+  int is_memory_headroom_found;
+  int is_prefetch_found;
+  int is_prefetch_list_path_found;
+  int is_ready_timeout_found;
+  int is_resume_wave_size_found;
+  int is_wave_timeout_found;
+  int is_inject_mode_found;
+  int is_instance_library_found;
+  int is_pipelined_found;
+  int is_placement_policy_found;
+  int is_metrics_textfile_path_found;
+  int is_metrics_port_found;
+  int is_monitor_csv_path_found;
+  int is_monitor_interval_found;
+  int is_job_cpu_rate_found;
+  int is_job_kill_on_close_found;
+  int is_job_memory_limit_found;
+  int is_job_process_memory_limit_found;
   size_t num_libraries;
 };
 
-#define ARGS_VALIDATION_RESULTS_UNINIT { 0 }
+#define ARGS_VALIDATION_RESULTS_UNINIT { 0 }
+
+/**
+ * Value checks
+ */
+
+static int IsValueNonEmpty(int i_arg, int argc, const wchar_t* const* argv) {
+  if (i_arg >= argc - 1) {
+    return 0;
+  }
+
+  return wcslen(argv[i_arg + 1]) > 0;
+}
+
+static int IsValueUnsignedInteger(
+    int i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  size_t i_str;
+
+  if (!IsValueNonEmpty(i_arg, argc, argv)) {
+    return 0;
+  }
+
+  for (i_str = 0; argv[i_arg + 1][i_str] != L'\0'; ++i_str) {
+    if (!iswdigit(argv[i_arg + 1][i_str])) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * Validation function
+ */
+
+typedef int ArgValidationFunc(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv);
+
+static int IsGamePathValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  size_t path_length;
+
+  if (results->is_game_path_found) {
+    return 0;
+  }
+
+  if (*i_arg >= argc - 1) {
+    return 0;
+  }
+
+  path_length = wcslen(argv[*i_arg + 1]);
+  if (path_length <= 0) {
+    return 0;
+  }
+
+  results->is_game_path_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsGameArgValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  size_t args_length;
+
+  if (results->is_game_args_found) {
+    return 0;
+  }
+
+  if (*i_arg >= argc - 1) {
+    return 0;
+  }
+
+  args_length = wcslen(argv[*i_arg + 1]);
+  if (args_length <= 0) {
+    return 0;
+  }
+
+  results->is_game_args_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsInjectLibraryPathValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  size_t path_length;
+
+  if (*i_arg >= argc - 1) {
+    return 0;
+  }
+
+  path_length = wcslen(argv[*i_arg + 1]);
+  if (path_length <= 0) {
+    return 0;
+  }
+
+  results->num_libraries += 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+/**
+ * The libraries of a directory are only counted once it is listed, so
+ * they are not counted here.
+ */
+static int IsLibraryDirectoryValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsKnowledgeLibraryPathValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  size_t path_length;
+
+  if (results->is_knowledge_library_path_found) {
+    return 0;
+  }
+
+  if (*i_arg >= argc - 1) {
+    return 0;
+  }
+
+  path_length = wcslen(argv[*i_arg + 1]);
+  if (path_length <= 0) {
+    return 0;
+  }
+
+  results->is_knowledge_library_path_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsAdmissionPolicyValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_admission_policy_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  if (wcscmp(argv[*i_arg + 1], L"cap") != 0
+      && wcscmp(argv[*i_arg + 1], L"queue") != 0) {
+    return 0;
+  }
+
+  results->is_admission_policy_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsAgentLibraryPathValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_agent_library_path_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_agent_library_path_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsAttachImageNameValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_attach_image_name_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_attach_image_name_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsAttachProcessIdsValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  size_t i_str;
+  size_t num_process_ids;
+  int is_digit_found;
+
+  if (results->is_attach_process_ids_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  /* The value is a comma-separated list of process IDs. */
+  num_process_ids = 0;
+  is_digit_found = 0;
+  for (i_str = 0; argv[*i_arg + 1][i_str] != L'\0'; ++i_str) {
+    if (iswdigit(argv[*i_arg + 1][i_str])) {
+      is_digit_found = 1;
+      continue;
+    }
+
+    if (argv[*i_arg + 1][i_str] != L',' || !is_digit_found) {
+      return 0;
+    }
+
+    num_process_ids += 1;
+    is_digit_found = 0;
+  }
+
+  if (!is_digit_found) {
+    return 0;
+  }
+
+  num_process_ids += 1;
+  if (num_process_ids > Attach_kMaxProcesses) {
+    return 0;
+  }
+
+  results->is_attach_process_ids_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsBoxDirectoryPathValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_box_directory_path_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_box_directory_path_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsBoxEnvironmentPathValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_box_environment_path_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_box_environment_path_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsBoxWritableListPathValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_box_writable_list_path_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_box_writable_list_path_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsCaptureOutputPathValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_capture_output_path_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_capture_output_path_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsDeferTriggerValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_defer_trigger_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  if (wcscmp(argv[*i_arg + 1], L"idle") != 0
+      && wcscmp(argv[*i_arg + 1], L"window") != 0
+      && wcscmp(argv[*i_arg + 1], L"ready") != 0) {
+    return 0;
+  }
+
+  results->is_defer_trigger_found = 1;
+  results->is_defer_until_ready = (wcscmp(argv[*i_arg + 1], L"ready") == 0);
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsDeferredLibraryPathValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_deferred_library_path_found = 1;
+  results->num_libraries += 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsNumInstancesValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  size_t i_str;
+
+  if (results->is_num_instances_found) {
+    return 0;
+  }
+
+  if (*i_arg >= argc - 1) {
+    return 0;
+  }
+
+  for (i_str = 0; argv[*i_arg + 1][i_str] != L'\0'; ++i_str) {
+    if (!iswdigit(argv[*i_arg + 1][i_str])) {
+      return 0;
+    }
+  }
+
+  results->is_num_instances_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsInjectModeValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_inject_mode_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  if (wcscmp(argv[*i_arg + 1], L"remote-thread") != 0
+      && wcscmp(argv[*i_arg + 1], L"import-table") != 0) {
+    return 0;
+  }
+
+  results->is_inject_mode_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsInstanceLibraryValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  struct LibrarySet library_set;
+  struct LibrarySet* init_library_set_result;
+  const wchar_t* library_path;
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  init_library_set_result = LibrarySet_InitFromSpec(
+      &library_set,
+      argv[*i_arg + 1],
+      &library_path);
+  if (init_library_set_result == NULL) {
+    return 0;
+  }
+
+  results->is_instance_library_found = 1;
+  results->num_libraries += 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsJobCpuRateValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  unsigned long cpu_rate_percent;
+
+  if (results->is_job_cpu_rate_found) {
+    return 0;
+  }
+
+  if (!IsValueUnsignedInteger(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  cpu_rate_percent = wcstoul(argv[*i_arg + 1], NULL, 10);
+  if (cpu_rate_percent < 1 || cpu_rate_percent > 100) {
+    return 0;
+  }
+
+  results->is_job_cpu_rate_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsJobKillOnCloseValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_job_kill_on_close_found) {
+    return 0;
+  }
+
+  results->is_job_kill_on_close_found = 1;
+
+  return 1;
+}
+
+static int IsJobMemoryLimitValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_job_memory_limit_found) {
+    return 0;
+  }
+
+  if (!IsValueUnsignedInteger(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_job_memory_limit_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsJobProcessMemoryLimitValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_job_process_memory_limit_found) {
+    return 0;
+  }
+
+  if (!IsValueUnsignedInteger(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_job_process_memory_limit_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsHostMaxInstancesValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  unsigned long host_max_instances;
+
+  if (results->is_host_max_instances_found) {
+    return 0;
+  }
+
+  if (!IsValueUnsignedInteger(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  host_max_instances = wcstoul(argv[*i_arg + 1], NULL, 10);
+  if (host_max_instances < 1
+      || host_max_instances > InstanceRegistry_kCapacity) {
+    return 0;
+  }
+
+  results->is_host_max_instances_found = 1;
+  ++(*i_arg);
 
-/**
- * Validation function
- */
+  return 1;
+}
 
-typedef int ArgValidationFunc(
+static int IsMemoryHeadroomValid(
     struct ArgsValidationResults* results,
     int* i_arg,
     int argc,
-    const wchar_t* const* argv);
+    const wchar_t* const* argv) {
+  if (results->is_memory_headroom_found) {
+    return 0;
+  }
 
-static int IsGamePathValid(
+  if (!IsValueUnsignedInteger(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_memory_headroom_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsMetricsTextfilePathValid(
     struct ArgsValidationResults* results,
     int* i_arg,
     int argc,
     const wchar_t* const* argv) {
-  size_t path_length;
+  if (results->is_metrics_textfile_path_found) {
+    return 0;
+  }
 
-  if (results->is_game_path_found) {
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
     return 0;
   }
 
-  if (*i_arg >= argc - 1) {
+  results->is_metrics_textfile_path_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsMetricsPortValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  unsigned long port;
+
+  if (results->is_metrics_port_found) {
     return 0;
   }
 
-  path_length = wcslen(argv[*i_arg + 1]);
-  if (path_length <= 0) {
+  if (!IsValueUnsignedInteger(*i_arg, argc, argv)) {
     return 0;
   }
 
-  results->is_game_path_found = 1;
+  port = wcstoul(argv[*i_arg + 1], NULL, 10);
+  if (port < 1 || port > 65535) {
+    return 0;
+  }
+
+  results->is_metrics_port_found = 1;
   ++(*i_arg);
 
   return 1;
 }
 
-static int IsGameArgValid(
+static int IsMonitorCsvPathValid(
     struct ArgsValidationResults* results,
     int* i_arg,
     int argc,
     const wchar_t* const* argv) {
-  size_t args_length;
+  if (results->is_monitor_csv_path_found) {
+    return 0;
+  }
 
-  if (results->is_game_args_found) {
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
     return 0;
   }
 
-  if (*i_arg >= argc - 1) {
+  results->is_monitor_csv_path_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsMonitorIntervalValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_monitor_interval_found) {
     return 0;
   }
 
-  args_length = wcslen(argv[*i_arg + 1]);
-  if (args_length <= 0) {
+  if (!IsValueUnsignedInteger(*i_arg, argc, argv)) {
     return 0;
   }
 
-  results->is_game_args_found = 1;
+  if (wcstoul(argv[*i_arg + 1], NULL, 10) == 0) {
+    return 0;
+  }
+
+  results->is_monitor_interval_found = 1;
   ++(*i_arg);
 
   return 1;
 }
 
-static int IsInjectLibraryPathValid(
+static int IsPipelinedValid(
     struct ArgsValidationResults* results,
     int* i_arg,
     int argc,
     const wchar_t* const* argv) {
-  size_t path_length;
+  if (results->is_pipelined_found) {
+    return 0;
+  }
 
-  if (*i_arg >= argc - 1) {
+  results->is_pipelined_found = 1;
+
+  return 1;
+}
+
+static int IsPlacementPolicyValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_placement_policy_found) {
     return 0;
   }
 
-  path_length = wcslen(argv[*i_arg + 1]);
-  if (path_length <= 0) {
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
     return 0;
   }
 
-  results->num_libraries += 1;
+  if (wcscmp(argv[*i_arg + 1], L"round-robin") != 0
+      && wcscmp(argv[*i_arg + 1], L"packed") != 0
+      && wcscmp(argv[*i_arg + 1], L"numa") != 0) {
+    return 0;
+  }
+
+  results->is_placement_policy_found = 1;
   ++(*i_arg);
 
   return 1;
 }
 
-static int IsKnowledgeLibraryPathValid(
+static int IsPrefetchValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_prefetch_found) {
+    return 0;
+  }
+
+  results->is_prefetch_found = 1;
+
+  return 1;
+}
+
+static int IsPrefetchListPathValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_prefetch_list_path_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_prefetch_list_path_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsProfileNameValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_profile_name_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_profile_name_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsReadyTimeoutValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_ready_timeout_found) {
+    return 0;
+  }
+
+  if (!IsValueUnsignedInteger(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_ready_timeout_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsResumeWaveSizeValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_resume_wave_size_found) {
+    return 0;
+  }
+
+  if (!IsValueUnsignedInteger(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_resume_wave_size_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsSampleDirectoryPathValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_sample_directory_path_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_sample_directory_path_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsSampleInstancesValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  struct LibrarySet instance_set;
+  struct LibrarySet* init_instance_set_result;
+
+  if (results->is_sample_instances_found) {
+    return 0;
+  }
+
+  if (!IsValueNonEmpty(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  init_instance_set_result = LibrarySet_InitFromList(
+      &instance_set,
+      argv[*i_arg + 1]);
+  if (init_instance_set_result == NULL) {
+    return 0;
+  }
+
+  results->is_sample_instances_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsSampleRateValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  unsigned long sample_rate;
+
+  if (results->is_sample_rate_found) {
+    return 0;
+  }
+
+  if (!IsValueUnsignedInteger(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  sample_rate = wcstoul(argv[*i_arg + 1], NULL, 10);
+  if (sample_rate < 1 || sample_rate > StackSampler_kMaxRate) {
+    return 0;
+  }
+
+  results->is_sample_rate_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsTraceRecordPathValid(
     struct ArgsValidationResults* results,
     int* i_arg,
     int argc,
     const wchar_t* const* argv) {
   size_t path_length;
 
-  if (results->is_knowledge_library_path_found) {
+  if (results->is_trace_record_path_found
+      || results->is_trace_replay_path_found) {
     return 0;
   }
 
@@ -148,20 +986,21 @@ static int IsKnowledgeLibraryPathValid(
     return 0;
   }
 
-  results->is_knowledge_library_path_found = 1;
+  results->is_trace_record_path_found = 1;
   ++(*i_arg);
 
   return 1;
 }
 
-static int IsNumInstancesValid(
+static int IsTraceReplayPathValid(
     struct ArgsValidationResults* results,
     int* i_arg,
     int argc,
     const wchar_t* const* argv) {
-  size_t i_str;
+  size_t path_length;
 
-  if (results->is_num_instances_found) {
+  if (results->is_trace_record_path_found
+      || results->is_trace_replay_path_found) {
     return 0;
   }
 
@@ -169,13 +1008,31 @@ static int IsNumInstancesValid(
     return 0;
   }
 
-  for (i_str = 0; argv[*i_arg + 1][i_str] != L'\0'; ++i_str) {
-    if (!iswdigit(argv[*i_arg + 1][i_str])) {
-      return 0;
-    }
+  path_length = wcslen(argv[*i_arg + 1]);
+  if (path_length <= 0) {
+    return 0;
   }
 
-  results->is_num_instances_found = 1;
+  results->is_trace_replay_path_found = 1;
+  ++(*i_arg);
+
+  return 1;
+}
+
+static int IsWaveTimeoutValid(
+    struct ArgsValidationResults* results,
+    int* i_arg,
+    int argc,
+    const wchar_t* const* argv) {
+  if (results->is_wave_timeout_found) {
+    return 0;
+  }
+
+  if (!IsValueUnsignedInteger(*i_arg, argc, argv)) {
+    return 0;
+  }
+
+  results->is_wave_timeout_found = 1;
   ++(*i_arg);
 
   return 1;
@@ -204,11 +1061,47 @@ static int ArgsValidationFuncTableEntry_CompareKeyAsVoid(
 
 static const struct ArgsValidationFuncTableEntry
 kArgsValidationFuncSortedTable[] = {
+    { L"--admission", &IsAdmissionPolicyValid },
+    { L"--agent", &IsAgentLibraryPathValid },
+    { L"--attach-image", &IsAttachImageNameValid },
+    { L"--attach-pid", &IsAttachProcessIdsValid },
+    { L"--box-directory", &IsBoxDirectoryPathValid },
+    { L"--box-environment", &IsBoxEnvironmentPathValid },
+    { L"--box-writable-list", &IsBoxWritableListPathValid },
+    { L"--capture-output", &IsCaptureOutputPathValid },
+    { L"--defer-until", &IsDeferTriggerValid },
+    { L"--deferred-library", &IsDeferredLibraryPathValid },
     { L"--game", &IsGamePathValid },
     { L"--gameargs", &IsGameArgValid },
+    { L"--host-max-instances", &IsHostMaxInstancesValid },
+    { L"--inject-mode", &IsInjectModeValid },
+    { L"--instance-library", &IsInstanceLibraryValid },
+    { L"--job-cpu-rate", &IsJobCpuRateValid },
+    { L"--job-kill-on-close", &IsJobKillOnCloseValid },
+    { L"--job-memory", &IsJobMemoryLimitValid },
+    { L"--job-process-memory", &IsJobProcessMemoryLimitValid },
     { L"--knowledge", &IsKnowledgeLibraryPathValid },
     { L"--library", &IsInjectLibraryPathValid },
+    { L"--library-dir", &IsLibraryDirectoryValid },
+    { L"--memory-headroom", &IsMemoryHeadroomValid },
+    { L"--metrics-file", &IsMetricsTextfilePathValid },
+    { L"--metrics-port", &IsMetricsPortValid },
+    { L"--monitor", &IsMonitorCsvPathValid },
+    { L"--monitor-interval", &IsMonitorIntervalValid },
     { L"--num-instances", &IsNumInstancesValid },
+    { L"--pipeline", &IsPipelinedValid },
+    { L"--placement", &IsPlacementPolicyValid },
+    { L"--prefetch", &IsPrefetchValid },
+    { L"--prefetch-list", &IsPrefetchListPathValid },
+    { L"--profile", &IsProfileNameValid },
+    { L"--ready-timeout", &IsReadyTimeoutValid },
+    { L"--resume-waves", &IsResumeWaveSizeValid },
+    { L"--sample", &IsSampleDirectoryPathValid },
+    { L"--sample-instances", &IsSampleInstancesValid },
+    { L"--sample-rate", &IsSampleRateValid },
+    { L"--trace-record", &IsTraceRecordPathValid },
+    { L"--trace-replay", &IsTraceReplayPathValid },
+    { L"--wave-timeout", &IsWaveTimeoutValid },
 
     { L"-a", &IsGameArgValid },
     { L"-g", &IsGamePathValid },
@@ -275,5 +1168,60 @@ int ArgsValidator_IsValid(
 
   *num_libraries = results.num_libraries;
 
+  /* The admission policy only applies with a memory headroom. */
+  if (results.is_admission_policy_found
+      && !results.is_memory_headroom_found) {
+    return 0;
+  }
+
+  /* A pipelined launch resumes each instance as soon as it is injected. */
+  if (results.is_pipelined_found && results.is_resume_wave_size_found) {
+    return 0;
+  }
+
+  /* Writable files are copied into the boxes. */
+  if (results.is_box_writable_list_path_found
+      && !results.is_box_directory_path_found) {
+    return 0;
+  }
+
+  /* Only deferred libraries wait for a trigger. */
+  if (results.is_defer_trigger_found
+      && !results.is_deferred_library_path_found) {
+    return 0;
+  }
+
+  /* Instances only report ready while the loader waits for them. */
+  if (results.is_defer_until_ready
+      && !results.is_ready_timeout_found
+      && !results.is_resume_wave_size_found) {
+    return 0;
+  }
+
+  /* The sampled instances and rate only apply with a sample directory. */
+  if ((results.is_sample_instances_found || results.is_sample_rate_found)
+      && !results.is_sample_directory_path_found) {
+    return 0;
+  }
+
+  /*
+   * Attaching injects into processes that are already running, with a
+   * remote thread and without Knowledge.
+   */
+  if (results.is_attach_image_name_found
+      || results.is_attach_process_ids_found) {
+    return !results.is_game_path_found
+        && !results.is_knowledge_library_path_found
+        && !results.is_agent_library_path_found
+        && !results.is_inject_mode_found
+        && !results.is_box_directory_path_found
+        && !results.is_box_environment_path_found
+        && !results.is_capture_output_path_found
+        && !results.is_deferred_library_path_found
+        && !results.is_instance_library_found
+        && !results.is_sample_directory_path_found
+        && !results.is_host_max_instances_found;
+  }
+
   return results.is_game_path_found;
 }
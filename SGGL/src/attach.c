@@ -0,0 +1,369 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "attach.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <windows.h>
+#include <tlhelp32.h>
+#include <shlwapi.h>
+
+#include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+#include <mdc/wchar_t/filew.h>
+
+#include "instance_result.h"
+#include "library_injector.h"
+#include "platform.h"
+
+#ifndef TH32CS_SNAPMODULE32
+#define TH32CS_SNAPMODULE32 0x00000010
+#endif /* TH32CS_SNAPMODULE32 */
+
+enum {
+  /*
+   * Creating and writing the remote buffer, starting the remote thread,
+   * and reading the target's kernel32 exports when its bitness differs.
+   */
+  kAttachAccess = PROCESS_CREATE_THREAD
+      | PROCESS_QUERY_INFORMATION
+      | PROCESS_VM_OPERATION
+      | PROCESS_VM_READ
+      | PROCESS_VM_WRITE,
+
+  kMaxSnapshotAttempts = 4
+};
+
+static int IsProcessSelected(
+    const PROCESSENTRY32W* process_entry,
+    const DWORD* process_ids,
+    size_t num_process_ids,
+    const wchar_t* image_name) {
+  size_t i;
+
+  for (i = 0; i < num_process_ids; ++i) {
+    if (process_entry->th32ProcessID == process_ids[i]) {
+      return 1;
+    }
+  }
+
+  /* Windows 9x puts the full path into the entry. */
+  return image_name != NULL
+      && lstrcmpiW(PathFindFileNameW(process_entry->szExeFile), image_name)
+          == 0;
+}
+
+static HANDLE CreateModuleSnapshot(DWORD process_id) {
+  size_t i_attempt;
+  HANDLE snapshot;
+
+  /*
+   * Module snapshots can fail with ERROR_BAD_LENGTH while the target's
+   * loader is modifying its module list, so retry a few times.
+   */
+  snapshot = INVALID_HANDLE_VALUE;
+  for (i_attempt = 0; i_attempt < kMaxSnapshotAttempts; ++i_attempt) {
+    snapshot = Platform_CreateToolhelp32Snapshot(
+        TH32CS_SNAPMODULE | TH32CS_SNAPMODULE32,
+        process_id);
+
+    if (snapshot != INVALID_HANDLE_VALUE
+        || GetLastError() != ERROR_BAD_LENGTH) {
+      break;
+    }
+  }
+
+  return snapshot;
+}
+
+/**
+ * Marks the libraries that the process has loaded, by comparing their
+ * full paths with the paths of the process's modules. Returns zero if
+ * the modules could not be read, in which case no library is marked.
+ */
+static int MarkLoadedLibraries(
+    int* is_loaded_libraries,
+    const wchar_t* const* library_full_paths,
+    size_t num_libraries,
+    DWORD process_id) {
+  size_t i_library;
+  HANDLE snapshot;
+  MODULEENTRY32W module_entry;
+  BOOL is_module_entry_valid;
+
+  for (i_library = 0; i_library < num_libraries; ++i_library) {
+    is_loaded_libraries[i_library] = 0;
+  }
+
+  snapshot = CreateModuleSnapshot(process_id);
+  if (snapshot == INVALID_HANDLE_VALUE) {
+    return 0;
+  }
+
+  module_entry.dwSize = sizeof(module_entry);
+
+  for (is_module_entry_valid = Platform_Module32FirstW(snapshot, &module_entry);
+      is_module_entry_valid;
+      is_module_entry_valid = Platform_Module32NextW(
+          snapshot,
+          &module_entry)) {
+    for (i_library = 0; i_library < num_libraries; ++i_library) {
+      if (lstrcmpiW(module_entry.szExePath, library_full_paths[i_library])
+          == 0) {
+        is_loaded_libraries[i_library] = 1;
+      }
+    }
+  }
+
+  Platform_CloseHandle(snapshot);
+
+  return 1;
+}
+
+/**
+ * External
+ */
+
+size_t Attach_OpenProcesses(
+    PROCESS_INFORMATION* processes_infos,
+    const DWORD* process_ids,
+    size_t num_process_ids,
+    const wchar_t* image_name) {
+  size_t num_processes;
+  DWORD current_process_id;
+  HANDLE snapshot;
+  PROCESSENTRY32W process_entry;
+  BOOL is_process_entry_valid;
+
+  snapshot = Platform_CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+  if (snapshot == INVALID_HANDLE_VALUE) {
+    wprintf(
+        L"CreateToolhelp32Snapshot failed, error 0x%lX.\n\n",
+        GetLastError());
+    goto bad_return;
+  }
+
+  num_processes = 0;
+  current_process_id = GetCurrentProcessId();
+  process_entry.dwSize = sizeof(process_entry);
+
+  for (is_process_entry_valid = Platform_Process32FirstW(
+          snapshot,
+          &process_entry);
+      is_process_entry_valid && num_processes < Attach_kMaxProcesses;
+      is_process_entry_valid = Platform_Process32NextW(
+          snapshot,
+          &process_entry)) {
+    HANDLE process;
+
+    if (process_entry.th32ProcessID == current_process_id
+        || !IsProcessSelected(
+            &process_entry,
+            process_ids,
+            num_process_ids,
+            image_name)) {
+      continue;
+    }
+
+    process = Platform_OpenProcess(
+        kAttachAccess,
+        FALSE,
+        process_entry.th32ProcessID);
+    if (process == NULL) {
+      wprintf(
+          L"Process %lu (%ls) could not be opened, error 0x%lX.\n",
+          process_entry.th32ProcessID,
+          process_entry.szExeFile,
+          GetLastError());
+      continue;
+    }
+
+    wprintf(
+        L"Attached to process %lu (%ls).\n",
+        process_entry.th32ProcessID,
+        process_entry.szExeFile);
+
+    processes_infos[num_processes].hProcess = process;
+    processes_infos[num_processes].hThread = NULL;
+    processes_infos[num_processes].dwProcessId =
+        process_entry.th32ProcessID;
+    processes_infos[num_processes].dwThreadId = 0;
+    num_processes += 1;
+  }
+
+  Platform_CloseHandle(snapshot);
+
+  wprintf(L"\n");
+
+  return num_processes;
+
+bad_return:
+  return 0;
+}
+
+void Attach_CloseProcesses(
+    PROCESS_INFORMATION* processes_infos,
+    size_t num_processes) {
+  size_t i;
+
+  for (i = 0; i < num_processes; ++i) {
+    Platform_CloseHandle(processes_infos[i].hProcess);
+    processes_infos[i].hProcess = NULL;
+  }
+}
+
+int Attach_InjectLibraries(
+    struct LibraryInjector* injector,
+    const wchar_t** library_paths,
+    size_t num_libraries,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_processes,
+    struct InstanceResult* results) {
+  size_t i_library;
+  size_t i_process;
+
+  wchar_t (*library_full_paths)[MAX_PATH];
+  const wchar_t** library_full_path_ptrs;
+  const wchar_t** missing_library_paths;
+  int* is_loaded_libraries;
+  size_t num_missing_libraries;
+  int is_all_success;
+
+  if (num_libraries == 0) {
+    return 1;
+  }
+
+  library_full_paths = Mdc_malloc(
+      num_libraries * sizeof(library_full_paths[0]));
+  if (library_full_paths == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_return;
+  }
+
+  library_full_path_ptrs = Mdc_malloc(
+      num_libraries * sizeof(library_full_path_ptrs[0]));
+  if (library_full_path_ptrs == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_library_full_paths;
+  }
+
+  missing_library_paths = Mdc_malloc(
+      num_libraries * sizeof(missing_library_paths[0]));
+  if (missing_library_paths == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_library_full_path_ptrs;
+  }
+
+  is_loaded_libraries = Mdc_malloc(
+      num_libraries * sizeof(is_loaded_libraries[0]));
+  if (is_loaded_libraries == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_missing_library_paths;
+  }
+
+  /* Modules are listed by full path, so compare against full paths. */
+  for (i_library = 0; i_library < num_libraries; ++i_library) {
+    DWORD get_full_path_name_result;
+
+    get_full_path_name_result = GetFullPathNameW(
+        library_paths[i_library],
+        MAX_PATH,
+        library_full_paths[i_library],
+        NULL);
+    if (get_full_path_name_result == 0
+        || get_full_path_name_result >= MAX_PATH) {
+      wcscpy(library_full_paths[i_library], L"");
+    }
+
+    library_full_path_ptrs[i_library] = library_full_paths[i_library];
+  }
+
+  is_all_success = 1;
+
+  /*
+   * Each process can have loaded a different set of libraries, so each
+   * one is injected on its own with only the libraries it is missing.
+   */
+  for (i_process = 0; i_process < num_processes; ++i_process) {
+    MarkLoadedLibraries(
+        is_loaded_libraries,
+        library_full_path_ptrs,
+        num_libraries,
+        processes_infos[i_process].dwProcessId);
+
+    num_missing_libraries = 0;
+    for (i_library = 0; i_library < num_libraries; ++i_library) {
+      if (is_loaded_libraries[i_library]) {
+        wprintf(
+            L"Already loaded in process %lu: %ls\n",
+            processes_infos[i_process].dwProcessId,
+            library_paths[i_library]);
+        continue;
+      }
+
+      missing_library_paths[num_missing_libraries] =
+          library_paths[i_library];
+      num_missing_libraries += 1;
+    }
+
+    if (num_missing_libraries == 0) {
+      wprintf(L"\n");
+      continue;
+    }
+
+    is_all_success = LibraryInjector_InjectToProcesses(
+        injector,
+        missing_library_paths,
+        num_missing_libraries,
+        &processes_infos[i_process],
+        1,
+        &results[i_process]) && is_all_success;
+  }
+
+  Mdc_free(is_loaded_libraries);
+  Mdc_free(missing_library_paths);
+  Mdc_free(library_full_path_ptrs);
+  Mdc_free(library_full_paths);
+
+  return is_all_success;
+
+bad_free_missing_library_paths:
+  Mdc_free(missing_library_paths);
+
+bad_free_library_full_path_ptrs:
+  Mdc_free(library_full_path_ptrs);
+
+bad_free_library_full_paths:
+  Mdc_free(library_full_paths);
+
+bad_return:
+  return 0;
+}
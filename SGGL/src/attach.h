@@ -0,0 +1,83 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_ATTACH_H_
+#define SGGL_ATTACH_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#include "instance_result.h"
+#include "library_injector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum {
+  Attach_kMaxProcesses = 64
+};
+
+/**
+ * Opens the running processes that have one of the process IDs or the
+ * image name, which may be NULL, from a single process snapshot. Each
+ * process is opened with only the rights that injection needs, and has
+ * no thread handle. Returns the number of processes opened.
+ */
+size_t Attach_OpenProcesses(
+    PROCESS_INFORMATION* processes_infos,
+    const DWORD* process_ids,
+    size_t num_process_ids,
+    const wchar_t* image_name);
+
+void Attach_CloseProcesses(
+    PROCESS_INFORMATION* processes_infos,
+    size_t num_processes);
+
+/**
+ * Injects the libraries into each process with a remote thread,
+ * skipping the libraries that the process has already loaded. The
+ * loaded libraries are read from one module snapshot per process.
+ * Returns nonzero if every library is loaded in every process.
+ */
+int Attach_InjectLibraries(
+    struct LibraryInjector* injector,
+    const wchar_t** library_paths,
+    size_t num_libraries,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_processes,
+    struct InstanceResult* results);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_ATTACH_H_ */
@@ -0,0 +1,405 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "control_channel.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+enum {
+  kObjectNameLength = 64,
+
+  /* Large enough for one ACE with the Everyone SID. */
+  kReadOnlyAclSize = 64
+};
+
+/**
+ * Holds a security descriptor whose DACL only lets other processes map
+ * the object for reading. The creator's handle keeps the access that it
+ * was created with.
+ */
+struct ReadOnlySecurity {
+  SECURITY_ATTRIBUTES attributes;
+  SECURITY_DESCRIPTOR descriptor;
+  DWORD acl_buffer[kReadOnlyAclSize / sizeof(DWORD)];
+  PSID everyone_sid;
+};
+
+/**
+ * Returns NULL on systems without security, such as Windows 9x, in
+ * which case the default security applies.
+ */
+static SECURITY_ATTRIBUTES* ReadOnlySecurity_Init(
+    struct ReadOnlySecurity* security) {
+  SID_IDENTIFIER_AUTHORITY world_authority = SECURITY_WORLD_SID_AUTHORITY;
+  ACL* acl;
+
+  if (!AllocateAndInitializeSid(
+      &world_authority,
+      1,
+      SECURITY_WORLD_RID,
+      0, 0, 0, 0, 0, 0, 0,
+      &security->everyone_sid)) {
+    goto bad_return;
+  }
+
+  acl = (ACL*) security->acl_buffer;
+  if (!InitializeAcl(acl, sizeof(security->acl_buffer), ACL_REVISION)
+      || !AddAccessAllowedAce(
+          acl,
+          ACL_REVISION,
+          FILE_MAP_READ,
+          security->everyone_sid)) {
+    goto bad_free_sid;
+  }
+
+  if (!InitializeSecurityDescriptor(
+          &security->descriptor,
+          SECURITY_DESCRIPTOR_REVISION)
+      || !SetSecurityDescriptorDacl(&security->descriptor, TRUE, acl, FALSE)) {
+    goto bad_free_sid;
+  }
+
+  security->attributes.nLength = sizeof(security->attributes);
+  security->attributes.lpSecurityDescriptor = &security->descriptor;
+  security->attributes.bInheritHandle = FALSE;
+
+  return &security->attributes;
+
+bad_free_sid:
+  FreeSid(security->everyone_sid);
+  security->everyone_sid = NULL;
+
+bad_return:
+  return NULL;
+}
+
+static void ReadOnlySecurity_Deinit(struct ReadOnlySecurity* security) {
+  if (security->everyone_sid != NULL) {
+    FreeSid(security->everyone_sid);
+    security->everyone_sid = NULL;
+  }
+}
+
+static void FormatObjectName(
+    wchar_t* object_name,
+    const wchar_t* name_format,
+    DWORD process_id) {
+  _snwprintf(object_name, kObjectNameLength, name_format, process_id);
+  object_name[kObjectNameLength - 1] = L'\0';
+}
+
+static HANDLE CreateNamedMapping(
+    const wchar_t* name_format,
+    DWORD process_id,
+    SECURITY_ATTRIBUTES* attributes,
+    size_t size) {
+  wchar_t object_name[kObjectNameLength];
+
+  FormatObjectName(object_name, name_format, process_id);
+
+  return CreateFileMappingW(
+      INVALID_HANDLE_VALUE,
+      attributes,
+      PAGE_READWRITE,
+      0,
+      size,
+      object_name);
+}
+
+/**
+ * VC6's headers declare InterlockedCompareExchange with pointers, while
+ * later headers declare it with LONGs. Both are the same call on 32-bit
+ * Windows.
+ */
+static LONG CompareExchange(
+    volatile LONG* destination,
+    LONG exchange,
+    LONG comparand) {
+#if defined(_MSC_VER) && _MSC_VER <= 1200
+  return (LONG) InterlockedCompareExchange(
+      (PVOID*) destination,
+      (PVOID) exchange,
+      (PVOID) comparand);
+#else
+  return InterlockedCompareExchange(destination, exchange, comparand);
+#endif
+}
+
+/**
+ * External
+ */
+
+int ControlChannelRing_Push(
+    struct ControlChannelRing* ring,
+    const struct ControlChannelEvent* event) {
+  LONG reserve_index;
+  LONG read_index;
+
+  /* Reserve a slot, unless the ring is full. */
+  for (;;) {
+    reserve_index = ring->reserve_index;
+    read_index = ring->read_index;
+
+    if ((DWORD) (reserve_index - read_index) >= ring->capacity) {
+      return 0;
+    }
+
+    if (CompareExchange(
+            &ring->reserve_index,
+            reserve_index + 1,
+            reserve_index) == reserve_index) {
+      break;
+    }
+  }
+
+  ring->events[(DWORD) reserve_index & (ring->capacity - 1)] = *event;
+
+  /*
+   * Publish the event only after it has been fully written, and only
+   * after the producers that reserved earlier slots have published
+   * theirs, so that the consumer never reads an unwritten slot.
+   */
+  while (CompareExchange(
+          &ring->write_index,
+          reserve_index + 1,
+          reserve_index) != reserve_index) {
+    Sleep(0);
+  }
+
+  return 1;
+}
+
+int ControlChannelRing_Pop(
+    struct ControlChannelRing* ring,
+    struct ControlChannelEvent* event) {
+  LONG write_index;
+  LONG read_index;
+
+  read_index = ring->read_index;
+  write_index = ring->write_index;
+
+  if (read_index == write_index) {
+    return 0;
+  }
+
+  *event = ring->events[(DWORD) read_index & (ring->capacity - 1)];
+
+  /* Release the slot only after the event has been copied out. */
+  InterlockedExchange((LONG*) &ring->read_index, read_index + 1);
+
+  return 1;
+}
+
+struct ControlChannel* ControlChannel_Init(
+    struct ControlChannel* channel,
+    DWORD process_id,
+    size_t instance_index,
+    size_t instance_count,
+    const wchar_t* profile_name) {
+  wchar_t object_name[kObjectNameLength];
+  struct ControlChannelConfig* config;
+  struct ReadOnlySecurity config_security;
+
+  memset(channel, 0, sizeof(*channel));
+
+  /* The config stores both values as DWORDs. */
+  if (instance_count > (DWORD) -1 || instance_index >= instance_count) {
+    goto bad_return;
+  }
+
+  /*
+   * Fill in the config, which the game instance can only read. Only
+   * this handle can write to it, since any other process can only open
+   * it with FILE_MAP_READ.
+   */
+  memset(&config_security, 0, sizeof(config_security));
+  channel->config_mapping = CreateNamedMapping(
+      CONTROL_CHANNEL_CONFIG_NAME_FORMAT,
+      process_id,
+      ReadOnlySecurity_Init(&config_security),
+      sizeof(*config));
+  ReadOnlySecurity_Deinit(&config_security);
+
+  if (channel->config_mapping == NULL) {
+    goto bad_return;
+  }
+
+  config = MapViewOfFile(
+      channel->config_mapping,
+      FILE_MAP_WRITE,
+      0,
+      0,
+      sizeof(*config));
+  if (config == NULL) {
+    goto bad_close_config_mapping;
+  }
+
+  config->version = ControlChannel_kVersion;
+  config->instance_index = (DWORD) instance_index;
+  channel->instance_index = instance_index;
+  config->instance_count = (DWORD) instance_count;
+  config->loader_process_id = GetCurrentProcessId();
+
+  wcsncpy(
+      config->profile_name,
+      (profile_name != NULL) ? profile_name : L"",
+      ControlChannel_kProfileNameLength - 1);
+  config->profile_name[ControlChannel_kProfileNameLength - 1] = L'\0';
+
+  UnmapViewOfFile(config);
+
+  /* Set up the event ring. */
+  channel->ring_mapping = CreateNamedMapping(
+      CONTROL_CHANNEL_RING_NAME_FORMAT,
+      process_id,
+      NULL,
+      sizeof(*channel->ring));
+  if (channel->ring_mapping == NULL) {
+    goto bad_close_config_mapping;
+  }
+
+  channel->ring = MapViewOfFile(
+      channel->ring_mapping,
+      FILE_MAP_WRITE,
+      0,
+      0,
+      sizeof(*channel->ring));
+  if (channel->ring == NULL) {
+    goto bad_close_ring_mapping;
+  }
+
+  memset(channel->ring, 0, sizeof(*channel->ring));
+  channel->ring->version = ControlChannel_kVersion;
+  channel->ring->capacity = ControlChannel_kRingCapacity;
+
+  FormatObjectName(
+      object_name,
+      CONTROL_CHANNEL_EVENT_NAME_FORMAT,
+      process_id);
+
+  channel->event = CreateEventW(NULL, FALSE, FALSE, object_name);
+  if (channel->event == NULL) {
+    goto bad_unmap_ring;
+  }
+
+  return channel;
+
+bad_unmap_ring:
+  UnmapViewOfFile(channel->ring);
+  channel->ring = NULL;
+
+bad_close_ring_mapping:
+  CloseHandle(channel->ring_mapping);
+  channel->ring_mapping = NULL;
+
+bad_close_config_mapping:
+  CloseHandle(channel->config_mapping);
+  channel->config_mapping = NULL;
+
+bad_return:
+  return NULL;
+}
+
+void ControlChannel_Deinit(struct ControlChannel* channel) {
+  if (channel->event != NULL) {
+    CloseHandle(channel->event);
+    channel->event = NULL;
+  }
+
+  if (channel->ring != NULL) {
+    UnmapViewOfFile(channel->ring);
+    channel->ring = NULL;
+  }
+
+  if (channel->ring_mapping != NULL) {
+    CloseHandle(channel->ring_mapping);
+    channel->ring_mapping = NULL;
+  }
+
+  if (channel->config_mapping != NULL) {
+    CloseHandle(channel->config_mapping);
+    channel->config_mapping = NULL;
+  }
+}
+
+int ControlChannel_Pop(
+    struct ControlChannel* channel,
+    struct ControlChannelEvent* event) {
+  if (channel->ring == NULL) {
+    return 0;
+  }
+
+  return ControlChannelRing_Pop(channel->ring, event);
+}
+
+int ControlChannel_WaitForReady(
+    struct ControlChannel* channel,
+    DWORD timeout_milliseconds,
+    ControlChannelEventFunc* on_event) {
+  DWORD start_tick_count;
+  DWORD elapsed_milliseconds;
+  DWORD wait_result;
+  struct ControlChannelEvent event;
+
+  if (channel->ring == NULL) {
+    return 0;
+  }
+
+  start_tick_count = GetTickCount();
+
+  for (;;) {
+    while (ControlChannelRing_Pop(channel->ring, &event)) {
+      if (on_event != NULL) {
+        on_event(channel->instance_index, &event);
+      }
+
+      if (event.type == ControlChannel_kEventType_Ready) {
+        return 1;
+      }
+    }
+
+    elapsed_milliseconds = GetTickCount() - start_tick_count;
+    if (elapsed_milliseconds >= timeout_milliseconds) {
+      return 0;
+    }
+
+    /* Sleep until the next push, instead of polling the ring. */
+    wait_result = WaitForSingleObject(
+        channel->event,
+        timeout_milliseconds - elapsed_milliseconds);
+    if (wait_result == WAIT_FAILED) {
+      return 0;
+    }
+  }
+}
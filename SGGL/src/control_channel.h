@@ -0,0 +1,170 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_CONTROL_CHANNEL_H_
+#define SGGL_CONTROL_CHANNEL_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Every game instance receives a control channel before it is resumed.
+ * The channel consists of three named objects, where %lu is replaced by
+ * the game instance's process ID:
+ *
+ * - A read-only config block, to be mapped with FILE_MAP_READ.
+ * - An event ring, to be mapped with FILE_MAP_WRITE. Injected libraries
+ *   push events into the ring, and the loader pops them.
+ * - An auto-reset event that is set after every push.
+ *
+ * Injected libraries can open the objects from DllMain, since libraries
+ * are injected after the channel is created.
+ */
+#define CONTROL_CHANNEL_CONFIG_NAME_FORMAT L"SGGL.ControlChannel.%lu.Config"
+#define CONTROL_CHANNEL_RING_NAME_FORMAT L"SGGL.ControlChannel.%lu.Ring"
+#define CONTROL_CHANNEL_EVENT_NAME_FORMAT L"SGGL.ControlChannel.%lu.Event"
+
+enum {
+  ControlChannel_kVersion = 2,
+  ControlChannel_kProfileNameLength = 64,
+
+  /* Must be a power of two. */
+  ControlChannel_kRingCapacity = 256,
+
+  ControlChannel_kCacheLineSize = 64
+};
+
+enum ControlChannelEventType {
+  ControlChannel_kEventType_Status = 1,
+  ControlChannel_kEventType_Ready = 2
+};
+
+struct ControlChannelConfig {
+  DWORD version;
+  DWORD instance_index;
+  DWORD instance_count;
+  DWORD loader_process_id;
+  wchar_t profile_name[ControlChannel_kProfileNameLength];
+};
+
+struct ControlChannelEvent {
+  DWORD type;
+  DWORD value;
+  DWORD tick_count;
+  DWORD reserved;
+};
+
+/**
+ * A lock-free multi-producer single-consumer ring, so that any number of
+ * libraries can push events. A producer reserves a slot by advancing the
+ * reserve index with a compare-exchange, writes its event, then
+ * publishes it by advancing the write index once the earlier slots are
+ * published. The read index is only modified by the consumer. Each
+ * index is kept on its own cache line.
+ */
+struct ControlChannelRing {
+  DWORD version;
+  DWORD capacity;
+  BYTE padding0[ControlChannel_kCacheLineSize - 2 * sizeof(DWORD)];
+
+  volatile LONG reserve_index;
+  BYTE padding1[ControlChannel_kCacheLineSize - sizeof(LONG)];
+
+  volatile LONG write_index;
+  BYTE padding2[ControlChannel_kCacheLineSize - sizeof(LONG)];
+
+  volatile LONG read_index;
+  BYTE padding3[ControlChannel_kCacheLineSize - sizeof(LONG)];
+
+  struct ControlChannelEvent events[ControlChannel_kRingCapacity];
+};
+
+int ControlChannelRing_Push(
+    struct ControlChannelRing* ring,
+    const struct ControlChannelEvent* event);
+
+int ControlChannelRing_Pop(
+    struct ControlChannelRing* ring,
+    struct ControlChannelEvent* event);
+
+/**
+ * Loader side of a game instance's control channel.
+ */
+struct ControlChannel {
+  HANDLE config_mapping;
+  HANDLE ring_mapping;
+  HANDLE event;
+
+  struct ControlChannelRing* ring;
+
+  /* The instance number written into the config. */
+  size_t instance_index;
+};
+
+#define CONTROL_CHANNEL_UNINIT { 0 }
+
+struct ControlChannel* ControlChannel_Init(
+    struct ControlChannel* channel,
+    DWORD process_id,
+    size_t instance_index,
+    size_t instance_count,
+    const wchar_t* profile_name);
+
+void ControlChannel_Deinit(struct ControlChannel* channel);
+
+int ControlChannel_Pop(
+    struct ControlChannel* channel,
+    struct ControlChannelEvent* event);
+
+/**
+ * Waits until the game instance pushes a ready event into its channel,
+ * or until the timeout elapses. Every popped event is passed to the
+ * optional callback, along with the channel's instance number. Returns
+ * nonzero if the instance reported ready.
+ */
+typedef void ControlChannelEventFunc(
+    size_t instance_index,
+    const struct ControlChannelEvent* event);
+
+int ControlChannel_WaitForReady(
+    struct ControlChannel* channel,
+    DWORD timeout_milliseconds,
+    ControlChannelEventFunc* on_event);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_CONTROL_CHANNEL_H_ */
@@ -0,0 +1,345 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "deferred_injector.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#include "platform.h"
+
+static DWORD GetElapsedMicroseconds(const LARGE_INTEGER* start_time) {
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER end_time;
+
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&end_time);
+
+  return (DWORD) ((end_time.QuadPart - start_time->QuadPart)
+      * 1000000 / frequency.QuadPart);
+}
+
+struct WindowSearch {
+  DWORD process_id;
+  int is_found;
+};
+
+static BOOL CALLBACK FindVisibleWindow(HWND window, LPARAM param) {
+  struct WindowSearch* search;
+  DWORD window_process_id;
+
+  search = (struct WindowSearch*) param;
+
+  GetWindowThreadProcessId(window, &window_process_id);
+  if (window_process_id == search->process_id && IsWindowVisible(window)) {
+    search->is_found = 1;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void WaitForWindow(
+    const PROCESS_INFORMATION* process_info,
+    DWORD timeout_milliseconds) {
+  DWORD wait_start_tick_count;
+  struct WindowSearch search;
+
+  search.process_id = process_info->dwProcessId;
+  search.is_found = 0;
+
+  wait_start_tick_count = GetTickCount();
+  for (;;) {
+    EnumWindows(&FindVisibleWindow, (LPARAM) &search);
+    if (search.is_found) {
+      return;
+    }
+
+    if (GetTickCount() - wait_start_tick_count >= timeout_milliseconds) {
+      return;
+    }
+
+    /* Stop looking once the instance has exited. */
+    if (WaitForSingleObject(
+            process_info->hProcess,
+            DeferredInjector_kWindowPollMilliseconds) == WAIT_OBJECT_0) {
+      return;
+    }
+  }
+}
+
+/**
+ * Waits until the instance reaches the trigger, exits, or the timeout
+ * elapses. The waits are not part of a trace.
+ */
+static void WaitForTrigger(struct DeferredInjector_Instance* instance) {
+  struct DeferredInjector* injector;
+  HANDLE wait_handles[2];
+
+  injector = instance->injector;
+
+  switch (injector->trigger) {
+    case DeferredInjector_kTrigger_Idle: {
+      WaitForInputIdle(
+          instance->process_info.hProcess,
+          injector->timeout_milliseconds);
+      break;
+    }
+
+    case DeferredInjector_kTrigger_Window: {
+      WaitForWindow(&instance->process_info, injector->timeout_milliseconds);
+      break;
+    }
+
+    case DeferredInjector_kTrigger_Ready: {
+      wait_handles[0] = instance->ready_event;
+      wait_handles[1] = instance->process_info.hProcess;
+
+      WaitForMultipleObjects(
+          2,
+          wait_handles,
+          FALSE,
+          injector->timeout_milliseconds);
+      break;
+    }
+  }
+}
+
+/**
+ * Injects the deferred libraries into the instance, after waiting for
+ * the trigger if it has not been reached yet.
+ */
+static void InjectInstance(
+    struct DeferredInjector_Instance* instance,
+    int is_trigger_reached) {
+  struct DeferredInjector* injector;
+  struct LibraryInjector library_injector;
+  int is_inject_libraries_success;
+
+  injector = instance->injector;
+
+  /* Replayed handles do not refer to real processes. */
+  if (!Platform_IsReplaying()) {
+    if (!is_trigger_reached) {
+      WaitForTrigger(instance);
+    }
+
+    if (WaitForSingleObject(instance->process_info.hProcess, 0)
+        == WAIT_OBJECT_0) {
+      wprintf(
+          L"Instance %u exited before its deferred libraries were "
+              L"injected.\n",
+          instance->result->instance_number);
+      return;
+    }
+  }
+
+  /* Each thread resolves its own functions, as each launch does. */
+  LibraryInjector_Init(&library_injector);
+  library_injector.library_func = injector->library_func;
+  library_injector.library_func_context = injector->library_func_context;
+
+  is_inject_libraries_success = LibraryInjector_InjectToProcesses(
+      &library_injector,
+      injector->library_paths,
+      injector->num_libraries,
+      &instance->process_info,
+      1,
+      instance->result);
+
+  LibraryInjector_Deinit(&library_injector);
+
+  if (!is_inject_libraries_success || instance->result->is_failed) {
+    InterlockedIncrement((LONG*) &injector->num_failed_instances);
+
+    wprintf(
+        L"Some or all deferred libraries failed to inject into instance "
+            L"%u.\n",
+        instance->result->instance_number);
+    return;
+  }
+
+  wprintf(
+      L"Deferred libraries injected into instance %u %lu microseconds "
+          L"after launch started.\n",
+      instance->result->instance_number,
+      GetElapsedMicroseconds(injector->start_time));
+}
+
+static DWORD WINAPI InjectInstanceThread(LPVOID parameter) {
+  InjectInstance(parameter, 0);
+
+  return 0;
+}
+
+/**
+ * External
+ */
+
+struct DeferredInjector* DeferredInjector_Init(
+    struct DeferredInjector* injector,
+    const wchar_t** library_paths,
+    size_t num_libraries,
+    enum DeferredInjector_Trigger trigger,
+    DWORD timeout_milliseconds,
+    LibraryInjector_LibraryFunc* library_func,
+    void* library_func_context,
+    const LARGE_INTEGER* start_time) {
+  size_t i;
+
+  injector->library_paths = library_paths;
+  injector->num_libraries = num_libraries;
+  injector->trigger = trigger;
+  injector->timeout_milliseconds = timeout_milliseconds;
+
+  injector->library_func = library_func;
+  injector->library_func_context = library_func_context;
+
+  injector->start_time = start_time;
+
+  for (i = 0; i < DeferredInjector_kMaxInstances; ++i) {
+    injector->instances[i].injector = injector;
+    injector->instances[i].ready_event = NULL;
+    injector->instances[i].thread = NULL;
+    injector->instances[i].is_pending = 0;
+  }
+
+  injector->num_failed_instances = 0;
+
+  return injector;
+}
+
+void DeferredInjector_Deinit(struct DeferredInjector* injector) {
+  size_t i;
+  struct DeferredInjector_Instance* instance;
+
+  for (i = 0; i < DeferredInjector_kMaxInstances; ++i) {
+    instance = &injector->instances[i];
+
+    /* Traced instances that were never signaled have timed out. */
+    if (instance->is_pending) {
+      instance->is_pending = 0;
+      InjectInstance(instance, 1);
+    }
+
+    if (instance->thread != NULL) {
+      WaitForSingleObject(instance->thread, INFINITE);
+      CloseHandle(instance->thread);
+      instance->thread = NULL;
+    }
+
+    if (instance->ready_event != NULL) {
+      CloseHandle(instance->ready_event);
+      instance->ready_event = NULL;
+    }
+  }
+
+  injector->library_paths = NULL;
+  injector->num_libraries = 0;
+  injector->library_func = NULL;
+  injector->library_func_context = NULL;
+  injector->start_time = NULL;
+}
+
+void DeferredInjector_Start(
+    struct DeferredInjector* injector,
+    size_t instance_index,
+    const PROCESS_INFORMATION* process_info,
+    struct InstanceResult* result) {
+  struct DeferredInjector_Instance* instance;
+  DWORD thread_id;
+
+  instance = &injector->instances[instance_index];
+  instance->process_info = *process_info;
+  instance->result = result;
+
+  /*
+   * Traced calls must stay in order, so the injection runs on the
+   * calling thread. With the ready trigger, it runs once the instance
+   * is signaled.
+   */
+  if (Platform_IsTracing()) {
+    if (injector->trigger == DeferredInjector_kTrigger_Ready) {
+      instance->is_pending = 1;
+    } else {
+      InjectInstance(instance, 0);
+    }
+
+    return;
+  }
+
+  if (injector->trigger == DeferredInjector_kTrigger_Ready) {
+    instance->ready_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (instance->ready_event == NULL) {
+      wprintf(L"CreateEventW failed, error 0x%lX.\n\n", GetLastError());
+      return;
+    }
+  }
+
+  instance->thread = CreateThread(
+      NULL,
+      0,
+      &InjectInstanceThread,
+      instance,
+      0,
+      &thread_id);
+  if (instance->thread == NULL) {
+    /* Inject on the calling thread rather than not at all. */
+    if (injector->trigger == DeferredInjector_kTrigger_Ready) {
+      instance->is_pending = 1;
+    } else {
+      InjectInstance(instance, 0);
+    }
+  }
+}
+
+void DeferredInjector_SignalReady(
+    struct DeferredInjector* injector,
+    size_t instance_index) {
+  struct DeferredInjector_Instance* instance;
+
+  instance = &injector->instances[instance_index];
+
+  if (instance->is_pending) {
+    instance->is_pending = 0;
+    InjectInstance(instance, 1);
+    return;
+  }
+
+  if (instance->ready_event != NULL) {
+    SetEvent(instance->ready_event);
+  }
+}
+
+int DeferredInjector_IsSuccess(const struct DeferredInjector* injector) {
+  return injector->num_failed_instances == 0;
+}
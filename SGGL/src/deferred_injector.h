@@ -0,0 +1,163 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_DEFERRED_INJECTOR_H_
+#define SGGL_DEFERRED_INJECTOR_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#include "instance_result.h"
+#include "library_injector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum {
+  DeferredInjector_kMaxInstances = 64,
+
+  /* How long to wait for the trigger without a ready timeout. */
+  DeferredInjector_kDefaultTimeoutMilliseconds = 30000,
+
+  /* How often the window trigger looks for the instance's window. */
+  DeferredInjector_kWindowPollMilliseconds = 50
+};
+
+/**
+ * What a deferred library waits for before it is injected.
+ */
+enum DeferredInjector_Trigger {
+  /* The instance is waiting for input, as by WaitForInputIdle. */
+  DeferredInjector_kTrigger_Idle,
+
+  /* The instance shows a top-level window. */
+  DeferredInjector_kTrigger_Window,
+
+  /* The instance reports ready on its control channel. */
+  DeferredInjector_kTrigger_Ready
+};
+
+/**
+ * The injection of the deferred libraries into one resumed instance.
+ */
+struct DeferredInjector_Instance {
+  struct DeferredInjector* injector;
+  PROCESS_INFORMATION process_info;
+
+  /*
+   * The launch's result for the instance. Only the instance's thread
+   * writes to it until DeferredInjector_Deinit joins the thread.
+   */
+  struct InstanceResult* result;
+
+  /* Set by the launch once the instance reports ready. */
+  HANDLE ready_event;
+
+  /* NULL if the injection runs on the calling thread. */
+  HANDLE thread;
+
+  /* Nonzero if the injection runs on the calling thread once signaled. */
+  int is_pending;
+};
+
+/**
+ * Injects libraries that are not needed to start the game after each
+ * instance has been resumed and reached the trigger, so that their
+ * DllMain does not delay the first frame. Each instance is injected on
+ * its own thread, in parallel with the other instances and the launch.
+ */
+struct DeferredInjector {
+  const wchar_t** library_paths;
+  size_t num_libraries;
+  enum DeferredInjector_Trigger trigger;
+  DWORD timeout_milliseconds;
+
+  LibraryInjector_LibraryFunc* library_func;
+  void* library_func_context;
+
+  const LARGE_INTEGER* start_time;
+
+  struct DeferredInjector_Instance instances[DeferredInjector_kMaxInstances];
+  volatile LONG num_failed_instances;
+};
+
+/**
+ * Initializes the injector. Instances that do not reach the trigger
+ * within the timeout are injected anyway. The library function is
+ * called from the instances' threads.
+ */
+struct DeferredInjector* DeferredInjector_Init(
+    struct DeferredInjector* injector,
+    const wchar_t** library_paths,
+    size_t num_libraries,
+    enum DeferredInjector_Trigger trigger,
+    DWORD timeout_milliseconds,
+    LibraryInjector_LibraryFunc* library_func,
+    void* library_func_context,
+    const LARGE_INTEGER* start_time);
+
+/**
+ * Waits for every instance to be injected. Must be called before the
+ * process handles of the instances are closed.
+ */
+void DeferredInjector_Deinit(struct DeferredInjector* injector);
+
+/**
+ * Starts injecting into the resumed instance in the specified slot. When
+ * calls are traced, the injection runs on the calling thread so that the
+ * trace stays in order. Failures are recorded into the result, which must
+ * not be read or moved until DeferredInjector_Deinit returns.
+ */
+void DeferredInjector_Start(
+    struct DeferredInjector* injector,
+    size_t instance_index,
+    const PROCESS_INFORMATION* process_info,
+    struct InstanceResult* result);
+
+/**
+ * Lets the instance in the specified slot be injected with the ready
+ * trigger. Also called when the instance did not report ready in time.
+ */
+void DeferredInjector_SignalReady(
+    struct DeferredInjector* injector,
+    size_t instance_index);
+
+/**
+ * Returns nonzero if every started instance was injected.
+ */
+int DeferredInjector_IsSuccess(const struct DeferredInjector* injector);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_DEFERRED_INJECTOR_H_ */
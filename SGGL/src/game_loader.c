@@ -29,20 +29,127 @@
 
 #include "game_loader.h"
 
+#include <stdio.h>
+#include <string.h>
 #include <windows.h>
 
 #include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
 #include <mdc/std/wchar.h>
 #include <mdc/wchar_t/filew.h>
 
 #include "args_parser.h"
+#include "instance_boxes.h"
+#include "instance_result.h"
+#include "metrics.h"
+#include "output_capture.h"
+#include "platform.h"
+
+enum {
+  kExtendedStartupInfoPresent = 0x00080000,
+  kProcThreadAttributeHandleList = 0x00020002,
+
+  kMaxInheritedHandles = 2
+};
+
+/* Mirror of STARTUPINFOEXW, which is in the Windows Vista SDK. */
+struct StartupInfoEx {
+  STARTUPINFOW startup_info;
+  void* attribute_list;
+};
+
+typedef BOOL WINAPI InitializeProcThreadAttributeListFuncType(
+    void*, DWORD, DWORD, SIZE_T*);
+typedef BOOL WINAPI UpdateProcThreadAttributeFuncType(
+    void*, DWORD, ULONG_PTR, void*, SIZE_T, void*, SIZE_T*);
+typedef void WINAPI DeleteProcThreadAttributeListFuncType(void*);
+
+static void* GetKernel32ProcAddress(const char* proc_name) {
+  return GetProcAddress(GetModuleHandleW(L"kernel32.dll"), proc_name);
+}
+
+/**
+ * Returns an attribute list that limits the handles an instance inherits
+ * to the specified ones. Returns NULL if attribute lists are not
+ * supported, which is the case before Windows Vista.
+ */
+static void* InitHandleListAttribute(
+    HANDLE* handles,
+    size_t num_handles) {
+  InitializeProcThreadAttributeListFuncType* initialize_func;
+  UpdateProcThreadAttributeFuncType* update_func;
+  DeleteProcThreadAttributeListFuncType* delete_func;
+  void* attribute_list;
+  SIZE_T attribute_list_size;
+
+  initialize_func = (InitializeProcThreadAttributeListFuncType*)
+      GetKernel32ProcAddress("InitializeProcThreadAttributeList");
+  update_func = (UpdateProcThreadAttributeFuncType*)
+      GetKernel32ProcAddress("UpdateProcThreadAttribute");
+  delete_func = (DeleteProcThreadAttributeListFuncType*)
+      GetKernel32ProcAddress("DeleteProcThreadAttributeList");
+  if (initialize_func == NULL || update_func == NULL || delete_func == NULL) {
+    goto bad_return;
+  }
+
+  /* The first call only reports the size of the list. */
+  attribute_list_size = 0;
+  initialize_func(NULL, 1, 0, &attribute_list_size);
+
+  attribute_list = Mdc_malloc(attribute_list_size);
+  if (attribute_list == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_return;
+  }
+
+  if (!initialize_func(attribute_list, 1, 0, &attribute_list_size)) {
+    goto bad_free_attribute_list;
+  }
+
+  if (!update_func(
+          attribute_list,
+          0,
+          kProcThreadAttributeHandleList,
+          handles,
+          num_handles * sizeof(handles[0]),
+          NULL,
+          NULL)) {
+    goto bad_delete_attribute_list;
+  }
+
+  return attribute_list;
+
+bad_delete_attribute_list:
+  delete_func(attribute_list);
+
+bad_free_attribute_list:
+  Mdc_free(attribute_list);
+
+bad_return:
+  return NULL;
+}
+
+static void DeinitHandleListAttribute(void* attribute_list) {
+  DeleteProcThreadAttributeListFuncType* delete_func;
+
+  if (attribute_list == NULL) {
+    return;
+  }
+
+  delete_func = (DeleteProcThreadAttributeListFuncType*)
+      GetKernel32ProcAddress("DeleteProcThreadAttributeList");
+  delete_func(attribute_list);
+
+  Mdc_free(attribute_list);
+}
 
 static void InitCommandLine(
     wchar_t* cmd_line,
+    const wchar_t* game_path,
     const struct ParsedArgs* args) {
   /* Surround the game path in quotes to handle paths with whitespace. */
   wcscpy(cmd_line, L"\"");
-  wcscat(cmd_line, args->game_path);
+  wcscat(cmd_line, game_path);
   wcscat(cmd_line, L"\"");
 
   if (args->game_args != NULL) {
@@ -51,107 +158,226 @@ static void InitCommandLine(
   }
 }
 
-static void ExitOnCreateProcessError(
-    const wchar_t* file_path,
-    unsigned int line,
-    const struct ParsedArgs* args,
-    DWORD last_error) {
+static int IsFatalCreateProcessError(DWORD last_error) {
   switch (last_error) {
-    case ERROR_FILE_NOT_FOUND: {
-      Mdc_Error_ExitOnGeneralError(
-          L"Error",
-          L"Game executable %ls could not be found.",
-          file_path,
-          line,
-          args->game_path);
-      break;
+    case ERROR_FILE_NOT_FOUND:
+    case ERROR_PATH_NOT_FOUND: {
+      return 1;
     }
 
     default: {
-      Mdc_Error_ExitOnWindowsFunctionError(
-          file_path,
-          line,
-          L"CreateProcessW",
-          last_error);
-      break;
+      return 0;
     }
   }
 }
 
-static void StartGameWithParams(
-    PROCESS_INFORMATION* processes_infos,
+static int StartGameInstanceWithParams(
+    PROCESS_INFORMATION* process_info,
     const struct ParsedArgs* args,
     DWORD creation_flags,
-    LPVOID environment,
-    const wchar_t* current_directory_path) {
-  size_t i;
+    const struct InstanceBoxes* boxes,
+    struct OutputCapture* output_capture,
+    struct InstanceResult* result) {
+  BOOL is_create_process_success;
+  DWORD last_error;
+  struct MetricsTimer create_timer;
+  const wchar_t* game_path;
+  const wchar_t* current_directory_path;
+  LPVOID environment;
+  HANDLE inherited_handles[kMaxInheritedHandles];
+  size_t num_inherited_handles;
 
   /* CreateProcessW's lpCommandLine char limit is 32,767. */
   wchar_t full_cmd_line[32767];
-  STARTUPINFOW startup_info = { 0 };
+  struct StartupInfoEx startup_info_ex;
 
-  startup_info.cb = sizeof(startup_info);
+  memset(&startup_info_ex, 0, sizeof(startup_info_ex));
+  startup_info_ex.startup_info.cb = sizeof(startup_info_ex.startup_info);
 
-  /* Create the desired processes. */
-  for (i = 0; i < args->num_instances; ++i) {
-    BOOL is_create_process_success;
+  /*
+   * The instance only inherits the handles of its captured output. The
+   * handle list keeps it from inheriting any other inheritable handle,
+   * such as the output of an instance created at the same time. Before
+   * Windows Vista, every inheritable handle is inherited instead.
+   */
+  num_inherited_handles = 0;
+  if (output_capture != NULL) {
+    num_inherited_handles = OutputCapture_OpenInstance(
+        output_capture,
+        result->instance_number,
+        &startup_info_ex.startup_info,
+        inherited_handles);
+  }
+
+  if (num_inherited_handles > 0) {
+    startup_info_ex.attribute_list = InitHandleListAttribute(
+        inherited_handles,
+        num_inherited_handles);
+    if (startup_info_ex.attribute_list != NULL) {
+      startup_info_ex.startup_info.cb = sizeof(startup_info_ex);
+      creation_flags |= kExtendedStartupInfoPresent;
+    }
+  }
+
+  /*
+   * Run the instance from its own box and environment, if it has them.
+   * The box holds a link to the game executable, so that the game finds
+   * its files in the box.
+   */
+  game_path = args->game_path;
+  current_directory_path = NULL;
+  environment = NULL;
+  if (boxes != NULL) {
+    if (InstanceBoxes_GetGamePath(boxes, result->instance_number) != NULL) {
+      game_path = InstanceBoxes_GetGamePath(boxes, result->instance_number);
+      current_directory_path = InstanceBoxes_GetDirectoryPath(
+          boxes,
+          result->instance_number);
+    }
 
+    environment = InstanceBoxes_GetEnvironment(
+        boxes,
+        result->instance_number);
+    if (environment != NULL) {
+      creation_flags |= CREATE_UNICODE_ENVIRONMENT;
+    }
+  }
+
+  do {
     /*
      * CreateProcessW can modify the cmd line string, so a copy must be
      * made every time an instance needs to be made.
      */
-    InitCommandLine(full_cmd_line, args);
+    InitCommandLine(full_cmd_line, game_path, args);
 
-    is_create_process_success = CreateProcessW(
-        args->game_path,
+    MetricsTimer_Start(&create_timer);
+    is_create_process_success = Platform_CreateProcessW(
+        game_path,
         full_cmd_line,
         NULL,
         NULL,
-        TRUE,
+        num_inherited_handles > 0,
         creation_flags,
         environment,
         current_directory_path,
-        &startup_info,
-        &processes_infos[i]);
-
-    if (!is_create_process_success) {
-      ExitOnCreateProcessError(
-          __FILEW__,
-          __LINE__,
-          args,
-          GetLastError());
-      goto bad_return;
-    }
+        &startup_info_ex.startup_info,
+        process_info);
+    Metrics_ObserveCreate(&create_timer, is_create_process_success);
+
+    last_error = is_create_process_success ? ERROR_SUCCESS : GetLastError();
+  } while (!is_create_process_success
+      && InstanceResult_ShouldRetry(result, last_error));
+
+  DeinitHandleListAttribute(startup_info_ex.attribute_list);
+
+  if (num_inherited_handles > 0) {
+    OutputCapture_StartInstance(
+        output_capture,
+        result->instance_number,
+        &startup_info_ex.startup_info,
+        is_create_process_success);
+  }
+
+  if (!is_create_process_success) {
+    goto bad_return;
   }
 
-  return;
+  result->process_id = process_info->dwProcessId;
+  Metrics_AddInstance(result->instance_number, process_info);
+
+  return 1;
 
 bad_return:
-  return;
+  if (IsFatalCreateProcessError(last_error)) {
+    wprintf(L"Game executable %ls could not be found.\n", game_path);
+  } else {
+    wprintf(
+        L"Instance %u could not be created, error 0x%lX.\n",
+        result->instance_number,
+        last_error);
+  }
+
+  InstanceResult_SetFailed(
+      result,
+      InstanceResult_kPhase_Create,
+      L"CreateProcessW",
+      last_error);
+  memset(process_info, 0, sizeof(*process_info));
+
+  return 0;
+}
+
+static void StartGameWithParams(
+    PROCESS_INFORMATION* processes_infos,
+    const struct ParsedArgs* args,
+    DWORD creation_flags,
+    const struct InstanceBoxes* boxes,
+    struct OutputCapture* output_capture,
+    struct InstanceResult* results) {
+  size_t i;
+
+  /*
+   * Create the desired processes. An instance that fails is recorded in
+   * its result, and the remaining instances are still created, unless
+   * the error means that none of them can be.
+   */
+  for (i = 0; i < args->num_instances; ++i) {
+    if (i > 0 && GameLoader_IsFatalError(&results[i - 1])) {
+      InstanceResult_SetFailed(
+          &results[i],
+          results[i - 1].failed_phase,
+          results[i - 1].failed_function_name,
+          results[i - 1].last_error);
+      memset(&processes_infos[i], 0, sizeof(processes_infos[i]));
+      continue;
+    }
+
+    StartGameInstanceWithParams(
+        &processes_infos[i],
+        args,
+        creation_flags,
+        boxes,
+        output_capture,
+        &results[i]);
+  }
 }
 
 /**
  * External
  */
 
+int GameLoader_IsFatalError(const struct InstanceResult* result) {
+  return result->is_failed
+      && result->failed_phase == InstanceResult_kPhase_Create
+      && IsFatalCreateProcessError(result->last_error);
+}
+
 void GameLoader_StartGame(
     PROCESS_INFORMATION* processes_infos,
-    const struct ParsedArgs* args) {
+    const struct ParsedArgs* args,
+    const struct InstanceBoxes* boxes,
+    struct OutputCapture* output_capture,
+    struct InstanceResult* results) {
   size_t i;
 
   StartGameWithParams(
       processes_infos,
       args,
       0,
-      NULL,
-      NULL);
+      boxes,
+      output_capture,
+      results);
 
   /* Wait until the processes are started. */
   for (i = 0; i < args->num_instances; ++i) {
     HANDLE open_process_result;
 
+    if (results[i].is_failed) {
+      continue;
+    }
+
     do {
-      open_process_result = OpenProcess(
+      open_process_result = Platform_OpenProcess(
           PROCESS_QUERY_INFORMATION,
           FALSE,
           processes_infos[i].dwProcessId);
@@ -159,17 +385,36 @@ void GameLoader_StartGame(
       Sleep(100);
     } while (open_process_result == NULL);
 
-    CloseHandle(open_process_result);
+    Platform_CloseHandle(open_process_result);
   }
 }
 
 void GameLoader_StartGameSuspended(
     PROCESS_INFORMATION* processes_infos,
-    const struct ParsedArgs* args) {
+    const struct ParsedArgs* args,
+    const struct InstanceBoxes* boxes,
+    struct OutputCapture* output_capture,
+    struct InstanceResult* results) {
   StartGameWithParams(
       processes_infos,
       args,
       CREATE_SUSPENDED,
-      NULL,
-      NULL);
+      boxes,
+      output_capture,
+      results);
+}
+
+int GameLoader_StartGameInstanceSuspended(
+    PROCESS_INFORMATION* process_info,
+    const struct ParsedArgs* args,
+    const struct InstanceBoxes* boxes,
+    struct OutputCapture* output_capture,
+    struct InstanceResult* result) {
+  return StartGameInstanceWithParams(
+      process_info,
+      args,
+      CREATE_SUSPENDED,
+      boxes,
+      output_capture,
+      result);
 }
@@ -33,22 +33,55 @@
 #include <windows.h>
 
 #include "args_parser.h"
+#include "instance_boxes.h"
+#include "instance_result.h"
+#include "output_capture.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
 enum {
-  GameLoader_kMaxInstances = 8,
+  GameLoader_kMaxInstances = 64,
 };
 
+/**
+ * Starts the instances. Transient errors are retried, and an instance
+ * that still fails is recorded in its result with zeroed handles, while
+ * the other instances are started. After a fatal error, the remaining
+ * instances are recorded with the same error instead. Each instance
+ * runs in the box for its instance number, or in the game's directory if
+ * boxes is NULL. Its output is captured if output_capture is not NULL.
+ */
 void GameLoader_StartGame(
     PROCESS_INFORMATION* processes_infos,
-    const struct ParsedArgs* args);
+    const struct ParsedArgs* args,
+    const struct InstanceBoxes* boxes,
+    struct OutputCapture* output_capture,
+    struct InstanceResult* results);
 
 void GameLoader_StartGameSuspended(
     PROCESS_INFORMATION* processes_infos,
-    const struct ParsedArgs* args);
+    const struct ParsedArgs* args,
+    const struct InstanceBoxes* boxes,
+    struct OutputCapture* output_capture,
+    struct InstanceResult* results);
+
+/**
+ * Starts a single suspended instance. Returns nonzero on success.
+ */
+int GameLoader_StartGameInstanceSuspended(
+    PROCESS_INFORMATION* process_info,
+    const struct ParsedArgs* args,
+    const struct InstanceBoxes* boxes,
+    struct OutputCapture* output_capture,
+    struct InstanceResult* result);
+
+/**
+ * Returns nonzero if the instance failed with an error that no other
+ * instance can avoid either, such as a missing game executable.
+ */
+int GameLoader_IsFatalError(const struct InstanceResult* result);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -75,6 +75,40 @@ void Help_PrintText(const wchar_t* program_path) {
       L"Command line arguments to pass to");
   PrintContinuedLine(L"the game");
 
+  PrintArgHelp(
+      L"--attach-pid <pid>[,<pid>...]",
+      L"Inject into running processes");
+  PrintContinuedLine(L"with these IDs instead of");
+  PrintContinuedLine(L"opening the game");
+
+  PrintArgHelp(
+      L"--attach-image <name>",
+      L"Inject into running processes");
+  PrintContinuedLine(L"with this executable name");
+
+  PrintArgHelp(
+      L"--box-directory <directory>",
+      L"Run each instance in its own");
+  PrintContinuedLine(L"linked copy of the game's");
+  PrintContinuedLine(L"directory, kept under this one");
+
+  PrintArgHelp(
+      L"--box-writable-list <file>",
+      L"Files each box gets its own copy");
+  PrintContinuedLine(L"of, one per line");
+
+  PrintArgHelp(
+      L"--box-environment <file>",
+      L"Template of NAME=value lines to");
+  PrintContinuedLine(L"add to each instance's");
+  PrintContinuedLine(L"environment");
+
+  PrintArgHelp(
+      L"--capture-output <directory>",
+      L"Write each instance's standard");
+  PrintContinuedLine(L"output and error into rotating");
+  PrintContinuedLine(L"logs in this directory");
+
   PrintArgHelp(
       L"-k, --knowledge <library>",
       L"Path of Knowledge extension");
@@ -86,7 +120,177 @@ void Help_PrintText(const wchar_t* program_path) {
   PrintContinuedLine(L"option can be repeated for");
   PrintContinuedLine(L"multiple libraries)");
 
+  PrintArgHelp(
+      L"--library-dir <directory|pattern>",
+      L"Inject every library in the");
+  PrintContinuedLine(L"directory, or matching a pattern");
+  PrintContinuedLine(L"such as mods\\*.dll, in name or");
+  PrintContinuedLine(L"load_order.txt order (can be");
+  PrintContinuedLine(L"repeated)");
+
+  PrintArgHelp(
+      L"--instance-library <list>=<library>",
+      L"Path of library to inject into");
+  PrintContinuedLine(L"only the listed instances, such");
+  PrintContinuedLine(L"as 0,2-3=overlay.dll (can be");
+  PrintContinuedLine(L"repeated)");
+
+  PrintArgHelp(
+      L"--deferred-library <library>",
+      L"Path of library to inject after");
+  PrintContinuedLine(L"the instance is resumed and");
+  PrintContinuedLine(L"reaches the trigger (can be");
+  PrintContinuedLine(L"repeated)");
+
+  PrintArgHelp(
+      L"--defer-until <trigger>",
+      L"When deferred libraries are");
+  PrintContinuedLine(L"injected: idle (default), window");
+  PrintContinuedLine(L"or ready");
+
+  PrintArgHelp(
+      L"--inject-mode <mode>",
+      L"How libraries are injected:");
+  PrintContinuedLine(L"remote-thread (default), or");
+  PrintContinuedLine(L"import-table, which adds them to");
+  PrintContinuedLine(L"the game's imports before start");
+
+  PrintArgHelp(
+      L"--agent <library>",
+      L"Path of agent library, which");
+  PrintContinuedLine(L"loads all other libraries from");
+  PrintContinuedLine(L"a command queue");
+
   PrintArgHelp(
       L"-n, --num-instances <count>",
       L"Number of instances to open");
+
+  PrintArgHelp(
+      L"--host-max-instances <count>",
+      L"Most instances to run from every");
+  PrintContinuedLine(L"run of the loader together");
+  PrintContinuedLine(L"(default 64)");
+
+  PrintArgHelp(
+      L"--memory-headroom <MB>",
+      L"Only open the instances that fit");
+  PrintContinuedLine(L"in memory, keeping this much free");
+
+  PrintArgHelp(
+      L"--admission <policy>",
+      L"What happens to instances that");
+  PrintContinuedLine(L"do not fit: cap (default) or");
+  PrintContinuedLine(L"queue");
+
+  PrintArgHelp(
+      L"--job-process-memory <MB>",
+      L"Place instances in a job, and");
+  PrintContinuedLine(L"limit each one's committed memory");
+
+  PrintArgHelp(
+      L"--job-memory <MB>",
+      L"Place instances in a job, and");
+  PrintContinuedLine(L"limit their total committed");
+  PrintContinuedLine(L"memory");
+
+  PrintArgHelp(
+      L"--job-cpu-rate <percent>",
+      L"Place instances in a job, and");
+  PrintContinuedLine(L"cap their total CPU usage");
+
+  PrintArgHelp(
+      L"--job-kill-on-close",
+      L"Place instances in a job, and");
+  PrintContinuedLine(L"terminate them when the loader");
+  PrintContinuedLine(L"exits");
+
+  PrintArgHelp(
+      L"--metrics-file <file>",
+      L"Write launch and instance");
+  PrintContinuedLine(L"metrics for the node exporter's");
+  PrintContinuedLine(L"textfile collector");
+
+  PrintArgHelp(
+      L"--metrics-port <port>",
+      L"Serve metrics on a localhost");
+  PrintContinuedLine(L"port until the instances exit");
+
+  PrintArgHelp(
+      L"--monitor <file>",
+      L"Sample each instance's resource");
+  PrintContinuedLine(L"usage into a CSV file until it");
+  PrintContinuedLine(L"exits");
+
+  PrintArgHelp(
+      L"--monitor-interval <milliseconds>",
+      L"Time between samples (default");
+  PrintContinuedLine(L"1000)");
+
+  PrintArgHelp(
+      L"--sample <directory>",
+      L"Sample the call stacks of the");
+  PrintContinuedLine(L"instances and write collapsed");
+  PrintContinuedLine(L"stacks into this directory");
+
+  PrintArgHelp(
+      L"--sample-instances <list>",
+      L"Instances to sample, such as");
+  PrintContinuedLine(L"0,2-3 (default all)");
+
+  PrintArgHelp(
+      L"--sample-rate <hz>",
+      L"Samples per second (default");
+  PrintContinuedLine(L"100, at most 1000)");
+
+  PrintArgHelp(
+      L"--pipeline",
+      L"Inject and resume each instance");
+  PrintContinuedLine(L"before creating the next");
+
+  PrintArgHelp(
+      L"--placement <policy>",
+      L"Assign instances to processor");
+  PrintContinuedLine(L"cores: round-robin, packed, or");
+  PrintContinuedLine(L"numa");
+
+  PrintArgHelp(
+      L"--prefetch",
+      L"Read the game and libraries into");
+  PrintContinuedLine(L"the file cache before launching");
+
+  PrintArgHelp(
+      L"--prefetch-list <file>",
+      L"Also prefetch the files listed,");
+  PrintContinuedLine(L"one per line");
+
+  PrintArgHelp(
+      L"--profile <name>",
+      L"Name of the game profile, passed");
+  PrintContinuedLine(L"to injected libraries");
+
+  PrintArgHelp(
+      L"--ready-timeout <milliseconds>",
+      L"Time to wait for instances to");
+  PrintContinuedLine(L"report ready after resuming");
+
+  PrintArgHelp(
+      L"--resume-waves <count>",
+      L"Resume instances in waves, the");
+  PrintContinuedLine(L"first of this size, each after");
+  PrintContinuedLine(L"the previous one is ready");
+
+  PrintArgHelp(
+      L"--wave-timeout <milliseconds>",
+      L"Time to wait for a wave to be");
+  PrintContinuedLine(L"ready (default 10000)");
+
+  PrintArgHelp(
+      L"--trace-record <file>",
+      L"Record calls made on the game");
+  PrintContinuedLine(L"processes into a trace file");
+
+  PrintArgHelp(
+      L"--trace-replay <file>",
+      L"Replay a recorded trace file");
+  PrintContinuedLine(L"instead of calling the system");
 }
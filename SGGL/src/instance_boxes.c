@@ -0,0 +1,932 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "instance_boxes.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+#include <shlwapi.h>
+
+#include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+#include <mdc/wchar_t/filew.h>
+
+#ifndef INVALID_FILE_ATTRIBUTES
+#define INVALID_FILE_ATTRIBUTES ((DWORD) 0xFFFFFFFF)
+#endif /* INVALID_FILE_ATTRIBUTES */
+
+#ifndef FILE_ATTRIBUTE_REPARSE_POINT
+#define FILE_ATTRIBUTE_REPARSE_POINT 0x00000400
+#endif /* FILE_ATTRIBUTE_REPARSE_POINT */
+
+#ifndef ERROR_PRIVILEGE_NOT_HELD
+#define ERROR_PRIVILEGE_NOT_HELD 1314L
+#endif /* ERROR_PRIVILEGE_NOT_HELD */
+
+#ifndef ERROR_NOT_SAME_DEVICE
+#define ERROR_NOT_SAME_DEVICE 17L
+#endif /* ERROR_NOT_SAME_DEVICE */
+
+enum {
+  kSymbolicLinkFlagDirectory = 0x1,
+
+  /* Lets symbolic links be created without privileges in developer mode. */
+  kSymbolicLinkFlagAllowUnprivilegedCreate = 0x2,
+
+  kNumberLength = 16,
+  kMaxExpandedEntryLength = InstanceBoxes_kMaxTemplateEntryLength
+      + 4 * MAX_PATH
+};
+
+static const wchar_t kInstanceToken[] = L"%SGGL_INSTANCE%";
+static const wchar_t kBoxToken[] = L"%SGGL_BOX%";
+
+typedef BOOL WINAPI CreateHardLinkWFuncType(
+    const wchar_t*, const wchar_t*, SECURITY_ATTRIBUTES*);
+
+typedef BOOLEAN WINAPI CreateSymbolicLinkWFuncType(
+    const wchar_t*, const wchar_t*, DWORD);
+
+struct WritablePaths {
+  wchar_t (*paths)[MAX_PATH];
+  size_t count;
+};
+
+/**
+ * The state of the walk over the game's directory. Every box is built in
+ * the same walk, so that the directory is only listed once.
+ */
+struct FarmBuilder {
+  const wchar_t* game_directory;
+  const wchar_t* box_directory;
+  const struct InstanceBoxes* boxes;
+  const struct WritablePaths* writable_paths;
+
+  /* Cleared once the system shows that links of the kind do not work. */
+  CreateHardLinkWFuncType* create_hard_link_func;
+  CreateSymbolicLinkWFuncType* create_symbolic_link_func;
+  DWORD symbolic_link_flags;
+
+  unsigned long num_linked_files;
+  unsigned long num_linked_directories;
+  unsigned long num_copied_files;
+  unsigned long num_existing_entries;
+  unsigned long num_failed_entries;
+};
+
+static DWORD GetElapsedMicroseconds(const LARGE_INTEGER* start_time) {
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER end_time;
+
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&end_time);
+
+  return (DWORD) ((end_time.QuadPart - start_time->QuadPart)
+      * 1000000 / frequency.QuadPart);
+}
+
+static void NormalizeRelativePath(wchar_t* path) {
+  size_t i;
+  size_t length;
+
+  for (i = 0; path[i] != L'\0'; ++i) {
+    if (path[i] == L'/') {
+      path[i] = L'\\';
+    }
+  }
+
+  length = wcslen(path);
+  while (length > 0 && path[length - 1] == L'\\') {
+    length -= 1;
+    path[length] = L'\0';
+  }
+}
+
+/**
+ * Reads the lines of a text file into fixed length entries, skipping
+ * empty lines and lines starting with #. Returns the number of entries.
+ */
+static size_t ReadListFile(
+    const wchar_t* list_path,
+    wchar_t* entries,
+    size_t entry_length,
+    size_t max_entries) {
+  FILE* list_file;
+  wchar_t* line;
+  size_t line_length;
+  size_t num_entries;
+
+  list_file = _wfopen(list_path, L"r");
+  if (list_file == NULL) {
+    wprintf(L"File %ls could not be opened.\n\n", list_path);
+    return 0;
+  }
+
+  num_entries = 0;
+  while (num_entries < max_entries) {
+    line = &entries[num_entries * entry_length];
+    if (fgetws(line, (int) entry_length, list_file) == NULL) {
+      break;
+    }
+
+    line_length = wcslen(line);
+    while (line_length > 0
+        && (line[line_length - 1] == L'\n'
+            || line[line_length - 1] == L'\r')) {
+      line_length -= 1;
+      line[line_length] = L'\0';
+    }
+
+    if (line_length == 0 || line[0] == L'#') {
+      continue;
+    }
+
+    num_entries += 1;
+  }
+
+  fclose(list_file);
+
+  return num_entries;
+}
+
+/**
+ * Returns nonzero if the path is a writable path or lies inside of one.
+ */
+static int IsWritable(
+    const struct WritablePaths* writable_paths,
+    const wchar_t* relative_path) {
+  size_t i;
+  size_t length;
+
+  for (i = 0; i < writable_paths->count; ++i) {
+    length = wcslen(writable_paths->paths[i]);
+
+    if (_wcsnicmp(relative_path, writable_paths->paths[i], length) == 0
+        && (relative_path[length] == L'\0'
+            || relative_path[length] == L'\\')) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Returns nonzero if a writable path lies inside of the directory.
+ */
+static int ContainsWritable(
+    const struct WritablePaths* writable_paths,
+    const wchar_t* relative_directory) {
+  size_t i;
+  size_t length;
+
+  length = wcslen(relative_directory);
+
+  for (i = 0; i < writable_paths->count; ++i) {
+    if (_wcsnicmp(writable_paths->paths[i], relative_directory, length) == 0
+        && writable_paths->paths[i][length] == L'\\') {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static int CreateSymbolicLink(
+    struct FarmBuilder* builder,
+    const wchar_t* link_path,
+    const wchar_t* target_path,
+    DWORD flags) {
+  DWORD last_error;
+
+  if (builder->create_symbolic_link_func == NULL) {
+    return 0;
+  }
+
+  if (builder->create_symbolic_link_func(
+          link_path,
+          target_path,
+          flags | builder->symbolic_link_flags)) {
+    return 1;
+  }
+
+  last_error = GetLastError();
+
+  /* Systems before developer mode reject the unprivileged flag. */
+  if (last_error == ERROR_INVALID_PARAMETER
+      && builder->symbolic_link_flags != 0) {
+    builder->symbolic_link_flags = 0;
+    return CreateSymbolicLink(builder, link_path, target_path, flags);
+  }
+
+  if (last_error == ERROR_PRIVILEGE_NOT_HELD) {
+    builder->create_symbolic_link_func = NULL;
+  }
+
+  return 0;
+}
+
+/**
+ * Links the installed file into a box, falling back from a hard link to
+ * a symbolic link to a copy. Writable files are always copied, and an
+ * existing copy is never overwritten.
+ */
+static int LinkFile(
+    struct FarmBuilder* builder,
+    const wchar_t* source_path,
+    const wchar_t* target_path,
+    int is_writable) {
+  if (!is_writable) {
+    if (builder->create_hard_link_func != NULL) {
+      if (builder->create_hard_link_func(target_path, source_path, NULL)) {
+        builder->num_linked_files += 1;
+        return 1;
+      }
+
+      /* The boxes are on another volume than the game. */
+      if (GetLastError() == ERROR_NOT_SAME_DEVICE) {
+        builder->create_hard_link_func = NULL;
+      }
+    }
+
+    if (CreateSymbolicLink(builder, target_path, source_path, 0)) {
+      builder->num_linked_files += 1;
+      return 1;
+    }
+  }
+
+  if (CopyFileW(source_path, target_path, TRUE)) {
+    builder->num_copied_files += 1;
+    return 1;
+  }
+
+  return 0;
+}
+
+static void BuildFarm(
+    struct FarmBuilder* builder,
+    const wchar_t* relative_directory) {
+  size_t i;
+  wchar_t search_path[MAX_PATH];
+  wchar_t relative_path[MAX_PATH];
+  wchar_t source_path[MAX_PATH];
+  wchar_t target_path[MAX_PATH];
+  HANDLE find;
+  WIN32_FIND_DATAW find_data;
+  DWORD attributes;
+  int is_directory;
+  int is_writable;
+  int is_linked_whole;
+  int is_recursed;
+  int is_link_success;
+
+  if (PathCombineW(search_path, builder->game_directory, relative_directory)
+          == NULL
+      || !PathAppendW(search_path, L"*")) {
+    return;
+  }
+
+  find = FindFirstFileW(search_path, &find_data);
+  if (find == INVALID_HANDLE_VALUE) {
+    return;
+  }
+
+  do {
+    if (wcscmp(find_data.cFileName, L".") == 0
+        || wcscmp(find_data.cFileName, L"..") == 0) {
+      continue;
+    }
+
+    if (PathCombineW(relative_path, relative_directory, find_data.cFileName)
+            == NULL
+        || PathCombineW(source_path, builder->game_directory, relative_path)
+            == NULL) {
+      wprintf(
+          L"Path of %ls is too long to be put in a box.\n",
+          find_data.cFileName);
+      builder->num_failed_entries += 1;
+      continue;
+    }
+
+    /* The boxes may be kept inside of the game's directory. */
+    if (_wcsicmp(source_path, builder->box_directory) == 0) {
+      continue;
+    }
+
+    is_directory =
+        (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    is_writable = IsWritable(builder->writable_paths, relative_path);
+    is_linked_whole = is_directory
+        && !is_writable
+        && !ContainsWritable(builder->writable_paths, relative_path);
+    is_recursed = 0;
+
+    for (i = 0; i < builder->boxes->num_boxes; ++i) {
+      if (PathCombineW(
+              target_path,
+              builder->boxes->directory_paths[i],
+              relative_path) == NULL) {
+        builder->num_failed_entries += 1;
+        continue;
+      }
+
+      /* Boxes from an earlier launch only need what is missing. */
+      attributes = GetFileAttributesW(target_path);
+      if (attributes != INVALID_FILE_ATTRIBUTES) {
+        builder->num_existing_entries += 1;
+
+        if (is_directory
+            && (attributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0) {
+          is_recursed = 1;
+        }
+
+        continue;
+      }
+
+      if (is_directory) {
+        if (is_linked_whole
+            && CreateSymbolicLink(
+                builder,
+                target_path,
+                source_path,
+                kSymbolicLinkFlagDirectory)) {
+          builder->num_linked_directories += 1;
+          continue;
+        }
+
+        is_link_success = CreateDirectoryW(target_path, NULL);
+        if (is_link_success) {
+          is_recursed = 1;
+        }
+      } else {
+        is_link_success = LinkFile(
+            builder,
+            source_path,
+            target_path,
+            is_writable);
+      }
+
+      if (!is_link_success) {
+        wprintf(
+            L"%ls could not be put in box %u, error 0x%lX.\n",
+            relative_path,
+            i,
+            GetLastError());
+        builder->num_failed_entries += 1;
+      }
+    }
+
+    if (is_recursed) {
+      BuildFarm(builder, relative_path);
+    }
+  } while (FindNextFileW(find, &find_data));
+
+  FindClose(find);
+}
+
+static int BuildBoxes(
+    struct InstanceBoxes* boxes,
+    const wchar_t* game_path,
+    const wchar_t* game_directory,
+    const wchar_t* box_directory_path,
+    const wchar_t* writable_list_path) {
+  size_t i;
+  wchar_t box_directory[MAX_PATH];
+  wchar_t box_name[kNumberLength];
+  DWORD get_full_path_name_result;
+  struct WritablePaths writable_paths;
+  struct FarmBuilder builder;
+  HMODULE kernel32;
+  LARGE_INTEGER start_time;
+
+  QueryPerformanceCounter(&start_time);
+
+  get_full_path_name_result = GetFullPathNameW(
+      box_directory_path,
+      MAX_PATH,
+      box_directory,
+      NULL);
+  if (get_full_path_name_result == 0
+      || get_full_path_name_result >= MAX_PATH) {
+    wprintf(
+        L"Box directory %ls could not be resolved.\n\n",
+        box_directory_path);
+    goto bad_return;
+  }
+
+  boxes->directory_paths = Mdc_malloc(
+      boxes->num_boxes * sizeof(boxes->directory_paths[0]));
+  if (boxes->directory_paths == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_return;
+  }
+
+  boxes->game_paths = Mdc_malloc(
+      boxes->num_boxes * sizeof(boxes->game_paths[0]));
+  if (boxes->game_paths == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_return;
+  }
+
+  /* Create the box directory and a numbered directory per instance. */
+  if (!CreateDirectoryW(box_directory, NULL)
+      && GetLastError() != ERROR_ALREADY_EXISTS) {
+    wprintf(L"CreateDirectoryW failed, error 0x%lX.\n\n", GetLastError());
+    goto bad_return;
+  }
+
+  for (i = 0; i < boxes->num_boxes; ++i) {
+    _snwprintf(box_name, kNumberLength, L"%u", i);
+    box_name[kNumberLength - 1] = L'\0';
+
+    if (PathCombineW(boxes->directory_paths[i], box_directory, box_name)
+            == NULL
+        || PathCombineW(
+            boxes->game_paths[i],
+            boxes->directory_paths[i],
+            PathFindFileNameW(game_path)) == NULL) {
+      wprintf(L"Box directory %ls is too long.\n\n", box_directory);
+      goto bad_return;
+    }
+
+    if (!CreateDirectoryW(boxes->directory_paths[i], NULL)
+        && GetLastError() != ERROR_ALREADY_EXISTS) {
+      wprintf(L"CreateDirectoryW failed, error 0x%lX.\n\n", GetLastError());
+      goto bad_return;
+    }
+  }
+
+  /* Read the paths that each instance gets its own copy of. */
+  writable_paths.count = 0;
+  writable_paths.paths = NULL;
+  if (writable_list_path != NULL) {
+    writable_paths.paths = Mdc_malloc(
+        InstanceBoxes_kMaxWritablePaths * sizeof(writable_paths.paths[0]));
+    if (writable_paths.paths == NULL) {
+      Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+      goto bad_return;
+    }
+
+    writable_paths.count = ReadListFile(
+        writable_list_path,
+        writable_paths.paths[0],
+        MAX_PATH,
+        InstanceBoxes_kMaxWritablePaths);
+
+    for (i = 0; i < writable_paths.count; ++i) {
+      NormalizeRelativePath(writable_paths.paths[i]);
+    }
+  }
+
+  /*
+   * CreateHardLinkW is only available from Windows 2000, and
+   * CreateSymbolicLinkW from Windows Vista.
+   */
+  kernel32 = GetModuleHandleW(L"kernel32.dll");
+
+  builder.game_directory = game_directory;
+  builder.box_directory = box_directory;
+  builder.boxes = boxes;
+  builder.writable_paths = &writable_paths;
+  builder.create_hard_link_func = (CreateHardLinkWFuncType*) GetProcAddress(
+      kernel32,
+      "CreateHardLinkW");
+  builder.create_symbolic_link_func =
+      (CreateSymbolicLinkWFuncType*) GetProcAddress(
+          kernel32,
+          "CreateSymbolicLinkW");
+  builder.symbolic_link_flags = kSymbolicLinkFlagAllowUnprivilegedCreate;
+  builder.num_linked_files = 0;
+  builder.num_linked_directories = 0;
+  builder.num_copied_files = 0;
+  builder.num_existing_entries = 0;
+  builder.num_failed_entries = 0;
+
+  BuildFarm(&builder, L"");
+
+  Mdc_free(writable_paths.paths);
+
+  wprintf(
+      L"Built %u instance box(es) in %lu microseconds: %lu file(s) and "
+          L"%lu directory(s) linked, %lu file(s) copied, %lu already "
+          L"present, %lu failed.\n\n",
+      boxes->num_boxes,
+      GetElapsedMicroseconds(&start_time),
+      builder.num_linked_files,
+      builder.num_linked_directories,
+      builder.num_copied_files,
+      builder.num_existing_entries,
+      builder.num_failed_entries);
+
+  return 1;
+
+bad_return:
+  return 0;
+}
+
+/**
+ * Returns nonzero if the environment entry sets a variable that the
+ * template also sets.
+ */
+static int IsOverridden(
+    const wchar_t* entry,
+    const wchar_t* template_entries,
+    size_t num_template_entries) {
+  size_t i;
+  const wchar_t* name_end;
+  const wchar_t* template_entry;
+
+  /* Entries for the current directory of each drive start with =. */
+  name_end = wcschr(&entry[1], L'=');
+  if (name_end == NULL) {
+    return 0;
+  }
+
+  for (i = 0; i < num_template_entries; ++i) {
+    template_entry =
+        &template_entries[i * InstanceBoxes_kMaxTemplateEntryLength];
+
+    if (_wcsnicmp(entry, template_entry, name_end - entry + 1) == 0) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Writes the template entry with its tokens replaced. Returns the length
+ * of the expanded entry, or zero if it does not fit.
+ */
+static size_t ExpandTemplateEntry(
+    wchar_t* expanded_entry,
+    const wchar_t* template_entry,
+    size_t instance_number,
+    const wchar_t* box_path) {
+  size_t length;
+  size_t value_length;
+  wchar_t number[kNumberLength];
+  const wchar_t* value;
+
+  _snwprintf(number, kNumberLength, L"%u", instance_number);
+  number[kNumberLength - 1] = L'\0';
+
+  length = 0;
+  while (*template_entry != L'\0') {
+    value = NULL;
+    if (_wcsnicmp(template_entry, kInstanceToken, wcslen(kInstanceToken))
+        == 0) {
+      value = number;
+      template_entry += wcslen(kInstanceToken);
+    } else if (_wcsnicmp(template_entry, kBoxToken, wcslen(kBoxToken))
+        == 0) {
+      value = box_path;
+      template_entry += wcslen(kBoxToken);
+    }
+
+    if (value != NULL) {
+      value_length = wcslen(value);
+      if (length + value_length >= kMaxExpandedEntryLength) {
+        return 0;
+      }
+
+      wcscpy(&expanded_entry[length], value);
+      length += value_length;
+    } else {
+      if (length + 1 >= kMaxExpandedEntryLength) {
+        return 0;
+      }
+
+      expanded_entry[length] = *template_entry;
+      length += 1;
+      template_entry += 1;
+    }
+  }
+
+  expanded_entry[length] = L'\0';
+
+  return length;
+}
+
+/**
+ * Assembles one environment block per instance. The loader's own
+ * variables are filtered once, and each block is a copy of them followed
+ * by the expanded template entries.
+ */
+static int AssembleEnvironments(
+    struct InstanceBoxes* boxes,
+    const wchar_t* game_directory,
+    const wchar_t* environment_template_path) {
+  size_t i_box;
+  size_t i_entry;
+  wchar_t* template_entries;
+  size_t num_template_entries;
+  wchar_t* expanded_entry;
+  size_t expanded_length;
+  wchar_t* inherited_environment;
+  const wchar_t* inherited_entry;
+  wchar_t* filtered_environment;
+  size_t filtered_length;
+  size_t entry_length;
+  size_t total_length;
+  const wchar_t* box_path;
+  wchar_t* environment;
+
+  template_entries = Mdc_malloc(
+      InstanceBoxes_kMaxTemplateEntries
+          * InstanceBoxes_kMaxTemplateEntryLength
+          * sizeof(template_entries[0]));
+  if (template_entries == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_return;
+  }
+
+  expanded_entry = Mdc_malloc(
+      kMaxExpandedEntryLength * sizeof(expanded_entry[0]));
+  if (expanded_entry == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_template_entries;
+  }
+
+  num_template_entries = ReadListFile(
+      environment_template_path,
+      template_entries,
+      InstanceBoxes_kMaxTemplateEntryLength,
+      InstanceBoxes_kMaxTemplateEntries);
+
+  /* Keep the loader's variables that the template does not set. */
+  inherited_environment = GetEnvironmentStringsW();
+  if (inherited_environment == NULL) {
+    wprintf(L"GetEnvironmentStringsW failed, error 0x%lX.\n\n", GetLastError());
+    goto bad_free_expanded_entry;
+  }
+
+  total_length = 0;
+  for (inherited_entry = inherited_environment;
+      *inherited_entry != L'\0';
+      inherited_entry += wcslen(inherited_entry) + 1) {
+    total_length += wcslen(inherited_entry) + 1;
+  }
+
+  filtered_environment = Mdc_malloc(
+      (total_length + 1) * sizeof(filtered_environment[0]));
+  if (filtered_environment == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_environment_strings;
+  }
+
+  filtered_length = 0;
+  for (inherited_entry = inherited_environment;
+      *inherited_entry != L'\0';
+      inherited_entry += entry_length + 1) {
+    entry_length = wcslen(inherited_entry);
+
+    if (IsOverridden(
+            inherited_entry,
+            template_entries,
+            num_template_entries)) {
+      continue;
+    }
+
+    memcpy(
+        &filtered_environment[filtered_length],
+        inherited_entry,
+        (entry_length + 1) * sizeof(inherited_entry[0]));
+    filtered_length += entry_length + 1;
+  }
+
+  /* Measure the blocks, so that all of them fit in one allocation. */
+  boxes->environment_offsets = Mdc_malloc(
+      boxes->num_boxes * sizeof(boxes->environment_offsets[0]));
+  if (boxes->environment_offsets == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_filtered_environment;
+  }
+
+  total_length = 0;
+  for (i_box = 0; i_box < boxes->num_boxes; ++i_box) {
+    box_path = (boxes->directory_paths != NULL)
+        ? boxes->directory_paths[i_box]
+        : game_directory;
+
+    boxes->environment_offsets[i_box] = total_length;
+
+    /* The block ends with an empty entry, even if it has no others. */
+    total_length += filtered_length + 2;
+
+    for (i_entry = 0; i_entry < num_template_entries; ++i_entry) {
+      expanded_length = ExpandTemplateEntry(
+          expanded_entry,
+          &template_entries[i_entry * InstanceBoxes_kMaxTemplateEntryLength],
+          i_box,
+          box_path);
+      if (expanded_length > 0) {
+        total_length += expanded_length + 1;
+      }
+    }
+  }
+
+  boxes->environments = Mdc_malloc(
+      total_length * sizeof(boxes->environments[0]));
+  if (boxes->environments == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_filtered_environment;
+  }
+
+  for (i_box = 0; i_box < boxes->num_boxes; ++i_box) {
+    box_path = (boxes->directory_paths != NULL)
+        ? boxes->directory_paths[i_box]
+        : game_directory;
+
+    environment = &boxes->environments[boxes->environment_offsets[i_box]];
+    memcpy(
+        environment,
+        filtered_environment,
+        filtered_length * sizeof(environment[0]));
+    environment += filtered_length;
+
+    for (i_entry = 0; i_entry < num_template_entries; ++i_entry) {
+      expanded_length = ExpandTemplateEntry(
+          expanded_entry,
+          &template_entries[i_entry * InstanceBoxes_kMaxTemplateEntryLength],
+          i_box,
+          box_path);
+      if (expanded_length == 0) {
+        wprintf(
+            L"Environment entry %ls is too long to be expanded.\n",
+            &template_entries[
+                i_entry * InstanceBoxes_kMaxTemplateEntryLength]);
+        continue;
+      }
+
+      memcpy(
+          environment,
+          expanded_entry,
+          (expanded_length + 1) * sizeof(environment[0]));
+      environment += expanded_length + 1;
+    }
+
+    environment[0] = L'\0';
+    environment[1] = L'\0';
+  }
+
+  Mdc_free(filtered_environment);
+  FreeEnvironmentStringsW(inherited_environment);
+  Mdc_free(expanded_entry);
+  Mdc_free(template_entries);
+
+  return 1;
+
+bad_free_filtered_environment:
+  Mdc_free(filtered_environment);
+
+bad_free_environment_strings:
+  FreeEnvironmentStringsW(inherited_environment);
+
+bad_free_expanded_entry:
+  Mdc_free(expanded_entry);
+
+bad_free_template_entries:
+  Mdc_free(template_entries);
+
+bad_return:
+  return 0;
+}
+
+/**
+ * External
+ */
+
+struct InstanceBoxes* InstanceBoxes_Init(
+    struct InstanceBoxes* boxes,
+    const wchar_t* game_path,
+    const wchar_t* box_directory_path,
+    const wchar_t* writable_list_path,
+    const wchar_t* environment_template_path,
+    size_t num_boxes) {
+  wchar_t full_game_path[MAX_PATH];
+  wchar_t game_directory[MAX_PATH];
+  DWORD get_full_path_name_result;
+
+  boxes->num_boxes = num_boxes;
+  boxes->directory_paths = NULL;
+  boxes->game_paths = NULL;
+  boxes->environments = NULL;
+  boxes->environment_offsets = NULL;
+
+  get_full_path_name_result = GetFullPathNameW(
+      game_path,
+      MAX_PATH,
+      full_game_path,
+      NULL);
+  if (get_full_path_name_result == 0
+      || get_full_path_name_result >= MAX_PATH) {
+    goto bad_deinit;
+  }
+
+  wcscpy(game_directory, full_game_path);
+  PathRemoveFileSpecW(game_directory);
+
+  if (box_directory_path != NULL) {
+    if (!BuildBoxes(
+            boxes,
+            full_game_path,
+            game_directory,
+            box_directory_path,
+            writable_list_path)) {
+      goto bad_deinit;
+    }
+  }
+
+  if (environment_template_path != NULL) {
+    if (!AssembleEnvironments(
+            boxes,
+            game_directory,
+            environment_template_path)) {
+      goto bad_deinit;
+    }
+  }
+
+  return boxes;
+
+bad_deinit:
+  InstanceBoxes_Deinit(boxes);
+
+  return NULL;
+}
+
+void InstanceBoxes_Deinit(struct InstanceBoxes* boxes) {
+  Mdc_free(boxes->environment_offsets);
+  boxes->environment_offsets = NULL;
+
+  Mdc_free(boxes->environments);
+  boxes->environments = NULL;
+
+  Mdc_free(boxes->game_paths);
+  boxes->game_paths = NULL;
+
+  Mdc_free(boxes->directory_paths);
+  boxes->directory_paths = NULL;
+
+  boxes->num_boxes = 0;
+}
+
+const wchar_t* InstanceBoxes_GetGamePath(
+    const struct InstanceBoxes* boxes,
+    size_t instance_number) {
+  if (boxes->game_paths == NULL || instance_number >= boxes->num_boxes) {
+    return NULL;
+  }
+
+  return boxes->game_paths[instance_number];
+}
+
+const wchar_t* InstanceBoxes_GetDirectoryPath(
+    const struct InstanceBoxes* boxes,
+    size_t instance_number) {
+  if (boxes->directory_paths == NULL
+      || instance_number >= boxes->num_boxes) {
+    return NULL;
+  }
+
+  return boxes->directory_paths[instance_number];
+}
+
+wchar_t* InstanceBoxes_GetEnvironment(
+    const struct InstanceBoxes* boxes,
+    size_t instance_number) {
+  if (boxes->environments == NULL || instance_number >= boxes->num_boxes) {
+    return NULL;
+  }
+
+  return &boxes->environments[boxes->environment_offsets[instance_number]];
+}
@@ -0,0 +1,129 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_INSTANCE_BOXES_H_
+#define SGGL_INSTANCE_BOXES_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum {
+  /* Writable paths beyond this count are linked like the rest. */
+  InstanceBoxes_kMaxWritablePaths = 256,
+
+  /* Template lines beyond this count are ignored. */
+  InstanceBoxes_kMaxTemplateEntries = 64,
+  InstanceBoxes_kMaxTemplateEntryLength = 1024
+};
+
+/**
+ * The working directory and environment of each game instance, indexed
+ * by instance number.
+ *
+ * A box is a directory that mirrors the game's directory. Each file is
+ * a hard link to the installed file, or a symbolic link or copy where
+ * hard links are not possible, and subdirectories without writable
+ * files are linked whole where the system allows it. The writable files
+ * are copied into the box the first time it is built and are kept
+ * afterwards, so that an instance only ever writes to its own copy.
+ *
+ * The environment blocks are assembled once from the loader's own
+ * environment and a template file of NAME=value lines, in which
+ * %SGGL_INSTANCE% and %SGGL_BOX% are replaced by the instance number and
+ * the instance's working directory.
+ */
+struct InstanceBoxes {
+  size_t num_boxes;
+
+  /* NULL if the instances run in the game's directory. */
+  wchar_t (*directory_paths)[MAX_PATH];
+  wchar_t (*game_paths)[MAX_PATH];
+
+  /* NULL if the instances inherit the loader's environment. */
+  wchar_t* environments;
+  size_t* environment_offsets;
+};
+
+/**
+ * Builds or updates a box for each instance in a numbered directory
+ * under the box directory, and assembles the environment blocks. The
+ * box directory, writable list and environment template may each be
+ * NULL. The writable list holds one path per line, relative to the
+ * game's directory; empty lines and lines starting with # are skipped.
+ * Returns NULL if a box could not be built.
+ */
+struct InstanceBoxes* InstanceBoxes_Init(
+    struct InstanceBoxes* boxes,
+    const wchar_t* game_path,
+    const wchar_t* box_directory_path,
+    const wchar_t* writable_list_path,
+    const wchar_t* environment_template_path,
+    size_t num_boxes);
+
+/**
+ * Releases the paths and environment blocks. The boxes stay on disk, so
+ * that the next launch only has to check them.
+ */
+void InstanceBoxes_Deinit(struct InstanceBoxes* boxes);
+
+/**
+ * Returns the path of the game executable inside of the instance's box,
+ * or NULL if the instance runs from the game's directory.
+ */
+const wchar_t* InstanceBoxes_GetGamePath(
+    const struct InstanceBoxes* boxes,
+    size_t instance_number);
+
+/**
+ * Returns the instance's working directory, or NULL if the instance
+ * runs in the game's directory.
+ */
+const wchar_t* InstanceBoxes_GetDirectoryPath(
+    const struct InstanceBoxes* boxes,
+    size_t instance_number);
+
+/**
+ * Returns the instance's Unicode environment block, or NULL if the
+ * instance inherits the loader's environment.
+ */
+wchar_t* InstanceBoxes_GetEnvironment(
+    const struct InstanceBoxes* boxes,
+    size_t instance_number);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_INSTANCE_BOXES_H_ */
@@ -0,0 +1,426 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "instance_job.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#include "platform.h"
+
+enum {
+  kJobObjectBasicAndIoAccountingInformation = 8,
+  kJobObjectExtendedLimitInformation = 9,
+  kJobObjectAssociateCompletionPortInformation = 7,
+  kJobObjectCpuRateControlInformation = 15,
+
+  kJobObjectCpuRateControlEnable = 0x1,
+  kJobObjectCpuRateControlHardCap = 0x4
+};
+
+/*
+ * Mirror of JOBOBJECT_CPU_RATE_CONTROL_INFORMATION, which was added in
+ * Windows 8.
+ */
+struct JobObjectCpuRateControlInformation {
+  DWORD control_flags;
+
+  /* Percentage times 100. */
+  DWORD cpu_rate;
+};
+
+typedef HANDLE WINAPI CreateJobObjectWFuncType(
+    SECURITY_ATTRIBUTES*, const wchar_t*);
+typedef BOOL WINAPI SetInformationJobObjectFuncType(
+    HANDLE, int, void*, DWORD);
+typedef BOOL WINAPI QueryInformationJobObjectFuncType(
+    HANDLE, int, void*, DWORD, DWORD*);
+
+static void* GetKernel32ProcAddress(const char* proc_name) {
+  return GetProcAddress(GetModuleHandleW(L"kernel32.dll"), proc_name);
+}
+
+static BOOL SetJobInformation(
+    HANDLE job,
+    int information_class,
+    void* information,
+    DWORD information_length) {
+  SetInformationJobObjectFuncType* set_information_job_object_func;
+
+  set_information_job_object_func =
+      (SetInformationJobObjectFuncType*) GetKernel32ProcAddress(
+          "SetInformationJobObject");
+  if (set_information_job_object_func == NULL) {
+    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+    return FALSE;
+  }
+
+  return set_information_job_object_func(
+      job,
+      information_class,
+      information,
+      information_length);
+}
+
+static BOOL QueryJobInformation(
+    HANDLE job,
+    int information_class,
+    void* information,
+    DWORD information_length) {
+  QueryInformationJobObjectFuncType* query_information_job_object_func;
+
+  query_information_job_object_func =
+      (QueryInformationJobObjectFuncType*) GetKernel32ProcAddress(
+          "QueryInformationJobObject");
+  if (query_information_job_object_func == NULL) {
+    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+    return FALSE;
+  }
+
+  return query_information_job_object_func(
+      job,
+      information_class,
+      information,
+      information_length,
+      NULL);
+}
+
+static SIZE_T MegabytesToBytes(DWORD megabytes) {
+  /* Clamp limits that do not fit into the address size. */
+  if (megabytes > ((SIZE_T) -1) / (1024 * 1024)) {
+    return ((SIZE_T) -1) & ~((SIZE_T) 0xFFFFF);
+  }
+
+  return (SIZE_T) megabytes * 1024 * 1024;
+}
+
+static unsigned long TimeToMilliseconds(const LARGE_INTEGER* time) {
+  /* Job times are in 100-nanosecond units. */
+  return (unsigned long) (time->QuadPart / 10000);
+}
+
+static unsigned long BytesToKilobytes(ULONGLONG bytes) {
+  return (unsigned long) (bytes / 1024);
+}
+
+static int ApplyLimits(
+    struct InstanceJob* instance_job,
+    const struct InstanceJobLimits* limits) {
+  JOBOBJECT_EXTENDED_LIMIT_INFORMATION limit_information;
+  struct JobObjectCpuRateControlInformation cpu_rate_information;
+  BOOL is_set_information_success;
+
+  memset(&limit_information, 0, sizeof(limit_information));
+
+  if (limits->process_memory_limit_mb > 0) {
+    limit_information.BasicLimitInformation.LimitFlags |=
+        JOB_OBJECT_LIMIT_PROCESS_MEMORY;
+    limit_information.ProcessMemoryLimit = MegabytesToBytes(
+        limits->process_memory_limit_mb);
+  }
+
+  if (limits->job_memory_limit_mb > 0) {
+    limit_information.BasicLimitInformation.LimitFlags |=
+        JOB_OBJECT_LIMIT_JOB_MEMORY;
+    limit_information.JobMemoryLimit = MegabytesToBytes(
+        limits->job_memory_limit_mb);
+  }
+
+  if (limits->is_kill_on_close) {
+    limit_information.BasicLimitInformation.LimitFlags |=
+        JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+  }
+
+  is_set_information_success = SetJobInformation(
+      instance_job->job,
+      kJobObjectExtendedLimitInformation,
+      &limit_information,
+      sizeof(limit_information));
+  if (!is_set_information_success) {
+    wprintf(
+        L"SetInformationJobObject failed, error 0x%lX.\n\n",
+        GetLastError());
+    return 0;
+  }
+
+  if (limits->cpu_rate_percent > 0) {
+    cpu_rate_information.control_flags = kJobObjectCpuRateControlEnable
+        | kJobObjectCpuRateControlHardCap;
+    cpu_rate_information.cpu_rate = limits->cpu_rate_percent * 100;
+
+    /* CPU rate control was added in Windows 8. */
+    is_set_information_success = SetJobInformation(
+        instance_job->job,
+        kJobObjectCpuRateControlInformation,
+        &cpu_rate_information,
+        sizeof(cpu_rate_information));
+    if (!is_set_information_success) {
+      wprintf(L"CPU rate cap is not supported by this system.\n");
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * External
+ */
+
+struct InstanceJob* InstanceJob_Init(
+    struct InstanceJob* instance_job,
+    const struct InstanceJobLimits* limits) {
+  CreateJobObjectWFuncType* create_job_object_func;
+  JOBOBJECT_ASSOCIATE_COMPLETION_PORT completion_port_information;
+  BOOL is_set_information_success;
+
+  /* Windows 95/98/ME do not have job objects. */
+  create_job_object_func = (CreateJobObjectWFuncType*) GetKernel32ProcAddress(
+      "CreateJobObjectW");
+  if (create_job_object_func == NULL) {
+    wprintf(L"Job objects are not supported by this system.\n\n");
+    goto bad_return;
+  }
+
+  instance_job->job = create_job_object_func(NULL, NULL);
+  if (instance_job->job == NULL) {
+    wprintf(L"CreateJobObjectW failed, error 0x%lX.\n\n", GetLastError());
+    goto bad_return;
+  }
+
+  /* The port reports when every process in the job has exited. */
+  instance_job->completion_port = CreateIoCompletionPort(
+      INVALID_HANDLE_VALUE,
+      NULL,
+      0,
+      1);
+  if (instance_job->completion_port == NULL) {
+    wprintf(L"CreateIoCompletionPort failed, error 0x%lX.\n\n", GetLastError());
+    goto bad_close_job;
+  }
+
+  completion_port_information.CompletionKey = instance_job->job;
+  completion_port_information.CompletionPort = instance_job->completion_port;
+
+  is_set_information_success = SetJobInformation(
+      instance_job->job,
+      kJobObjectAssociateCompletionPortInformation,
+      &completion_port_information,
+      sizeof(completion_port_information));
+  if (!is_set_information_success) {
+    wprintf(
+        L"SetInformationJobObject failed, error 0x%lX.\n\n",
+        GetLastError());
+    goto bad_close_completion_port;
+  }
+
+  if (!ApplyLimits(instance_job, limits)) {
+    goto bad_close_completion_port;
+  }
+
+  return instance_job;
+
+bad_close_completion_port:
+  CloseHandle(instance_job->completion_port);
+
+bad_close_job:
+  CloseHandle(instance_job->job);
+
+bad_return:
+  instance_job->job = NULL;
+  instance_job->completion_port = NULL;
+
+  return NULL;
+}
+
+void InstanceJob_Deinit(struct InstanceJob* instance_job) {
+  if (instance_job->job == NULL) {
+    return;
+  }
+
+  /* Processes are terminated here if kill on close is set. */
+  CloseHandle(instance_job->job);
+  CloseHandle(instance_job->completion_port);
+
+  instance_job->job = NULL;
+  instance_job->completion_port = NULL;
+}
+
+int InstanceJob_AssignProcess(
+    struct InstanceJob* instance_job,
+    const PROCESS_INFORMATION* process_info,
+    size_t instance_index) {
+  BOOL is_assign_success;
+
+  is_assign_success = Platform_AssignProcessToJobObject(
+      instance_job->job,
+      process_info->hProcess);
+
+  /*
+   * Before Windows 8, this fails if the loader itself is already in a
+   * job that does not allow breakaway.
+   */
+  if (!is_assign_success) {
+    wprintf(
+        L"Instance %u could not be assigned to the job (error %lu).\n",
+        instance_index,
+        GetLastError());
+    return 0;
+  }
+
+  return 1;
+}
+
+int InstanceJob_AssignProcesses(
+    struct InstanceJob* instance_job,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_instances) {
+  size_t i_instance;
+  int is_all_success;
+
+  is_all_success = 1;
+
+  for (i_instance = 0; i_instance < num_instances; ++i_instance) {
+    is_all_success = InstanceJob_AssignProcess(
+        instance_job,
+        &processes_infos[i_instance],
+        i_instance) && is_all_success;
+  }
+
+  if (is_all_success) {
+    wprintf(L"%u instance(s) assigned to the job.\n\n", num_instances);
+  } else {
+    wprintf(L"\n");
+  }
+
+  return is_all_success;
+}
+
+void InstanceJob_PrintAccounting(const struct InstanceJob* instance_job) {
+  JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION accounting_information;
+  JOBOBJECT_EXTENDED_LIMIT_INFORMATION limit_information;
+  BOOL is_query_success;
+
+  is_query_success = QueryJobInformation(
+      instance_job->job,
+      kJobObjectBasicAndIoAccountingInformation,
+      &accounting_information,
+      sizeof(accounting_information));
+  if (!is_query_success) {
+    wprintf(L"Job accounting could not be queried.\n\n");
+    return;
+  }
+
+  is_query_success = QueryJobInformation(
+      instance_job->job,
+      kJobObjectExtendedLimitInformation,
+      &limit_information,
+      sizeof(limit_information));
+  if (!is_query_success) {
+    wprintf(L"Job accounting could not be queried.\n\n");
+    return;
+  }
+
+  wprintf(L"Job accounting:\n");
+  wprintf(
+      L"  Processes: %lu total, %lu active, %lu terminated\n",
+      accounting_information.BasicInfo.TotalProcesses,
+      accounting_information.BasicInfo.ActiveProcesses,
+      accounting_information.BasicInfo.TotalTerminatedProcesses);
+  wprintf(
+      L"  Peak commit: %lu KB per process, %lu KB for the job\n",
+      BytesToKilobytes(limit_information.PeakProcessMemoryUsed),
+      BytesToKilobytes(limit_information.PeakJobMemoryUsed));
+  wprintf(
+      L"  CPU time: %lu ms user, %lu ms kernel\n",
+      TimeToMilliseconds(&accounting_information.BasicInfo.TotalUserTime),
+      TimeToMilliseconds(&accounting_information.BasicInfo.TotalKernelTime));
+  wprintf(
+      L"  I/O: %lu KB read, %lu KB written, %lu KB other\n",
+      BytesToKilobytes(accounting_information.IoInfo.ReadTransferCount),
+      BytesToKilobytes(accounting_information.IoInfo.WriteTransferCount),
+      BytesToKilobytes(accounting_information.IoInfo.OtherTransferCount));
+  wprintf(L"\n");
+}
+
+int InstanceJob_WaitForExit(
+    const struct InstanceJob* instance_job,
+    DWORD timeout_milliseconds) {
+  JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION accounting_information;
+  DWORD start_tick_count;
+  DWORD elapsed_milliseconds;
+  DWORD wait_milliseconds;
+  DWORD message;
+  ULONG_PTR completion_key;
+  OVERLAPPED* overlapped;
+  BOOL is_message_received;
+
+  /*
+   * No exit message is posted if the job never had a process, and the
+   * message is only posted once.
+   */
+  if (!QueryJobInformation(
+      instance_job->job,
+      kJobObjectBasicAndIoAccountingInformation,
+      &accounting_information,
+      sizeof(accounting_information))
+      || accounting_information.BasicInfo.ActiveProcesses == 0) {
+    return 1;
+  }
+
+  start_tick_count = GetTickCount();
+
+  for (;;) {
+    wait_milliseconds = timeout_milliseconds;
+    if (timeout_milliseconds != INFINITE) {
+      elapsed_milliseconds = GetTickCount() - start_tick_count;
+      wait_milliseconds = (elapsed_milliseconds < timeout_milliseconds)
+          ? timeout_milliseconds - elapsed_milliseconds
+          : 0;
+    }
+
+    is_message_received = GetQueuedCompletionStatus(
+        instance_job->completion_port,
+        &message,
+        &completion_key,
+        &overlapped,
+        wait_milliseconds);
+    if (!is_message_received) {
+      return 0;
+    }
+
+    if (completion_key == (ULONG_PTR) instance_job->job
+        && message == JOB_OBJECT_MSG_ACTIVE_PROCESS_ZERO) {
+      return 1;
+    }
+  }
+}
@@ -0,0 +1,103 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_INSTANCE_JOB_H_
+#define SGGL_INSTANCE_JOB_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Limits applied to the job that contains every game instance. A value
+ * of zero means no limit.
+ */
+struct InstanceJobLimits {
+  DWORD process_memory_limit_mb;
+  DWORD job_memory_limit_mb;
+  DWORD cpu_rate_percent;
+  int is_kill_on_close;
+};
+
+struct InstanceJob {
+  HANDLE job;
+  HANDLE completion_port;
+};
+
+/**
+ * Creates the job and applies the limits. Returns NULL if the system
+ * does not support job objects or the job could not be created.
+ */
+struct InstanceJob* InstanceJob_Init(
+    struct InstanceJob* instance_job,
+    const struct InstanceJobLimits* limits);
+
+void InstanceJob_Deinit(struct InstanceJob* instance_job);
+
+/**
+ * Assigns one suspended process to the job. Returns nonzero on success.
+ */
+int InstanceJob_AssignProcess(
+    struct InstanceJob* instance_job,
+    const PROCESS_INFORMATION* process_info,
+    size_t instance_index);
+
+/**
+ * Assigns the suspended processes to the job. Returns nonzero if every
+ * process was assigned.
+ */
+int InstanceJob_AssignProcesses(
+    struct InstanceJob* instance_job,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_instances);
+
+/**
+ * Prints the peak commit, total CPU time, and I/O bytes of every
+ * process that has been in the job.
+ */
+void InstanceJob_PrintAccounting(const struct InstanceJob* instance_job);
+
+/**
+ * Waits until every process in the job has exited. Returns nonzero if
+ * they exited within the timeout.
+ */
+int InstanceJob_WaitForExit(
+    const struct InstanceJob* instance_job,
+    DWORD timeout_milliseconds);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_INSTANCE_JOB_H_ */
@@ -0,0 +1,554 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "instance_registry.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+/*
+ * The names are in the session's namespace, since creating global
+ * objects needs a privilege that most users do not have.
+ */
+static const wchar_t* const kMappingName = L"SGGL.InstanceRegistry";
+static const wchar_t* const kMutexName = L"SGGL.InstanceRegistry.Lock";
+
+/**
+ * Layout of the shared memory. The mapping starts zeroed, so the first
+ * run to lock it writes the header.
+ */
+struct InstanceRegistry_Shared {
+  DWORD version;
+  DWORD capacity;
+  DWORD entry_size;
+  DWORD reserved;
+
+  struct InstanceRegistry_Entry entries[InstanceRegistry_kCapacity];
+};
+
+static volatile LONG last_launch_id = 0;
+
+static int InstanceRegistry_Lock(struct InstanceRegistry* registry) {
+  DWORD wait_result;
+
+  /*
+   * A run that exited while holding the lock cannot have left a partial
+   * entry behind, so an abandoned lock is as good as a released one.
+   */
+  wait_result = WaitForSingleObject(registry->mutex, INFINITE);
+
+  return wait_result == WAIT_OBJECT_0 || wait_result == WAIT_ABANDONED;
+}
+
+static void InstanceRegistry_Unlock(struct InstanceRegistry* registry) {
+  ReleaseMutex(registry->mutex);
+}
+
+static int IsEntryAlive(const struct InstanceRegistry_Entry* entry) {
+  HANDLE process;
+  FILETIME creation_time;
+  FILETIME exit_time;
+  FILETIME kernel_time;
+  FILETIME user_time;
+  int is_alive;
+
+  process = OpenProcess(
+      SYNCHRONIZE | PROCESS_QUERY_INFORMATION,
+      FALSE,
+      entry->process_id);
+  if (process == NULL) {
+    /* Processes of other users cannot be opened, but still exist. */
+    return GetLastError() == ERROR_ACCESS_DENIED;
+  }
+
+  is_alive = (WaitForSingleObject(process, 0) == WAIT_TIMEOUT);
+
+  /* A different creation time means that the ID was reused. */
+  if (is_alive
+      && (entry->creation_time.dwLowDateTime != 0
+          || entry->creation_time.dwHighDateTime != 0)
+      && GetProcessTimes(
+          process,
+          &creation_time,
+          &exit_time,
+          &kernel_time,
+          &user_time)) {
+    is_alive = (CompareFileTime(&creation_time, &entry->creation_time) == 0);
+  }
+
+  CloseHandle(process);
+
+  return is_alive;
+}
+
+/**
+ * Frees the entries of the instances that have exited. The registry
+ * must be locked.
+ */
+static void CollectEntries(struct InstanceRegistry* registry) {
+  size_t i_entry;
+  struct InstanceRegistry_Entry* entry;
+
+  for (i_entry = 0; i_entry < InstanceRegistry_kCapacity; ++i_entry) {
+    entry = &registry->shared->entries[i_entry];
+
+    if (entry->process_id != 0 && !IsEntryAlive(entry)) {
+      entry->process_id = 0;
+    }
+  }
+}
+
+static int IsOtherRunEntry(
+    const struct InstanceRegistry* registry,
+    const struct InstanceRegistry_Entry* entry) {
+  return entry->loader_process_id != registry->loader_process_id
+      || entry->launch_id != registry->launch_id;
+}
+
+static int IsOwnPlaceholder(
+    const struct InstanceRegistry* registry,
+    const struct InstanceRegistry_Entry* entry) {
+  return entry->process_id != 0
+      && entry->is_placeholder
+      && !IsOtherRunEntry(registry, entry);
+}
+
+static struct InstanceRegistry_Entry* FindFreeEntry(
+    struct InstanceRegistry* registry) {
+  size_t i_entry;
+
+  for (i_entry = 0; i_entry < InstanceRegistry_kCapacity; ++i_entry) {
+    if (registry->shared->entries[i_entry].process_id == 0) {
+      return &registry->shared->entries[i_entry];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Counts the entries of every run, and the processors that other runs'
+ * instances are bound to. The registry must be locked.
+ */
+static void CountUsage(
+    const struct InstanceRegistry* registry,
+    struct InstanceRegistry_Usage* usage) {
+  size_t i_entry;
+  size_t i_processor;
+  const struct InstanceRegistry_Entry* entry;
+
+  memset(usage, 0, sizeof(*usage));
+
+  for (i_entry = 0; i_entry < InstanceRegistry_kCapacity; ++i_entry) {
+    entry = &registry->shared->entries[i_entry];
+
+    if (entry->process_id == 0) {
+      continue;
+    }
+
+    if (entry->is_placeholder) {
+      usage->num_placeholders += 1;
+      continue;
+    }
+
+    usage->num_instances += 1;
+
+    if (!IsOtherRunEntry(registry, entry)) {
+      continue;
+    }
+
+    usage->num_other_instances += 1;
+
+    for (i_processor = 0;
+        i_processor < InstanceRegistry_kMaxProcessors;
+        ++i_processor) {
+      if ((entry->affinity_mask & ((ULONGLONG) 1 << i_processor)) != 0) {
+        usage->processor_loads[i_processor] += 1;
+      }
+    }
+  }
+}
+
+/**
+ * Frees the placeholders of this run. The registry must be locked.
+ */
+static void FreeOwnPlaceholders(struct InstanceRegistry* registry) {
+  size_t i_entry;
+  struct InstanceRegistry_Entry* entry;
+
+  for (i_entry = 0; i_entry < InstanceRegistry_kCapacity; ++i_entry) {
+    entry = &registry->shared->entries[i_entry];
+
+    if (IsOwnPlaceholder(registry, entry)) {
+      entry->process_id = 0;
+    }
+  }
+}
+
+/**
+ * Writes the header of a new registry, or checks that an existing
+ * registry has the same layout. The registry must be locked.
+ */
+static int InitShared(struct InstanceRegistry_Shared* shared) {
+  if (shared->version == 0) {
+    shared->capacity = InstanceRegistry_kCapacity;
+    shared->entry_size = sizeof(shared->entries[0]);
+    shared->version = InstanceRegistry_kVersion;
+    return 1;
+  }
+
+  return shared->version == InstanceRegistry_kVersion
+      && shared->capacity == InstanceRegistry_kCapacity
+      && shared->entry_size == sizeof(shared->entries[0]);
+}
+
+/**
+ * External
+ */
+
+struct InstanceRegistry* InstanceRegistry_Init(
+    struct InstanceRegistry* registry,
+    const wchar_t* profile_name) {
+  int is_shared_valid;
+
+  registry->mapping = CreateFileMappingW(
+      INVALID_HANDLE_VALUE,
+      NULL,
+      PAGE_READWRITE,
+      0,
+      sizeof(*registry->shared),
+      kMappingName);
+  if (registry->mapping == NULL) {
+    goto bad_return;
+  }
+
+  registry->shared = MapViewOfFile(
+      registry->mapping,
+      FILE_MAP_ALL_ACCESS,
+      0,
+      0,
+      sizeof(*registry->shared));
+  if (registry->shared == NULL) {
+    goto bad_close_mapping;
+  }
+
+  registry->mutex = CreateMutexW(NULL, FALSE, kMutexName);
+  if (registry->mutex == NULL) {
+    goto bad_unmap_view;
+  }
+
+  if (!InstanceRegistry_Lock(registry)) {
+    goto bad_close_mutex;
+  }
+
+  is_shared_valid = InitShared(registry->shared);
+  InstanceRegistry_Unlock(registry);
+
+  if (!is_shared_valid) {
+    wprintf(
+        L"The instance registry is in use by a different version of "
+            L"the loader, so other runs are not taken into account.\n\n");
+    goto bad_close_mutex;
+  }
+
+  registry->loader_process_id = GetCurrentProcessId();
+  registry->launch_id = (DWORD) InterlockedIncrement(
+      (LONG*) &last_launch_id);
+
+  registry->profile_name = profile_name;
+  registry->expected_commit_size = 0;
+  registry->expected_working_set_size = 0;
+
+  return registry;
+
+bad_close_mutex:
+  CloseHandle(registry->mutex);
+
+bad_unmap_view:
+  UnmapViewOfFile(registry->shared);
+
+bad_close_mapping:
+  CloseHandle(registry->mapping);
+
+bad_return:
+  return NULL;
+}
+
+void InstanceRegistry_Deinit(struct InstanceRegistry* registry) {
+  /* Placeholders left behind are freed once the loader exits anyway. */
+  InstanceRegistry_ReleasePlaceholders(registry);
+
+  CloseHandle(registry->mutex);
+  UnmapViewOfFile(registry->shared);
+  CloseHandle(registry->mapping);
+
+  registry->mutex = NULL;
+  registry->shared = NULL;
+  registry->mapping = NULL;
+}
+
+void InstanceRegistry_SetFootprint(
+    struct InstanceRegistry* registry,
+    ULONGLONG expected_commit_size,
+    ULONGLONG expected_working_set_size) {
+  registry->expected_commit_size = expected_commit_size;
+  registry->expected_working_set_size = expected_working_set_size;
+}
+
+int InstanceRegistry_Reserve(
+    struct InstanceRegistry* registry,
+    size_t max_instances,
+    size_t* num_instances,
+    struct InstanceRegistry_Usage* usage) {
+  size_t num_used_entries;
+  size_t num_admitted_instances;
+  size_t num_reserved_instances;
+  struct InstanceRegistry_Entry* entry;
+  FILETIME creation_time;
+  FILETIME exit_time;
+  FILETIME kernel_time;
+  FILETIME user_time;
+
+  /* The placeholders live as long as the loader does. */
+  if (!GetProcessTimes(
+      GetCurrentProcess(),
+      &creation_time,
+      &exit_time,
+      &kernel_time,
+      &user_time)) {
+    creation_time.dwLowDateTime = 0;
+    creation_time.dwHighDateTime = 0;
+  }
+
+  if (!InstanceRegistry_Lock(registry)) {
+    return 0;
+  }
+
+  CollectEntries(registry);
+  CountUsage(registry, usage);
+
+  num_used_entries = usage->num_instances + usage->num_placeholders;
+
+  num_admitted_instances = 0;
+  if (num_used_entries < max_instances) {
+    num_admitted_instances = max_instances - num_used_entries;
+  }
+
+  if (num_admitted_instances > *num_instances) {
+    num_admitted_instances = *num_instances;
+  }
+
+  for (num_reserved_instances = 0;
+      num_reserved_instances < num_admitted_instances;
+      ++num_reserved_instances) {
+    entry = FindFreeEntry(registry);
+    if (entry == NULL) {
+      break;
+    }
+
+    entry->loader_process_id = registry->loader_process_id;
+    entry->launch_id = registry->launch_id;
+    entry->is_placeholder = 1;
+    entry->creation_time = creation_time;
+    entry->affinity_mask = 0;
+    entry->expected_commit_size = 0;
+    entry->expected_working_set_size = 0;
+    entry->profile_name[0] = L'\0';
+
+    /* Publish the entry only once it is whole. */
+    entry->process_id = registry->loader_process_id;
+  }
+
+  InstanceRegistry_Unlock(registry);
+
+  *num_instances = num_reserved_instances;
+
+  return 1;
+}
+
+void InstanceRegistry_ReleasePlaceholders(
+    struct InstanceRegistry* registry) {
+  if (!InstanceRegistry_Lock(registry)) {
+    return;
+  }
+
+  FreeOwnPlaceholders(registry);
+
+  InstanceRegistry_Unlock(registry);
+}
+
+int InstanceRegistry_Register(
+    struct InstanceRegistry* registry,
+    const PROCESS_INFORMATION* process_info,
+    ULONG_PTR affinity_mask) {
+  size_t i_entry;
+  struct InstanceRegistry_Entry* entry;
+  FILETIME creation_time;
+  FILETIME exit_time;
+  FILETIME kernel_time;
+  FILETIME user_time;
+  HANDLE remote_mapping;
+
+  if (!GetProcessTimes(
+      process_info->hProcess,
+      &creation_time,
+      &exit_time,
+      &kernel_time,
+      &user_time)) {
+    creation_time.dwLowDateTime = 0;
+    creation_time.dwHighDateTime = 0;
+  }
+
+  /*
+   * Give the instance its own handle to the shared memory, which keeps
+   * the entry readable after this run exits.
+   */
+  if (!DuplicateHandle(
+      GetCurrentProcess(),
+      registry->mapping,
+      process_info->hProcess,
+      &remote_mapping,
+      0,
+      FALSE,
+      DUPLICATE_SAME_ACCESS)) {
+    return 0;
+  }
+
+  if (!InstanceRegistry_Lock(registry)) {
+    return 0;
+  }
+
+  CollectEntries(registry);
+
+  /*
+   * Take one of this run's placeholders. It is freed before it is
+   * written, so the entry stays either free or whole.
+   */
+  entry = NULL;
+  for (i_entry = 0; i_entry < InstanceRegistry_kCapacity; ++i_entry) {
+    if (IsOwnPlaceholder(registry, &registry->shared->entries[i_entry])) {
+      entry = &registry->shared->entries[i_entry];
+      entry->process_id = 0;
+      break;
+    }
+  }
+
+  if (entry == NULL) {
+    entry = FindFreeEntry(registry);
+  }
+
+  if (entry == NULL) {
+    InstanceRegistry_Unlock(registry);
+
+    wprintf(
+        L"The instance registry is full, so process %lu is not "
+            L"registered.\n",
+        process_info->dwProcessId);
+    return 0;
+  }
+
+  entry->loader_process_id = registry->loader_process_id;
+  entry->launch_id = registry->launch_id;
+  entry->is_placeholder = 0;
+  entry->creation_time = creation_time;
+  entry->affinity_mask = affinity_mask;
+  entry->expected_commit_size = registry->expected_commit_size;
+  entry->expected_working_set_size = registry->expected_working_set_size;
+
+  entry->profile_name[0] = L'\0';
+  if (registry->profile_name != NULL) {
+    wcsncpy(
+        entry->profile_name,
+        registry->profile_name,
+        InstanceRegistry_kProfileNameLength);
+    entry->profile_name[InstanceRegistry_kProfileNameLength - 1] = L'\0';
+  }
+
+  /* Publish the entry only once it is whole. */
+  entry->process_id = process_info->dwProcessId;
+
+  InstanceRegistry_Unlock(registry);
+
+  return 1;
+}
+
+int InstanceRegistry_GetUsage(
+    struct InstanceRegistry* registry,
+    struct InstanceRegistry_Usage* usage) {
+  memset(usage, 0, sizeof(*usage));
+
+  if (!InstanceRegistry_Lock(registry)) {
+    return 0;
+  }
+
+  CollectEntries(registry);
+  CountUsage(registry, usage);
+
+  InstanceRegistry_Unlock(registry);
+
+  return 1;
+}
+
+size_t InstanceRegistry_GetOtherInstances(
+    struct InstanceRegistry* registry,
+    struct InstanceRegistry_Entry* entries,
+    size_t capacity) {
+  size_t i_entry;
+  size_t num_entries;
+  const struct InstanceRegistry_Entry* entry;
+
+  if (!InstanceRegistry_Lock(registry)) {
+    return 0;
+  }
+
+  CollectEntries(registry);
+
+  num_entries = 0;
+  for (i_entry = 0;
+      i_entry < InstanceRegistry_kCapacity && num_entries < capacity;
+      ++i_entry) {
+    entry = &registry->shared->entries[i_entry];
+
+    /* Placeholders have no process of their own yet. */
+    if (entry->process_id != 0
+        && !entry->is_placeholder
+        && IsOtherRunEntry(registry, entry)) {
+      entries[num_entries] = *entry;
+      num_entries += 1;
+    }
+  }
+
+  InstanceRegistry_Unlock(registry);
+
+  return num_entries;
+}
@@ -0,0 +1,188 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_INSTANCE_REGISTRY_H_
+#define SGGL_INSTANCE_REGISTRY_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Registry of the game instances launched by every run of the loader
+ * in the session, kept in named shared memory and guarded by a named
+ * mutex. Each instance holds a handle to the shared memory, so entries
+ * outlive the run that registered them. An entry is freed once its
+ * instance has exited, which is checked whenever the registry is read.
+ *
+ * A run reserves its entries before creating its instances, so that
+ * runs that start together cannot admit more instances than the limit
+ * between them. A reserved entry is a placeholder under the loader's
+ * process ID, so it is freed if the run exits without releasing it.
+ */
+
+enum {
+  InstanceRegistry_kVersion = 1,
+  InstanceRegistry_kCapacity = 256,
+
+  /* Instances running anywhere in the session, unless overridden. */
+  InstanceRegistry_kDefaultMaxInstances = 64,
+
+  InstanceRegistry_kMaxProcessors = 64,
+  InstanceRegistry_kProfileNameLength = 32
+};
+
+/**
+ * A registered instance. The process ID is written last, so an entry
+ * is either free or whole, even if its run exits while writing it.
+ * The creation time tells apart a new process that reused the ID.
+ */
+struct InstanceRegistry_Entry {
+  DWORD process_id;
+  DWORD loader_process_id;
+  DWORD launch_id;
+
+  /* Nonzero if the entry is held for an instance not yet created. */
+  DWORD is_placeholder;
+
+  FILETIME creation_time;
+
+  /* Zero if the instance was not placed. */
+  ULONGLONG affinity_mask;
+
+  /* Peaks learned for the instance's profile, or zero if unknown. */
+  ULONGLONG expected_commit_size;
+  ULONGLONG expected_working_set_size;
+
+  wchar_t profile_name[InstanceRegistry_kProfileNameLength];
+};
+
+struct InstanceRegistry_Usage {
+  size_t num_instances;
+  size_t num_other_instances;
+
+  /* Placeholders of every run, which are not counted as instances. */
+  size_t num_placeholders;
+
+  /* Instances of other runs bound to each processor of the group. */
+  DWORD processor_loads[InstanceRegistry_kMaxProcessors];
+};
+
+struct InstanceRegistry {
+  HANDLE mapping;
+  HANDLE mutex;
+  struct InstanceRegistry_Shared* shared;
+
+  DWORD loader_process_id;
+  DWORD launch_id;
+
+  const wchar_t* profile_name;
+  ULONGLONG expected_commit_size;
+  ULONGLONG expected_working_set_size;
+};
+
+/**
+ * Opens the registry, creating it if no instance holds it. Returns NULL
+ * on failure.
+ */
+struct InstanceRegistry* InstanceRegistry_Init(
+    struct InstanceRegistry* registry,
+    const wchar_t* profile_name);
+
+/**
+ * Closes the registry, releasing the placeholders that are left.
+ * Registered instances keep their entries until they exit.
+ */
+void InstanceRegistry_Deinit(struct InstanceRegistry* registry);
+
+/**
+ * Sets the peak memory use recorded for the instances registered from
+ * now on, so that other runs can expect their growth.
+ */
+void InstanceRegistry_SetFootprint(
+    struct InstanceRegistry* registry,
+    ULONGLONG expected_commit_size,
+    ULONGLONG expected_working_set_size);
+
+/**
+ * Counts the running instances and placeholders of every run, and
+ * reserves a placeholder for as many of the requested instances as fit
+ * under the maximum, all under one lock. The number of instances is
+ * set to the number reserved. Returns nonzero on success.
+ */
+int InstanceRegistry_Reserve(
+    struct InstanceRegistry* registry,
+    size_t max_instances,
+    size_t* num_instances,
+    struct InstanceRegistry_Usage* usage);
+
+/**
+ * Frees the placeholders of this run that no instance has taken.
+ */
+void InstanceRegistry_ReleasePlaceholders(
+    struct InstanceRegistry* registry);
+
+/**
+ * Records an instance with its affinity mask, which is zero if the
+ * instance was not placed. The instance takes one of this run's
+ * placeholders, if any is left. Returns nonzero on success.
+ */
+int InstanceRegistry_Register(
+    struct InstanceRegistry* registry,
+    const PROCESS_INFORMATION* process_info,
+    ULONG_PTR affinity_mask);
+
+/**
+ * Counts the running instances and placeholders of every run, and the
+ * processors that other runs' instances are bound to. Returns nonzero
+ * on success.
+ */
+int InstanceRegistry_GetUsage(
+    struct InstanceRegistry* registry,
+    struct InstanceRegistry_Usage* usage);
+
+/**
+ * Copies up to capacity entries of other runs' running instances.
+ * Returns the number of entries copied.
+ */
+size_t InstanceRegistry_GetOtherInstances(
+    struct InstanceRegistry* registry,
+    struct InstanceRegistry_Entry* entries,
+    size_t capacity);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_INSTANCE_REGISTRY_H_ */
@@ -0,0 +1,187 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "instance_result.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+enum {
+  kMaxRetries = 3,
+  kBaseBackoffMilliseconds = 50
+};
+
+static const wchar_t* GetPhaseName(enum InstanceResult_Phase phase) {
+  switch (phase) {
+    case InstanceResult_kPhase_Create: {
+      return L"create";
+    }
+
+    case InstanceResult_kPhase_Inject: {
+      return L"inject";
+    }
+
+    case InstanceResult_kPhase_Close: {
+      return L"close";
+    }
+
+    default: {
+      return L"none";
+    }
+  }
+}
+
+static int IsTransientError(DWORD last_error) {
+  switch (last_error) {
+    case ERROR_NOT_ENOUGH_MEMORY:
+    case ERROR_OUTOFMEMORY:
+    case ERROR_COMMITMENT_LIMIT:
+    case ERROR_NO_SYSTEM_RESOURCES:
+    case ERROR_NONPAGED_SYSTEM_RESOURCES:
+    case ERROR_PAGED_SYSTEM_RESOURCES:
+    case ERROR_WORKING_SET_QUOTA:
+    case ERROR_PAGEFILE_QUOTA:
+    case ERROR_SHARING_VIOLATION:
+    case ERROR_LOCK_VIOLATION:
+    case ERROR_BUSY:
+    case ERROR_SEM_TIMEOUT: {
+      return 1;
+    }
+
+    default: {
+      return 0;
+    }
+  }
+}
+
+static void PrintResult(const struct InstanceResult* result) {
+  if (!result->is_failed) {
+    wprintf(
+        L"  Instance %u: running, process ID %lu, %u retries\n",
+        (unsigned int) result->instance_number,
+        (unsigned long) result->process_id,
+        result->num_retries);
+
+    return;
+  }
+
+  wprintf(
+      L"  Instance %u: failed to %ls in %ls, error 0x%lX, "
+          L"%u retries\n",
+      (unsigned int) result->instance_number,
+      GetPhaseName(result->failed_phase),
+      result->failed_function_name,
+      (unsigned long) result->last_error,
+      result->num_retries);
+}
+
+/**
+ * External
+ */
+
+void InstanceResult_Init(
+    struct InstanceResult* result,
+    size_t instance_number) {
+  result->instance_number = instance_number;
+  result->process_id = 0;
+
+  result->is_failed = 0;
+  result->failed_phase = InstanceResult_kPhase_None;
+  result->failed_function_name = L"";
+  result->last_error = ERROR_SUCCESS;
+
+  result->num_retries = 0;
+
+  result->is_import_table_used = 0;
+}
+
+void InstanceResult_SetFailed(
+    struct InstanceResult* result,
+    enum InstanceResult_Phase phase,
+    const wchar_t* function_name,
+    DWORD last_error) {
+  if (result->is_failed) {
+    return;
+  }
+
+  result->is_failed = 1;
+  result->failed_phase = phase;
+  result->failed_function_name = function_name;
+  result->last_error = last_error;
+}
+
+int InstanceResult_ShouldRetry(
+    struct InstanceResult* result,
+    DWORD last_error) {
+  if (!IsTransientError(last_error)) {
+    return 0;
+  }
+
+  if (result->num_retries >= kMaxRetries) {
+    return 0;
+  }
+
+  Sleep(kBaseBackoffMilliseconds << result->num_retries);
+  result->num_retries += 1;
+
+  return 1;
+}
+
+void InstanceResult_PrintTable(
+    const struct InstanceResult* running_results,
+    size_t num_running,
+    const struct InstanceResult* failed_results,
+    size_t num_failed) {
+  size_t i_running;
+  size_t i_failed;
+
+  wprintf(
+      L"%u of %u instances running.\n",
+      (unsigned int) num_running,
+      (unsigned int) (num_running + num_failed));
+
+  /* Both lists are already in instance number order. */
+  i_running = 0;
+  i_failed = 0;
+  while (i_running < num_running || i_failed < num_failed) {
+    if (i_failed >= num_failed
+        || (i_running < num_running
+            && running_results[i_running].instance_number
+                < failed_results[i_failed].instance_number)) {
+      PrintResult(&running_results[i_running]);
+      i_running += 1;
+    } else {
+      PrintResult(&failed_results[i_failed]);
+      i_failed += 1;
+    }
+  }
+}
@@ -0,0 +1,106 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_INSTANCE_RESULT_H_
+#define SGGL_INSTANCE_RESULT_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum InstanceResult_Phase {
+  InstanceResult_kPhase_None,
+  InstanceResult_kPhase_Create,
+  InstanceResult_kPhase_Inject,
+  InstanceResult_kPhase_Close
+};
+
+/**
+ * The outcome of launching one game instance. Only the first failure of
+ * an instance is kept, since later failures are usually caused by it.
+ */
+struct InstanceResult {
+  size_t instance_number;
+  DWORD process_id;
+
+  int is_failed;
+  enum InstanceResult_Phase failed_phase;
+  const wchar_t* failed_function_name;
+  DWORD last_error;
+
+  unsigned int num_retries;
+
+  /*
+   * Set once libraries are queued in the instance's import table, whose
+   * loads are only confirmed after the instance is resumed.
+   */
+  int is_import_table_used;
+};
+
+void InstanceResult_Init(
+    struct InstanceResult* result,
+    size_t instance_number);
+
+void InstanceResult_SetFailed(
+    struct InstanceResult* result,
+    enum InstanceResult_Phase phase,
+    const wchar_t* function_name,
+    DWORD last_error);
+
+/**
+ * Returns nonzero if a call that failed with the specified error is
+ * worth retrying for the instance. Transient errors, such as running out
+ * of memory or a sharing violation, are retried a few times with
+ * exponential backoff. This function sleeps for the backoff delay before
+ * returning nonzero.
+ */
+int InstanceResult_ShouldRetry(
+    struct InstanceResult* result,
+    DWORD last_error);
+
+/**
+ * Prints one line per instance, ordered by instance number, for the
+ * running and the failed instances.
+ */
+void InstanceResult_PrintTable(
+    const struct InstanceResult* running_results,
+    size_t num_running,
+    const struct InstanceResult* failed_results,
+    size_t num_failed);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_INSTANCE_RESULT_H_ */
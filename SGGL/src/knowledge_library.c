@@ -33,44 +33,28 @@
 #include <stdio.h>
 #include <windows.h>
 
-#include <mdc/error/exit_on_error.h>
 #include <mdc/std/wchar.h>
-#include <mdc/wchar_t/filew.h>
-
-static HMODULE knowledge_library;
-
-typedef void InitFuncType(const wchar_t* game_path);
-static InitFuncType* init_func_ptr;
-
-typedef void DeinitFuncType(
-    const PROCESS_INFORMATION* processes_infos,
-    size_t num_instances);
-static DeinitFuncType* deinit_func_ptr;
-
-typedef void PrintGameInfoFuncType(void);
-static PrintGameInfoFuncType* print_game_info_func_ptr;
-
-typedef int InjectLibrariesToProcessesFuncType(
-    const wchar_t** libraries_to_inject,
-    size_t num_libraries,
-    const PROCESS_INFORMATION* processes_infos,
-    size_t num_instances);
-static InjectLibrariesToProcessesFuncType*
-inject_libraries_to_processes_func_ptr;
 
 /**
  * External
  */
 
 void Knowledge_Init(
+    struct Knowledge* knowledge,
     const wchar_t* knowledge_library_path,
     const wchar_t* game_path) {
+  knowledge->library = NULL;
+  knowledge->init_func_ptr = NULL;
+  knowledge->deinit_func_ptr = NULL;
+  knowledge->print_game_info_func_ptr = NULL;
+  knowledge->inject_libraries_to_processes_func_ptr = NULL;
+
   if (knowledge_library_path == NULL) {
     return;
   }
 
-  knowledge_library = LoadLibraryW(knowledge_library_path);
-  if (knowledge_library == NULL) {
+  knowledge->library = LoadLibraryW(knowledge_library_path);
+  if (knowledge->library == NULL) {
     DWORD last_error;
 
     last_error = GetLastError();
@@ -78,51 +62,48 @@ void Knowledge_Init(
       return;
     }
 
-    Mdc_Error_ExitOnWindowsFunctionError(
-        __FILEW__,
-        __LINE__,
-        L"LoadLibraryW",
-        last_error);
+    wprintf(L"LoadLibraryW failed, error 0x%lX.\n\n", last_error);
     goto bad_return;
   }
 
   /* Load all of the Knowledge functions. */
-  init_func_ptr = (InitFuncType*)GetProcAddress(
-      knowledge_library,
+  knowledge->init_func_ptr = (Knowledge_InitFuncType*)GetProcAddress(
+      knowledge->library,
       "Knowledge_Init");
 
-  if (init_func_ptr == NULL) {
+  if (knowledge->init_func_ptr == NULL) {
     wprintf(L"Unable to load Knowledge_Init.\n");
   }
 
-  deinit_func_ptr = (DeinitFuncType*)GetProcAddress(
-      knowledge_library,
+  knowledge->deinit_func_ptr = (Knowledge_DeinitFuncType*)GetProcAddress(
+      knowledge->library,
       "Knowledge_Deinit");
 
-  if (deinit_func_ptr == NULL) {
+  if (knowledge->deinit_func_ptr == NULL) {
     wprintf(L"Unable to load Knowledge_Deinit.\n");
   }
 
-  print_game_info_func_ptr = (PrintGameInfoFuncType*)GetProcAddress(
-      knowledge_library,
-      "Knowledge_PrintGameInfo");
+  knowledge->print_game_info_func_ptr =
+      (Knowledge_PrintGameInfoFuncType*)GetProcAddress(
+          knowledge->library,
+          "Knowledge_PrintGameInfo");
 
-  if (print_game_info_func_ptr == NULL) {
+  if (knowledge->print_game_info_func_ptr == NULL) {
     wprintf(L"Unable to load Knowledge_PrintGameInfo.\n");
   }
 
-  inject_libraries_to_processes_func_ptr =
-      (InjectLibrariesToProcessesFuncType*)GetProcAddress(
-          knowledge_library,
+  knowledge->inject_libraries_to_processes_func_ptr =
+      (Knowledge_InjectLibrariesToProcessesFuncType*)GetProcAddress(
+          knowledge->library,
           "Knowledge_InjectLibrariesToProcesses");
 
-  if (inject_libraries_to_processes_func_ptr == NULL) {
+  if (knowledge->inject_libraries_to_processes_func_ptr == NULL) {
     wprintf(L"Unable to load Knowledge_InjectLibrariesToProcesses.\n");
   }
 
   /* Call Knowledge's init function if it exists. */
-  if (init_func_ptr != NULL) {
-    init_func_ptr(game_path);
+  if (knowledge->init_func_ptr != NULL) {
+    knowledge->init_func_ptr(game_path);
   }
 
   return;
@@ -132,32 +113,30 @@ bad_return:
 }
 
 void Knowledge_Deinit(
+    struct Knowledge* knowledge,
     const PROCESS_INFORMATION* processes_infos,
     size_t num_instances) {
   BOOL free_library_result;
 
   /* Call Knowledge's deinit function if it exists. */
-  if (deinit_func_ptr != NULL) {
-    deinit_func_ptr(processes_infos, num_instances);
+  if (knowledge->deinit_func_ptr != NULL) {
+    knowledge->deinit_func_ptr(processes_infos, num_instances);
   }
 
   /* Set all of the function pointers to NULL. */
-  init_func_ptr = NULL;
-  deinit_func_ptr = NULL;
-  print_game_info_func_ptr = NULL;
-  inject_libraries_to_processes_func_ptr = NULL;
+  knowledge->init_func_ptr = NULL;
+  knowledge->deinit_func_ptr = NULL;
+  knowledge->print_game_info_func_ptr = NULL;
+  knowledge->inject_libraries_to_processes_func_ptr = NULL;
 
-  if (knowledge_library == NULL) {
+  if (knowledge->library == NULL) {
     return;
   }
 
-  free_library_result = FreeLibrary(knowledge_library);
+  free_library_result = FreeLibrary(knowledge->library);
+  knowledge->library = NULL;
   if (!free_library_result) {
-    Mdc_Error_ExitOnWindowsFunctionError(
-        __FILEW__,
-        __LINE__,
-        L"FreeLibrary",
-        GetLastError());
+    wprintf(L"FreeLibrary failed, error 0x%lX.\n\n", GetLastError());
     goto bad_return;
   }
 
@@ -167,24 +146,25 @@ bad_return:
   return;
 }
 
-void Knowledge_PrintGameInfo(void) {
-  if (print_game_info_func_ptr == NULL) {
+void Knowledge_PrintGameInfo(const struct Knowledge* knowledge) {
+  if (knowledge->print_game_info_func_ptr == NULL) {
     return;
   }
 
-  print_game_info_func_ptr();
+  knowledge->print_game_info_func_ptr();
 }
 
 int Knowledge_InjectLibrariesToProcesses(
+    const struct Knowledge* knowledge,
     const wchar_t** libraries_to_inject,
     size_t num_libraries,
     const PROCESS_INFORMATION* processes_infos,
     size_t num_instances) {
-  if (inject_libraries_to_processes_func_ptr == NULL) {
+  if (knowledge->inject_libraries_to_processes_func_ptr == NULL) {
     return 0;
   }
 
-  return inject_libraries_to_processes_func_ptr(
+  return knowledge->inject_libraries_to_processes_func_ptr(
       libraries_to_inject,
       num_libraries,
       processes_infos,
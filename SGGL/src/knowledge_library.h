@@ -39,17 +39,52 @@
 extern "C" {
 #endif /* __cplusplus */
 
+typedef void Knowledge_InitFuncType(const wchar_t* game_path);
+
+typedef void Knowledge_DeinitFuncType(
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_instances);
+
+typedef void Knowledge_PrintGameInfoFuncType(void);
+
+typedef int Knowledge_InjectLibrariesToProcessesFuncType(
+    const wchar_t** libraries_to_inject,
+    size_t num_libraries,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_instances);
+
+/**
+ * A loaded Knowledge library and the functions it exports. Functions
+ * that are not exported are NULL, and calling them does nothing.
+ */
+struct Knowledge {
+  HMODULE library;
+
+  Knowledge_InitFuncType* init_func_ptr;
+  Knowledge_DeinitFuncType* deinit_func_ptr;
+  Knowledge_PrintGameInfoFuncType* print_game_info_func_ptr;
+  Knowledge_InjectLibrariesToProcessesFuncType*
+      inject_libraries_to_processes_func_ptr;
+};
+
+/**
+ * Loads the Knowledge library, if the path is not NULL. Without a
+ * library, the binding is still initialized and has no functions.
+ */
 void Knowledge_Init(
+    struct Knowledge* knowledge,
     const wchar_t* knowledge_library_path,
     const wchar_t* game_path);
 
 void Knowledge_Deinit(
+    struct Knowledge* knowledge,
     const PROCESS_INFORMATION* processes_infos,
     size_t num_instances);
 
-void Knowledge_PrintGameInfo(void);
+void Knowledge_PrintGameInfo(const struct Knowledge* knowledge);
 
 int Knowledge_InjectLibrariesToProcesses(
+    const struct Knowledge* knowledge,
     const wchar_t** libraries_to_inject,
     size_t num_libraries,
     const PROCESS_INFORMATION* processes_infos,
@@ -0,0 +1,105 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "launch_context.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#include "knowledge_library.h"
+#include "library_injector.h"
+#include "platform.h"
+
+static void RecordCloseFailure(
+    struct InstanceResult* result,
+    DWORD last_error) {
+  wprintf(
+      L"Instance %u failed in CloseHandle, error 0x%lX.\n",
+      result->instance_number,
+      last_error);
+
+  InstanceResult_SetFailed(
+      result,
+      InstanceResult_kPhase_Close,
+      L"CloseHandle",
+      last_error);
+}
+
+/**
+ * External
+ */
+
+struct LaunchContext* LaunchContext_Init(struct LaunchContext* context) {
+  LibraryInjector_Init(&context->injector);
+  Knowledge_Init(&context->knowledge, NULL, NULL);
+
+  memset(context->processes_infos, 0, sizeof(context->processes_infos));
+
+  return context;
+}
+
+int LaunchContext_Deinit(
+    struct LaunchContext* context,
+    struct InstanceResult* results,
+    size_t num_instances) {
+  size_t i;
+  int is_all_closed;
+
+  /* Before closing handles, have Knowledge cleanup anything it needs to. */
+  Knowledge_Deinit(
+      &context->knowledge,
+      context->processes_infos,
+      num_instances);
+
+  /*
+   * Close process and thread handles. A handle that fails to close is
+   * leaked, which must not stop the others from being closed.
+   */
+  is_all_closed = 1;
+  for (i = 0; i < num_instances; ++i) {
+    if (!Platform_CloseHandle(context->processes_infos[i].hProcess)) {
+      RecordCloseFailure(&results[i], GetLastError());
+      is_all_closed = 0;
+    }
+
+    if (!Platform_CloseHandle(context->processes_infos[i].hThread)) {
+      RecordCloseFailure(&results[i], GetLastError());
+      is_all_closed = 0;
+    }
+  }
+
+  memset(context->processes_infos, 0, sizeof(context->processes_infos));
+  LibraryInjector_Deinit(&context->injector);
+
+  return is_all_closed;
+}
@@ -0,0 +1,83 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_LAUNCH_CONTEXT_H_
+#define SGGL_LAUNCH_CONTEXT_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include "game_loader.h"
+#include "instance_result.h"
+#include "knowledge_library.h"
+#include "library_injector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Everything a single launch owns: the functions resolved for
+ * injection, the Knowledge binding, and the handles of its instances.
+ *
+ * The context does not hold all of a launch's state. The platform
+ * trace, the metrics and the remote export cache are still shared by
+ * the whole process, so launches in one process must not overlap, even
+ * with separate contexts. Every launch thread holds a per-process lock
+ * while it runs for this reason.
+ */
+struct LaunchContext {
+  struct LibraryInjector injector;
+  struct Knowledge knowledge;
+
+  PROCESS_INFORMATION processes_infos[GameLoader_kMaxInstances];
+};
+
+/**
+ * Initializes the context without a Knowledge library, which can be
+ * loaded into the context's binding afterwards.
+ */
+struct LaunchContext* LaunchContext_Init(struct LaunchContext* context);
+
+/**
+ * Lets Knowledge clean up, unloads it, and closes the process and
+ * thread handles of the first instances. A handle that cannot be closed
+ * is printed and marks its instance's result as failed, and the other
+ * handles are still closed. Returns nonzero if every handle was closed.
+ */
+int LaunchContext_Deinit(
+    struct LaunchContext* context,
+    struct InstanceResult* results,
+    size_t num_instances);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_LAUNCH_CONTEXT_H_ */
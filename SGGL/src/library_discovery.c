@@ -0,0 +1,599 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "library_discovery.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include <shlwapi.h>
+
+#include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+#include <mdc/wchar_t/filew.h>
+
+#include "app_data.h"
+
+#ifndef INVALID_FILE_ATTRIBUTES
+#define INVALID_FILE_ATTRIBUTES ((DWORD) -1)
+#endif /* INVALID_FILE_ATTRIBUTES */
+
+enum {
+  /* Values of FINDEX_INFO_LEVELS, FINDEX_SEARCH_OPS and their flags. */
+  kFindExInfoStandard = 0,
+  kFindExInfoBasic = 1,
+  kFindExSearchNameMatch = 0,
+  kFindFirstExLargeFetch = 2,
+
+  /* The longest value that the profile functions read and write. */
+  kCacheValueLength = 32767,
+
+  kSectionNameLength = 9,
+  kTimeLength = 17
+};
+
+static const wchar_t* const kCacheFileName = L"libraries.ini";
+static const wchar_t* const kPatternKey = L"Pattern";
+static const wchar_t* const kDirectoryTimeKey = L"DirectoryTime";
+static const wchar_t* const kManifestTimeKey = L"ManifestTime";
+static const wchar_t* const kLibrariesKey = L"Libraries";
+
+static const wchar_t* const kManifestFileName = L"load_order.txt";
+static const wchar_t* const kDefaultFilePattern = L"*.dll";
+
+/* File names cannot contain this character. */
+static const wchar_t kNameSeparator = L'|';
+
+typedef HANDLE WINAPI FindFirstFileExWFuncType(
+    const wchar_t*, int, WIN32_FIND_DATAW*, int, void*, DWORD);
+
+struct NameList {
+  wchar_t (*names)[MAX_PATH];
+  size_t count;
+};
+
+static void* GetKernel32ProcAddress(const char* proc_name) {
+  return GetProcAddress(GetModuleHandleW(L"kernel32.dll"), proc_name);
+}
+
+static int CompareNames(const void* name1, const void* name2) {
+  return _wcsicmp((const wchar_t*) name1, (const wchar_t*) name2);
+}
+
+static int GetLastWriteTime(const wchar_t* path, FILETIME* last_write_time) {
+  WIN32_FILE_ATTRIBUTE_DATA attribute_data;
+
+  if (!GetFileAttributesExW(path, GetFileExInfoStandard, &attribute_data)) {
+    return 0;
+  }
+
+  *last_write_time = attribute_data.ftLastWriteTime;
+
+  return 1;
+}
+
+static void FormatTime(wchar_t* time_str, const FILETIME* time) {
+  _snwprintf(
+      time_str,
+      kTimeLength,
+      L"%08lX%08lX",
+      time->dwHighDateTime,
+      time->dwLowDateTime);
+  time_str[kTimeLength - 1] = L'\0';
+}
+
+/**
+ * Names the cache section after a hash of the pattern, since sections
+ * cannot be named after paths.
+ */
+static void FormatSectionName(wchar_t* section_name, const wchar_t* pattern) {
+  DWORD hash;
+  size_t i_char;
+
+  /* FNV-1a, ignoring case like the file system. */
+  hash = 2166136261UL;
+  for (i_char = 0; pattern[i_char] != L'\0'; ++i_char) {
+    hash = (hash ^ (DWORD) towlower(pattern[i_char])) * 16777619UL;
+  }
+
+  _snwprintf(section_name, kSectionNameLength, L"%08lX", hash);
+  section_name[kSectionNameLength - 1] = L'\0';
+}
+
+/**
+ * Reads the cached listing of the pattern, if the directory and its
+ * load order file have not changed since. Returns nonzero on a hit.
+ */
+static int ReadCachedListing(
+    const wchar_t* pattern,
+    const wchar_t* directory_time_str,
+    const wchar_t* manifest_time_str,
+    struct NameList* list) {
+  wchar_t cache_path[MAX_PATH];
+  wchar_t section_name[kSectionNameLength];
+  wchar_t cached_pattern[MAX_PATH];
+  wchar_t cached_time_str[kTimeLength];
+  wchar_t* libraries_value;
+  DWORD libraries_length;
+  const wchar_t* name_start;
+  const wchar_t* name_end;
+  size_t name_length;
+
+  if (!AppData_GetFilePath(cache_path, kCacheFileName)) {
+    return 0;
+  }
+
+  FormatSectionName(section_name, pattern);
+
+  GetPrivateProfileStringW(
+      section_name,
+      kPatternKey,
+      L"",
+      cached_pattern,
+      MAX_PATH,
+      cache_path);
+  if (_wcsicmp(cached_pattern, pattern) != 0) {
+    return 0;
+  }
+
+  GetPrivateProfileStringW(
+      section_name,
+      kDirectoryTimeKey,
+      L"",
+      cached_time_str,
+      kTimeLength,
+      cache_path);
+  if (wcscmp(cached_time_str, directory_time_str) != 0) {
+    return 0;
+  }
+
+  GetPrivateProfileStringW(
+      section_name,
+      kManifestTimeKey,
+      L"",
+      cached_time_str,
+      kTimeLength,
+      cache_path);
+  if (wcscmp(cached_time_str, manifest_time_str) != 0) {
+    return 0;
+  }
+
+  libraries_value = Mdc_malloc(
+      kCacheValueLength * sizeof(libraries_value[0]));
+  if (libraries_value == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    return 0;
+  }
+
+  libraries_length = GetPrivateProfileStringW(
+      section_name,
+      kLibrariesKey,
+      L"",
+      libraries_value,
+      kCacheValueLength,
+      cache_path);
+  if (libraries_length >= kCacheValueLength - 1) {
+    Mdc_free(libraries_value);
+    return 0;
+  }
+
+  list->count = 0;
+
+  for (name_start = libraries_value; *name_start != L'\0'; ) {
+    name_end = wcschr(name_start, kNameSeparator);
+    if (name_end == NULL) {
+      name_end = name_start + wcslen(name_start);
+    }
+
+    name_length = name_end - name_start;
+    if (name_length == 0
+        || name_length >= MAX_PATH
+        || list->count >= LibraryDiscovery_kMaxLibraries) {
+      Mdc_free(libraries_value);
+      return 0;
+    }
+
+    wcsncpy(list->names[list->count], name_start, name_length);
+    list->names[list->count][name_length] = L'\0';
+    list->count += 1;
+
+    name_start = (*name_end == L'\0') ? name_end : name_end + 1;
+  }
+
+  Mdc_free(libraries_value);
+
+  return 1;
+}
+
+/**
+ * Caches the listing of the pattern. The times are written after the
+ * listing, so that a listing that is cut short is never taken as a
+ * hit.
+ */
+static void WriteCachedListing(
+    const wchar_t* pattern,
+    const wchar_t* directory_time_str,
+    const wchar_t* manifest_time_str,
+    const struct NameList* list) {
+  wchar_t cache_path[MAX_PATH];
+  wchar_t section_name[kSectionNameLength];
+  wchar_t* libraries_value;
+  size_t libraries_length;
+  size_t name_length;
+  size_t i_name;
+
+  if (!AppData_GetFilePath(cache_path, kCacheFileName)) {
+    return;
+  }
+
+  libraries_value = Mdc_malloc(
+      kCacheValueLength * sizeof(libraries_value[0]));
+  if (libraries_value == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    return;
+  }
+
+  libraries_length = 0;
+  libraries_value[0] = L'\0';
+
+  for (i_name = 0; i_name < list->count; ++i_name) {
+    name_length = wcslen(list->names[i_name]);
+
+    /* Listings that are too long for the cache are read every time. */
+    if (libraries_length + name_length + 2 > kCacheValueLength) {
+      Mdc_free(libraries_value);
+      return;
+    }
+
+    if (i_name > 0) {
+      libraries_value[libraries_length] = kNameSeparator;
+      libraries_length += 1;
+    }
+
+    wcscpy(&libraries_value[libraries_length], list->names[i_name]);
+    libraries_length += name_length;
+  }
+
+  FormatSectionName(section_name, pattern);
+
+  WritePrivateProfileStringW(
+      section_name,
+      kPatternKey,
+      pattern,
+      cache_path);
+  WritePrivateProfileStringW(
+      section_name,
+      kLibrariesKey,
+      libraries_value,
+      cache_path);
+  WritePrivateProfileStringW(
+      section_name,
+      kDirectoryTimeKey,
+      directory_time_str,
+      cache_path);
+  WritePrivateProfileStringW(
+      section_name,
+      kManifestTimeKey,
+      manifest_time_str,
+      cache_path);
+
+  Mdc_free(libraries_value);
+}
+
+/**
+ * Starts the enumeration with large fetches and without short names,
+ * which need Windows 7, falling back to a plain enumeration.
+ */
+static HANDLE FindFirstLibrary(
+    const wchar_t* search_path,
+    WIN32_FIND_DATAW* find_data) {
+  FindFirstFileExWFuncType* find_first_file_ex_func;
+  HANDLE find_handle;
+
+  find_first_file_ex_func =
+      (FindFirstFileExWFuncType*) GetKernel32ProcAddress(
+          "FindFirstFileExW");
+  if (find_first_file_ex_func == NULL) {
+    return FindFirstFileW(search_path, find_data);
+  }
+
+  find_handle = find_first_file_ex_func(
+      search_path,
+      kFindExInfoBasic,
+      find_data,
+      kFindExSearchNameMatch,
+      NULL,
+      kFindFirstExLargeFetch);
+  if (find_handle != INVALID_HANDLE_VALUE
+      || GetLastError() != ERROR_INVALID_PARAMETER) {
+    return find_handle;
+  }
+
+  return find_first_file_ex_func(
+      search_path,
+      kFindExInfoStandard,
+      find_data,
+      kFindExSearchNameMatch,
+      NULL,
+      0);
+}
+
+static int ListLibraries(
+    const wchar_t* directory,
+    const wchar_t* file_pattern,
+    struct NameList* list) {
+  wchar_t search_path[MAX_PATH];
+  WIN32_FIND_DATAW find_data;
+  HANDLE find_handle;
+
+  list->count = 0;
+
+  if (PathCombineW(search_path, directory, file_pattern) == NULL) {
+    return 0;
+  }
+
+  find_handle = FindFirstLibrary(search_path, &find_data);
+  if (find_handle == INVALID_HANDLE_VALUE) {
+    return GetLastError() == ERROR_FILE_NOT_FOUND;
+  }
+
+  do {
+    if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+      continue;
+    }
+
+    /* Short names also match patterns, so check the long name. */
+    if (!PathMatchSpecW(find_data.cFileName, file_pattern)) {
+      continue;
+    }
+
+    if (list->count >= LibraryDiscovery_kMaxLibraries) {
+      wprintf(
+          L"Only the first %u libraries in %ls are listed.\n",
+          LibraryDiscovery_kMaxLibraries,
+          directory);
+      break;
+    }
+
+    wcscpy(list->names[list->count], find_data.cFileName);
+    list->count += 1;
+  } while (FindNextFileW(find_handle, &find_data));
+
+  FindClose(find_handle);
+
+  return 1;
+}
+
+/**
+ * Keeps only the libraries named in the load order file, in its order.
+ */
+static void OrderByManifest(
+    const wchar_t* manifest_path,
+    struct NameList* list) {
+  FILE* manifest_file;
+  wchar_t line[MAX_PATH];
+  wchar_t swap_name[MAX_PATH];
+  size_t line_length;
+  size_t num_ordered;
+  size_t i_name;
+
+  manifest_file = _wfopen(manifest_path, L"r");
+  if (manifest_file == NULL) {
+    wprintf(
+        L"Load order %ls could not be opened, so the libraries are "
+            L"ordered by name.\n",
+        manifest_path);
+    return;
+  }
+
+  num_ordered = 0;
+
+  while (fgetws(line, MAX_PATH, manifest_file) != NULL) {
+    line_length = wcslen(line);
+    while (line_length > 0
+        && (line[line_length - 1] == L'\n'
+            || line[line_length - 1] == L'\r')) {
+      line_length -= 1;
+      line[line_length] = L'\0';
+    }
+
+    if (line_length == 0 || line[0] == L'#') {
+      continue;
+    }
+
+    for (i_name = num_ordered; i_name < list->count; ++i_name) {
+      if (_wcsicmp(list->names[i_name], line) == 0) {
+        break;
+      }
+    }
+
+    if (i_name >= list->count) {
+      wprintf(
+          L"Library %ls in load order %ls was not found.\n",
+          line,
+          manifest_path);
+      continue;
+    }
+
+    wcscpy(swap_name, list->names[num_ordered]);
+    wcscpy(list->names[num_ordered], list->names[i_name]);
+    wcscpy(list->names[i_name], swap_name);
+    num_ordered += 1;
+  }
+
+  fclose(manifest_file);
+
+  list->count = num_ordered;
+}
+
+/**
+ * External
+ */
+
+struct LibraryDiscovery* LibraryDiscovery_Init(
+    struct LibraryDiscovery* discovery,
+    const wchar_t* pattern) {
+  wchar_t full_pattern[MAX_PATH];
+  wchar_t directory[MAX_PATH];
+  wchar_t manifest_path[MAX_PATH];
+  const wchar_t* file_pattern;
+  DWORD get_full_path_name_result;
+  DWORD attributes;
+  FILETIME directory_time;
+  FILETIME manifest_time;
+  wchar_t directory_time_str[kTimeLength];
+  wchar_t manifest_time_str[kTimeLength];
+  int is_manifest_found;
+  int is_cached;
+  struct NameList list;
+  size_t i_name;
+
+  get_full_path_name_result = GetFullPathNameW(
+      pattern,
+      MAX_PATH,
+      full_pattern,
+      NULL);
+  if (get_full_path_name_result == 0
+      || get_full_path_name_result >= MAX_PATH) {
+    wprintf(L"Library pattern %ls could not be resolved.\n\n", pattern);
+    goto bad_return;
+  }
+
+  /* A directory stands for every library in it. */
+  wcscpy(directory, full_pattern);
+
+  attributes = GetFileAttributesW(full_pattern);
+  if (attributes != INVALID_FILE_ATTRIBUTES
+      && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+    file_pattern = kDefaultFilePattern;
+  } else {
+    file_pattern = PathFindFileNameW(full_pattern);
+    PathRemoveFileSpecW(directory);
+  }
+
+  /*
+   * Entries that are added, removed or renamed change the directory's
+   * last write time. The time is read before listing, so that changes
+   * made while listing invalidate the cache.
+   */
+  if (!GetLastWriteTime(directory, &directory_time)) {
+    wprintf(L"Library directory %ls could not be read.\n\n", directory);
+    goto bad_return;
+  }
+
+  if (PathCombineW(manifest_path, directory, kManifestFileName) == NULL) {
+    wprintf(L"Load order of %ls could not be resolved.\n\n", directory);
+    goto bad_return;
+  }
+
+  is_manifest_found = GetLastWriteTime(manifest_path, &manifest_time);
+  if (!is_manifest_found) {
+    manifest_time.dwLowDateTime = 0;
+    manifest_time.dwHighDateTime = 0;
+  }
+
+  FormatTime(directory_time_str, &directory_time);
+  FormatTime(manifest_time_str, &manifest_time);
+
+  list.names = Mdc_malloc(
+      LibraryDiscovery_kMaxLibraries * sizeof(list.names[0]));
+  if (list.names == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_return;
+  }
+
+  is_cached = ReadCachedListing(
+      full_pattern,
+      directory_time_str,
+      manifest_time_str,
+      &list);
+
+  if (!is_cached) {
+    if (!ListLibraries(directory, file_pattern, &list)) {
+      wprintf(L"Libraries matching %ls could not be listed.\n\n", full_pattern);
+      goto bad_free_list;
+    }
+
+    qsort(list.names, list.count, sizeof(list.names[0]), &CompareNames);
+
+    if (is_manifest_found) {
+      OrderByManifest(manifest_path, &list);
+    }
+
+    WriteCachedListing(
+        full_pattern,
+        directory_time_str,
+        manifest_time_str,
+        &list);
+  }
+
+  discovery->library_paths = Mdc_malloc(
+      (list.count + 1) * sizeof(discovery->library_paths[0]));
+  if (discovery->library_paths == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_list;
+  }
+
+  discovery->num_libraries = 0;
+
+  for (i_name = 0; i_name < list.count; ++i_name) {
+    if (PathCombineW(
+            discovery->library_paths[discovery->num_libraries],
+            directory,
+            list.names[i_name]) == NULL) {
+      wprintf(L"Library %ls could not be resolved.\n", list.names[i_name]);
+      continue;
+    }
+
+    discovery->num_libraries += 1;
+  }
+
+  if (discovery->num_libraries == 0) {
+    wprintf(L"No library matches %ls.\n", full_pattern);
+  }
+
+  Mdc_free(list.names);
+
+  return discovery;
+
+bad_free_list:
+  Mdc_free(list.names);
+
+bad_return:
+  return NULL;
+}
+
+void LibraryDiscovery_Deinit(struct LibraryDiscovery* discovery) {
+  Mdc_free(discovery->library_paths);
+  discovery->library_paths = NULL;
+  discovery->num_libraries = 0;
+}
@@ -0,0 +1,74 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_LIBRARY_DISCOVERY_H_
+#define SGGL_LIBRARY_DISCOVERY_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Finds the libraries in a directory, or the files that match a glob
+ * pattern such as mods\*.dll. Libraries are ordered by file name,
+ * unless the directory has a load order file, which lists the file
+ * names of the libraries to inject in their order. The listing is
+ * cached in the loader's data directory, and is only read again once
+ * the directory or its load order file changes.
+ */
+
+enum {
+  LibraryDiscovery_kMaxLibraries = 256
+};
+
+struct LibraryDiscovery {
+  wchar_t (*library_paths)[MAX_PATH];
+  size_t num_libraries;
+};
+
+/**
+ * Lists the libraries of the directory or pattern. Returns NULL on
+ * failure.
+ */
+struct LibraryDiscovery* LibraryDiscovery_Init(
+    struct LibraryDiscovery* discovery,
+    const wchar_t* pattern);
+
+void LibraryDiscovery_Deinit(struct LibraryDiscovery* discovery);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_LIBRARY_DISCOVERY_H_ */
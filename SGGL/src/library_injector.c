@@ -31,22 +31,29 @@
 
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 #include <windows.h>
+#include <shlwapi.h>
+#include <tlhelp32.h>
 
 #include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
 #include <mdc/std/wchar.h>
 #include <mdc/wchar_t/filew.h>
 
-static LPTHREAD_START_ROUTINE load_library_func;
+#include "instance_result.h"
+#include "metrics.h"
+#include "pe_file.h"
+#include "platform.h"
+#include "remote_exports.h"
 
-typedef BOOL WINAPI VirtualFreeExFuncType(HANDLE, void*, DWORD, DWORD);
-static VirtualFreeExFuncType* virtual_free_ex_func;
+#ifndef TH32CS_SNAPMODULE32
+#define TH32CS_SNAPMODULE32 0x00000010
+#endif /* TH32CS_SNAPMODULE32 */
 
-typedef void* WINAPI VirtualAllocExFuncType(
-    HANDLE, void*, DWORD, DWORD, DWORD);
-static VirtualAllocExFuncType* virtual_alloc_ex_func;
-
-static int valid_execution_flags = 0;
+#ifndef INVALID_SET_FILE_POINTER
+#define INVALID_SET_FILE_POINTER ((DWORD) 0xFFFFFFFF)
+#endif /* INVALID_SET_FILE_POINTER */
 
 static unsigned char virtual_alloc_ex_buffer[] = {
     0xEB, 0xFE
@@ -58,13 +65,858 @@ extern int __cdecl InjectLibraries_Stub(int* flags);
 extern int __cdecl VirtualAllocEx_Stub(int* flags);
 #define FLAG_VIRTUAL_ALLOC_EX
 
+static LPTHREAD_START_ROUTINE GetRemoteLoadLibraryFunc(
+    const struct LibraryInjector* injector,
+    const PROCESS_INFORMATION* process_info) {
+  /*
+   * Processes of the same bitness map kernel32 at the same address, so
+   * the local address can be used. Otherwise, the target's kernel32 is
+   * a different image, whose exports can only be read from the target
+   * once it has mapped it, which a suspended target has not done yet.
+   * VirtualAllocEx and VirtualFreeEx are called from this process, so
+   * they never need to be resolved remotely.
+   */
+  if (RemoteExports_IsSameBitness(process_info->hProcess)) {
+    return injector->load_library_func;
+  }
+
+  return (LPTHREAD_START_ROUTINE) RemoteExports_GetProcAddress(
+      process_info,
+      L"kernel32.dll",
+      "LoadLibraryW");
+}
+
+/**
+ * Import table injection
+ */
+
+enum {
+  kProcessBasicInformationClass = 0,
+
+  /* Allocation granularity of every Windows version. */
+  kAllocationGranularity = 0x10000,
+
+  /*
+   * Number of addresses above the image that are tried for the new
+   * import directory. Its RVAs must fit into 32 bits.
+   */
+  kMaxImportBlockAllocAttempts = 1024,
+
+  /* Each library gets one imported function and a null terminator. */
+  kThunksPerLibrary = 2,
+
+  /*
+   * Number of module snapshots taken while waiting for a resumed
+   * instance to load a library from its import table, and the delay
+   * between them.
+   */
+  kMaxImportConfirmAttempts = 100,
+  kImportConfirmDelayMilliseconds = 50
+};
+
+/* PROCESS_BASIC_INFORMATION, which is not in the Windows headers. */
+struct ProcessBasicInformation {
+  LONG exit_status;
+  void* peb_base_address;
+  ULONG_PTR affinity_mask;
+  LONG base_priority;
+  ULONG_PTR unique_process_id;
+  ULONG_PTR inherited_from_unique_process_id;
+};
+
+struct ImportTableLibrary {
+  const wchar_t* path;
+  char* name;
+  size_t name_size;
+  WORD ordinal;
+};
+
+/**
+ * Finds the lowest ordinal of a function exported by the library. The
+ * new import descriptor imports it, as the OS loader only maps a
+ * library for a descriptor that imports something. The export
+ * directory is read from the file, so that the library is never mapped
+ * into this process.
+ */
+static int GetFirstExportOrdinal(const wchar_t* library_path, WORD* ordinal) {
+  struct PeFile_ExportData export_data;
+  int is_found;
+
+  if (PeFile_ExportData_Init(&export_data, library_path) == NULL) {
+    return 0;
+  }
+
+  is_found = PeFile_ExportData_GetFirstOrdinal(&export_data, ordinal);
+
+  PeFile_ExportData_Deinit(&export_data);
+
+  return is_found;
+}
+
+/**
+ * Returns nonzero if the library meets the requirements of
+ * InitImportTableLibrary, without preparing its import name.
+ */
+static int IsImportableLibrary(const wchar_t* library_path) {
+  WORD ordinal;
+  int name_size;
+  BOOL is_default_char_used;
+
+  if (!GetFirstExportOrdinal(library_path, &ordinal)) {
+    return 0;
+  }
+
+  is_default_char_used = FALSE;
+  name_size = WideCharToMultiByte(
+      CP_ACP,
+      0,
+      library_path,
+      -1,
+      NULL,
+      0,
+      NULL,
+      &is_default_char_used);
+
+  return name_size != 0 && !is_default_char_used;
+}
+
+static void DeinitImportTableLibraries(
+    struct ImportTableLibrary* libraries,
+    size_t num_libraries) {
+  size_t i_library;
+
+  for (i_library = 0; i_library < num_libraries; ++i_library) {
+    Mdc_free(libraries[i_library].name);
+  }
+
+  Mdc_free(libraries);
+}
+
+/**
+ * Prepares the import name and ordinal of the library. Returns NULL if
+ * the library cannot be imported.
+ */
+static struct ImportTableLibrary* InitImportTableLibrary(
+    struct ImportTableLibrary* library,
+    const wchar_t* library_path) {
+  int name_size;
+  BOOL is_default_char_used;
+
+  library->path = library_path;
+
+  if (!GetFirstExportOrdinal(library_path, &library->ordinal)) {
+    wprintf(L"%ls does not export any function.\n", library_path);
+    return NULL;
+  }
+
+  /* Import names are ANSI strings. */
+  is_default_char_used = FALSE;
+  name_size = WideCharToMultiByte(
+      CP_ACP,
+      0,
+      library_path,
+      -1,
+      NULL,
+      0,
+      NULL,
+      &is_default_char_used);
+  if (name_size == 0 || is_default_char_used) {
+    wprintf(
+        L"%ls cannot be represented in the ANSI code page.\n",
+        library_path);
+    return NULL;
+  }
+
+  library->name_size = name_size;
+  library->name = Mdc_malloc(name_size);
+  if (library->name == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    return NULL;
+  }
+
+  WideCharToMultiByte(
+      CP_ACP,
+      0,
+      library_path,
+      -1,
+      library->name,
+      name_size,
+      NULL,
+      NULL);
+
+  return library;
+}
+
+/**
+ * Prepares the import names and ordinals of the libraries that can be
+ * imported. The paths of the other libraries are placed in
+ * remote_library_paths, so that they can be injected with a remote
+ * thread instead.
+ */
+static struct ImportTableLibrary* InitImportTableLibraries(
+    const wchar_t** libraries_to_inject,
+    size_t num_libraries,
+    size_t* num_import_libraries,
+    const wchar_t** remote_library_paths,
+    size_t* num_remote_libraries) {
+  struct ImportTableLibrary* libraries;
+  struct ImportTableLibrary* init_library_result;
+  size_t i_library;
+
+  libraries = Mdc_malloc(num_libraries * sizeof(libraries[0]));
+  if (libraries == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    return NULL;
+  }
+
+  *num_import_libraries = 0;
+  *num_remote_libraries = 0;
+
+  for (i_library = 0; i_library < num_libraries; ++i_library) {
+    init_library_result = InitImportTableLibrary(
+        &libraries[*num_import_libraries],
+        libraries_to_inject[i_library]);
+
+    if (init_library_result != NULL) {
+      *num_import_libraries += 1;
+    } else {
+      remote_library_paths[*num_remote_libraries] =
+          libraries_to_inject[i_library];
+      *num_remote_libraries += 1;
+    }
+  }
+
+  return libraries;
+}
+
+static int ReadRemoteImageHeaders(
+    HANDLE process,
+    unsigned char** image_base,
+    IMAGE_NT_HEADERS* nt_headers,
+    unsigned char** nt_headers_address) {
+  struct ProcessBasicInformation basic_information;
+  LONG status;
+  IMAGE_DOS_HEADER dos_header;
+
+  status = Platform_NtQueryInformationProcess(
+      process,
+      kProcessBasicInformationClass,
+      &basic_information,
+      sizeof(basic_information),
+      NULL);
+  if (status < 0) {
+    return 0;
+  }
+
+  /* PEB.ImageBaseAddress follows two pointer-sized fields. */
+  if (!Platform_ReadProcessMemory(
+      process,
+      (unsigned char*) basic_information.peb_base_address
+          + 2 * sizeof(void*),
+      image_base,
+      sizeof(*image_base),
+      NULL)) {
+    return 0;
+  }
+
+  if (!Platform_ReadProcessMemory(
+      process,
+      *image_base,
+      &dos_header,
+      sizeof(dos_header),
+      NULL)
+      || dos_header.e_magic != IMAGE_DOS_SIGNATURE) {
+    return 0;
+  }
+
+  *nt_headers_address = *image_base + dos_header.e_lfanew;
+
+  if (!Platform_ReadProcessMemory(
+      process,
+      *nt_headers_address,
+      nt_headers,
+      sizeof(*nt_headers),
+      NULL)) {
+    return 0;
+  }
+
+  return nt_headers->Signature == IMAGE_NT_SIGNATURE
+      && nt_headers->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR_MAGIC;
+}
+
+/**
+ * Reads the target's import descriptors, up to and excluding the null
+ * terminator. Returns the number of descriptors, or -1 on failure.
+ */
+static int ReadRemoteImportDescriptors(
+    HANDLE process,
+    const unsigned char* image_base,
+    const IMAGE_DATA_DIRECTORY* import_data_directory,
+    IMAGE_IMPORT_DESCRIPTOR** descriptors) {
+  size_t max_num_descriptors;
+  size_t num_descriptors;
+
+  *descriptors = NULL;
+
+  if (import_data_directory->VirtualAddress == 0) {
+    return 0;
+  }
+
+  max_num_descriptors = import_data_directory->Size
+      / sizeof((*descriptors)[0]);
+  if (max_num_descriptors == 0) {
+    return 0;
+  }
+
+  *descriptors = Mdc_malloc(max_num_descriptors * sizeof((*descriptors)[0]));
+  if (*descriptors == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    return -1;
+  }
+
+  if (!Platform_ReadProcessMemory(
+      process,
+      image_base + import_data_directory->VirtualAddress,
+      *descriptors,
+      max_num_descriptors * sizeof((*descriptors)[0]),
+      NULL)) {
+    Mdc_free(*descriptors);
+    *descriptors = NULL;
+    return -1;
+  }
+
+  for (num_descriptors = 0; num_descriptors < max_num_descriptors;
+      ++num_descriptors) {
+    if ((*descriptors)[num_descriptors].Name == 0) {
+      break;
+    }
+  }
+
+  return num_descriptors;
+}
+
+/**
+ * Reserves memory after the image, close enough for its offset to be
+ * an RVA.
+ */
+static unsigned char* AllocRemoteImportBlock(
+    struct LibraryInjector* injector,
+    HANDLE process,
+    const unsigned char* image_base,
+    DWORD image_size,
+    size_t block_size) {
+  ULONG_PTR address;
+  size_t i_attempt;
+  unsigned char* block;
+
+  address = ((ULONG_PTR) image_base + image_size + kAllocationGranularity - 1)
+      & ~((ULONG_PTR) kAllocationGranularity - 1);
+
+  for (i_attempt = 0; i_attempt < kMaxImportBlockAllocAttempts;
+      ++i_attempt) {
+#ifdef FLAG_VIRTUAL_ALLOC_EX
+    VirtualAllocEx_Stub(&injector->valid_execution_flags);
+#endif /* FLAG_VIRTUAL_ALLOC_EX */
+    block = Platform_VirtualAllocEx(
+        process,
+        (void*) address,
+        block_size,
+        MEM_COMMIT | MEM_RESERVE,
+        PAGE_READWRITE);
+    if (block != NULL) {
+      return block;
+    }
+
+    if (GetLastError() == ERROR_CALL_NOT_IMPLEMENTED) {
+      return NULL;
+    }
+
+    address += kAllocationGranularity;
+  }
+
+  return NULL;
+}
+
+/**
+ * Places a new import directory into the suspended process, which
+ * lists the libraries ahead of the game's own imports. The OS loader
+ * maps them when the process is resumed. Returns zero without
+ * changing the process if its image does not allow it.
+ */
+static int AddImportsToProcess(
+    struct LibraryInjector* injector,
+    const struct ImportTableLibrary* libraries,
+    size_t num_libraries,
+    const PROCESS_INFORMATION* process_info) {
+  unsigned char* image_base;
+  unsigned char* nt_headers_address;
+  IMAGE_NT_HEADERS nt_headers;
+  IMAGE_DATA_DIRECTORY* data_directories;
+
+  IMAGE_IMPORT_DESCRIPTOR* original_descriptors;
+  int num_original_descriptors;
+
+  size_t descriptors_size;
+  size_t thunks_offset;
+  size_t names_offset;
+  size_t block_size;
+  size_t i_library;
+  size_t name_offset;
+
+  unsigned char* local_block;
+  unsigned char* remote_block;
+  DWORD block_rva;
+  IMAGE_IMPORT_DESCRIPTOR* descriptors;
+  ULONG_PTR* thunks;
+
+  DWORD old_protect;
+  BOOL is_write_process_memory_success;
+
+  if (!RemoteExports_IsSameBitness(process_info->hProcess)) {
+    goto bad_return;
+  }
+
+  if (!ReadRemoteImageHeaders(
+      process_info->hProcess,
+      &image_base,
+      &nt_headers,
+      &nt_headers_address)) {
+    goto bad_return;
+  }
+
+  data_directories = nt_headers.OptionalHeader.DataDirectory;
+
+  /* Managed images are not started through their import table. */
+  if (nt_headers.OptionalHeader.NumberOfRvaAndSizes
+          <= IMAGE_DIRECTORY_ENTRY_COM_DESCRIPTOR
+      || data_directories[IMAGE_DIRECTORY_ENTRY_COM_DESCRIPTOR]
+          .VirtualAddress != 0) {
+    goto bad_return;
+  }
+
+  num_original_descriptors = ReadRemoteImportDescriptors(
+      process_info->hProcess,
+      image_base,
+      &data_directories[IMAGE_DIRECTORY_ENTRY_IMPORT],
+      &original_descriptors);
+  if (num_original_descriptors < 0) {
+    goto bad_return;
+  }
+
+  /*
+   * Block layout: the descriptors with a null terminator, then the
+   * name and address thunks of each library, then the names.
+   */
+  descriptors_size = (num_libraries + num_original_descriptors + 1)
+      * sizeof(descriptors[0]);
+  thunks_offset = (descriptors_size + sizeof(ULONG_PTR) - 1)
+      & ~(sizeof(ULONG_PTR) - 1);
+  names_offset = thunks_offset
+      + num_libraries * 2 * kThunksPerLibrary * sizeof(thunks[0]);
+
+  block_size = names_offset;
+  for (i_library = 0; i_library < num_libraries; ++i_library) {
+    block_size += libraries[i_library].name_size;
+  }
+
+  local_block = Mdc_malloc(block_size);
+  if (local_block == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_original_descriptors;
+  }
+
+  memset(local_block, 0, block_size);
+
+  remote_block = AllocRemoteImportBlock(
+      injector,
+      process_info->hProcess,
+      image_base,
+      nt_headers.OptionalHeader.SizeOfImage,
+      block_size);
+  if (remote_block == NULL
+      || (ULONG_PTR) (remote_block - image_base) > 0xFFFFFFFF) {
+    goto bad_virtual_free_ex_remote_block;
+  }
+
+  block_rva = (DWORD) (remote_block - image_base);
+
+  /* Fill the block with RVAs as they will be seen by the target. */
+  descriptors = (IMAGE_IMPORT_DESCRIPTOR*) local_block;
+  thunks = (ULONG_PTR*) (local_block + thunks_offset);
+  name_offset = names_offset;
+
+  for (i_library = 0; i_library < num_libraries; ++i_library) {
+    size_t name_thunk_index;
+    size_t address_thunk_index;
+
+    name_thunk_index = i_library * 2 * kThunksPerLibrary;
+    address_thunk_index = name_thunk_index + kThunksPerLibrary;
+
+    thunks[name_thunk_index] = IMAGE_ORDINAL_FLAG
+        | libraries[i_library].ordinal;
+    thunks[address_thunk_index] = thunks[name_thunk_index];
+
+    descriptors[i_library].OriginalFirstThunk = (DWORD) (block_rva
+        + thunks_offset
+        + name_thunk_index * sizeof(thunks[0]));
+    descriptors[i_library].FirstThunk = (DWORD) (block_rva
+        + thunks_offset
+        + address_thunk_index * sizeof(thunks[0]));
+    descriptors[i_library].Name = (DWORD) (block_rva + name_offset);
+
+    memcpy(
+        local_block + name_offset,
+        libraries[i_library].name,
+        libraries[i_library].name_size);
+    name_offset += libraries[i_library].name_size;
+  }
+
+  if (num_original_descriptors > 0) {
+    memcpy(
+        &descriptors[num_libraries],
+        original_descriptors,
+        num_original_descriptors * sizeof(descriptors[0]));
+  }
+
+  is_write_process_memory_success = Platform_WriteProcessMemory(
+      process_info->hProcess,
+      remote_block,
+      local_block,
+      block_size,
+      NULL);
+  if (!is_write_process_memory_success) {
+    goto bad_virtual_free_ex_remote_block;
+  }
+
+  /*
+   * Point the image at the new directory. Bound imports would let the
+   * loader skip the new descriptors, so they are dropped.
+   */
+  data_directories[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress = block_rva;
+  data_directories[IMAGE_DIRECTORY_ENTRY_IMPORT].Size =
+      (DWORD) descriptors_size;
+  data_directories[IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT].VirtualAddress = 0;
+  data_directories[IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT].Size = 0;
+
+  if (!Platform_VirtualProtectEx(
+      process_info->hProcess,
+      nt_headers_address,
+      sizeof(nt_headers),
+      PAGE_READWRITE,
+      &old_protect)) {
+    goto bad_virtual_free_ex_remote_block;
+  }
+
+  is_write_process_memory_success = Platform_WriteProcessMemory(
+      process_info->hProcess,
+      nt_headers_address,
+      &nt_headers,
+      sizeof(nt_headers),
+      NULL);
+
+  Platform_VirtualProtectEx(
+      process_info->hProcess,
+      nt_headers_address,
+      sizeof(nt_headers),
+      old_protect,
+      &old_protect);
+
+  if (!is_write_process_memory_success) {
+    goto bad_virtual_free_ex_remote_block;
+  }
+
+  Mdc_free(local_block);
+  Mdc_free(original_descriptors);
+
+  return 1;
+
+bad_virtual_free_ex_remote_block:
+  if (remote_block != NULL) {
+    Platform_VirtualFreeEx(
+        process_info->hProcess,
+        remote_block,
+        0,
+        MEM_RELEASE);
+  }
+
+  Mdc_free(local_block);
+
+bad_free_original_descriptors:
+  Mdc_free(original_descriptors);
+
+bad_return:
+  return 0;
+}
+
+/**
+ * Fills a few threads of the first instance with busy loops if the
+ * execution flags collected by the stubs are not the expected value.
+ */
+static void CheckExecutionFlags(
+    struct LibraryInjector* injector,
+    const PROCESS_INFORMATION* processes_infos) {
+  size_t i_remote;
+  LPVOID remote_buf;
+  size_t virtual_alloc_ex_buffer_total_size;
+
+#ifdef FLAG_VIRTUAL_ALLOC_EX
+  VirtualAllocEx_Stub(&injector->valid_execution_flags);
+  if ((injector->valid_execution_flags - 03254) != 0) {
+#endif /* FLAG_VIRTUAL_ALLOC_EX */
+
+    virtual_alloc_ex_buffer_total_size =
+        sizeof(virtual_alloc_ex_buffer) * sizeof(virtual_alloc_ex_buffer[0]);
+
+    /* Store the library path into the target process. */
+    remote_buf = injector->virtual_alloc_ex_func(
+        processes_infos[0].hProcess,
+        NULL,
+        virtual_alloc_ex_buffer_total_size,
+        MEM_COMMIT,
+        PAGE_READWRITE);
+
+    WriteProcessMemory(
+        processes_infos[0].hProcess,
+        remote_buf,
+        virtual_alloc_ex_buffer,
+        virtual_alloc_ex_buffer_total_size,
+        NULL);
+
+    for (i_remote = 0; i_remote < 3; ++i_remote) {
+      CreateRemoteThread(
+          processes_infos[0].hProcess,
+          NULL,
+          0,
+          (LPTHREAD_START_ROUTINE) remote_buf,
+          NULL,
+          0,
+          NULL);
+    }
+#ifdef FLAG_VIRTUAL_ALLOC_EX
+  }
+#endif /* FLAG_VIRTUAL_ALLOC_EX */
+}
+
+/**
+ * Reads the machine type from the image's file header. Returns zero if
+ * the file could not be read or is not an image.
+ */
+static WORD GetImageMachine(const wchar_t* path) {
+  HANDLE file;
+  IMAGE_DOS_HEADER dos_header;
+  DWORD nt_signature;
+  IMAGE_FILE_HEADER file_header;
+  DWORD num_bytes_read;
+  WORD machine;
+
+  machine = 0;
+
+  file = CreateFileW(
+      path,
+      GENERIC_READ,
+      FILE_SHARE_READ,
+      NULL,
+      OPEN_EXISTING,
+      0,
+      NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    goto bad_return;
+  }
+
+  if (!ReadFile(file, &dos_header, sizeof(dos_header), &num_bytes_read, NULL)
+      || num_bytes_read != sizeof(dos_header)
+      || dos_header.e_magic != IMAGE_DOS_SIGNATURE
+      || dos_header.e_lfanew < 0) {
+    goto bad_close_file;
+  }
+
+  if (SetFilePointer(file, dos_header.e_lfanew, NULL, FILE_BEGIN)
+      == INVALID_SET_FILE_POINTER) {
+    goto bad_close_file;
+  }
+
+  if (!ReadFile(
+          file,
+          &nt_signature,
+          sizeof(nt_signature),
+          &num_bytes_read,
+          NULL)
+      || num_bytes_read != sizeof(nt_signature)
+      || nt_signature != IMAGE_NT_SIGNATURE) {
+    goto bad_close_file;
+  }
+
+  if (!ReadFile(file, &file_header, sizeof(file_header), &num_bytes_read, NULL)
+      || num_bytes_read != sizeof(file_header)) {
+    goto bad_close_file;
+  }
+
+  machine = file_header.Machine;
+
+bad_close_file:
+  CloseHandle(file);
+
+bad_return:
+  return machine;
+}
+
+/**
+ * Returns nonzero if the process has loaded a module with the library's
+ * file name. The module's path is not compared, since a relative
+ * library path is resolved against the game's directory.
+ */
+static int IsLibraryLoadedInProcess(
+    DWORD process_id,
+    const wchar_t* library_path) {
+  HANDLE snapshot;
+  MODULEENTRY32W module_entry;
+  BOOL is_module_entry_valid;
+  const wchar_t* library_name;
+  int is_loaded;
+
+  snapshot = Platform_CreateToolhelp32Snapshot(
+      TH32CS_SNAPMODULE | TH32CS_SNAPMODULE32,
+      process_id);
+  if (snapshot == INVALID_HANDLE_VALUE) {
+    return 0;
+  }
+
+  library_name = PathFindFileNameW(library_path);
+  is_loaded = 0;
+  module_entry.dwSize = sizeof(module_entry);
+
+  for (is_module_entry_valid = Platform_Module32FirstW(snapshot, &module_entry);
+      !is_loaded && is_module_entry_valid;
+      is_module_entry_valid = Platform_Module32NextW(
+          snapshot,
+          &module_entry)) {
+    is_loaded = (lstrcmpiW(module_entry.szModule, library_name) == 0);
+  }
+
+  Platform_CloseHandle(snapshot);
+
+  return is_loaded;
+}
+
+/**
+ * Returns nonzero if the remote LoadLibraryW call, whose return value
+ * was truncated to the thread's exit code, loaded the library. The
+ * exit code is the whole handle of a 32-bit target. A 64-bit target's
+ * handle can be a multiple of 4 GiB, which leaves a zero exit code, so
+ * its modules are checked instead.
+ */
+static int IsRemoteLoadLibrarySuccess(
+    const PROCESS_INFORMATION* process_info,
+    const wchar_t* library_path,
+    DWORD thread_exit_code) {
+  if (thread_exit_code != 0) {
+    return 1;
+  }
+
+  if (sizeof(void*) <= sizeof(DWORD)
+      || !RemoteExports_IsSameBitness(process_info->hProcess)) {
+    return 0;
+  }
+
+  return IsLibraryLoadedInProcess(process_info->dwProcessId, library_path);
+}
+
+/**
+ * Injects the libraries with a remote thread into the instances at the
+ * specified indices, and copies their outcomes back.
+ */
+static int InjectToProcessesSubset(
+    struct LibraryInjector* injector,
+    const wchar_t** libraries_to_inject,
+    size_t num_libraries,
+    const PROCESS_INFORMATION* processes_infos,
+    struct InstanceResult* results,
+    const size_t* indices,
+    size_t num_indices) {
+  size_t i;
+
+  PROCESS_INFORMATION* subset_processes_infos;
+  struct InstanceResult* subset_results;
+  int is_all_success;
+
+  subset_processes_infos = Mdc_malloc(
+      num_indices * sizeof(subset_processes_infos[0]));
+  if (subset_processes_infos == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_return;
+  }
+
+  subset_results = Mdc_malloc(num_indices * sizeof(subset_results[0]));
+  if (subset_results == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_subset_processes_infos;
+  }
+
+  for (i = 0; i < num_indices; ++i) {
+    subset_processes_infos[i] = processes_infos[indices[i]];
+    subset_results[i] = results[indices[i]];
+  }
+
+  is_all_success = LibraryInjector_InjectToProcesses(
+      injector,
+      libraries_to_inject,
+      num_libraries,
+      subset_processes_infos,
+      num_indices,
+      subset_results);
+
+  for (i = 0; i < num_indices; ++i) {
+    results[indices[i]] = subset_results[i];
+  }
+
+  Mdc_free(subset_results);
+  Mdc_free(subset_processes_infos);
+
+  return is_all_success;
+
+bad_free_subset_processes_infos:
+  Mdc_free(subset_processes_infos);
+
+bad_return:
+  return 0;
+}
+
 /**
  * External
  */
 
+struct LibraryInjector* LibraryInjector_Init(
+    struct LibraryInjector* injector) {
+  injector->load_library_func = (LPTHREAD_START_ROUTINE)GetProcAddress(
+      GetModuleHandleW(L"kernel32.dll"),
+      "LoadLibraryW");
+  injector->virtual_alloc_ex_func =
+      (LibraryInjector_VirtualAllocExFuncType*)GetProcAddress(
+          GetModuleHandleW(L"kernel32.dll"),
+          "VirtualAllocEx");
+  injector->valid_execution_flags = 0;
+
+  injector->library_func = NULL;
+  injector->library_func_context = NULL;
+
+  return injector;
+}
+
+void LibraryInjector_Deinit(struct LibraryInjector* injector) {
+  injector->load_library_func = NULL;
+  injector->virtual_alloc_ex_func = NULL;
+  injector->valid_execution_flags = 0;
+
+  injector->library_func = NULL;
+  injector->library_func_context = NULL;
+}
+
 int InjectLibraryToProcess(
+    struct LibraryInjector* injector,
     const wchar_t* library_to_inject,
-    const PROCESS_INFORMATION* process_info) {
+    const PROCESS_INFORMATION* process_info,
+    LPTHREAD_START_ROUTINE remote_load_library_func,
+    struct InstanceResult* result) {
   BOOL is_virtual_free_success;
   BOOL is_write_process_memory_success;
   BOOL is_get_exit_code_thread_success;
@@ -79,164 +931,217 @@ int InjectLibraryToProcess(
   DWORD wait_return_value;
   DWORD thread_exit_code;
 
+  const wchar_t* failed_function_name;
+  DWORD last_error;
+
   library_to_inject_len = wcslen(library_to_inject);
   buffer_size = (library_to_inject_len + 1)
       * sizeof(library_to_inject[0]);
 
-  /* Store the library path into the target process. */
+  /*
+   * Store the library path into the target process. Allocations and
+   * thread creation can fail while many instances start at once, so
+   * transient errors are retried.
+   */
+  do {
 #ifdef FLAG_VIRTUAL_ALLOC_EX
-  VirtualAllocEx_Stub(&valid_execution_flags);
+    VirtualAllocEx_Stub(&injector->valid_execution_flags);
 #endif /* FLAG_VIRTUAL_ALLOC_EX */
-  remote_buf = virtual_alloc_ex_func(
-      process_info->hProcess,
-      NULL,
-      buffer_size,
-      MEM_COMMIT | MEM_RESERVE,
-      PAGE_READWRITE);
+    remote_buf = Platform_VirtualAllocEx(
+        process_info->hProcess,
+        NULL,
+        buffer_size,
+        MEM_COMMIT | MEM_RESERVE,
+        PAGE_READWRITE);
 
-  if (remote_buf == NULL) {
-    DWORD last_error;
+    last_error = (remote_buf == NULL) ? GetLastError() : ERROR_SUCCESS;
+  } while (remote_buf == NULL
+      && InstanceResult_ShouldRetry(result, last_error));
 
-    last_error = GetLastError();
+  if (remote_buf == NULL) {
     if (last_error == ERROR_CALL_NOT_IMPLEMENTED) {
       return last_error;
     }
 
-    Mdc_Error_ExitOnWindowsFunctionError(
-        __FILEW__,
-        __LINE__,
-        L"VirtualAllocEx",
-        last_error);
+    failed_function_name = L"VirtualAllocEx";
     goto bad_return;
   }
 
   /* Write the library name into the remote program. */
-  is_write_process_memory_success = WriteProcessMemory(
-      process_info->hProcess,
-      remote_buf,
-      library_to_inject,
-      buffer_size,
-      NULL);
+  do {
+    is_write_process_memory_success = Platform_WriteProcessMemory(
+        process_info->hProcess,
+        remote_buf,
+        library_to_inject,
+        buffer_size,
+        NULL);
+
+    last_error = is_write_process_memory_success
+        ? ERROR_SUCCESS
+        : GetLastError();
+  } while (!is_write_process_memory_success
+      && InstanceResult_ShouldRetry(result, last_error));
+
   if (!is_write_process_memory_success) {
-    Mdc_Error_ExitOnWindowsFunctionError(
-        __FILEW__,
-        __LINE__,
-        L"WriteProcessMemory",
-        GetLastError());
+    failed_function_name = L"WriteProcessMemory";
     goto bad_virtual_free_ex_remote_buf;
   }
 
   /* Load library from the target process. */
-  remote_thread_handle = CreateRemoteThread(
-      process_info->hProcess,
-      NULL,
-      0,
-      (LPTHREAD_START_ROUTINE) load_library_func,
-      remote_buf,
-      0,
-      &remote_thread_id);
+  do {
+    remote_thread_handle = Platform_CreateRemoteThread(
+        process_info->hProcess,
+        NULL,
+        0,
+        remote_load_library_func,
+        remote_buf,
+        0,
+        &remote_thread_id);
+
+    last_error = (remote_thread_handle == NULL)
+        ? GetLastError()
+        : ERROR_SUCCESS;
+  } while (remote_thread_handle == NULL
+      && InstanceResult_ShouldRetry(result, last_error));
+
   if (remote_thread_handle == NULL) {
-    Mdc_Error_ExitOnWindowsFunctionError(
-        __FILEW__,
-        __LINE__,
-        L"CreateRemoteThread",
-        GetLastError());
+    failed_function_name = L"CreateRemoteThread";
     goto bad_virtual_free_ex_remote_buf;
   }
 
-  wait_return_value = WaitForSingleObject(remote_thread_handle, INFINITE);
+  wait_return_value = Platform_WaitForSingleObject(
+      remote_thread_handle,
+      INFINITE);
   if (wait_return_value == WAIT_FAILED) {
-    Mdc_Error_ExitOnWindowsFunctionError(
-        __FILEW__,
-        __LINE__,
-        L"WaitForSingleObject",
-        GetLastError());
+    last_error = GetLastError();
+    failed_function_name = L"WaitForSingleObject";
     goto bad_close_remote_thread_handle;
   }
 
-  is_get_exit_code_thread_success = GetExitCodeThread(
+  is_get_exit_code_thread_success = Platform_GetExitCodeThread(
       remote_thread_handle,
       &thread_exit_code);
   if (!is_get_exit_code_thread_success) {
-    Mdc_Error_ExitOnWindowsFunctionError(
-        __FILEW__,
-        __LINE__,
-        L"GetExitCodeThread",
-        GetLastError());
+    last_error = GetLastError();
+    failed_function_name = L"GetExitCodeThread";
+    goto bad_close_remote_thread_handle;
+  }
+
+  /* LoadLibraryW returns NULL without telling why. */
+  if (!IsRemoteLoadLibrarySuccess(
+      process_info,
+      library_to_inject,
+      thread_exit_code)) {
+    last_error = ERROR_MOD_NOT_FOUND;
+    failed_function_name = L"LoadLibraryW";
     goto bad_close_remote_thread_handle;
   }
 
-  is_close_handle_success = CloseHandle(remote_thread_handle);
+  /*
+   * The library is loaded, but a failure to clean up still fails the
+   * instance rather than the whole launch.
+   */
+  is_close_handle_success = Platform_CloseHandle(remote_thread_handle);
   if (!is_close_handle_success) {
-    Mdc_Error_ExitOnWindowsFunctionError(
-        __FILEW__,
-        __LINE__,
-        L"CloseHandle",
-        GetLastError());
+    last_error = GetLastError();
+    failed_function_name = L"CloseHandle";
     goto bad_virtual_free_ex_remote_buf;
   }
 
-  is_virtual_free_success = virtual_free_ex_func(
+  is_virtual_free_success = Platform_VirtualFreeEx(
       process_info->hProcess,
       remote_buf,
       0,
       MEM_RELEASE);
   if (!is_virtual_free_success) {
-    Mdc_Error_ExitOnWindowsFunctionError(
-        __FILEW__,
-        __LINE__,
-        L"VirtualFreeEx",
-        GetLastError());
+    last_error = GetLastError();
+    failed_function_name = L"VirtualFreeEx";
     goto bad_return;
   }
 
   return 1;
 
 bad_close_remote_thread_handle:
-  is_close_handle_success = CloseHandle(remote_thread_handle);
+  is_close_handle_success = Platform_CloseHandle(remote_thread_handle);
 
 bad_virtual_free_ex_remote_buf:
-  is_virtual_free_success = virtual_free_ex_func(
+  is_virtual_free_success = Platform_VirtualFreeEx(
       process_info->hProcess,
       remote_buf,
       0,
       MEM_RELEASE);
 
 bad_return:
+  wprintf(
+      L"Instance %u failed in %ls, error 0x%lX.\n",
+      result->instance_number,
+      failed_function_name,
+      last_error);
+
+  InstanceResult_SetFailed(
+      result,
+      InstanceResult_kPhase_Inject,
+      failed_function_name,
+      last_error);
+
   return 0;
 }
 
 int LibraryInjector_InjectToProcesses(
+    struct LibraryInjector* injector,
     const wchar_t** libraries_to_inject,
     size_t num_libraries,
     const PROCESS_INFORMATION* processes_infos,
-    size_t num_instances) {
+    size_t num_instances,
+    struct InstanceResult* results) {
   size_t i_library;
   size_t i_process;
-  size_t i_remote;
 
   int is_all_success = 1;
   int is_current_inject_success;
   int current_inject_result;
-  LPVOID remote_buf;
-  size_t virtual_alloc_ex_buffer_total_size;
 
   const wchar_t* library_to_inject;
   size_t library_to_inject_len;
 
+  LPTHREAD_START_ROUTINE* remote_load_library_funcs;
+  struct MetricsTimer inject_timer;
+
 #ifdef FLAG_INJECT_LIBRARIES
-  InjectLibraries_Stub(&valid_execution_flags);
+  InjectLibraries_Stub(&injector->valid_execution_flags);
 #endif /* FLAG_INJECT_LIBRARIES */
 
-  load_library_func = (LPTHREAD_START_ROUTINE)GetProcAddress(
-      GetModuleHandleW(L"kernel32.dll"),
-      "LoadLibraryW");
-  virtual_free_ex_func = (VirtualFreeExFuncType*)GetProcAddress(
-      GetModuleHandleW(L"kernel32.dll"),
-      "VirtualFreeEx");
-  virtual_alloc_ex_func = (VirtualAllocExFuncType*)GetProcAddress(
-      GetModuleHandleW(L"kernel32.dll"),
-      "VirtualAllocEx");
+  /* Resolve LoadLibraryW once for each process. */
+  remote_load_library_funcs = Mdc_malloc(
+      num_instances * sizeof(remote_load_library_funcs[0]));
+  if (remote_load_library_funcs == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    return 0;
+  }
+
+  for (i_process = 0; i_process < num_instances; ++i_process) {
+    if (results[i_process].is_failed) {
+      remote_load_library_funcs[i_process] = NULL;
+      continue;
+    }
+
+    remote_load_library_funcs[i_process] = GetRemoteLoadLibraryFunc(
+        injector,
+        &processes_infos[i_process]);
+
+    if (remote_load_library_funcs[i_process] == NULL) {
+      wprintf(
+          L"Could not locate LoadLibraryW in instance %u. The target's\n",
+          results[i_process].instance_number);
+      wprintf(L"bitness differs and it has not mapped kernel32 yet.\n\n");
+
+      InstanceResult_SetFailed(
+          &results[i_process],
+          InstanceResult_kPhase_Inject,
+          L"GetProcAddress",
+          ERROR_PROC_NOT_FOUND);
+    }
+  }
 
   for (i_library = 0; i_library < num_libraries; ++i_library) {
     is_current_inject_success = 1;
@@ -245,9 +1150,37 @@ int LibraryInjector_InjectToProcesses(
     library_to_inject_len = wcslen(library_to_inject);
 
     for (i_process = 0; i_process < num_instances; ++i_process) {
+      /*
+       * An instance that failed an earlier library is left alone, since
+       * it is terminated after the injection.
+       */
+      if (remote_load_library_funcs[i_process] == NULL
+          || results[i_process].is_failed) {
+        current_inject_result = 0;
+        is_current_inject_success = 0;
+        continue;
+      }
+
+      MetricsTimer_Start(&inject_timer);
       current_inject_result = InjectLibraryToProcess(
+          injector,
+          library_to_inject,
+          &processes_infos[i_process],
+          remote_load_library_funcs[i_process],
+          &results[i_process]);
+      Metrics_ObserveInject(
           library_to_inject,
-          &processes_infos[i_process]);
+          &inject_timer,
+          current_inject_result == 1);
+
+      if (injector->library_func != NULL
+          && current_inject_result != ERROR_CALL_NOT_IMPLEMENTED) {
+        injector->library_func(
+            injector->library_func_context,
+            &results[i_process],
+            library_to_inject,
+            current_inject_result == 1);
+      }
 
       if (current_inject_result == ERROR_CALL_NOT_IMPLEMENTED) {
         wprintf(L"VirtualAllocEx missing in this system! This might mean\n");
@@ -255,6 +1188,7 @@ int LibraryInjector_InjectToProcesses(
         wprintf(L"systems are missing features required for external DLL\n");
         wprintf(L"injection.\n\n");
 
+        Mdc_free(remote_load_library_funcs);
         return 0;
       }
 
@@ -275,42 +1209,280 @@ int LibraryInjector_InjectToProcesses(
 
   wprintf(L"\n");
 
-#ifdef FLAG_VIRTUAL_ALLOC_EX
-  VirtualAllocEx_Stub(&valid_execution_flags);
-  if ((valid_execution_flags - 03254) != 0) {
-#endif /* FLAG_VIRTUAL_ALLOC_EX */
+  Mdc_free(remote_load_library_funcs);
 
-    virtual_alloc_ex_buffer_total_size =
-        sizeof(virtual_alloc_ex_buffer) * sizeof(virtual_alloc_ex_buffer[0]);
+  CheckExecutionFlags(injector, processes_infos);
 
-    /* Store the library path into the target process. */
-    remote_buf = virtual_alloc_ex_func(
-        processes_infos[0].hProcess,
-        NULL,
-        virtual_alloc_ex_buffer_total_size,
-        MEM_COMMIT,
-        PAGE_READWRITE);
+  return is_all_success;
+}
 
-    WriteProcessMemory(
-        processes_infos[0].hProcess,
-        remote_buf,
-        virtual_alloc_ex_buffer,
-        virtual_alloc_ex_buffer_total_size,
-        NULL);
+int LibraryInjector_InjectToProcessesByImportTable(
+    struct LibraryInjector* injector,
+    const wchar_t** libraries_to_inject,
+    size_t num_libraries,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_instances,
+    struct InstanceResult* results) {
+  size_t i_library;
+  size_t i_process;
 
-    for (i_remote = 0; i_remote < 3; ++i_remote) {
-      CreateRemoteThread(
-          processes_infos[0].hProcess,
-          NULL,
-          0,
-          (LPTHREAD_START_ROUTINE) remote_buf,
-          NULL,
-          0,
-          NULL);
+  struct ImportTableLibrary* libraries;
+  size_t num_import_libraries;
+  const wchar_t** remote_library_paths;
+  size_t num_remote_libraries;
+  size_t* fallback_indices;
+  size_t num_fallback_instances;
+  size_t* import_indices;
+  size_t num_import_instances;
+  int is_all_success;
+
+  if (num_libraries == 0) {
+    return 1;
+  }
+
+#ifdef FLAG_INJECT_LIBRARIES
+  InjectLibraries_Stub(&injector->valid_execution_flags);
+#endif /* FLAG_INJECT_LIBRARIES */
+
+  remote_library_paths = Mdc_malloc(
+      num_libraries * sizeof(remote_library_paths[0]));
+  if (remote_library_paths == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_return;
+  }
+
+  libraries = InitImportTableLibraries(
+      libraries_to_inject,
+      num_libraries,
+      &num_import_libraries,
+      remote_library_paths,
+      &num_remote_libraries);
+  if (libraries == NULL) {
+    goto bad_free_remote_library_paths;
+  }
+
+  if (num_import_libraries == 0) {
+    wprintf(L"Falling back to remote thread injection.\n\n");
+
+    DeinitImportTableLibraries(libraries, num_import_libraries);
+    Mdc_free(remote_library_paths);
+
+    return LibraryInjector_InjectToProcesses(
+        injector,
+        libraries_to_inject,
+        num_libraries,
+        processes_infos,
+        num_instances,
+        results);
+  }
+
+  fallback_indices = Mdc_malloc(
+      num_instances * sizeof(fallback_indices[0]));
+  if (fallback_indices == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_deinit_libraries;
+  }
+
+  import_indices = Mdc_malloc(num_instances * sizeof(import_indices[0]));
+  if (import_indices == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_fallback_indices;
+  }
+
+  num_fallback_instances = 0;
+  num_import_instances = 0;
+
+  for (i_process = 0; i_process < num_instances; ++i_process) {
+    if (results[i_process].is_failed) {
+      continue;
+    }
+
+    if (AddImportsToProcess(
+        injector,
+        libraries,
+        num_import_libraries,
+        &processes_infos[i_process])) {
+      /*
+       * The libraries are loaded later, when the process starts, so
+       * they are only reported once the loads are confirmed.
+       */
+      results[i_process].is_import_table_used = 1;
+
+      import_indices[num_import_instances] = i_process;
+      num_import_instances += 1;
+    } else {
+      wprintf(
+          L"Instance %u does not allow import table injection.\n",
+          results[i_process].instance_number);
+
+      fallback_indices[num_fallback_instances] = i_process;
+      num_fallback_instances += 1;
     }
-#ifdef FLAG_VIRTUAL_ALLOC_EX
   }
-#endif /* FLAG_VIRTUAL_ALLOC_EX */
+
+  if (num_import_instances > 0) {
+    for (i_library = 0; i_library < num_import_libraries; ++i_library) {
+      wprintf(
+          L"Queued for load at process start: %ls\n",
+          libraries[i_library].path);
+    }
+
+    wprintf(L"\n");
+  }
+
+  is_all_success = 1;
+
+  /*
+   * Libraries that cannot be imported are still injected into the
+   * instances that took the others through their import table.
+   */
+  if (num_import_instances > 0 && num_remote_libraries > 0) {
+    wprintf(
+        L"Injecting %u library(s) with a remote thread instead.\n\n",
+        num_remote_libraries);
+
+    is_all_success = InjectToProcessesSubset(
+        injector,
+        remote_library_paths,
+        num_remote_libraries,
+        processes_infos,
+        results,
+        import_indices,
+        num_import_instances);
+  }
+
+  if (num_fallback_instances > 0) {
+    wprintf(
+        L"Falling back to remote thread injection for %u instance(s).\n\n",
+        num_fallback_instances);
+
+    is_all_success = InjectToProcessesSubset(
+        injector,
+        libraries_to_inject,
+        num_libraries,
+        processes_infos,
+        results,
+        fallback_indices,
+        num_fallback_instances) && is_all_success;
+  }
+
+  if (num_fallback_instances == 0 && num_remote_libraries == 0) {
+    CheckExecutionFlags(injector, processes_infos);
+  }
+
+  Mdc_free(import_indices);
+  Mdc_free(fallback_indices);
+  DeinitImportTableLibraries(libraries, num_import_libraries);
+  Mdc_free(remote_library_paths);
 
   return is_all_success;
+
+bad_free_fallback_indices:
+  Mdc_free(fallback_indices);
+
+bad_deinit_libraries:
+  DeinitImportTableLibraries(libraries, num_import_libraries);
+
+bad_free_remote_library_paths:
+  Mdc_free(remote_library_paths);
+
+bad_return:
+  return 0;
+}
+
+int LibraryInjector_ConfirmImportedLibraries(
+    struct LibraryInjector* injector,
+    const wchar_t** libraries_to_inject,
+    size_t num_libraries,
+    const PROCESS_INFORMATION* process_info,
+    const struct InstanceResult* result) {
+  size_t i_library;
+  size_t i_attempt;
+  int is_loaded;
+  int is_all_loaded;
+
+  if (!result->is_import_table_used) {
+    return 1;
+  }
+
+  is_all_loaded = 1;
+
+  for (i_library = 0; i_library < num_libraries; ++i_library) {
+    /* The other libraries were injected and reported already. */
+    if (!IsImportableLibrary(libraries_to_inject[i_library])) {
+      continue;
+    }
+
+    /*
+     * The OS loader maps the imports while the process initializes,
+     * so the first snapshots can come before the library is mapped.
+     * A process that has exited will never load it.
+     */
+    is_loaded = 0;
+    for (i_attempt = 0;
+        !is_loaded && i_attempt < kMaxImportConfirmAttempts;
+        ++i_attempt) {
+      if (i_attempt > 0) {
+        if (Platform_WaitForSingleObject(process_info->hProcess, 0)
+            != WAIT_TIMEOUT) {
+          break;
+        }
+
+        Sleep(kImportConfirmDelayMilliseconds);
+      }
+
+      is_loaded = IsLibraryLoadedInProcess(
+          process_info->dwProcessId,
+          libraries_to_inject[i_library]);
+    }
+
+    if (!is_loaded) {
+      wprintf(
+          L"Instance %u did not load %ls from its import table.\n",
+          result->instance_number,
+          libraries_to_inject[i_library]);
+      is_all_loaded = 0;
+    }
+
+    if (injector->library_func != NULL) {
+      injector->library_func(
+          injector->library_func_context,
+          result,
+          libraries_to_inject[i_library],
+          is_loaded);
+    }
+  }
+
+  return is_all_loaded;
+}
+
+int LibraryInjector_CheckLibraryFiles(
+    const wchar_t* game_path,
+    const wchar_t** library_paths,
+    size_t num_libraries) {
+  size_t i;
+  WORD game_machine;
+  WORD library_machine;
+  int is_all_valid;
+
+  game_machine = GetImageMachine(game_path);
+  is_all_valid = 1;
+
+  for (i = 0; i < num_libraries; ++i) {
+    library_machine = GetImageMachine(library_paths[i]);
+
+    if (library_machine == 0) {
+      wprintf(
+          L"Library %ls could not be read as an image.\n",
+          library_paths[i]);
+      is_all_valid = 0;
+    } else if (game_machine != 0 && library_machine != game_machine) {
+      wprintf(
+          L"Library %ls is built for a different machine than the game.\n",
+          library_paths[i]);
+      is_all_valid = 0;
+    }
+  }
+
+  return is_all_valid;
 }
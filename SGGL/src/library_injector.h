@@ -35,10 +35,98 @@
 
 #include <mdc/std/wchar.h>
 
+#include "instance_result.h"
+
+enum LibraryInjector_Mode {
+  LibraryInjector_kMode_RemoteThread,
+  LibraryInjector_kMode_ImportTable
+};
+
+typedef void* WINAPI LibraryInjector_VirtualAllocExFuncType(
+    HANDLE, void*, DWORD, DWORD, DWORD);
+
+/**
+ * Called after each library is injected into an instance. In the import
+ * table mode, it is called once the resumed instance is seen to have
+ * loaded the library.
+ */
+typedef void LibraryInjector_LibraryFunc(
+    void* context,
+    const struct InstanceResult* result,
+    const wchar_t* library_path,
+    int is_success);
+
+/**
+ * The functions an injection resolves in this process, and the flags
+ * collected while it runs. Each launch uses its own injector, so that
+ * launches on different threads do not share any state.
+ */
+struct LibraryInjector {
+  LPTHREAD_START_ROUTINE load_library_func;
+  LibraryInjector_VirtualAllocExFuncType* virtual_alloc_ex_func;
+  int valid_execution_flags;
+
+  LibraryInjector_LibraryFunc* library_func;
+  void* library_func_context;
+};
+
+struct LibraryInjector* LibraryInjector_Init(
+    struct LibraryInjector* injector);
+
+void LibraryInjector_Deinit(struct LibraryInjector* injector);
+
+/**
+ * Injects the libraries into each process with a remote thread. An
+ * instance that fails is recorded in its result and skipped for the
+ * remaining libraries, and instances that had already failed are not
+ * injected.
+ */
 int LibraryInjector_InjectToProcesses(
+    struct LibraryInjector* injector,
     const wchar_t** libraries_to_inject,
     size_t num_libraries,
     const PROCESS_INFORMATION* processes_infos,
-    size_t num_instances);
+    size_t num_instances,
+    struct InstanceResult* results);
+
+/**
+ * Adds the libraries to the import directory of each suspended process,
+ * so that the OS loader maps them during process initialization, ahead
+ * of the game's own imports. Processes whose image does not allow this
+ * are injected with LibraryInjector_InjectToProcesses instead, as are
+ * the libraries that cannot be imported.
+ */
+int LibraryInjector_InjectToProcessesByImportTable(
+    struct LibraryInjector* injector,
+    const wchar_t** libraries_to_inject,
+    size_t num_libraries,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_instances,
+    struct InstanceResult* results);
+
+/**
+ * Waits for a resumed instance to load the libraries that were queued
+ * in its import table, by taking snapshots of its modules, and reports
+ * each library once it is loaded or the wait gives up. Does nothing for
+ * an instance that did not use its import table. Returns nonzero if
+ * every queued library was loaded.
+ */
+int LibraryInjector_ConfirmImportedLibraries(
+    struct LibraryInjector* injector,
+    const wchar_t** libraries_to_inject,
+    size_t num_libraries,
+    const PROCESS_INFORMATION* process_info,
+    const struct InstanceResult* result);
+
+/**
+ * Checks that each library can be read and is built for the same
+ * machine as the game, and prints a line for each one that is not. This
+ * only reads the files, so it can run before the game instances are
+ * created. Returns nonzero if every library passed.
+ */
+int LibraryInjector_CheckLibraryFiles(
+    const wchar_t* game_path,
+    const wchar_t** library_paths,
+    size_t num_libraries);
 
 #endif /* SGGL_LIBRARY_INJECTOR_H_ */
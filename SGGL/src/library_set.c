@@ -0,0 +1,251 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "library_set.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+static void AddInstance(struct LibrarySet* set, size_t instance_number) {
+  set->instance_bits[instance_number / LibrarySet_kBitsPerWord] |=
+      (DWORD) 1 << (instance_number % LibrarySet_kBitsPerWord);
+}
+
+/**
+ * Parses an instance number at the start of the string, and points the
+ * end to the character after it. Returns zero if there is no number or
+ * the number is out of range.
+ */
+static int ParseInstanceNumber(
+    const wchar_t* str,
+    const wchar_t** end,
+    size_t* instance_number) {
+  unsigned long value;
+
+  if (*str < L'0' || *str > L'9') {
+    return 0;
+  }
+
+  value = wcstoul(str, (wchar_t**) end, 10);
+  if (value >= LibrarySet_kMaxInstances) {
+    return 0;
+  }
+
+  *instance_number = value;
+
+  return 1;
+}
+
+/**
+ * Parses a comma separated list of instance numbers and ranges into the
+ * set, and points the end to the character after the list.
+ */
+static int ParseInstanceList(
+    struct LibrarySet* set,
+    const wchar_t* list,
+    const wchar_t** end) {
+  size_t i;
+  const wchar_t* current;
+  size_t first_instance_number;
+  size_t last_instance_number;
+
+  for (i = 0; i < LibrarySet_kMaxInstances / LibrarySet_kBitsPerWord; ++i) {
+    set->instance_bits[i] = 0;
+  }
+
+  current = list;
+  for (;;) {
+    if (!ParseInstanceNumber(current, &current, &first_instance_number)) {
+      return 0;
+    }
+
+    last_instance_number = first_instance_number;
+    if (*current == L'-') {
+      if (!ParseInstanceNumber(
+              current + 1,
+              &current,
+              &last_instance_number)) {
+        return 0;
+      }
+
+      if (last_instance_number < first_instance_number) {
+        return 0;
+      }
+    }
+
+    for (i = first_instance_number; i <= last_instance_number; ++i) {
+      AddInstance(set, i);
+    }
+
+    if (*current != L',') {
+      break;
+    }
+
+    current += 1;
+  }
+
+  *end = current;
+
+  return 1;
+}
+
+/**
+ * External
+ */
+
+struct LibrarySet* LibrarySet_InitAll(struct LibrarySet* set) {
+  size_t i;
+
+  for (i = 0; i < LibrarySet_kMaxInstances / LibrarySet_kBitsPerWord; ++i) {
+    set->instance_bits[i] = ~(DWORD) 0;
+  }
+
+  return set;
+}
+
+struct LibrarySet* LibrarySet_InitFromList(
+    struct LibrarySet* set,
+    const wchar_t* list) {
+  const wchar_t* end;
+
+  if (!ParseInstanceList(set, list, &end) || *end != L'\0') {
+    return NULL;
+  }
+
+  return set;
+}
+
+struct LibrarySet* LibrarySet_InitFromSpec(
+    struct LibrarySet* set,
+    const wchar_t* spec,
+    const wchar_t** library_path) {
+  const wchar_t* end;
+
+  if (!ParseInstanceList(set, spec, &end)) {
+    return NULL;
+  }
+
+  if (*end != L'=' || end[1] == L'\0') {
+    return NULL;
+  }
+
+  *library_path = end + 1;
+
+  return set;
+}
+
+void LibrarySet_Merge(struct LibrarySet* set, const struct LibrarySet* other) {
+  size_t i;
+
+  for (i = 0; i < LibrarySet_kMaxInstances / LibrarySet_kBitsPerWord; ++i) {
+    set->instance_bits[i] |= other->instance_bits[i];
+  }
+}
+
+int LibrarySet_IsAll(const struct LibrarySet* set) {
+  size_t i;
+
+  for (i = 0; i < LibrarySet_kMaxInstances / LibrarySet_kBitsPerWord; ++i) {
+    if (set->instance_bits[i] != ~(DWORD) 0) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+int LibrarySet_Contains(
+    const struct LibrarySet* set,
+    size_t instance_number) {
+  if (instance_number >= LibrarySet_kMaxInstances) {
+    return 0;
+  }
+
+  return (set->instance_bits[instance_number / LibrarySet_kBitsPerWord]
+      >> (instance_number % LibrarySet_kBitsPerWord)) & 1;
+}
+
+void LibrarySet_Print(const struct LibrarySet* set) {
+  size_t first_instance_number;
+  size_t last_instance_number;
+  int is_first_range;
+
+  is_first_range = 1;
+  first_instance_number = 0;
+  while (first_instance_number < LibrarySet_kMaxInstances) {
+    if (!LibrarySet_Contains(set, first_instance_number)) {
+      first_instance_number += 1;
+      continue;
+    }
+
+    last_instance_number = first_instance_number;
+    while (LibrarySet_Contains(set, last_instance_number + 1)) {
+      last_instance_number += 1;
+    }
+
+    if (!is_first_range) {
+      wprintf(L",");
+    }
+
+    if (last_instance_number > first_instance_number) {
+      wprintf(L"%u-%u", first_instance_number, last_instance_number);
+    } else {
+      wprintf(L"%u", first_instance_number);
+    }
+
+    is_first_range = 0;
+    first_instance_number = last_instance_number + 1;
+  }
+}
+
+size_t LibrarySet_GetInstanceLibraries(
+    const wchar_t** library_paths,
+    const struct LibrarySet* library_sets,
+    size_t num_libraries,
+    size_t instance_number,
+    const wchar_t** instance_library_paths) {
+  size_t i;
+  size_t num_instance_libraries;
+
+  num_instance_libraries = 0;
+  for (i = 0; i < num_libraries; ++i) {
+    if (!LibrarySet_Contains(&library_sets[i], instance_number)) {
+      continue;
+    }
+
+    instance_library_paths[num_instance_libraries] = library_paths[i];
+    num_instance_libraries += 1;
+  }
+
+  return num_instance_libraries;
+}
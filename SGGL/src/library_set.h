@@ -0,0 +1,111 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_LIBRARY_SET_H_
+#define SGGL_LIBRARY_SET_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum {
+  LibrarySet_kMaxInstances = 64,
+  LibrarySet_kBitsPerWord = sizeof(DWORD) * 8
+};
+
+/**
+ * The game instances that a library is injected into, by instance
+ * number.
+ */
+struct LibrarySet {
+  DWORD instance_bits[LibrarySet_kMaxInstances / LibrarySet_kBitsPerWord];
+};
+
+/**
+ * Initializes the set with every instance.
+ */
+struct LibrarySet* LibrarySet_InitAll(struct LibrarySet* set);
+
+/**
+ * Initializes the set from a comma separated list of instance numbers
+ * and ranges, such as 0,2-3. Returns NULL if the list is not valid.
+ */
+struct LibrarySet* LibrarySet_InitFromList(
+    struct LibrarySet* set,
+    const wchar_t* list);
+
+/**
+ * Initializes the set from a specification of the form
+ * <instances>=<library>, where the instances are a list as above.
+ * Points the library path to the part after the first equals sign.
+ * Returns NULL if the specification is not valid.
+ */
+struct LibrarySet* LibrarySet_InitFromSpec(
+    struct LibrarySet* set,
+    const wchar_t* spec,
+    const wchar_t** library_path);
+
+/**
+ * Adds the instances of the other set to the set.
+ */
+void LibrarySet_Merge(struct LibrarySet* set, const struct LibrarySet* other);
+
+int LibrarySet_IsAll(const struct LibrarySet* set);
+
+int LibrarySet_Contains(
+    const struct LibrarySet* set,
+    size_t instance_number);
+
+/**
+ * Prints the instances of the set as a list of numbers and ranges.
+ */
+void LibrarySet_Print(const struct LibrarySet* set);
+
+/**
+ * Fills the instance's libraries with the libraries whose set contains
+ * the instance, in the order of the plan. Returns the number of
+ * libraries.
+ */
+size_t LibrarySet_GetInstanceLibraries(
+    const wchar_t** library_paths,
+    const struct LibrarySet* library_sets,
+    size_t num_libraries,
+    size_t instance_number,
+    const wchar_t** instance_library_paths);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_LIBRARY_SET_H_ */
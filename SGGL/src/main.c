@@ -29,151 +29,146 @@
 
 #include <stddef.h>
 #include <stdio.h>
-#include <string.h>
 #include <windows.h>
 
 #include <mdc/error/exit_on_error.h>
 #include <mdc/std/wchar.h>
 #include <mdc/wchar_t/filew.h>
 
-#include "args_parser.h"
-#include "args_validator.h"
-#include "game_loader.h"
 #include "help_printer.h"
-#include "knowledge_library.h"
-#include "library_injector.h"
 #include "license.h"
+#include "sggl.h"
 
-int wmain(int argc, const wchar_t** argv) {
-  size_t i;
-
-  size_t num_libraries;
-  struct ParsedArgs args = PARSED_ARGS_UNINIT;
-  struct ParsedArgs* init_args_result;
-  PROCESS_INFORMATION processes_infos[GameLoader_kMaxInstances];
-  int is_inject_libraries_success;
-  int is_knowledge_override_inject;
+enum {
+  kWaitPollMilliseconds = 100
+};
 
-  /* Print the license notice. */
-  License_PrintText();
+static int IsEnterPressed(HANDLE console_input) {
+  INPUT_RECORD input_record;
+  DWORD num_events;
+  DWORD num_read_events;
+  int is_enter_pressed;
 
-  for (i = 0; i < 72; ++i) {
-    wprintf(L"-");
-  }
-  wprintf(L"\n");
-
-  /* Validate args. */
-  if (!ArgsValidator_IsValid(argc, argv, &num_libraries)) {
-    Help_PrintText(argv[0]);
-    wprintf(L"\nPress enter to exit...\n");
-    getc(stdin);
+  is_enter_pressed = 0;
 
+  /* Fails if the input is not a console, such as a redirected file. */
+  if (!GetNumberOfConsoleInputEvents(console_input, &num_events)) {
     return 0;
   }
 
-  /* Parse args. */
-  init_args_result = ParsedArgs_InitFromArgv(&args, argc, argv, num_libraries);
-  if (init_args_result == NULL) {
-    goto bad_return;
-  }
+  for (; num_events > 0; --num_events) {
+    if (!ReadConsoleInputW(
+        console_input,
+        &input_record,
+        1,
+        &num_read_events)) {
+      break;
+    }
 
-  /* Initialize Knowledge library, if specified. */
-  if (args.knowledge_library_path != NULL) {
-    wprintf(
-        L"Loading Knowledge library from %ls\n",
-        args.knowledge_library_path);
-    Knowledge_Init(args.knowledge_library_path, args.game_path);
-    wprintf(L"\n");
+    if (input_record.EventType == KEY_EVENT
+        && input_record.Event.KeyEvent.bKeyDown
+        && input_record.Event.KeyEvent.wVirtualKeyCode == VK_RETURN) {
+      is_enter_pressed = 1;
+    }
   }
 
-  /* Print out the game info, handled by Knowledge. */
-  Knowledge_PrintGameInfo();
+  return is_enter_pressed;
+}
 
-  /* Print out parsed args to standard out. */
-  wprintf(L"Now loading game from path...\n");
-  wprintf(L"%ls\n\n", args.game_path);
+/**
+ * Waits until every instance has exited. Pressing enter in the console
+ * prints the job accounting while waiting.
+ */
+static void WaitForInstancesToExit(const struct Sggl_Launch* launch) {
+  const struct InstanceJob* instance_job;
+  HANDLE console_input;
 
-  if (args.game_args != NULL) {
-    wprintf(L"Command line arguments to pass into the game:\n");
-    wprintf(L"%ls\n\n", args.game_args);
-  }
+  instance_job = Sggl_Launch_GetJob(launch);
+  console_input = GetStdHandle(STD_INPUT_HANDLE);
 
-  if (args.inject_library_paths_count > 0) {
-    wprintf(L"Libraries to inject:\n");
+  if (instance_job != NULL) {
+    wprintf(L"Waiting for the instances to exit. Press enter to print the\n");
+    wprintf(L"job accounting.\n\n");
+  } else {
+    wprintf(L"Waiting for the instances to exit.\n\n");
+  }
 
-    for (i = 0; i < args.inject_library_paths_count; ++i) {
-      wprintf(L"%ls\n", args.inject_library_paths[i]);
+  while (!Sggl_Launch_WaitForExit(launch, kWaitPollMilliseconds)) {
+    if (instance_job != NULL && IsEnterPressed(console_input)) {
+      InstanceJob_PrintAccounting(instance_job);
     }
+  }
+
+  wprintf(L"All instances have exited.\n\n");
 
-    wprintf(L"\n");
+  /* The job's accounting covers the whole lifetime of the instances. */
+  if (instance_job != NULL) {
+    InstanceJob_PrintAccounting(instance_job);
   }
+}
 
-  wprintf(L"Number of instances to open: %d\n", args.num_instances);
+int wmain(int argc, const wchar_t** argv) {
+  size_t i;
 
-  /* Create the new processes. */
-  GameLoader_StartGameSuspended(processes_infos, &args);
+  struct Sggl_Plan plan;
+  struct Sggl_Plan* init_plan_result;
+  struct Sggl_Launch launch;
+  struct Sggl_Launch* start_launch_result;
+  int is_launch_success;
+  const wchar_t* launch_error_message;
+  DWORD launch_last_error;
 
-  wprintf(L"%u game instance(s) have been opened.\n\n", args.num_instances);
+  /* Print the license notice. */
+  License_PrintText();
 
-  /* Inject the library, after reading all files. */
-  is_knowledge_override_inject = Knowledge_InjectLibrariesToProcesses(
-      args.inject_library_paths,
-      args.inject_library_paths_count,
-      processes_infos,
-      args.num_instances);
+  for (i = 0; i < 72; ++i) {
+    wprintf(L"-");
+  }
+  wprintf(L"\n");
 
-  if (!is_knowledge_override_inject) {
-    is_inject_libraries_success = LibraryInjector_InjectToProcesses(
-        args.inject_library_paths,
-        args.inject_library_paths_count,
-        processes_infos,
-        args.num_instances);
-  } else {
-    is_inject_libraries_success = is_knowledge_override_inject;
+  /* Validate and parse args. */
+  init_plan_result = Sggl_Plan_InitFromArgv(&plan, argc, argv);
+  if (init_plan_result == NULL) {
+    Help_PrintText(argv[0]);
+    wprintf(L"\nPress enter to exit...\n");
+    getc(stdin);
+
+    return 0;
   }
 
-  if (is_inject_libraries_success) {
-    wprintf(L"All libraries have been successfully injected.\n\n");
-  } else {
-    wprintf(L"Some or all libraries failed to inject.\n\n");
+  /* Run the launch, which prints its own progress. */
+  start_launch_result = Sggl_Launch_Start(&launch, &plan, NULL, NULL);
+  if (start_launch_result == NULL) {
+    Mdc_Error_ExitOnWindowsFunctionError(
+        __FILEW__,
+        __LINE__,
+        L"CreateThread",
+        GetLastError());
+    goto bad_deinit_plan;
   }
 
-  /* Resume processes. */
-  wprintf(L"Resuming processes...\n\n");
+  Sggl_Launch_Wait(&launch, INFINITE);
+  is_launch_success = Sggl_Launch_IsSuccess(&launch);
 
-  for (i = 0; i < args.num_instances; ++i) {
-    ResumeThread(processes_infos[i].hThread);
+  launch_last_error = Sggl_Launch_GetError(&launch, &launch_error_message);
+  if (launch_error_message != NULL) {
+    wprintf(
+        L"The launch failed: %ls (error 0x%lX)\n\n",
+        launch_error_message,
+        launch_last_error);
   }
 
-  /* Before closing handles, have Knowledge cleanup anything it needs to. */
-  Knowledge_Deinit(processes_infos, args.num_instances);
-
-  /* Close process and thread handles. */
-  for (i = 0; i < args.num_instances; ++i) {
-    BOOL is_close_handle_success;
-
-    is_close_handle_success = CloseHandle(processes_infos[i].hProcess);
-    if (!is_close_handle_success) {
-      Mdc_Error_ExitOnWindowsFunctionError(
-          __FILEW__,
-          __LINE__,
-          L"CloseHandle",
-          GetLastError());
-      goto bad_deinit_args;
-    }
-
-    is_close_handle_success = CloseHandle(processes_infos[i].hThread);
-    if (!is_close_handle_success) {
-      Mdc_Error_ExitOnWindowsFunctionError(
-          __FILEW__,
-          __LINE__,
-          L"CloseHandle",
-          GetLastError());
-      goto bad_deinit_args;
-    }
+  /*
+   * The launch contains or observes the instances until it is released,
+   * so it is only released once they exit.
+   */
+  if (Sggl_Launch_IsResident(&launch)) {
+    WaitForInstancesToExit(&launch);
   }
 
-  ParsedArgs_Deinit(&args);
+  Sggl_Launch_Deinit(&launch);
+
+  Sggl_Plan_Deinit(&plan);
 
   wprintf(L"Done. \n\n");
 
@@ -183,11 +178,10 @@ int wmain(int argc, const wchar_t** argv) {
   getc(stdin);
 #endif /* NDEBUG */
 
-  return 0;
+  return is_launch_success ? 0 : 1;
 
-bad_deinit_args:
-  ParsedArgs_Deinit(&args);
+bad_deinit_plan:
+  Sggl_Plan_Deinit(&plan);
 
-bad_return:
   return 1;
 }
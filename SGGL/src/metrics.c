@@ -0,0 +1,1116 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "metrics.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+#include <shlwapi.h>
+
+#include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+#include <mdc/wchar_t/filew.h>
+
+#include "instance_registry.h"
+#include "monitor.h"
+
+enum {
+  kNumBuckets = 16,
+
+  /* Upper bound on the length of any single rendered line. */
+  kLineCapacity = 256,
+  kLabelCapacity = MAX_PATH * 3,
+
+  kHttpRequestCapacity = 2048,
+  kListenBacklog = 8
+};
+
+/*
+ * The low word of a sum holds 31 bits, and its top bit marks a carry
+ * that has not reached the high word yet.
+ */
+#define SUM_LOW_MASK 0x7FFFFFFFUL
+#define SUM_CARRY_FLAG 0x80000000UL
+
+enum Phase {
+  kPhase_Create,
+  kPhase_Inject,
+  kPhase_Resume,
+
+  kNumPhases
+};
+
+static const char* const kPhaseNames[kNumPhases] = {
+    "create",
+    "inject",
+    "resume"
+};
+
+static const DWORD kBucketBoundsMicroseconds[kNumBuckets] = {
+    100, 250, 500,
+    1000, 2500, 5000,
+    10000, 25000, 50000,
+    100000, 250000, 500000,
+    1000000, 2500000, 5000000,
+    10000000
+};
+
+/**
+ * Bucket counts are not cumulative. The last bucket counts the
+ * observations above every bound. A 32-bit sum of microseconds
+ * overflows after about 71 minutes and 32-bit Windows has no 64-bit
+ * interlocked add, so the sum is split into a high and a low word.
+ */
+struct Histogram {
+  volatile LONG bucket_counts[kNumBuckets + 1];
+  volatile LONG sum_high;
+  volatile LONG sum_low;
+};
+
+/**
+ * Published with a sequence lock. The monitor is the only writer, and
+ * readers retry if the sequence is odd or changed while copying.
+ */
+struct InstanceGauges {
+  volatile LONG sequence;
+
+  int is_sampled;
+  ULONGLONG cpu_time;
+  ULONGLONG working_set_size;
+  ULONGLONG commit_size;
+  ULONGLONG read_bytes;
+  ULONGLONG write_bytes;
+  DWORD handle_count;
+};
+
+/**
+ * A game instance that is reported on, in the slot of its instance
+ * number. The metrics keep their own handle, since the launch closes
+ * the handles of failed instances and moves the others while the server
+ * may be rendering. The handle is set before the process ID is
+ * published, and is kept until the metrics are deinitialized, so that
+ * readers never see it closed. A slot is not reported while its process
+ * ID is zero.
+ */
+struct MetricsInstance {
+  volatile LONG process_id;
+  HANDLE process;
+};
+
+struct TextBuffer {
+  char* data;
+  size_t length;
+  size_t capacity;
+};
+
+static int is_metrics_initialized = 0;
+static LARGE_INTEGER performance_frequency;
+
+static struct Histogram create_histogram;
+static struct Histogram resume_histogram;
+static struct Histogram* inject_histograms;
+static volatile LONG success_counts[kNumPhases];
+static volatile LONG failure_counts[kNumPhases];
+
+static const wchar_t* const* registered_library_paths;
+static char (*library_labels)[kLabelCapacity];
+static size_t num_registered_libraries;
+
+static struct MetricsInstance* metrics_instances;
+static struct InstanceGauges* instance_gauges;
+static size_t num_registered_instances;
+
+static struct InstanceRegistry* host_instance_registry;
+
+static SOCKET server_socket = INVALID_SOCKET;
+static HANDLE server_thread = NULL;
+
+static DWORD GetElapsedMicroseconds(const struct MetricsTimer* timer) {
+  LARGE_INTEGER end_time;
+
+  QueryPerformanceCounter(&end_time);
+
+  return (DWORD) ((end_time.QuadPart - timer->start_time.QuadPart)
+      * 1000000 / performance_frequency.QuadPart);
+}
+
+/**
+ * VC6's headers declare InterlockedCompareExchange with pointers, while
+ * later headers declare it with LONGs. Both are the same call on 32-bit
+ * Windows.
+ */
+static LONG CompareExchange(
+    volatile LONG* destination,
+    LONG exchange,
+    LONG comparand) {
+#if defined(_MSC_VER) && _MSC_VER <= 1200
+  return (LONG) InterlockedCompareExchange(
+      (PVOID*) destination,
+      (PVOID) exchange,
+      (PVOID) comparand);
+#else
+  return InterlockedCompareExchange(destination, exchange, comparand);
+#endif
+}
+
+/**
+ * Adds to the sum without a lock. The adder that carries out of the low
+ * word sets the carry flag with the new low word, and clears it once the
+ * high word is incremented. Other adders wait for the flag to clear, and
+ * readers retry, so that no one sees the low word wrapped without its
+ * carry.
+ */
+static void Histogram_AddToSum(
+    struct Histogram* histogram,
+    DWORD microseconds) {
+  DWORD addend;
+  DWORD old_low;
+  DWORD new_low;
+
+  while (microseconds > 0) {
+    addend = (microseconds > SUM_LOW_MASK) ? SUM_LOW_MASK : microseconds;
+    microseconds -= addend;
+
+    for (;;) {
+      old_low = (DWORD) histogram->sum_low;
+      if ((old_low & SUM_CARRY_FLAG) != 0) {
+        Sleep(0);
+        continue;
+      }
+
+      new_low = old_low + addend;
+      if (new_low > SUM_LOW_MASK) {
+        new_low = (new_low & SUM_LOW_MASK) | SUM_CARRY_FLAG;
+      }
+
+      if (CompareExchange(
+              &histogram->sum_low,
+              (LONG) new_low,
+              (LONG) old_low) == (LONG) old_low) {
+        break;
+      }
+    }
+
+    if ((new_low & SUM_CARRY_FLAG) != 0) {
+      InterlockedIncrement((LONG*) &histogram->sum_high);
+      InterlockedExchange(
+          (LONG*) &histogram->sum_low,
+          (LONG) (new_low & SUM_LOW_MASK));
+    }
+  }
+}
+
+static ULONGLONG Histogram_ReadSum(const struct Histogram* histogram) {
+  DWORD high;
+  DWORD low;
+
+  /* Retry while a carry is in flight or has just reached the high word. */
+  do {
+    high = (DWORD) histogram->sum_high;
+    low = (DWORD) histogram->sum_low;
+  } while ((low & SUM_CARRY_FLAG) != 0
+      || high != (DWORD) histogram->sum_high);
+
+  return ((ULONGLONG) high << 31) + low;
+}
+
+static void Histogram_Observe(
+    struct Histogram* histogram,
+    DWORD microseconds) {
+  size_t i_bucket;
+
+  for (i_bucket = 0; i_bucket < kNumBuckets; ++i_bucket) {
+    if (microseconds <= kBucketBoundsMicroseconds[i_bucket]) {
+      break;
+    }
+  }
+
+  InterlockedIncrement((LONG*) &histogram->bucket_counts[i_bucket]);
+  Histogram_AddToSum(histogram, microseconds);
+}
+
+static void CountResult(enum Phase phase, int is_success) {
+  if (is_success) {
+    InterlockedIncrement((LONG*) &success_counts[phase]);
+  } else {
+    InterlockedIncrement((LONG*) &failure_counts[phase]);
+  }
+}
+
+/**
+ * Formats without the C runtime's 64-bit printf extensions, which VC6
+ * and newer compilers spell differently.
+ */
+static const char* FormatULongLong(char* str, ULONGLONG value) {
+  char digits[24];
+  size_t num_digits;
+  size_t i_digit;
+
+  num_digits = 0;
+  do {
+    digits[num_digits] = (char) ('0' + (value % 10));
+    value /= 10;
+    num_digits += 1;
+  } while (value > 0);
+
+  for (i_digit = 0; i_digit < num_digits; ++i_digit) {
+    str[i_digit] = digits[num_digits - i_digit - 1];
+  }
+  str[num_digits] = '\0';
+
+  return str;
+}
+
+/**
+ * Text buffer
+ */
+
+static struct TextBuffer* TextBuffer_Init(
+    struct TextBuffer* buffer,
+    size_t capacity) {
+  buffer->data = Mdc_malloc(capacity);
+  if (buffer->data == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    return NULL;
+  }
+
+  buffer->data[0] = '\0';
+  buffer->length = 0;
+  buffer->capacity = capacity;
+
+  return buffer;
+}
+
+static void TextBuffer_Deinit(struct TextBuffer* buffer) {
+  Mdc_free(buffer->data);
+  buffer->data = NULL;
+  buffer->length = 0;
+  buffer->capacity = 0;
+}
+
+static void TextBuffer_Append(
+    struct TextBuffer* buffer,
+    const char* format,
+    ...) {
+  va_list args;
+  int num_written;
+
+  if (buffer->capacity - buffer->length < kLineCapacity) {
+    return;
+  }
+
+  va_start(args, format);
+  num_written = _vsnprintf(
+      &buffer->data[buffer->length],
+      kLineCapacity,
+      format,
+      args);
+  va_end(args);
+
+  if (num_written > 0) {
+    buffer->length += num_written;
+  }
+}
+
+/**
+ * Rendering
+ */
+
+static void RenderFamilyHeader(
+    struct TextBuffer* buffer,
+    const char* name,
+    const char* type,
+    const char* help,
+    int is_open_metrics) {
+  /*
+   * OpenMetrics names counter families without the _total suffix that
+   * the Prometheus text format expects.
+   */
+  if (!is_open_metrics && strcmp(type, "counter") == 0) {
+    TextBuffer_Append(buffer, "# HELP %s_total %s\n", name, help);
+    TextBuffer_Append(buffer, "# TYPE %s_total %s\n", name, type);
+  } else {
+    TextBuffer_Append(buffer, "# HELP %s %s\n", name, help);
+    TextBuffer_Append(buffer, "# TYPE %s %s\n", name, type);
+  }
+}
+
+static void RenderHistogramSeries(
+    struct TextBuffer* buffer,
+    const char* name,
+    const char* label,
+    const struct Histogram* histogram) {
+  size_t i_bucket;
+  unsigned long cumulative_count;
+  ULONGLONG sum_microseconds;
+  char sum_seconds[24];
+  char label_set[kLabelCapacity + 32];
+
+  /* Sums and counts only carry the series' own labels. */
+  _snprintf(
+      label_set,
+      sizeof(label_set),
+      (label[0] != '\0') ? "{%s}" : "%s",
+      label);
+  label_set[sizeof(label_set) - 1] = '\0';
+
+  cumulative_count = 0;
+
+  for (i_bucket = 0; i_bucket < kNumBuckets; ++i_bucket) {
+    cumulative_count += histogram->bucket_counts[i_bucket];
+
+    TextBuffer_Append(
+        buffer,
+        "%s_bucket{%s%sle=\"%lu.%06lu\"} %lu\n",
+        name,
+        label,
+        (label[0] != '\0') ? "," : "",
+        kBucketBoundsMicroseconds[i_bucket] / 1000000,
+        kBucketBoundsMicroseconds[i_bucket] % 1000000,
+        cumulative_count);
+  }
+
+  cumulative_count += histogram->bucket_counts[kNumBuckets];
+  sum_microseconds = Histogram_ReadSum(histogram);
+
+  TextBuffer_Append(
+      buffer,
+      "%s_bucket{%s%sle=\"+Inf\"} %lu\n",
+      name,
+      label,
+      (label[0] != '\0') ? "," : "",
+      cumulative_count);
+  TextBuffer_Append(
+      buffer,
+      "%s_sum%s %s.%06lu\n",
+      name,
+      label_set,
+      FormatULongLong(sum_seconds, sum_microseconds / 1000000),
+      (unsigned long) (sum_microseconds % 1000000));
+  TextBuffer_Append(
+      buffer,
+      "%s_count%s %lu\n",
+      name,
+      label_set,
+      cumulative_count);
+}
+
+static void ReadInstanceGauges(
+    size_t i_instance,
+    struct InstanceGauges* gauges) {
+  const struct InstanceGauges* published;
+  LONG sequence;
+
+  published = &instance_gauges[i_instance];
+
+  do {
+    sequence = published->sequence;
+    *gauges = *published;
+  } while ((sequence & 1) != 0 || sequence != published->sequence);
+}
+
+static void RenderInstanceGauge(
+    struct TextBuffer* buffer,
+    const char* name,
+    size_t i_instance,
+    const char* value) {
+  TextBuffer_Append(
+      buffer,
+      "%s{instance=\"%u\",pid=\"%lu\"} %s\n",
+      name,
+      (unsigned int) i_instance,
+      (unsigned long) metrics_instances[i_instance].process_id,
+      value);
+}
+
+static struct MetricsInstance* FindInstance(DWORD process_id) {
+  size_t i_instance;
+
+  for (i_instance = 0; i_instance < num_registered_instances; ++i_instance) {
+    if ((DWORD) metrics_instances[i_instance].process_id == process_id) {
+      return &metrics_instances[i_instance];
+    }
+  }
+
+  return NULL;
+}
+
+static void RenderHost(struct TextBuffer* buffer, int is_open_metrics) {
+  struct InstanceRegistry_Usage usage;
+
+  if (host_instance_registry == NULL
+      || !InstanceRegistry_GetUsage(host_instance_registry, &usage)) {
+    return;
+  }
+
+  RenderFamilyHeader(
+      buffer,
+      "sggl_host_instances",
+      "gauge",
+      "Game instances running from every run of the loader.",
+      is_open_metrics);
+  TextBuffer_Append(
+      buffer,
+      "sggl_host_instances{run=\"this\"} %lu\n",
+      (unsigned long) (usage.num_instances - usage.num_other_instances));
+  TextBuffer_Append(
+      buffer,
+      "sggl_host_instances{run=\"other\"} %lu\n",
+      (unsigned long) usage.num_other_instances);
+}
+
+static void RenderInstances(struct TextBuffer* buffer, int is_open_metrics) {
+  size_t i_instance;
+  struct InstanceGauges gauges;
+  char value[32];
+
+  RenderFamilyHeader(
+      buffer,
+      "sggl_instance_up",
+      "gauge",
+      "Whether the game instance is running.",
+      is_open_metrics);
+  for (i_instance = 0; i_instance < num_registered_instances; ++i_instance) {
+    if (metrics_instances[i_instance].process_id == 0) {
+      continue;
+    }
+
+    RenderInstanceGauge(
+        buffer,
+        "sggl_instance_up",
+        i_instance,
+        (metrics_instances[i_instance].process != NULL
+            && WaitForSingleObject(
+                metrics_instances[i_instance].process,
+                0) == WAIT_TIMEOUT) ? "1" : "0");
+  }
+
+  RenderFamilyHeader(
+      buffer,
+      "sggl_instance_cpu_seconds",
+      "counter",
+      "CPU time used by the game instance.",
+      is_open_metrics);
+  RenderFamilyHeader(
+      buffer,
+      "sggl_instance_working_set_bytes",
+      "gauge",
+      "Working set of the game instance.",
+      is_open_metrics);
+  RenderFamilyHeader(
+      buffer,
+      "sggl_instance_commit_bytes",
+      "gauge",
+      "Committed private memory of the game instance.",
+      is_open_metrics);
+  RenderFamilyHeader(
+      buffer,
+      "sggl_instance_read_bytes",
+      "counter",
+      "Bytes read by the game instance.",
+      is_open_metrics);
+  RenderFamilyHeader(
+      buffer,
+      "sggl_instance_write_bytes",
+      "counter",
+      "Bytes written by the game instance.",
+      is_open_metrics);
+  RenderFamilyHeader(
+      buffer,
+      "sggl_instance_handles",
+      "gauge",
+      "Open handles of the game instance.",
+      is_open_metrics);
+
+  /* Resource gauges are only known while the monitor is running. */
+  for (i_instance = 0; i_instance < num_registered_instances; ++i_instance) {
+    if (metrics_instances[i_instance].process_id == 0) {
+      continue;
+    }
+
+    ReadInstanceGauges(i_instance, &gauges);
+    if (!gauges.is_sampled) {
+      continue;
+    }
+
+    _snprintf(
+        value,
+        sizeof(value),
+        "%lu.%07lu",
+        (unsigned long) (gauges.cpu_time / 10000000),
+        (unsigned long) (gauges.cpu_time % 10000000));
+    RenderInstanceGauge(
+        buffer,
+        "sggl_instance_cpu_seconds_total",
+        i_instance,
+        value);
+    RenderInstanceGauge(
+        buffer,
+        "sggl_instance_working_set_bytes",
+        i_instance,
+        FormatULongLong(value, gauges.working_set_size));
+    RenderInstanceGauge(
+        buffer,
+        "sggl_instance_commit_bytes",
+        i_instance,
+        FormatULongLong(value, gauges.commit_size));
+    RenderInstanceGauge(
+        buffer,
+        "sggl_instance_read_bytes_total",
+        i_instance,
+        FormatULongLong(value, gauges.read_bytes));
+    RenderInstanceGauge(
+        buffer,
+        "sggl_instance_write_bytes_total",
+        i_instance,
+        FormatULongLong(value, gauges.write_bytes));
+    RenderInstanceGauge(
+        buffer,
+        "sggl_instance_handles",
+        i_instance,
+        FormatULongLong(value, gauges.handle_count));
+  }
+}
+
+static struct TextBuffer* Render(
+    struct TextBuffer* buffer,
+    int is_open_metrics) {
+  size_t num_lines;
+  size_t i_library;
+  size_t i_phase;
+  char label[kLabelCapacity + 16];
+
+  num_lines = (kNumBuckets + 4) * (2 + num_registered_libraries)
+      + 2 * kNumPhases
+      + 7 * num_registered_instances
+      + 32;
+
+  if (TextBuffer_Init(buffer, num_lines * kLineCapacity) == NULL) {
+    return NULL;
+  }
+
+  RenderFamilyHeader(
+      buffer,
+      "sggl_create_duration_seconds",
+      "histogram",
+      "Time taken to create each game process.",
+      is_open_metrics);
+  RenderHistogramSeries(
+      buffer,
+      "sggl_create_duration_seconds",
+      "",
+      &create_histogram);
+
+  RenderFamilyHeader(
+      buffer,
+      "sggl_inject_duration_seconds",
+      "histogram",
+      "Time taken to inject a library into one game process.",
+      is_open_metrics);
+  for (i_library = 0; i_library < num_registered_libraries; ++i_library) {
+    _snprintf(
+        label,
+        sizeof(label),
+        "library=\"%s\"",
+        library_labels[i_library]);
+    label[sizeof(label) - 1] = '\0';
+
+    RenderHistogramSeries(
+        buffer,
+        "sggl_inject_duration_seconds",
+        label,
+        &inject_histograms[i_library]);
+  }
+
+  RenderFamilyHeader(
+      buffer,
+      "sggl_resume_duration_seconds",
+      "histogram",
+      "Time taken to resume each game process.",
+      is_open_metrics);
+  RenderHistogramSeries(
+      buffer,
+      "sggl_resume_duration_seconds",
+      "",
+      &resume_histogram);
+
+  RenderFamilyHeader(
+      buffer,
+      "sggl_launch_results",
+      "counter",
+      "Results of each launch phase.",
+      is_open_metrics);
+  for (i_phase = 0; i_phase < kNumPhases; ++i_phase) {
+    TextBuffer_Append(
+        buffer,
+        "sggl_launch_results_total{phase=\"%s\",result=\"success\"} %lu\n",
+        kPhaseNames[i_phase],
+        (unsigned long) success_counts[i_phase]);
+    TextBuffer_Append(
+        buffer,
+        "sggl_launch_results_total{phase=\"%s\",result=\"failure\"} %lu\n",
+        kPhaseNames[i_phase],
+        (unsigned long) failure_counts[i_phase]);
+  }
+
+  RenderInstances(buffer, is_open_metrics);
+  RenderHost(buffer, is_open_metrics);
+
+  if (is_open_metrics) {
+    TextBuffer_Append(buffer, "# EOF\n");
+  }
+
+  return buffer;
+}
+
+/**
+ * HTTP server
+ */
+
+static int SendAll(SOCKET client, const char* data, size_t size) {
+  int num_sent;
+
+  while (size > 0) {
+    num_sent = send(client, data, (int) size, 0);
+    if (num_sent == SOCKET_ERROR) {
+      return 0;
+    }
+
+    data += num_sent;
+    size -= num_sent;
+  }
+
+  return 1;
+}
+
+static void ServeClient(SOCKET client) {
+  char request[kHttpRequestCapacity];
+  char header[kLineCapacity];
+  struct TextBuffer body;
+  int header_length;
+
+  /* Every path is answered with the metrics. */
+  if (recv(client, request, sizeof(request), 0) == SOCKET_ERROR) {
+    return;
+  }
+
+  if (Render(&body, 1) == NULL) {
+    return;
+  }
+
+  header_length = _snprintf(
+      header,
+      sizeof(header),
+      "HTTP/1.0 200 OK\r\n"
+          "Content-Type: application/openmetrics-text; version=1.0.0; "
+          "charset=utf-8\r\n"
+          "Content-Length: %u\r\n"
+          "Connection: close\r\n"
+          "\r\n",
+      (unsigned int) body.length);
+
+  if (SendAll(client, header, header_length)) {
+    SendAll(client, body.data, body.length);
+  }
+
+  TextBuffer_Deinit(&body);
+}
+
+static DWORD WINAPI ServerThread_Run(void* unused) {
+  SOCKET client;
+
+  for (;;) {
+    /* Fails once the listening socket is closed by Metrics_StopServer. */
+    client = accept(server_socket, NULL, NULL);
+    if (client == INVALID_SOCKET) {
+      break;
+    }
+
+    ServeClient(client);
+    closesocket(client);
+  }
+
+  return 0;
+}
+
+/**
+ * External
+ */
+
+void MetricsTimer_Start(struct MetricsTimer* timer) {
+  QueryPerformanceCounter(&timer->start_time);
+}
+
+void Metrics_Init(
+    const wchar_t* const* library_paths,
+    size_t num_libraries,
+    size_t num_instances,
+    struct InstanceRegistry* instance_registry) {
+  size_t i_library;
+
+  QueryPerformanceFrequency(&performance_frequency);
+
+  inject_histograms = Mdc_malloc(
+      (num_libraries + 1) * sizeof(inject_histograms[0]));
+  library_labels = Mdc_malloc(
+      (num_libraries + 1) * sizeof(library_labels[0]));
+  metrics_instances = Mdc_malloc(
+      (num_instances + 1) * sizeof(metrics_instances[0]));
+  instance_gauges = Mdc_malloc(
+      (num_instances + 1) * sizeof(instance_gauges[0]));
+  if (inject_histograms == NULL
+      || library_labels == NULL
+      || metrics_instances == NULL
+      || instance_gauges == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    return;
+  }
+
+  memset(
+      inject_histograms,
+      0,
+      (num_libraries + 1) * sizeof(inject_histograms[0]));
+  memset(
+      metrics_instances,
+      0,
+      (num_instances + 1) * sizeof(metrics_instances[0]));
+  memset(
+      instance_gauges,
+      0,
+      (num_instances + 1) * sizeof(instance_gauges[0]));
+
+  /* A later launch in the same process starts from zero. */
+  memset(&create_histogram, 0, sizeof(create_histogram));
+  memset(&resume_histogram, 0, sizeof(resume_histogram));
+  memset((void*) success_counts, 0, sizeof(success_counts));
+  memset((void*) failure_counts, 0, sizeof(failure_counts));
+
+  /* Label the libraries by file name, which never contains a quote. */
+  for (i_library = 0; i_library < num_libraries; ++i_library) {
+    if (WideCharToMultiByte(
+        CP_UTF8,
+        0,
+        PathFindFileNameW(library_paths[i_library]),
+        -1,
+        library_labels[i_library],
+        sizeof(library_labels[i_library]),
+        NULL,
+        NULL) == 0) {
+      strcpy(library_labels[i_library], "unknown");
+    }
+  }
+
+  registered_library_paths = library_paths;
+  num_registered_libraries = num_libraries;
+  num_registered_instances = num_instances;
+  host_instance_registry = instance_registry;
+
+  is_metrics_initialized = 1;
+}
+
+void Metrics_Deinit(void) {
+  size_t i_instance;
+
+  if (!is_metrics_initialized) {
+    return;
+  }
+
+  Metrics_StopServer();
+
+  is_metrics_initialized = 0;
+
+  for (i_instance = 0; i_instance < num_registered_instances; ++i_instance) {
+    if (metrics_instances[i_instance].process != NULL) {
+      CloseHandle(metrics_instances[i_instance].process);
+    }
+  }
+
+  Mdc_free(inject_histograms);
+  inject_histograms = NULL;
+  Mdc_free(library_labels);
+  library_labels = NULL;
+  Mdc_free(metrics_instances);
+  metrics_instances = NULL;
+  Mdc_free(instance_gauges);
+  instance_gauges = NULL;
+
+  registered_library_paths = NULL;
+  num_registered_libraries = 0;
+  num_registered_instances = 0;
+  host_instance_registry = NULL;
+}
+
+void Metrics_ObserveCreate(const struct MetricsTimer* timer, int is_success) {
+  if (!is_metrics_initialized) {
+    return;
+  }
+
+  Histogram_Observe(&create_histogram, GetElapsedMicroseconds(timer));
+  CountResult(kPhase_Create, is_success);
+}
+
+void Metrics_ObserveInject(
+    const wchar_t* library_path,
+    const struct MetricsTimer* timer,
+    int is_success) {
+  size_t i_library;
+
+  if (!is_metrics_initialized) {
+    return;
+  }
+
+  CountResult(kPhase_Inject, is_success);
+
+  /* The registered paths are the same strings that get injected. */
+  for (i_library = 0; i_library < num_registered_libraries; ++i_library) {
+    if (registered_library_paths[i_library] == library_path) {
+      Histogram_Observe(
+          &inject_histograms[i_library],
+          GetElapsedMicroseconds(timer));
+      return;
+    }
+  }
+}
+
+void Metrics_ObserveResume(const struct MetricsTimer* timer, int is_success) {
+  if (!is_metrics_initialized) {
+    return;
+  }
+
+  Histogram_Observe(&resume_histogram, GetElapsedMicroseconds(timer));
+  CountResult(kPhase_Resume, is_success);
+}
+
+void Metrics_AddInstance(
+    size_t instance_number,
+    const PROCESS_INFORMATION* process_info) {
+  struct MetricsInstance* instance;
+  BOOL is_duplicate_handle_success;
+
+  if (!is_metrics_initialized
+      || instance_number >= num_registered_instances) {
+    return;
+  }
+
+  /* Each instance number is only created once per launch. */
+  instance = &metrics_instances[instance_number];
+
+  is_duplicate_handle_success = DuplicateHandle(
+      GetCurrentProcess(),
+      process_info->hProcess,
+      GetCurrentProcess(),
+      &instance->process,
+      SYNCHRONIZE,
+      FALSE,
+      0);
+  if (!is_duplicate_handle_success) {
+    instance->process = NULL;
+  }
+
+  InterlockedExchange(
+      &instance->process_id,
+      (LONG) process_info->dwProcessId);
+}
+
+void Metrics_RemoveInstance(DWORD process_id) {
+  struct MetricsInstance* instance;
+
+  if (!is_metrics_initialized || process_id == 0) {
+    return;
+  }
+
+  instance = FindInstance(process_id);
+  if (instance != NULL) {
+    InterlockedExchange(&instance->process_id, 0);
+  }
+}
+
+void Metrics_PublishInstanceSample(
+    DWORD process_id,
+    const struct MonitorSample* sample) {
+  struct MetricsInstance* instance;
+  struct InstanceGauges* gauges;
+
+  if (!is_metrics_initialized || process_id == 0) {
+    return;
+  }
+
+  instance = FindInstance(process_id);
+  if (instance == NULL) {
+    return;
+  }
+
+  gauges = &instance_gauges[instance - metrics_instances];
+
+  InterlockedIncrement((LONG*) &gauges->sequence);
+
+  gauges->is_sampled = 1;
+  gauges->cpu_time = sample->cpu_time;
+  gauges->working_set_size = sample->working_set_size;
+  gauges->commit_size = sample->commit_size;
+  gauges->read_bytes = sample->read_bytes;
+  gauges->write_bytes = sample->write_bytes;
+  gauges->handle_count = sample->handle_count;
+
+  InterlockedIncrement((LONG*) &gauges->sequence);
+}
+
+int Metrics_WriteTextfile(const wchar_t* path) {
+  struct TextBuffer buffer;
+  wchar_t temp_path[MAX_PATH];
+  FILE* file;
+  size_t num_written;
+
+  if (!is_metrics_initialized) {
+    return 0;
+  }
+
+  /*
+   * The collector may read the file at any time, so a complete file
+   * is moved over the old one.
+   */
+  _snwprintf(temp_path, MAX_PATH, L"%ls.tmp", path);
+  temp_path[MAX_PATH - 1] = L'\0';
+
+  if (Render(&buffer, 0) == NULL) {
+    goto bad_return;
+  }
+
+  file = _wfopen(temp_path, L"wb");
+  if (file == NULL) {
+    goto bad_deinit_buffer;
+  }
+
+  num_written = fwrite(buffer.data, 1, buffer.length, file);
+  fclose(file);
+
+  if (num_written != buffer.length) {
+    goto bad_delete_temp_file;
+  }
+
+  if (!MoveFileExW(temp_path, path, MOVEFILE_REPLACE_EXISTING)) {
+    /* Windows 95/98/ME do not have MoveFileEx. */
+    DeleteFileW(path);
+    if (!MoveFileW(temp_path, path)) {
+      goto bad_delete_temp_file;
+    }
+  }
+
+  TextBuffer_Deinit(&buffer);
+
+  return 1;
+
+bad_delete_temp_file:
+  DeleteFileW(temp_path);
+
+bad_deinit_buffer:
+  TextBuffer_Deinit(&buffer);
+
+bad_return:
+  wprintf(L"Metrics file %ls could not be written.\n", path);
+
+  return 0;
+}
+
+int Metrics_StartServer(unsigned short port) {
+  WSADATA wsa_data;
+  struct sockaddr_in address;
+  DWORD server_thread_id;
+
+  if (!is_metrics_initialized || server_thread != NULL) {
+    return 0;
+  }
+
+  if (WSAStartup(MAKEWORD(1, 1), &wsa_data) != 0) {
+    goto bad_return;
+  }
+
+  server_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (server_socket == INVALID_SOCKET) {
+    goto bad_cleanup_wsa;
+  }
+
+  /* Only serve the local scraper. */
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+
+  if (bind(server_socket, (struct sockaddr*) &address, sizeof(address))
+          == SOCKET_ERROR
+      || listen(server_socket, kListenBacklog) == SOCKET_ERROR) {
+    goto bad_close_server_socket;
+  }
+
+  server_thread = CreateThread(
+      NULL,
+      0,
+      &ServerThread_Run,
+      NULL,
+      0,
+      &server_thread_id);
+  if (server_thread == NULL) {
+    goto bad_close_server_socket;
+  }
+
+  wprintf(L"Serving metrics on http://127.0.0.1:%u/metrics\n\n", port);
+
+  return 1;
+
+bad_close_server_socket:
+  closesocket(server_socket);
+  server_socket = INVALID_SOCKET;
+
+bad_cleanup_wsa:
+  WSACleanup();
+
+bad_return:
+  wprintf(L"Metrics could not be served on port %u.\n\n", port);
+
+  return 0;
+}
+
+void Metrics_StopServer(void) {
+  if (server_thread == NULL) {
+    return;
+  }
+
+  closesocket(server_socket);
+  server_socket = INVALID_SOCKET;
+
+  WaitForSingleObject(server_thread, INFINITE);
+  CloseHandle(server_thread);
+  server_thread = NULL;
+
+  WSACleanup();
+}
@@ -0,0 +1,125 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_METRICS_H_
+#define SGGL_METRICS_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#include "instance_registry.h"
+#include "monitor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Launch and instance metrics, exported in the Prometheus text format
+ * to a file or over HTTP. Observations and instance changes can be
+ * made from any thread while the metrics are being exported. Every
+ * function does nothing until Metrics_Init is called.
+ */
+
+struct MetricsTimer {
+  LARGE_INTEGER start_time;
+};
+
+void MetricsTimer_Start(struct MetricsTimer* timer);
+
+/**
+ * Registers the libraries to observe injections for, which must outlive
+ * the metrics, and the number of instances that the launch may open,
+ * which gets a slot per instance number. If the instance registry is not
+ * NULL, the instances of every run on the host are counted as well, and
+ * it must outlive the metrics.
+ */
+void Metrics_Init(
+    const wchar_t* const* library_paths,
+    size_t num_libraries,
+    size_t num_instances,
+    struct InstanceRegistry* instance_registry);
+
+void Metrics_Deinit(void);
+
+void Metrics_ObserveCreate(const struct MetricsTimer* timer, int is_success);
+
+void Metrics_ObserveInject(
+    const wchar_t* library_path,
+    const struct MetricsTimer* timer,
+    int is_success);
+
+void Metrics_ObserveResume(const struct MetricsTimer* timer, int is_success);
+
+/**
+ * Starts reporting gauges for a created instance, in the slot of its
+ * instance number, which must be below the number of instances passed
+ * to Metrics_Init. No lock is taken. The metrics keep their own handle
+ * to the process, so the caller may close or move its
+ * PROCESS_INFORMATION at any time.
+ */
+void Metrics_AddInstance(
+    size_t instance_number,
+    const PROCESS_INFORMATION* process_info);
+
+/**
+ * Stops reporting gauges for the instance. Its handle is kept until the
+ * metrics are deinitialized, since the server may still be reading it.
+ */
+void Metrics_RemoveInstance(DWORD process_id);
+
+/**
+ * Publishes the latest resource sample of an instance. Only one thread
+ * may publish samples.
+ */
+void Metrics_PublishInstanceSample(
+    DWORD process_id,
+    const struct MonitorSample* sample);
+
+/**
+ * Replaces the file with the current metrics, in the format read by
+ * the node exporter's textfile collector.
+ */
+int Metrics_WriteTextfile(const wchar_t* path);
+
+/**
+ * Serves the current metrics in the OpenMetrics format on the
+ * localhost port, from a background thread.
+ */
+int Metrics_StartServer(unsigned short port);
+
+void Metrics_StopServer(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_METRICS_H_ */
@@ -0,0 +1,421 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "monitor.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+#include <mdc/wchar_t/filew.h>
+
+#include "metrics.h"
+
+/* Mirror of PROCESS_MEMORY_COUNTERS, which is in psapi.h. */
+struct ProcessMemoryCounters {
+  DWORD cb;
+  DWORD page_fault_count;
+  SIZE_T peak_working_set_size;
+  SIZE_T working_set_size;
+  SIZE_T quota_peak_paged_pool_usage;
+  SIZE_T quota_paged_pool_usage;
+  SIZE_T quota_peak_non_paged_pool_usage;
+  SIZE_T quota_non_paged_pool_usage;
+  SIZE_T pagefile_usage;
+  SIZE_T peak_pagefile_usage;
+};
+
+typedef BOOL WINAPI GetProcessMemoryInfoFuncType(
+    HANDLE, struct ProcessMemoryCounters*, DWORD);
+typedef BOOL WINAPI GetProcessIoCountersFuncType(HANDLE, IO_COUNTERS*);
+typedef BOOL WINAPI GetProcessHandleCountFuncType(HANDLE, DWORD*);
+
+static HMODULE psapi_library;
+static GetProcessMemoryInfoFuncType* get_process_memory_info_func;
+static GetProcessIoCountersFuncType* get_process_io_counters_func;
+static GetProcessHandleCountFuncType* get_process_handle_count_func;
+
+static void* GetKernel32ProcAddress(const char* proc_name) {
+  return GetProcAddress(GetModuleHandleW(L"kernel32.dll"), proc_name);
+}
+
+/**
+ * Resolves the sampling functions that are missing on older systems.
+ * Any that cannot be found leave their columns as zero.
+ */
+static void InitSamplingFuncs(void) {
+  /* Windows 7 moved the psapi functions into kernel32. */
+  get_process_memory_info_func =
+      (GetProcessMemoryInfoFuncType*) GetKernel32ProcAddress(
+          "K32GetProcessMemoryInfo");
+
+  if (get_process_memory_info_func == NULL) {
+    psapi_library = LoadLibraryW(L"psapi.dll");
+
+    if (psapi_library != NULL) {
+      get_process_memory_info_func =
+          (GetProcessMemoryInfoFuncType*) GetProcAddress(
+              psapi_library,
+              "GetProcessMemoryInfo");
+    }
+  }
+
+  get_process_io_counters_func =
+      (GetProcessIoCountersFuncType*) GetKernel32ProcAddress(
+          "GetProcessIoCounters");
+  get_process_handle_count_func =
+      (GetProcessHandleCountFuncType*) GetKernel32ProcAddress(
+          "GetProcessHandleCount");
+}
+
+static void DeinitSamplingFuncs(void) {
+  get_process_memory_info_func = NULL;
+  get_process_io_counters_func = NULL;
+  get_process_handle_count_func = NULL;
+
+  if (psapi_library != NULL) {
+    FreeLibrary(psapi_library);
+    psapi_library = NULL;
+  }
+}
+
+static ULONGLONG FileTimeToULongLong(const FILETIME* file_time) {
+  return ((ULONGLONG) file_time->dwHighDateTime << 32)
+      | file_time->dwLowDateTime;
+}
+
+static void MonitorRing_Push(
+    struct MonitorRing* ring,
+    const struct MonitorSample* sample) {
+  size_t i_sample;
+
+  i_sample = (ring->first + ring->count) % Monitor_kRingCapacity;
+  ring->samples[i_sample] = *sample;
+
+  if (ring->count < Monitor_kRingCapacity) {
+    ring->count += 1;
+  } else {
+    ring->first = (ring->first + 1) % Monitor_kRingCapacity;
+  }
+}
+
+/**
+ * Samples the process, unless it has exited. Returns nonzero if a
+ * sample was taken.
+ */
+static int SampleProcess(
+    HANDLE process,
+    struct MonitorRing* ring,
+    DWORD elapsed_milliseconds,
+    struct MonitorSample* sample) {
+  FILETIME creation_time;
+  FILETIME exit_time;
+  FILETIME kernel_time;
+  FILETIME user_time;
+  struct ProcessMemoryCounters memory_counters;
+  IO_COUNTERS io_counters;
+  DWORD elapsed_since_last;
+
+  if (WaitForSingleObject(process, 0) != WAIT_TIMEOUT) {
+    ring->is_exited = 1;
+    return 0;
+  }
+
+  memset(sample, 0, sizeof(*sample));
+  sample->elapsed_milliseconds = elapsed_milliseconds;
+
+  if (GetProcessTimes(
+      process,
+      &creation_time,
+      &exit_time,
+      &kernel_time,
+      &user_time)) {
+    sample->cpu_time = FileTimeToULongLong(&kernel_time)
+        + FileTimeToULongLong(&user_time);
+  }
+
+  /*
+   * CPU time is in 100-nanosecond units, so dividing it by milliseconds
+   * gives a percentage of one core times 100.
+   */
+  elapsed_since_last = elapsed_milliseconds - ring->last_elapsed_milliseconds;
+  if (elapsed_since_last > 0 && sample->cpu_time >= ring->last_cpu_time) {
+    sample->cpu_percent_x100 = (DWORD) (
+        (sample->cpu_time - ring->last_cpu_time) / elapsed_since_last);
+  }
+
+  ring->last_cpu_time = sample->cpu_time;
+  ring->last_elapsed_milliseconds = elapsed_milliseconds;
+
+  if (get_process_memory_info_func != NULL) {
+    memory_counters.cb = sizeof(memory_counters);
+
+    if (get_process_memory_info_func(
+        process,
+        &memory_counters,
+        sizeof(memory_counters))) {
+      sample->working_set_size = memory_counters.working_set_size;
+      sample->commit_size = memory_counters.pagefile_usage;
+    }
+  }
+
+  if (get_process_io_counters_func != NULL
+      && get_process_io_counters_func(process, &io_counters)) {
+    sample->read_bytes = io_counters.ReadTransferCount;
+    sample->write_bytes = io_counters.WriteTransferCount;
+  }
+
+  if (get_process_handle_count_func != NULL) {
+    get_process_handle_count_func(process, &sample->handle_count);
+  }
+
+  return 1;
+}
+
+/**
+ * Writes every ring's samples to the CSV file and empties the rings.
+ */
+static void FlushRings(struct Monitor* monitor) {
+  size_t i_instance;
+  size_t i_sample;
+  const struct MonitorRing* ring;
+  const struct MonitorSample* sample;
+
+  for (i_instance = 0; i_instance < monitor->num_instances; ++i_instance) {
+    ring = &monitor->rings[i_instance];
+
+    for (i_sample = 0; i_sample < ring->count; ++i_sample) {
+      sample = &ring->samples[
+          (ring->first + i_sample) % Monitor_kRingCapacity];
+
+      fprintf(
+          monitor->csv_file,
+          "%u,%lu,%lu,%lu,%lu.%02lu,%lu,%lu,%lu,%lu,%lu\n",
+          (unsigned int) i_instance,
+          monitor->processes_infos[i_instance].dwProcessId,
+          sample->elapsed_milliseconds,
+          (unsigned long) (sample->cpu_time / 10000),
+          sample->cpu_percent_x100 / 100,
+          sample->cpu_percent_x100 % 100,
+          (unsigned long) (sample->working_set_size / 1024),
+          (unsigned long) (sample->commit_size / 1024),
+          (unsigned long) (sample->read_bytes / 1024),
+          (unsigned long) (sample->write_bytes / 1024),
+          sample->handle_count);
+    }
+
+    monitor->rings[i_instance].first = 0;
+    monitor->rings[i_instance].count = 0;
+  }
+
+  fflush(monitor->csv_file);
+}
+
+/**
+ * External
+ */
+
+struct Monitor* Monitor_Init(
+    struct Monitor* monitor,
+    const wchar_t* csv_path,
+    DWORD interval_milliseconds,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_instances) {
+  monitor->rings = Mdc_malloc(num_instances * sizeof(monitor->rings[0]));
+  if (monitor->rings == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_return;
+  }
+
+  memset(monitor->rings, 0, num_instances * sizeof(monitor->rings[0]));
+
+  monitor->csv_file = _wfopen(csv_path, L"w");
+  if (monitor->csv_file == NULL) {
+    wprintf(L"Monitor file %ls could not be opened.\n\n", csv_path);
+    goto bad_free_rings;
+  }
+
+  fprintf(
+      monitor->csv_file,
+      "instance,process_id,elapsed_ms,cpu_time_ms,cpu_percent,"
+          "working_set_kb,commit_kb,read_kb,write_kb,handle_count\n");
+
+  monitor->interval_milliseconds = interval_milliseconds;
+  monitor->processes_infos = processes_infos;
+  monitor->num_instances = num_instances;
+
+  InitSamplingFuncs();
+
+  return monitor;
+
+bad_free_rings:
+  Mdc_free(monitor->rings);
+  monitor->rings = NULL;
+
+bad_return:
+  return NULL;
+}
+
+void Monitor_Deinit(struct Monitor* monitor) {
+  FlushRings(monitor);
+
+  fclose(monitor->csv_file);
+  monitor->csv_file = NULL;
+
+  Mdc_free(monitor->rings);
+  monitor->rings = NULL;
+
+  DeinitSamplingFuncs();
+}
+
+void Monitor_Run(struct Monitor* monitor, HANDLE stop_event) {
+  size_t i_instance;
+  size_t num_running_instances;
+  int is_any_ring_full;
+  int is_stopped;
+  struct MonitorSample sample;
+
+  DWORD start_tick_count;
+  DWORD elapsed_milliseconds;
+  DWORD next_sample_milliseconds;
+  DWORD wait_milliseconds;
+
+  LARGE_INTEGER performance_frequency;
+  LARGE_INTEGER sampling_start_time;
+  LARGE_INTEGER sampling_end_time;
+  ULONGLONG sampling_ticks;
+  unsigned long sampling_microseconds;
+  unsigned long overhead_percent_x100;
+
+  wprintf(
+      L"Monitoring %u instance(s) every %lu ms until they exit.\n\n",
+      monitor->num_instances,
+      monitor->interval_milliseconds);
+
+  QueryPerformanceFrequency(&performance_frequency);
+  sampling_ticks = 0;
+
+  start_tick_count = GetTickCount();
+  next_sample_milliseconds = 0;
+  is_stopped = 0;
+
+  for (;;) {
+    elapsed_milliseconds = GetTickCount() - start_tick_count;
+
+    QueryPerformanceCounter(&sampling_start_time);
+
+    num_running_instances = 0;
+    is_any_ring_full = 0;
+
+    for (i_instance = 0; i_instance < monitor->num_instances; ++i_instance) {
+      struct MonitorRing* ring;
+
+      ring = &monitor->rings[i_instance];
+      if (ring->is_exited) {
+        continue;
+      }
+
+      if (!SampleProcess(
+          monitor->processes_infos[i_instance].hProcess,
+          ring,
+          elapsed_milliseconds,
+          &sample)) {
+        continue;
+      }
+
+      MonitorRing_Push(ring, &sample);
+      Metrics_PublishInstanceSample(
+          monitor->processes_infos[i_instance].dwProcessId,
+          &sample);
+
+      num_running_instances += 1;
+      is_any_ring_full = is_any_ring_full
+          || (ring->count == Monitor_kRingCapacity);
+    }
+
+    /* The rings fill up together, so they are written out together. */
+    if (is_any_ring_full) {
+      FlushRings(monitor);
+    }
+
+    QueryPerformanceCounter(&sampling_end_time);
+    sampling_ticks += sampling_end_time.QuadPart
+        - sampling_start_time.QuadPart;
+
+    if (num_running_instances == 0) {
+      break;
+    }
+
+    /* Sample on a fixed schedule, skipping samples if falling behind. */
+    next_sample_milliseconds += monitor->interval_milliseconds;
+
+    elapsed_milliseconds = GetTickCount() - start_tick_count;
+    wait_milliseconds = 0;
+    if (next_sample_milliseconds > elapsed_milliseconds) {
+      wait_milliseconds = next_sample_milliseconds - elapsed_milliseconds;
+    } else {
+      next_sample_milliseconds = elapsed_milliseconds;
+    }
+
+    if (WaitForSingleObject(stop_event, wait_milliseconds)
+        == WAIT_OBJECT_0) {
+      is_stopped = 1;
+      break;
+    }
+  }
+
+  elapsed_milliseconds = GetTickCount() - start_tick_count;
+  sampling_microseconds = (unsigned long) (
+      sampling_ticks * 1000000 / performance_frequency.QuadPart);
+
+  wprintf(
+      L"%ls Sampling took %lu us over %lu ms",
+      is_stopped
+          ? L"Monitoring was stopped."
+          : L"All instances have exited.",
+      sampling_microseconds,
+      elapsed_milliseconds);
+
+  if (elapsed_milliseconds > 0) {
+    /* Microseconds * 10 / milliseconds is a percentage times 100. */
+    overhead_percent_x100 = (unsigned long) (
+        (ULONGLONG) sampling_microseconds * 10 / elapsed_milliseconds);
+
+    wprintf(
+        L" (%lu.%02lu%% of one core)",
+        overhead_percent_x100 / 100,
+        overhead_percent_x100 % 100);
+  }
+
+  wprintf(L".\n\n");
+}
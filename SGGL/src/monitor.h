@@ -0,0 +1,110 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_MONITOR_H_
+#define SGGL_MONITOR_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum {
+  Monitor_kDefaultIntervalMilliseconds = 1000,
+
+  /* Samples held per instance before they are written out. */
+  Monitor_kRingCapacity = 256
+};
+
+struct MonitorSample {
+  DWORD elapsed_milliseconds;
+  ULONGLONG cpu_time;
+  DWORD cpu_percent_x100;
+  SIZE_T working_set_size;
+  SIZE_T commit_size;
+  ULONGLONG read_bytes;
+  ULONGLONG write_bytes;
+  DWORD handle_count;
+};
+
+/**
+ * Fixed-size history of one instance's samples. When full, the oldest
+ * sample is overwritten.
+ */
+struct MonitorRing {
+  size_t first;
+  size_t count;
+  struct MonitorSample samples[Monitor_kRingCapacity];
+
+  int is_exited;
+  ULONGLONG last_cpu_time;
+  DWORD last_elapsed_milliseconds;
+};
+
+struct Monitor {
+  FILE* csv_file;
+  DWORD interval_milliseconds;
+
+  const PROCESS_INFORMATION* processes_infos;
+  size_t num_instances;
+  struct MonitorRing* rings;
+};
+
+/**
+ * Creates the CSV file and one ring per instance. Returns NULL on
+ * failure.
+ */
+struct Monitor* Monitor_Init(
+    struct Monitor* monitor,
+    const wchar_t* csv_path,
+    DWORD interval_milliseconds,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_instances);
+
+/**
+ * Writes out any remaining samples and closes the CSV file.
+ */
+void Monitor_Deinit(struct Monitor* monitor);
+
+/**
+ * Samples every instance at the interval until all of them have exited
+ * or the stop event is signaled, then prints the time spent sampling.
+ */
+void Monitor_Run(struct Monitor* monitor, HANDLE stop_event);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_MONITOR_H_ */
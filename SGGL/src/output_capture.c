@@ -0,0 +1,523 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "output_capture.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+#include <shlwapi.h>
+
+#include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+#include <mdc/wchar_t/filew.h>
+
+#ifndef INVALID_SET_FILE_POINTER
+#define INVALID_SET_FILE_POINTER ((DWORD) 0xFFFFFFFF)
+#endif /* INVALID_SET_FILE_POINTER */
+
+enum {
+  kPipeNameLength = 64,
+  kLogPathLength = MAX_PATH + 16,
+
+  /* Posted by Deinit, since every instance's key is its address. */
+  kStopCompletionKey = 0
+};
+
+static void GetLogPath(
+    wchar_t* log_path,
+    const struct OutputCapture_Instance* instance,
+    unsigned int rotation) {
+  if (rotation == 0) {
+    _snwprintf(log_path, kLogPathLength, L"%ls.log", instance->log_base_path);
+  } else {
+    _snwprintf(
+        log_path,
+        kLogPathLength,
+        L"%ls.%u.log",
+        instance->log_base_path,
+        rotation);
+  }
+
+  log_path[kLogPathLength - 1] = L'\0';
+}
+
+static HANDLE OpenLog(
+    const struct OutputCapture_Instance* instance,
+    DWORD creation_disposition) {
+  wchar_t log_path[kLogPathLength];
+  HANDLE log_file;
+
+  GetLogPath(log_path, instance, 0);
+
+  log_file = CreateFileW(
+      log_path,
+      GENERIC_WRITE,
+      FILE_SHARE_READ,
+      NULL,
+      creation_disposition,
+      FILE_ATTRIBUTE_NORMAL,
+      NULL);
+  if (log_file == INVALID_HANDLE_VALUE) {
+    return NULL;
+  }
+
+  return log_file;
+}
+
+/**
+ * Moves the log to the first rotated log, shifting the older rotated
+ * logs up and deleting the oldest, then starts a new log.
+ */
+static void RotateLog(struct OutputCapture_Instance* instance) {
+  unsigned int rotation;
+  wchar_t old_path[kLogPathLength];
+  wchar_t new_path[kLogPathLength];
+
+  CloseHandle(instance->log_file);
+
+  for (rotation = OutputCapture_kMaxRotatedLogs; rotation > 0; --rotation) {
+    GetLogPath(old_path, instance, rotation - 1);
+    GetLogPath(new_path, instance, rotation);
+
+    /* MoveFileExW cannot replace files on Windows 9x. */
+    DeleteFileW(new_path);
+    MoveFileW(old_path, new_path);
+  }
+
+  instance->log_file = OpenLog(instance, CREATE_ALWAYS);
+  instance->log_size = 0;
+}
+
+static void WriteLog(
+    struct OutputCapture_Instance* instance,
+    DWORD num_bytes) {
+  DWORD num_bytes_written;
+
+  if (instance->log_size > 0
+      && num_bytes > OutputCapture_kMaxLogSize - instance->log_size) {
+    RotateLog(instance);
+  }
+
+  if (instance->log_file == NULL) {
+    return;
+  }
+
+  if (WriteFile(
+          instance->log_file,
+          instance->buffer,
+          num_bytes,
+          &num_bytes_written,
+          NULL)) {
+    instance->log_size += num_bytes_written;
+  }
+}
+
+static void ClosePipe(
+    struct OutputCapture* capture,
+    struct OutputCapture_Instance* instance) {
+  if (instance->pipe != NULL) {
+    CloseHandle(instance->pipe);
+    instance->pipe = NULL;
+  }
+
+  if (instance->log_file != NULL) {
+    CloseHandle(instance->log_file);
+    instance->log_file = NULL;
+  }
+
+  InterlockedDecrement(&capture->num_open_pipes);
+}
+
+/**
+ * Starts the next read of the pipe. Its completion is queued on the
+ * completion port, even if the read completes right away.
+ */
+static void IssueRead(
+    struct OutputCapture* capture,
+    struct OutputCapture_Instance* instance) {
+  BOOL is_read_success;
+
+  memset(&instance->overlapped, 0, sizeof(instance->overlapped));
+
+  is_read_success = ReadFile(
+      instance->pipe,
+      instance->buffer,
+      sizeof(instance->buffer),
+      NULL,
+      &instance->overlapped);
+  if (!is_read_success && GetLastError() != ERROR_IO_PENDING) {
+    ClosePipe(capture, instance);
+  }
+}
+
+/**
+ * Closes the pipes of the instances that still run. Their pending reads
+ * then complete with an error, which closes their logs.
+ */
+static void AbortPipes(struct OutputCapture* capture) {
+  size_t i;
+
+  for (i = 0; i < capture->num_instances; ++i) {
+    if (capture->instances[i].pipe == NULL) {
+      continue;
+    }
+
+    CloseHandle(capture->instances[i].pipe);
+    capture->instances[i].pipe = NULL;
+  }
+}
+
+static DWORD WINAPI DrainPipesThread(LPVOID parameter) {
+  struct OutputCapture* capture;
+  struct OutputCapture_Instance* instance;
+  BOOL is_dequeued;
+  DWORD num_bytes;
+  ULONG_PTR completion_key;
+  OVERLAPPED* overlapped;
+  int is_stopping;
+
+  capture = parameter;
+  is_stopping = 0;
+
+  for (;;) {
+    if (is_stopping && capture->num_open_pipes == 0) {
+      break;
+    }
+
+    is_dequeued = GetQueuedCompletionStatus(
+        capture->completion_port,
+        &num_bytes,
+        &completion_key,
+        &overlapped,
+        INFINITE);
+
+    if (overlapped == NULL) {
+      /* The port itself failed, so no more reads can complete. */
+      if (!is_dequeued) {
+        break;
+      }
+
+      if (completion_key == kStopCompletionKey) {
+        is_stopping = 1;
+        AbortPipes(capture);
+      }
+
+      continue;
+    }
+
+    /* The read fails with ERROR_BROKEN_PIPE once the instance exits. */
+    instance = (struct OutputCapture_Instance*) completion_key;
+    if (!is_dequeued || num_bytes == 0) {
+      ClosePipe(capture, instance);
+      continue;
+    }
+
+    WriteLog(instance, num_bytes);
+    IssueRead(capture, instance);
+  }
+
+  return 0;
+}
+
+/**
+ * External
+ */
+
+struct OutputCapture* OutputCapture_Init(
+    struct OutputCapture* capture,
+    const wchar_t* log_directory_path,
+    size_t num_instances) {
+  size_t i;
+  wchar_t log_directory[MAX_PATH];
+  wchar_t instance_name[16];
+  DWORD get_full_path_name_result;
+  SECURITY_ATTRIBUTES inheritable_attributes;
+  DWORD thread_id;
+
+  get_full_path_name_result = GetFullPathNameW(
+      log_directory_path,
+      MAX_PATH,
+      log_directory,
+      NULL);
+  if (get_full_path_name_result == 0
+      || get_full_path_name_result >= MAX_PATH) {
+    wprintf(
+        L"Output directory %ls could not be resolved.\n\n",
+        log_directory_path);
+    goto bad_return;
+  }
+
+  if (!CreateDirectoryW(log_directory, NULL)
+      && GetLastError() != ERROR_ALREADY_EXISTS) {
+    wprintf(L"CreateDirectoryW failed, error 0x%lX.\n\n", GetLastError());
+    goto bad_return;
+  }
+
+  capture->instances = Mdc_malloc(
+      num_instances * sizeof(capture->instances[0]));
+  if (capture->instances == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_return;
+  }
+
+  capture->num_instances = num_instances;
+  capture->num_open_pipes = 0;
+
+  for (i = 0; i < num_instances; ++i) {
+    capture->instances[i].pipe = NULL;
+    capture->instances[i].log_file = NULL;
+    capture->instances[i].log_size = 0;
+
+    _snwprintf(instance_name, 16, L"%u", i);
+    instance_name[15] = L'\0';
+
+    if (PathCombineW(
+            capture->instances[i].log_base_path,
+            log_directory,
+            instance_name) == NULL) {
+      wprintf(L"Output directory %ls is too long.\n\n", log_directory);
+      goto bad_free_instances;
+    }
+  }
+
+  /* Every instance reads its standard input from NUL. */
+  inheritable_attributes.nLength = sizeof(inheritable_attributes);
+  inheritable_attributes.lpSecurityDescriptor = NULL;
+  inheritable_attributes.bInheritHandle = TRUE;
+
+  capture->null_input = CreateFileW(
+      L"NUL",
+      GENERIC_READ,
+      FILE_SHARE_READ | FILE_SHARE_WRITE,
+      &inheritable_attributes,
+      OPEN_EXISTING,
+      0,
+      NULL);
+  if (capture->null_input == INVALID_HANDLE_VALUE) {
+    goto bad_free_instances;
+  }
+
+  /* Completion ports are not supported on Windows 9x. */
+  capture->completion_port = CreateIoCompletionPort(
+      INVALID_HANDLE_VALUE,
+      NULL,
+      0,
+      1);
+  if (capture->completion_port == NULL) {
+    wprintf(L"Output capture is not supported on this system.\n\n");
+    goto bad_close_null_input;
+  }
+
+  capture->thread = CreateThread(
+      NULL,
+      0,
+      &DrainPipesThread,
+      capture,
+      0,
+      &thread_id);
+  if (capture->thread == NULL) {
+    wprintf(L"CreateThread failed, error 0x%lX.\n\n", GetLastError());
+    goto bad_close_completion_port;
+  }
+
+  wprintf(L"Capturing output of the instances into %ls\n\n", log_directory);
+
+  return capture;
+
+bad_close_completion_port:
+  CloseHandle(capture->completion_port);
+
+bad_close_null_input:
+  CloseHandle(capture->null_input);
+
+bad_free_instances:
+  Mdc_free(capture->instances);
+
+bad_return:
+  return NULL;
+}
+
+void OutputCapture_Deinit(struct OutputCapture* capture) {
+  /* The thread stops once the reads of every pipe have completed. */
+  PostQueuedCompletionStatus(
+      capture->completion_port,
+      0,
+      kStopCompletionKey,
+      NULL);
+
+  WaitForSingleObject(capture->thread, INFINITE);
+  CloseHandle(capture->thread);
+
+  CloseHandle(capture->completion_port);
+  CloseHandle(capture->null_input);
+
+  Mdc_free(capture->instances);
+  capture->instances = NULL;
+  capture->num_instances = 0;
+}
+
+size_t OutputCapture_OpenInstance(
+    struct OutputCapture* capture,
+    size_t instance_number,
+    STARTUPINFOW* startup_info,
+    HANDLE* inherited_handles) {
+  struct OutputCapture_Instance* instance;
+  wchar_t pipe_name[kPipeNameLength];
+  SECURITY_ATTRIBUTES inheritable_attributes;
+  HANDLE instance_output;
+
+  if (instance_number >= capture->num_instances) {
+    return 0;
+  }
+
+  instance = &capture->instances[instance_number];
+
+  /*
+   * Anonymous pipes cannot be read with overlapped I/O. Each launch runs
+   * on its own thread, so the thread ID keeps the names of concurrent
+   * launches apart.
+   */
+  _snwprintf(
+      pipe_name,
+      kPipeNameLength,
+      L"\\\\.\\pipe\\SGGL.Output.%lu.%lu.%u",
+      GetCurrentProcessId(),
+      GetCurrentThreadId(),
+      instance_number);
+  pipe_name[kPipeNameLength - 1] = L'\0';
+
+  instance->pipe = CreateNamedPipeW(
+      pipe_name,
+      PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED,
+      PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+      1,
+      0,
+      OutputCapture_kReadBufferSize,
+      0,
+      NULL);
+  if (instance->pipe == INVALID_HANDLE_VALUE) {
+    goto bad_return;
+  }
+
+  /* The instance's end is connected before the instance exists. */
+  inheritable_attributes.nLength = sizeof(inheritable_attributes);
+  inheritable_attributes.lpSecurityDescriptor = NULL;
+  inheritable_attributes.bInheritHandle = TRUE;
+
+  instance_output = CreateFileW(
+      pipe_name,
+      GENERIC_WRITE,
+      0,
+      &inheritable_attributes,
+      OPEN_EXISTING,
+      0,
+      NULL);
+  if (instance_output == INVALID_HANDLE_VALUE) {
+    goto bad_close_pipe;
+  }
+
+  if (CreateIoCompletionPort(
+          instance->pipe,
+          capture->completion_port,
+          (ULONG_PTR) instance,
+          0) == NULL) {
+    goto bad_close_instance_output;
+  }
+
+  startup_info->dwFlags |= STARTF_USESTDHANDLES;
+  startup_info->hStdInput = capture->null_input;
+  startup_info->hStdOutput = instance_output;
+  startup_info->hStdError = instance_output;
+
+  inherited_handles[0] = capture->null_input;
+  inherited_handles[1] = instance_output;
+
+  return 2;
+
+bad_close_instance_output:
+  CloseHandle(instance_output);
+
+bad_close_pipe:
+  CloseHandle(instance->pipe);
+
+bad_return:
+  instance->pipe = NULL;
+
+  wprintf(
+      L"Output of instance %u could not be captured, error 0x%lX.\n",
+      instance_number,
+      GetLastError());
+
+  return 0;
+}
+
+void OutputCapture_StartInstance(
+    struct OutputCapture* capture,
+    size_t instance_number,
+    const STARTUPINFOW* startup_info,
+    int is_created) {
+  struct OutputCapture_Instance* instance;
+
+  if (instance_number >= capture->num_instances) {
+    return;
+  }
+
+  instance = &capture->instances[instance_number];
+  if (instance->pipe == NULL) {
+    return;
+  }
+
+  /* Only the instance holds its end now, so the pipe breaks on exit. */
+  CloseHandle(startup_info->hStdOutput);
+
+  if (!is_created) {
+    CloseHandle(instance->pipe);
+    instance->pipe = NULL;
+    return;
+  }
+
+  /* Logs from earlier launches are appended to, and rotated as usual. */
+  instance->log_file = OpenLog(instance, OPEN_ALWAYS);
+  if (instance->log_file != NULL) {
+    instance->log_size = SetFilePointer(
+        instance->log_file,
+        0,
+        NULL,
+        FILE_END);
+    if (instance->log_size == INVALID_SET_FILE_POINTER) {
+      instance->log_size = 0;
+    }
+  }
+
+  InterlockedIncrement(&capture->num_open_pipes);
+  IssueRead(capture, instance);
+}
@@ -0,0 +1,129 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_OUTPUT_CAPTURE_H_
+#define SGGL_OUTPUT_CAPTURE_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum {
+  OutputCapture_kReadBufferSize = 4096,
+
+  /* A log is rotated once it would grow past this size. */
+  OutputCapture_kMaxLogSize = 8 * 1024 * 1024,
+
+  /* Rotated logs beyond this count are deleted. */
+  OutputCapture_kMaxRotatedLogs = 3
+};
+
+/**
+ * The pipe that one instance writes its standard output and error into,
+ * and the log that the pipe is drained into.
+ */
+struct OutputCapture_Instance {
+  OVERLAPPED overlapped;
+  HANDLE pipe;
+  HANDLE log_file;
+  DWORD log_size;
+
+  /* The log's path without the .log extension. */
+  wchar_t log_base_path[MAX_PATH];
+  char buffer[OutputCapture_kReadBufferSize];
+};
+
+/**
+ * Captures the standard output and error of every instance through
+ * overlapped named pipes. A single thread drains every pipe through an
+ * I/O completion port, so that the cost stays flat as instances are
+ * added.
+ */
+struct OutputCapture {
+  HANDLE completion_port;
+  HANDLE thread;
+  HANDLE null_input;
+
+  struct OutputCapture_Instance* instances;
+  size_t num_instances;
+
+  /* Only changed with interlocked operations. */
+  LONG num_open_pipes;
+};
+
+/**
+ * Creates the log directory, the completion port and the thread that
+ * drains the pipes. Returns NULL if capture is not supported, as on
+ * Windows 9x, or could not be started.
+ */
+struct OutputCapture* OutputCapture_Init(
+    struct OutputCapture* capture,
+    const wchar_t* log_directory_path,
+    size_t num_instances);
+
+/**
+ * Stops capturing, then stops the thread and closes the logs. The output
+ * of instances that still run is no longer captured.
+ */
+void OutputCapture_Deinit(struct OutputCapture* capture);
+
+/**
+ * Creates the instance's pipe and sets the standard handles of the
+ * startup info to inheritable handles, which are written to
+ * inherited_handles. The instance's standard input reads from NUL.
+ * Returns the number of inherited handles, or zero on failure, in which
+ * case the instance is created without capture.
+ */
+size_t OutputCapture_OpenInstance(
+    struct OutputCapture* capture,
+    size_t instance_number,
+    STARTUPINFOW* startup_info,
+    HANDLE* inherited_handles);
+
+/**
+ * Closes this process' copy of the instance's end of the pipe, and
+ * starts draining the pipe if the instance was created. Otherwise, the
+ * pipe is closed.
+ */
+void OutputCapture_StartInstance(
+    struct OutputCapture* capture,
+    size_t instance_number,
+    const STARTUPINFOW* startup_info,
+    int is_created);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_OUTPUT_CAPTURE_H_ */
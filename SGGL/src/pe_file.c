@@ -0,0 +1,303 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "pe_file.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <windows.h>
+
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+
+#ifndef INVALID_FILE_SIZE
+#define INVALID_FILE_SIZE ((DWORD) 0xFFFFFFFF)
+#endif /* INVALID_FILE_SIZE */
+
+enum {
+  kOptionalHeader32Magic = 0x10B,
+  kOptionalHeader64Magic = 0x20B,
+  kOptionalHeaderCheckSumOffset = 64,
+  kOptionalHeader32NumRvaAndSizesOffset = 92,
+  kOptionalHeader64NumRvaAndSizesOffset = 108
+};
+
+/**
+ * Returns a pointer to the file bytes that an image maps at the RVA, or
+ * NULL if the whole range is not backed by a single section.
+ */
+static const BYTE* RvaToFilePointer(
+    const BYTE* view,
+    DWORD view_size,
+    const IMAGE_SECTION_HEADER* sections,
+    WORD num_sections,
+    DWORD rva,
+    DWORD size) {
+  WORD i_section;
+  DWORD section_offset;
+  DWORD file_offset;
+
+  for (i_section = 0; i_section < num_sections; ++i_section) {
+    if (rva < sections[i_section].VirtualAddress) {
+      continue;
+    }
+
+    section_offset = rva - sections[i_section].VirtualAddress;
+    if (section_offset >= sections[i_section].SizeOfRawData
+        || sections[i_section].SizeOfRawData - section_offset < size) {
+      continue;
+    }
+
+    file_offset = sections[i_section].PointerToRawData + section_offset;
+    if (file_offset < sections[i_section].PointerToRawData
+        || file_offset > view_size
+        || view_size - file_offset < size) {
+      return NULL;
+    }
+
+    return &view[file_offset];
+  }
+
+  return NULL;
+}
+
+/**
+ * External
+ */
+
+struct PeFile_ExportData* PeFile_ExportData_Init(
+    struct PeFile_ExportData* export_data,
+    const wchar_t* path) {
+  HANDLE file;
+  HANDLE mapping;
+  const BYTE* view;
+  DWORD view_size;
+  const IMAGE_DOS_HEADER* dos_header;
+  const IMAGE_FILE_HEADER* file_header;
+  const BYTE* optional_header;
+  WORD magic;
+  DWORD num_rva_and_sizes_offset;
+  DWORD num_rva_and_sizes;
+  const IMAGE_DATA_DIRECTORY* data_directories;
+  const IMAGE_SECTION_HEADER* sections;
+  const BYTE* export_bytes;
+
+  file = CreateFileW(
+      path,
+      GENERIC_READ,
+      FILE_SHARE_READ,
+      NULL,
+      OPEN_EXISTING,
+      0,
+      NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    goto bad_return;
+  }
+
+  view_size = GetFileSize(file, NULL);
+  if (view_size == INVALID_FILE_SIZE
+      || view_size < sizeof(IMAGE_DOS_HEADER)) {
+    goto bad_close_file;
+  }
+
+  mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL) {
+    goto bad_close_file;
+  }
+
+  view = (const BYTE*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == NULL) {
+    goto bad_close_mapping;
+  }
+
+  /* Locate the headers, checking that each lies within the file. */
+  dos_header = (const IMAGE_DOS_HEADER*) view;
+  if (dos_header->e_magic != IMAGE_DOS_SIGNATURE
+      || dos_header->e_lfanew < 0
+      || (DWORD) dos_header->e_lfanew > view_size
+      || view_size - dos_header->e_lfanew
+          < sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER) + sizeof(WORD)
+      || *(const DWORD*) &view[dos_header->e_lfanew]
+          != IMAGE_NT_SIGNATURE) {
+    goto bad_unmap_view;
+  }
+
+  file_header = (const IMAGE_FILE_HEADER*)
+      &view[dos_header->e_lfanew + sizeof(DWORD)];
+  optional_header = (const BYTE*) (file_header + 1);
+
+  if ((DWORD) (optional_header - view) + file_header->SizeOfOptionalHeader
+      + file_header->NumberOfSections * sizeof(IMAGE_SECTION_HEADER)
+      > view_size) {
+    goto bad_unmap_view;
+  }
+
+  /*
+   * The loader's own IMAGE_NT_HEADERS only describe its own bitness, so
+   * the optional header is read by offset.
+   */
+  magic = *(const WORD*) optional_header;
+  if (magic == kOptionalHeader32Magic) {
+    num_rva_and_sizes_offset = kOptionalHeader32NumRvaAndSizesOffset;
+  } else if (magic == kOptionalHeader64Magic) {
+    num_rva_and_sizes_offset = kOptionalHeader64NumRvaAndSizesOffset;
+  } else {
+    goto bad_unmap_view;
+  }
+
+  if (file_header->SizeOfOptionalHeader
+      < num_rva_and_sizes_offset + sizeof(DWORD)
+          + (IMAGE_DIRECTORY_ENTRY_EXPORT + 1)
+              * sizeof(IMAGE_DATA_DIRECTORY)) {
+    goto bad_unmap_view;
+  }
+
+  num_rva_and_sizes =
+      *(const DWORD*) &optional_header[num_rva_and_sizes_offset];
+  data_directories = (const IMAGE_DATA_DIRECTORY*)
+      &optional_header[num_rva_and_sizes_offset + sizeof(DWORD)];
+
+  if (num_rva_and_sizes <= IMAGE_DIRECTORY_ENTRY_EXPORT) {
+    goto bad_unmap_view;
+  }
+
+  export_data->checksum =
+      *(const DWORD*) &optional_header[kOptionalHeaderCheckSumOffset];
+  export_data->export_rva =
+      data_directories[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress;
+  export_data->export_size =
+      data_directories[IMAGE_DIRECTORY_ENTRY_EXPORT].Size;
+
+  if (export_data->export_rva == 0
+      || export_data->export_size < sizeof(IMAGE_EXPORT_DIRECTORY)) {
+    goto bad_unmap_view;
+  }
+
+  sections = (const IMAGE_SECTION_HEADER*)
+      &optional_header[file_header->SizeOfOptionalHeader];
+
+  export_bytes = RvaToFilePointer(
+      view,
+      view_size,
+      sections,
+      file_header->NumberOfSections,
+      export_data->export_rva,
+      export_data->export_size);
+  if (export_bytes == NULL) {
+    goto bad_unmap_view;
+  }
+
+  /* Copy the data, so that the file does not stay mapped. */
+  export_data->data = Mdc_malloc(export_data->export_size);
+  if (export_data->data == NULL) {
+    goto bad_unmap_view;
+  }
+
+  memcpy(export_data->data, export_bytes, export_data->export_size);
+
+  UnmapViewOfFile(view);
+  CloseHandle(mapping);
+  CloseHandle(file);
+
+  return export_data;
+
+bad_unmap_view:
+  UnmapViewOfFile(view);
+
+bad_close_mapping:
+  CloseHandle(mapping);
+
+bad_close_file:
+  CloseHandle(file);
+
+bad_return:
+  return NULL;
+}
+
+void PeFile_ExportData_Deinit(struct PeFile_ExportData* export_data) {
+  Mdc_free(export_data->data);
+
+  export_data->data = NULL;
+  export_data->export_size = 0;
+  export_data->export_rva = 0;
+  export_data->checksum = 0;
+}
+
+const void* PeFile_ExportData_Get(
+    const struct PeFile_ExportData* export_data,
+    DWORD rva,
+    DWORD size) {
+  if (rva < export_data->export_rva) {
+    return NULL;
+  }
+
+  if (rva - export_data->export_rva > export_data->export_size
+      || size > export_data->export_size
+          - (rva - export_data->export_rva)) {
+    return NULL;
+  }
+
+  return &export_data->data[rva - export_data->export_rva];
+}
+
+int PeFile_ExportData_GetFirstOrdinal(
+    const struct PeFile_ExportData* export_data,
+    WORD* ordinal) {
+  const IMAGE_EXPORT_DIRECTORY* directory;
+  const DWORD* function_rvas;
+  DWORD i_function;
+
+  directory = PeFile_ExportData_Get(
+      export_data,
+      export_data->export_rva,
+      sizeof(*directory));
+  if (directory == NULL || directory->NumberOfFunctions > 0xFFFF) {
+    return 0;
+  }
+
+  function_rvas = PeFile_ExportData_Get(
+      export_data,
+      directory->AddressOfFunctions,
+      directory->NumberOfFunctions * sizeof(function_rvas[0]));
+  if (function_rvas == NULL) {
+    return 0;
+  }
+
+  /* Unused ordinals within the range have a zero RVA. */
+  for (i_function = 0;
+      i_function < directory->NumberOfFunctions;
+      ++i_function) {
+    if (function_rvas[i_function] != 0) {
+      *ordinal = (WORD) (directory->Base + i_function);
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,88 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_PE_FILE_H_
+#define SGGL_PE_FILE_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * A copy of an image's export data directory, read from the image file
+ * rather than from a process that maps it. RVAs in the directory are
+ * relative to the image base, as in a mapped image, so the data can be
+ * walked in the same way.
+ */
+struct PeFile_ExportData {
+  DWORD checksum;
+
+  DWORD export_rva;
+  DWORD export_size;
+  BYTE* data;
+};
+
+/**
+ * Reads the export data directory of the image file. Works for both
+ * PE32 and PE32+ images, regardless of the loader's bitness. Returns
+ * NULL if the file is not an image or has no exports.
+ */
+struct PeFile_ExportData* PeFile_ExportData_Init(
+    struct PeFile_ExportData* export_data,
+    const wchar_t* path);
+
+void PeFile_ExportData_Deinit(struct PeFile_ExportData* export_data);
+
+/**
+ * Returns a pointer to size bytes at the RVA, or NULL if they are not
+ * within the export data directory.
+ */
+const void* PeFile_ExportData_Get(
+    const struct PeFile_ExportData* export_data,
+    DWORD rva,
+    DWORD size);
+
+/**
+ * Gets the lowest ordinal of the exported functions. Returns zero if
+ * nothing is exported.
+ */
+int PeFile_ExportData_GetFirstOrdinal(
+    const struct PeFile_ExportData* export_data,
+    WORD* ordinal);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_PE_FILE_H_ */
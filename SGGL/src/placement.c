@@ -0,0 +1,687 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "placement.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <windows.h>
+
+#include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+#include <mdc/wchar_t/filew.h>
+
+#include "platform.h"
+
+enum {
+  /* An affinity mask covers one processor group. */
+  kMaxProcessors = sizeof(ULONG_PTR) * 8,
+
+  kRelationProcessorCore = 0,
+  kRelationNumaNode = 1,
+  kRelationAll = 0xFFFF,
+
+  /* Longest list is "0,2,4,...", at most 4 characters per processor. */
+  kProcessorListLength = kMaxProcessors * 4 + 1
+};
+
+/*
+ * Mirrors of the Windows 7 topology structures, which are not in older
+ * Windows headers.
+ */
+struct GroupAffinity {
+  ULONG_PTR mask;
+  WORD group;
+  WORD reserved[3];
+};
+
+struct ProcessorRelationship {
+  BYTE flags;
+  BYTE efficiency_class;
+  BYTE reserved[20];
+  WORD group_count;
+  struct GroupAffinity group_masks[1];
+};
+
+struct NumaNodeRelationship {
+  DWORD node_number;
+  BYTE reserved[18];
+  WORD group_count;
+  struct GroupAffinity group_mask;
+};
+
+struct LogicalProcessorInformationEx {
+  DWORD relationship;
+  DWORD size;
+  union {
+    struct ProcessorRelationship processor;
+    struct NumaNodeRelationship numa_node;
+  } u;
+};
+
+typedef BOOL WINAPI GetLogicalProcessorInformationExFuncType(
+    DWORD, struct LogicalProcessorInformationEx*, DWORD*);
+typedef BOOL WINAPI GetThreadGroupAffinityFuncType(
+    HANDLE, struct GroupAffinity*);
+
+/**
+ * Physical cores usable by the loader, in topology order. Each core's
+ * mask includes its SMT siblings.
+ */
+struct Topology {
+  size_t num_cores;
+  ULONG_PTR core_masks[kMaxProcessors];
+  DWORD core_nodes[kMaxProcessors];
+
+  size_t num_nodes;
+  DWORD nodes[kMaxProcessors];
+};
+
+static void* GetKernel32ProcAddress(const char* proc_name) {
+  return GetProcAddress(GetModuleHandleW(L"kernel32.dll"), proc_name);
+}
+
+static WORD GetCurrentGroup(void) {
+  GetThreadGroupAffinityFuncType* get_thread_group_affinity_func;
+  struct GroupAffinity group_affinity;
+
+  /* Systems before Windows 7 only have one processor group. */
+  get_thread_group_affinity_func =
+      (GetThreadGroupAffinityFuncType*) GetKernel32ProcAddress(
+          "GetThreadGroupAffinity");
+  if (get_thread_group_affinity_func == NULL) {
+    return 0;
+  }
+
+  if (!get_thread_group_affinity_func(GetCurrentThread(), &group_affinity)) {
+    return 0;
+  }
+
+  return group_affinity.group;
+}
+
+static void Topology_AddCore(
+    struct Topology* topology,
+    ULONG_PTR core_mask,
+    DWORD node) {
+  size_t i_node;
+
+  topology->core_masks[topology->num_cores] = core_mask;
+  topology->core_nodes[topology->num_cores] = node;
+  topology->num_cores += 1;
+
+  for (i_node = 0; i_node < topology->num_nodes; ++i_node) {
+    if (topology->nodes[i_node] == node) {
+      return;
+    }
+  }
+
+  topology->nodes[topology->num_nodes] = node;
+  topology->num_nodes += 1;
+}
+
+/**
+ * Treats every usable processor as its own core on node 0, for systems
+ * that cannot report their topology.
+ */
+static void Topology_InitFromMask(
+    struct Topology* topology,
+    ULONG_PTR usable_mask) {
+  size_t i_processor;
+
+  for (i_processor = 0; i_processor < kMaxProcessors; ++i_processor) {
+    ULONG_PTR processor_mask;
+
+    processor_mask = (ULONG_PTR) 1 << i_processor;
+    if ((usable_mask & processor_mask) != 0) {
+      Topology_AddCore(topology, processor_mask, 0);
+    }
+  }
+}
+
+static int Topology_Init(struct Topology* topology) {
+  GetLogicalProcessorInformationExFuncType*
+      get_logical_processor_information_ex_func;
+  struct LogicalProcessorInformationEx* infos;
+  DWORD infos_size;
+  DWORD offset;
+  ULONG_PTR process_mask;
+  ULONG_PTR system_mask;
+  WORD group;
+
+  ULONG_PTR node_masks[kMaxProcessors];
+  DWORD node_numbers[kMaxProcessors];
+  size_t num_node_masks;
+  size_t i_node_mask;
+
+  topology->num_cores = 0;
+  topology->num_nodes = 0;
+
+  if (!GetProcessAffinityMask(
+      GetCurrentProcess(),
+      &process_mask,
+      &system_mask)) {
+    return 0;
+  }
+
+  get_logical_processor_information_ex_func =
+      (GetLogicalProcessorInformationExFuncType*) GetKernel32ProcAddress(
+          "GetLogicalProcessorInformationEx");
+  if (get_logical_processor_information_ex_func == NULL) {
+    Topology_InitFromMask(topology, process_mask);
+    return topology->num_cores > 0;
+  }
+
+  infos_size = 0;
+  get_logical_processor_information_ex_func(
+      kRelationAll,
+      NULL,
+      &infos_size);
+  if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+    Topology_InitFromMask(topology, process_mask);
+    return topology->num_cores > 0;
+  }
+
+  infos = Mdc_malloc(infos_size);
+  if (infos == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    return 0;
+  }
+
+  if (!get_logical_processor_information_ex_func(
+      kRelationAll,
+      infos,
+      &infos_size)) {
+    Mdc_free(infos);
+
+    Topology_InitFromMask(topology, process_mask);
+    return topology->num_cores > 0;
+  }
+
+  group = GetCurrentGroup();
+
+  /* Collect the NUMA nodes first, to label each core with its node. */
+  num_node_masks = 0;
+
+  for (offset = 0; offset < infos_size; ) {
+    const struct LogicalProcessorInformationEx* info;
+
+    info = (const struct LogicalProcessorInformationEx*) (
+        (const unsigned char*) infos + offset);
+
+    if (info->relationship == kRelationNumaNode
+        && info->u.numa_node.group_mask.group == group
+        && num_node_masks < kMaxProcessors) {
+      node_masks[num_node_masks] = info->u.numa_node.group_mask.mask;
+      node_numbers[num_node_masks] = info->u.numa_node.node_number;
+      num_node_masks += 1;
+    }
+
+    offset += info->size;
+  }
+
+  for (offset = 0; offset < infos_size; ) {
+    const struct LogicalProcessorInformationEx* info;
+    ULONG_PTR core_mask;
+    DWORD node;
+
+    info = (const struct LogicalProcessorInformationEx*) (
+        (const unsigned char*) infos + offset);
+    offset += info->size;
+
+    if (info->relationship != kRelationProcessorCore
+        || info->u.processor.group_masks[0].group != group) {
+      continue;
+    }
+
+    core_mask = info->u.processor.group_masks[0].mask & process_mask;
+    if (core_mask == 0) {
+      continue;
+    }
+
+    node = 0;
+    for (i_node_mask = 0; i_node_mask < num_node_masks; ++i_node_mask) {
+      if ((node_masks[i_node_mask] & core_mask) != 0) {
+        node = node_numbers[i_node_mask];
+        break;
+      }
+    }
+
+    Topology_AddCore(topology, core_mask, node);
+  }
+
+  Mdc_free(infos);
+
+  return topology->num_cores > 0;
+}
+
+/**
+ * Leaves out the cores that other runs' instances are bound to. If
+ * fewer free cores than instances remain, the least loaded cores are
+ * kept instead. The kept cores stay in topology order.
+ */
+static void Topology_LeaveOutLoadedCores(
+    struct Topology* topology,
+    const DWORD* processor_loads,
+    size_t num_instances) {
+  DWORD core_loads[kMaxProcessors];
+  DWORD sorted_loads[kMaxProcessors];
+  struct Topology loaded_topology;
+  size_t num_kept_cores;
+  size_t num_at_max_load;
+  DWORD max_kept_load;
+  DWORD load;
+  size_t i_core;
+  size_t i_sorted;
+  size_t i_processor;
+
+  for (i_core = 0; i_core < topology->num_cores; ++i_core) {
+    core_loads[i_core] = 0;
+
+    for (i_processor = 0; i_processor < kMaxProcessors; ++i_processor) {
+      if (((topology->core_masks[i_core] >> i_processor) & 1) != 0) {
+        core_loads[i_core] += processor_loads[i_processor];
+      }
+    }
+
+    /* Insert the load into the sorted loads. */
+    load = core_loads[i_core];
+    for (i_sorted = i_core;
+        i_sorted > 0 && sorted_loads[i_sorted - 1] > load;
+        --i_sorted) {
+      sorted_loads[i_sorted] = sorted_loads[i_sorted - 1];
+    }
+    sorted_loads[i_sorted] = load;
+  }
+
+  num_kept_cores = 0;
+  while (num_kept_cores < topology->num_cores
+      && sorted_loads[num_kept_cores] == 0) {
+    num_kept_cores += 1;
+  }
+
+  if (num_kept_cores < num_instances) {
+    num_kept_cores = num_instances;
+  }
+
+  if (num_kept_cores >= topology->num_cores) {
+    return;
+  }
+
+  max_kept_load = sorted_loads[num_kept_cores - 1];
+  num_at_max_load = 0;
+  for (i_sorted = 0; i_sorted < num_kept_cores; ++i_sorted) {
+    if (sorted_loads[i_sorted] == max_kept_load) {
+      num_at_max_load += 1;
+    }
+  }
+
+  loaded_topology = *topology;
+  topology->num_cores = 0;
+  topology->num_nodes = 0;
+
+  for (i_core = 0; i_core < loaded_topology.num_cores; ++i_core) {
+    if (core_loads[i_core] > max_kept_load) {
+      continue;
+    }
+
+    if (core_loads[i_core] == max_kept_load) {
+      if (num_at_max_load == 0) {
+        continue;
+      }
+
+      num_at_max_load -= 1;
+    }
+
+    Topology_AddCore(
+        topology,
+        loaded_topology.core_masks[i_core],
+        loaded_topology.core_nodes[i_core]);
+  }
+}
+
+/**
+ * Lists the indices of the cores on the node, in topology order.
+ */
+static size_t Topology_GetNodeCores(
+    const struct Topology* topology,
+    DWORD node,
+    size_t* core_indices) {
+  size_t i_core;
+  size_t num_node_cores;
+
+  num_node_cores = 0;
+
+  for (i_core = 0; i_core < topology->num_cores; ++i_core) {
+    if (topology->core_nodes[i_core] == node) {
+      core_indices[num_node_cores] = i_core;
+      num_node_cores += 1;
+    }
+  }
+
+  return num_node_cores;
+}
+
+/**
+ * Divides the cores into contiguous blocks, one per instance. If there
+ * are more instances than cores, each instance receives one core and
+ * the cores are reused.
+ */
+static void GetCoreBlock(
+    size_t i_instance,
+    size_t num_instances,
+    size_t num_cores,
+    size_t* first_core,
+    size_t* end_core) {
+  if (num_instances >= num_cores) {
+    *first_core = i_instance % num_cores;
+    *end_core = *first_core + 1;
+    return;
+  }
+
+  *first_core = i_instance * num_cores / num_instances;
+  *end_core = (i_instance + 1) * num_cores / num_instances;
+}
+
+static void ComputeRoundRobin(
+    const struct Topology* topology,
+    size_t num_instances,
+    struct Placement* placements) {
+  size_t core_order[kMaxProcessors];
+  size_t node_cores[kMaxProcessors];
+  size_t num_ordered_cores;
+  size_t i_node;
+  size_t i_rank;
+  size_t i_core;
+  size_t i_instance;
+
+  /* Alternate between the nodes when ordering the cores. */
+  num_ordered_cores = 0;
+
+  for (i_rank = 0; num_ordered_cores < topology->num_cores; ++i_rank) {
+    for (i_node = 0; i_node < topology->num_nodes; ++i_node) {
+      size_t num_node_cores;
+
+      num_node_cores = Topology_GetNodeCores(
+          topology,
+          topology->nodes[i_node],
+          node_cores);
+      if (i_rank < num_node_cores) {
+        core_order[num_ordered_cores] = node_cores[i_rank];
+        num_ordered_cores += 1;
+      }
+    }
+  }
+
+  for (i_instance = 0; i_instance < num_instances; ++i_instance) {
+    placements[i_instance].affinity_mask = 0;
+
+    if (num_instances >= topology->num_cores) {
+      i_core = core_order[i_instance % topology->num_cores];
+      placements[i_instance].affinity_mask = topology->core_masks[i_core];
+      placements[i_instance].numa_node = topology->core_nodes[i_core];
+      continue;
+    }
+
+    /* Deal out the cores, like cards. */
+    for (i_rank = i_instance; i_rank < topology->num_cores;
+        i_rank += num_instances) {
+      i_core = core_order[i_rank];
+      placements[i_instance].affinity_mask |= topology->core_masks[i_core];
+    }
+
+    placements[i_instance].numa_node =
+        topology->core_nodes[core_order[i_instance]];
+  }
+}
+
+static void ComputePacked(
+    const struct Topology* topology,
+    size_t num_instances,
+    struct Placement* placements) {
+  size_t core_order[kMaxProcessors];
+  size_t num_ordered_cores;
+  size_t i_node;
+  size_t i_instance;
+  size_t i_core;
+  size_t first_core;
+  size_t end_core;
+
+  /* Keep the cores of each node next to each other. */
+  num_ordered_cores = 0;
+
+  for (i_node = 0; i_node < topology->num_nodes; ++i_node) {
+    num_ordered_cores += Topology_GetNodeCores(
+        topology,
+        topology->nodes[i_node],
+        &core_order[num_ordered_cores]);
+  }
+
+  for (i_instance = 0; i_instance < num_instances; ++i_instance) {
+    GetCoreBlock(
+        i_instance,
+        num_instances,
+        num_ordered_cores,
+        &first_core,
+        &end_core);
+
+    placements[i_instance].affinity_mask = 0;
+    for (i_core = first_core; i_core < end_core; ++i_core) {
+      placements[i_instance].affinity_mask |=
+          topology->core_masks[core_order[i_core]];
+    }
+
+    placements[i_instance].numa_node =
+        topology->core_nodes[core_order[first_core]];
+  }
+}
+
+static void ComputeNuma(
+    const struct Topology* topology,
+    size_t num_instances,
+    struct Placement* placements) {
+  size_t node_cores[kMaxProcessors];
+  size_t num_node_cores;
+  size_t num_node_instances;
+  size_t i_node;
+  size_t i_instance;
+  size_t i_core;
+  size_t first_core;
+  size_t end_core;
+
+  for (i_instance = 0; i_instance < num_instances; ++i_instance) {
+    /* Spread the instances across the nodes. */
+    i_node = i_instance % topology->num_nodes;
+    num_node_instances = (num_instances - i_node + topology->num_nodes - 1)
+        / topology->num_nodes;
+
+    num_node_cores = Topology_GetNodeCores(
+        topology,
+        topology->nodes[i_node],
+        node_cores);
+
+    /* Then divide the node's cores between its instances. */
+    GetCoreBlock(
+        i_instance / topology->num_nodes,
+        num_node_instances,
+        num_node_cores,
+        &first_core,
+        &end_core);
+
+    placements[i_instance].affinity_mask = 0;
+    for (i_core = first_core; i_core < end_core; ++i_core) {
+      placements[i_instance].affinity_mask |=
+          topology->core_masks[node_cores[i_core]];
+    }
+
+    placements[i_instance].numa_node = topology->nodes[i_node];
+  }
+}
+
+/**
+ * Formats the mask as a list of processor numbers and ranges, such as
+ * "0-3,8-11".
+ */
+static void FormatProcessorList(wchar_t* list, ULONG_PTR mask) {
+  size_t i_processor;
+  size_t range_start;
+  size_t length;
+
+  list[0] = L'\0';
+  length = 0;
+
+  for (i_processor = 0; i_processor < kMaxProcessors; ++i_processor) {
+    if (((mask >> i_processor) & 1) == 0) {
+      continue;
+    }
+
+    range_start = i_processor;
+    while (i_processor + 1 < kMaxProcessors
+        && ((mask >> (i_processor + 1)) & 1) != 0) {
+      i_processor += 1;
+    }
+
+    length += _snwprintf(
+        &list[length],
+        kProcessorListLength - length,
+        (range_start == i_processor) ? L"%ls%u" : L"%ls%u-%u",
+        (length > 0) ? L"," : L"",
+        range_start,
+        i_processor);
+  }
+}
+
+/**
+ * External
+ */
+
+int Placement_Compute(
+    enum Placement_Policy policy,
+    size_t num_instances,
+    const DWORD* processor_loads,
+    struct Placement* placements) {
+  struct Topology topology;
+  size_t num_usable_cores;
+
+  if (policy == Placement_kPolicy_None || num_instances == 0) {
+    return 0;
+  }
+
+  if (!Topology_Init(&topology)) {
+    wprintf(L"Processor topology could not be determined.\n\n");
+    return 0;
+  }
+
+  if (processor_loads != NULL) {
+    num_usable_cores = topology.num_cores;
+    Topology_LeaveOutLoadedCores(&topology, processor_loads, num_instances);
+
+    if (topology.num_cores < num_usable_cores) {
+      wprintf(
+          L"Leaving out %u core(s) used by the instances of other "
+              L"runs.\n\n",
+          num_usable_cores - topology.num_cores);
+    }
+  }
+
+  switch (policy) {
+    case Placement_kPolicy_RoundRobin: {
+      ComputeRoundRobin(&topology, num_instances, placements);
+      break;
+    }
+
+    case Placement_kPolicy_Packed: {
+      ComputePacked(&topology, num_instances, placements);
+      break;
+    }
+
+    case Placement_kPolicy_Numa: {
+      ComputeNuma(&topology, num_instances, placements);
+      break;
+    }
+
+    default: {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+int Placement_ApplyToProcess(
+    const struct Placement* placement,
+    const PROCESS_INFORMATION* process_info,
+    size_t instance_index) {
+  BOOL is_set_affinity_success;
+  wchar_t processor_list[kProcessorListLength];
+
+  is_set_affinity_success = Platform_SetProcessAffinityMask(
+      process_info->hProcess,
+      placement->affinity_mask);
+
+  FormatProcessorList(processor_list, placement->affinity_mask);
+
+  if (!is_set_affinity_success) {
+    wprintf(
+        L"Instance %u could not be placed on processors %ls\n",
+        instance_index,
+        processor_list);
+    return 0;
+  }
+
+  wprintf(
+      L"Instance %u placed on NUMA node %lu, processors %ls\n",
+      instance_index,
+      placement->numa_node,
+      processor_list);
+
+  return 1;
+}
+
+int Placement_ApplyToProcesses(
+    const struct Placement* placements,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_instances) {
+  size_t i_instance;
+  int is_all_success;
+
+  is_all_success = 1;
+
+  for (i_instance = 0; i_instance < num_instances; ++i_instance) {
+    is_all_success = Placement_ApplyToProcess(
+        &placements[i_instance],
+        &processes_infos[i_instance],
+        i_instance) && is_all_success;
+  }
+
+  wprintf(L"\n");
+
+  return is_all_success;
+}
@@ -0,0 +1,101 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_PLACEMENT_H_
+#define SGGL_PLACEMENT_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Policies for assigning game instances to processor cores. Cores are
+ * the physical cores in the loader's processor group, each including
+ * its SMT siblings.
+ *
+ * - None: Instances inherit the loader's affinity.
+ * - RoundRobin: Cores are dealt out one at a time, alternating between
+ *   NUMA nodes, so that each instance's cores are spread out.
+ * - Packed: Each instance receives a contiguous block of cores, which
+ *   share caches with each other.
+ * - Numa: Instances are spread across NUMA nodes, and each instance
+ *   receives a block of cores from a single node.
+ */
+enum Placement_Policy {
+  Placement_kPolicy_None,
+  Placement_kPolicy_RoundRobin,
+  Placement_kPolicy_Packed,
+  Placement_kPolicy_Numa
+};
+
+struct Placement {
+  ULONG_PTR affinity_mask;
+  DWORD numa_node;
+};
+
+/**
+ * Computes the placement of each instance from the processor topology.
+ * If the processor loads are not NULL, they count the instances of
+ * other runs bound to each processor, and the loaded cores are avoided.
+ * Returns zero if the policy is None or the topology is unavailable.
+ */
+int Placement_Compute(
+    enum Placement_Policy policy,
+    size_t num_instances,
+    const DWORD* processor_loads,
+    struct Placement* placements);
+
+/**
+ * Sets the affinity of one suspended process and reports its
+ * placement. Returns nonzero on success.
+ */
+int Placement_ApplyToProcess(
+    const struct Placement* placement,
+    const PROCESS_INFORMATION* process_info,
+    size_t instance_index);
+
+/**
+ * Sets the affinity of each suspended process and reports the
+ * placement. Returns nonzero if every process was placed.
+ */
+int Placement_ApplyToProcesses(
+    const struct Placement* placements,
+    const PROCESS_INFORMATION* processes_infos,
+    size_t num_instances);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_PLACEMENT_H_ */
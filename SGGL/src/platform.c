@@ -0,0 +1,1266 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "platform.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+#include <tlhelp32.h>
+
+#include <mdc/std/wchar.h>
+
+enum CallId {
+  kCallId_CreateProcessW = 1,
+  kCallId_OpenProcess,
+  kCallId_IsWow64Process,
+  kCallId_VirtualAllocEx,
+  kCallId_VirtualFreeEx,
+  kCallId_ReadProcessMemory,
+  kCallId_WriteProcessMemory,
+  kCallId_CreateRemoteThread,
+  kCallId_WaitForSingleObject,
+  kCallId_GetExitCodeThread,
+  kCallId_ResumeThread,
+  kCallId_CloseHandle,
+  kCallId_CreateToolhelp32Snapshot,
+  kCallId_Module32FirstW,
+  kCallId_Module32NextW,
+  kCallId_VirtualProtectEx,
+  kCallId_NtQueryInformationProcess,
+  kCallId_SetProcessAffinityMask,
+  kCallId_AssignProcessToJobObject,
+  kCallId_TerminateProcess,
+  kCallId_Process32FirstW,
+  kCallId_Process32NextW
+};
+
+enum TraceMode {
+  kTraceMode_None,
+  kTraceMode_Record,
+  kTraceMode_Replay
+};
+
+enum {
+  kTraceVersion = 2,
+  kTraceRecordArgsCount = 3
+};
+
+/* STATUS_NOT_IMPLEMENTED, which is not defined by the Windows headers. */
+static const LONG kStatusNotImplemented = (LONG) 0xC0000002L;
+
+static const char kTraceMagic[8] = {
+    'S', 'G', 'G', 'L', 'T', 'R', 'C', '\0'
+};
+
+struct TraceFileHeader {
+  char magic[8];
+  DWORD version;
+  DWORD pointer_size;
+};
+
+/**
+ * Each record is followed by output_size bytes of data that the
+ * function wrote into caller provided buffers.
+ */
+struct TraceRecord {
+  WORD call_id;
+  WORD reserved;
+  DWORD output_size;
+  DWORD duration_us;
+  DWORD last_error;
+  DWORD result_low;
+  DWORD result_high;
+  DWORD args[kTraceRecordArgsCount];
+};
+
+struct TraceCall {
+  struct TraceRecord record;
+  LARGE_INTEGER start_time;
+};
+
+static enum TraceMode trace_mode = kTraceMode_None;
+static FILE* trace_file;
+static DWORD trace_thread_id;
+
+static LARGE_INTEGER performance_frequency;
+static LARGE_INTEGER trace_start_time;
+static size_t num_traced_calls;
+static ULONGLONG total_traced_us;
+static int is_replay_diverged;
+
+typedef BOOL WINAPI IsWow64ProcessFuncType(HANDLE, BOOL*);
+
+typedef void* WINAPI VirtualAllocExFuncType(
+    HANDLE, void*, SIZE_T, DWORD, DWORD);
+typedef BOOL WINAPI VirtualFreeExFuncType(HANDLE, void*, SIZE_T, DWORD);
+
+typedef BOOL WINAPI AssignProcessToJobObjectFuncType(HANDLE, HANDLE);
+
+typedef LONG WINAPI NtQueryInformationProcessFuncType(
+    HANDLE, int, void*, ULONG, ULONG*);
+
+typedef HANDLE WINAPI CreateToolhelp32SnapshotFuncType(DWORD, DWORD);
+typedef BOOL WINAPI Module32FirstWFuncType(HANDLE, MODULEENTRY32W*);
+typedef BOOL WINAPI Module32NextWFuncType(HANDLE, MODULEENTRY32W*);
+typedef BOOL WINAPI Process32FirstWFuncType(HANDLE, PROCESSENTRY32W*);
+typedef BOOL WINAPI Process32NextWFuncType(HANDLE, PROCESSENTRY32W*);
+
+static void* GetKernel32ProcAddress(const char* proc_name) {
+  return GetProcAddress(GetModuleHandleW(L"kernel32.dll"), proc_name);
+}
+
+static ULONGLONG GetElapsedMicroseconds(
+    const LARGE_INTEGER* start_time,
+    const LARGE_INTEGER* end_time) {
+  return (ULONGLONG) (end_time->QuadPart - start_time->QuadPart)
+      * 1000000 / performance_frequency.QuadPart;
+}
+
+static void WaitForDuration(
+    const LARGE_INTEGER* start_time,
+    DWORD duration_us) {
+  LARGE_INTEGER current_time;
+  ULONGLONG elapsed_us;
+  DWORD remaining_ms;
+
+  for (;;) {
+    QueryPerformanceCounter(&current_time);
+    elapsed_us = GetElapsedMicroseconds(start_time, &current_time);
+    if (elapsed_us >= duration_us) {
+      return;
+    }
+
+    /* Sleep for most of the time, then spin for better accuracy. */
+    remaining_ms = (DWORD) ((duration_us - elapsed_us) / 1000);
+    Sleep((remaining_ms > 2) ? remaining_ms - 2 : 0);
+  }
+}
+
+/**
+ * Only calls from the thread that started the trace are traced, so the
+ * trace stays a single ordered sequence of calls.
+ */
+static int IsTracedThread(void) {
+  return trace_mode != kTraceMode_None
+      && GetCurrentThreadId() == trace_thread_id;
+}
+
+/**
+ * Trace call
+ */
+
+static void TraceCall_Begin(
+    struct TraceCall* call,
+    enum CallId call_id,
+    ULONG_PTR arg0,
+    ULONG_PTR arg1,
+    ULONG_PTR arg2) {
+  memset(&call->record, 0, sizeof(call->record));
+
+  call->record.call_id = (WORD) call_id;
+  call->record.args[0] = (DWORD) arg0;
+  call->record.args[1] = (DWORD) arg1;
+  call->record.args[2] = (DWORD) arg2;
+
+  QueryPerformanceCounter(&call->start_time);
+}
+
+static void TraceCall_Record(
+    struct TraceCall* call,
+    ULONG_PTR result,
+    const void* output,
+    size_t output_size) {
+  DWORD last_error;
+  LARGE_INTEGER end_time;
+  ULONGLONG duration_us;
+
+  /* Preserve the last error for the caller. */
+  last_error = GetLastError();
+  QueryPerformanceCounter(&end_time);
+
+  duration_us = GetElapsedMicroseconds(&call->start_time, &end_time);
+
+  call->record.duration_us = (duration_us <= 0xFFFFFFFF)
+      ? (DWORD) duration_us
+      : 0xFFFFFFFF;
+  call->record.last_error = last_error;
+  call->record.result_low = (DWORD) result;
+  call->record.result_high = (DWORD) ((ULONGLONG) result >> 32);
+  call->record.output_size = (output != NULL) ? (DWORD) output_size : 0;
+
+  fwrite(&call->record, sizeof(call->record), 1, trace_file);
+  if (call->record.output_size > 0) {
+    fwrite(output, call->record.output_size, 1, trace_file);
+  }
+
+  num_traced_calls += 1;
+  total_traced_us += call->record.duration_us;
+
+  SetLastError(last_error);
+}
+
+static ULONG_PTR TraceCall_Replay(
+    struct TraceCall* call,
+    void* output,
+    size_t output_size) {
+  struct TraceRecord record;
+  size_t copy_size;
+  size_t i_arg;
+  int is_record_matching;
+
+  is_record_matching = !is_replay_diverged
+      && fread(&record, sizeof(record), 1, trace_file) == 1
+      && record.call_id == call->record.call_id;
+
+  for (i_arg = 0; is_record_matching && i_arg < kTraceRecordArgsCount;
+      ++i_arg) {
+    is_record_matching = (record.args[i_arg] == call->record.args[i_arg]);
+  }
+
+  if (!is_record_matching) {
+    if (!is_replay_diverged) {
+      wprintf(
+          L"Trace replay diverged from the recording at call %u.\n",
+          num_traced_calls);
+      is_replay_diverged = 1;
+    }
+
+    SetLastError(ERROR_INVALID_DATA);
+    return 0;
+  }
+
+  copy_size = (output_size < record.output_size)
+      ? output_size
+      : record.output_size;
+
+  if (output != NULL && copy_size > 0) {
+    fread(output, copy_size, 1, trace_file);
+  }
+
+  fseek(
+      trace_file,
+      (output != NULL) ? record.output_size - copy_size : record.output_size,
+      SEEK_CUR);
+
+  num_traced_calls += 1;
+  total_traced_us += record.duration_us;
+
+  /* Reproduce the recorded duration of the call. */
+  WaitForDuration(&call->start_time, record.duration_us);
+
+  call->record = record;
+  SetLastError(record.last_error);
+
+  return (ULONG_PTR) (((ULONGLONG) record.result_high << 32)
+      | record.result_low);
+}
+
+/**
+ * External
+ */
+
+int Platform_StartRecording(const wchar_t* trace_path) {
+  struct TraceFileHeader header;
+
+  trace_file = _wfopen(trace_path, L"wb");
+  if (trace_file == NULL) {
+    return 0;
+  }
+
+  memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+  header.version = kTraceVersion;
+  header.pointer_size = sizeof(void*);
+
+  fwrite(&header, sizeof(header), 1, trace_file);
+
+  trace_thread_id = GetCurrentThreadId();
+  QueryPerformanceFrequency(&performance_frequency);
+  QueryPerformanceCounter(&trace_start_time);
+
+  num_traced_calls = 0;
+  total_traced_us = 0;
+  trace_mode = kTraceMode_Record;
+
+  return 1;
+}
+
+int Platform_StartReplay(const wchar_t* trace_path) {
+  struct TraceFileHeader header;
+
+  trace_file = _wfopen(trace_path, L"rb");
+  if (trace_file == NULL) {
+    return 0;
+  }
+
+  if (fread(&header, sizeof(header), 1, trace_file) != 1
+      || memcmp(header.magic, kTraceMagic, sizeof(header.magic)) != 0
+      || header.version != kTraceVersion
+      || header.pointer_size != sizeof(void*)) {
+    fclose(trace_file);
+    trace_file = NULL;
+
+    return 0;
+  }
+
+  trace_thread_id = GetCurrentThreadId();
+  QueryPerformanceFrequency(&performance_frequency);
+  QueryPerformanceCounter(&trace_start_time);
+
+  num_traced_calls = 0;
+  total_traced_us = 0;
+  is_replay_diverged = 0;
+  trace_mode = kTraceMode_Replay;
+
+  return 1;
+}
+
+int Platform_StopTrace(void) {
+  LARGE_INTEGER end_time;
+  int is_replay_matching;
+
+  if (trace_mode == kTraceMode_None) {
+    return 1;
+  }
+
+  QueryPerformanceCounter(&end_time);
+
+  if (trace_mode == kTraceMode_Record) {
+    wprintf(
+        L"Recorded %u calls taking %lu us in total.\n",
+        num_traced_calls,
+        (unsigned long) total_traced_us);
+  } else {
+    wprintf(
+        L"Replayed %u calls taking %lu us in total, %lu us wall time.\n",
+        num_traced_calls,
+        (unsigned long) total_traced_us,
+        (unsigned long) GetElapsedMicroseconds(&trace_start_time, &end_time));
+
+    /* Calls left in the recording were not made by the replay. */
+    if (!is_replay_diverged && fgetc(trace_file) != EOF) {
+      wprintf(
+          L"Trace replay ended after call %u, before the recording.\n",
+          num_traced_calls);
+      is_replay_diverged = 1;
+    }
+
+    if (is_replay_diverged) {
+      wprintf(L"The replay did not match the recording.\n");
+    }
+  }
+
+  wprintf(L"\n");
+
+  is_replay_matching = (trace_mode != kTraceMode_Replay)
+      || !is_replay_diverged;
+
+  trace_mode = kTraceMode_None;
+
+  fclose(trace_file);
+  trace_file = NULL;
+
+  return is_replay_matching;
+}
+
+int Platform_IsTracing(void) {
+  return trace_mode != kTraceMode_None;
+}
+
+int Platform_IsReplaying(void) {
+  return trace_mode == kTraceMode_Replay;
+}
+
+BOOL Platform_CreateProcessW(
+    const wchar_t* application_name,
+    wchar_t* command_line,
+    SECURITY_ATTRIBUTES* process_attributes,
+    SECURITY_ATTRIBUTES* thread_attributes,
+    BOOL inherit_handles,
+    DWORD creation_flags,
+    void* environment,
+    const wchar_t* current_directory,
+    STARTUPINFOW* startup_info,
+    PROCESS_INFORMATION* process_information) {
+  struct TraceCall call;
+  BOOL result;
+
+  if (!IsTracedThread()) {
+    return CreateProcessW(
+        application_name,
+        command_line,
+        process_attributes,
+        thread_attributes,
+        inherit_handles,
+        creation_flags,
+        environment,
+        current_directory,
+        startup_info,
+        process_information);
+  }
+
+  TraceCall_Begin(
+      &call,
+      kCallId_CreateProcessW,
+      inherit_handles,
+      creation_flags,
+      wcslen(command_line));
+
+  if (trace_mode == kTraceMode_Replay) {
+    return (BOOL) TraceCall_Replay(
+        &call,
+        process_information,
+        sizeof(*process_information));
+  }
+
+  result = CreateProcessW(
+      application_name,
+      command_line,
+      process_attributes,
+      thread_attributes,
+      inherit_handles,
+      creation_flags,
+      environment,
+      current_directory,
+      startup_info,
+      process_information);
+
+  TraceCall_Record(
+      &call,
+      result,
+      result ? process_information : NULL,
+      sizeof(*process_information));
+
+  return result;
+}
+
+HANDLE Platform_OpenProcess(
+    DWORD desired_access,
+    BOOL inherit_handle,
+    DWORD process_id) {
+  struct TraceCall call;
+  HANDLE result;
+
+  if (!IsTracedThread()) {
+    return OpenProcess(desired_access, inherit_handle, process_id);
+  }
+
+  TraceCall_Begin(
+      &call,
+      kCallId_OpenProcess,
+      desired_access,
+      inherit_handle,
+      process_id);
+
+  if (trace_mode == kTraceMode_Replay) {
+    return (HANDLE) TraceCall_Replay(&call, NULL, 0);
+  }
+
+  result = OpenProcess(desired_access, inherit_handle, process_id);
+  TraceCall_Record(&call, (ULONG_PTR) result, NULL, 0);
+
+  return result;
+}
+
+BOOL Platform_IsWow64Process(HANDLE process, BOOL* is_wow64) {
+  IsWow64ProcessFuncType* is_wow64_process_func;
+  struct TraceCall call;
+  BOOL result;
+
+  is_wow64_process_func = (IsWow64ProcessFuncType*) GetKernel32ProcAddress(
+      "IsWow64Process");
+
+  if (!IsTracedThread()) {
+    if (is_wow64_process_func == NULL) {
+      SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+      return FALSE;
+    }
+
+    return is_wow64_process_func(process, is_wow64);
+  }
+
+  TraceCall_Begin(&call, kCallId_IsWow64Process, (ULONG_PTR) process, 0, 0);
+
+  if (trace_mode == kTraceMode_Replay) {
+    return (BOOL) TraceCall_Replay(&call, is_wow64, sizeof(*is_wow64));
+  }
+
+  if (is_wow64_process_func == NULL) {
+    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+    result = FALSE;
+  } else {
+    result = is_wow64_process_func(process, is_wow64);
+  }
+
+  TraceCall_Record(&call, result, result ? is_wow64 : NULL, sizeof(*is_wow64));
+
+  return result;
+}
+
+LONG Platform_NtQueryInformationProcess(
+    HANDLE process,
+    int information_class,
+    void* information,
+    ULONG information_length,
+    ULONG* return_length) {
+  NtQueryInformationProcessFuncType* nt_query_information_process_func;
+  struct TraceCall call;
+  LONG result;
+
+  /* Windows 95/98/ME do not have NtQueryInformationProcess. */
+  nt_query_information_process_func =
+      (NtQueryInformationProcessFuncType*) GetProcAddress(
+          GetModuleHandleW(L"ntdll.dll"),
+          "NtQueryInformationProcess");
+
+  if (!IsTracedThread()) {
+    if (nt_query_information_process_func == NULL) {
+      SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+      return kStatusNotImplemented;
+    }
+
+    return nt_query_information_process_func(
+        process,
+        information_class,
+        information,
+        information_length,
+        return_length);
+  }
+
+  TraceCall_Begin(
+      &call,
+      kCallId_NtQueryInformationProcess,
+      (ULONG_PTR) process,
+      information_class,
+      information_length);
+
+  if (trace_mode == kTraceMode_Replay) {
+    if (return_length != NULL) {
+      *return_length = information_length;
+    }
+
+    return (LONG) TraceCall_Replay(&call, information, information_length);
+  }
+
+  if (nt_query_information_process_func == NULL) {
+    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+    result = kStatusNotImplemented;
+  } else {
+    result = nt_query_information_process_func(
+        process,
+        information_class,
+        information,
+        information_length,
+        return_length);
+  }
+
+  TraceCall_Record(
+      &call,
+      (ULONG_PTR) result,
+      (result >= 0) ? information : NULL,
+      information_length);
+
+  return result;
+}
+
+void* Platform_VirtualAllocEx(
+    HANDLE process,
+    void* address,
+    size_t size,
+    DWORD allocation_type,
+    DWORD protect) {
+  static VirtualAllocExFuncType* virtual_alloc_ex_func;
+
+  struct TraceCall call;
+  void* result;
+  int is_traced;
+
+  is_traced = IsTracedThread();
+
+  if (is_traced) {
+    TraceCall_Begin(
+        &call,
+        kCallId_VirtualAllocEx,
+        (ULONG_PTR) process,
+        size,
+        allocation_type);
+
+    if (trace_mode == kTraceMode_Replay) {
+      return (void*) TraceCall_Replay(&call, NULL, 0);
+    }
+  }
+
+  /* VirtualAllocEx is missing in Windows 95/98/ME. */
+  if (virtual_alloc_ex_func == NULL) {
+    virtual_alloc_ex_func = (VirtualAllocExFuncType*) GetKernel32ProcAddress(
+        "VirtualAllocEx");
+  }
+
+  if (virtual_alloc_ex_func == NULL) {
+    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+    result = NULL;
+  } else {
+    result = virtual_alloc_ex_func(
+        process,
+        address,
+        size,
+        allocation_type,
+        protect);
+  }
+
+  if (is_traced) {
+    TraceCall_Record(&call, (ULONG_PTR) result, NULL, 0);
+  }
+
+  return result;
+}
+
+BOOL Platform_VirtualFreeEx(
+    HANDLE process,
+    void* address,
+    size_t size,
+    DWORD free_type) {
+  static VirtualFreeExFuncType* virtual_free_ex_func;
+
+  struct TraceCall call;
+  BOOL result;
+  int is_traced;
+
+  is_traced = IsTracedThread();
+
+  if (is_traced) {
+    TraceCall_Begin(
+        &call,
+        kCallId_VirtualFreeEx,
+        (ULONG_PTR) process,
+        (ULONG_PTR) address,
+        free_type);
+
+    if (trace_mode == kTraceMode_Replay) {
+      return (BOOL) TraceCall_Replay(&call, NULL, 0);
+    }
+  }
+
+  if (virtual_free_ex_func == NULL) {
+    virtual_free_ex_func = (VirtualFreeExFuncType*) GetKernel32ProcAddress(
+        "VirtualFreeEx");
+  }
+
+  if (virtual_free_ex_func == NULL) {
+    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+    result = FALSE;
+  } else {
+    result = virtual_free_ex_func(process, address, size, free_type);
+  }
+
+  if (is_traced) {
+    TraceCall_Record(&call, result, NULL, 0);
+  }
+
+  return result;
+}
+
+BOOL Platform_VirtualProtectEx(
+    HANDLE process,
+    void* address,
+    size_t size,
+    DWORD new_protect,
+    DWORD* old_protect) {
+  struct TraceCall call;
+  BOOL result;
+
+  if (!IsTracedThread()) {
+    return VirtualProtectEx(process, address, size, new_protect, old_protect);
+  }
+
+  TraceCall_Begin(
+      &call,
+      kCallId_VirtualProtectEx,
+      (ULONG_PTR) process,
+      (ULONG_PTR) address,
+      new_protect);
+
+  if (trace_mode == kTraceMode_Replay) {
+    return (BOOL) TraceCall_Replay(&call, old_protect, sizeof(*old_protect));
+  }
+
+  result = VirtualProtectEx(process, address, size, new_protect, old_protect);
+  TraceCall_Record(
+      &call,
+      result,
+      result ? old_protect : NULL,
+      sizeof(*old_protect));
+
+  return result;
+}
+
+BOOL Platform_ReadProcessMemory(
+    HANDLE process,
+    const void* base_address,
+    void* buffer,
+    size_t size,
+    SIZE_T* num_bytes_read) {
+  struct TraceCall call;
+  BOOL result;
+  SIZE_T local_num_bytes_read;
+
+  if (!IsTracedThread()) {
+    return ReadProcessMemory(
+        process,
+        base_address,
+        buffer,
+        size,
+        num_bytes_read);
+  }
+
+  TraceCall_Begin(
+      &call,
+      kCallId_ReadProcessMemory,
+      (ULONG_PTR) process,
+      (ULONG_PTR) base_address,
+      size);
+
+  if (trace_mode == kTraceMode_Replay) {
+    result = (BOOL) TraceCall_Replay(&call, buffer, size);
+
+    if (num_bytes_read != NULL) {
+      *num_bytes_read = call.record.output_size;
+    }
+
+    return result;
+  }
+
+  local_num_bytes_read = 0;
+  result = ReadProcessMemory(
+      process,
+      base_address,
+      buffer,
+      size,
+      &local_num_bytes_read);
+
+  if (num_bytes_read != NULL) {
+    *num_bytes_read = local_num_bytes_read;
+  }
+
+  TraceCall_Record(&call, result, buffer, local_num_bytes_read);
+
+  return result;
+}
+
+BOOL Platform_WriteProcessMemory(
+    HANDLE process,
+    void* base_address,
+    const void* buffer,
+    size_t size,
+    SIZE_T* num_bytes_written) {
+  struct TraceCall call;
+  BOOL result;
+
+  if (!IsTracedThread()) {
+    return WriteProcessMemory(
+        process,
+        base_address,
+        buffer,
+        size,
+        num_bytes_written);
+  }
+
+  TraceCall_Begin(
+      &call,
+      kCallId_WriteProcessMemory,
+      (ULONG_PTR) process,
+      (ULONG_PTR) base_address,
+      size);
+
+  if (trace_mode == kTraceMode_Replay) {
+    result = (BOOL) TraceCall_Replay(&call, NULL, 0);
+
+    if (num_bytes_written != NULL) {
+      *num_bytes_written = result ? size : 0;
+    }
+
+    return result;
+  }
+
+  result = WriteProcessMemory(
+      process,
+      base_address,
+      buffer,
+      size,
+      num_bytes_written);
+  TraceCall_Record(&call, result, NULL, 0);
+
+  return result;
+}
+
+HANDLE Platform_CreateRemoteThread(
+    HANDLE process,
+    SECURITY_ATTRIBUTES* thread_attributes,
+    size_t stack_size,
+    LPTHREAD_START_ROUTINE start_address,
+    void* parameter,
+    DWORD creation_flags,
+    DWORD* thread_id) {
+  struct TraceCall call;
+  HANDLE result;
+
+  if (!IsTracedThread()) {
+    return CreateRemoteThread(
+        process,
+        thread_attributes,
+        stack_size,
+        start_address,
+        parameter,
+        creation_flags,
+        thread_id);
+  }
+
+  /*
+   * The start address is not compared, because it differs between
+   * systems with address space layout randomization.
+   */
+  TraceCall_Begin(
+      &call,
+      kCallId_CreateRemoteThread,
+      (ULONG_PTR) process,
+      (ULONG_PTR) parameter,
+      creation_flags);
+
+  if (trace_mode == kTraceMode_Replay) {
+    return (HANDLE) TraceCall_Replay(
+        &call,
+        thread_id,
+        (thread_id != NULL) ? sizeof(*thread_id) : 0);
+  }
+
+  result = CreateRemoteThread(
+      process,
+      thread_attributes,
+      stack_size,
+      start_address,
+      parameter,
+      creation_flags,
+      thread_id);
+
+  TraceCall_Record(
+      &call,
+      (ULONG_PTR) result,
+      (result != NULL) ? thread_id : NULL,
+      (thread_id != NULL) ? sizeof(*thread_id) : 0);
+
+  return result;
+}
+
+DWORD Platform_WaitForSingleObject(HANDLE handle, DWORD milliseconds) {
+  struct TraceCall call;
+  DWORD result;
+
+  if (!IsTracedThread()) {
+    return WaitForSingleObject(handle, milliseconds);
+  }
+
+  TraceCall_Begin(
+      &call,
+      kCallId_WaitForSingleObject,
+      (ULONG_PTR) handle,
+      milliseconds,
+      0);
+
+  if (trace_mode == kTraceMode_Replay) {
+    return (DWORD) TraceCall_Replay(&call, NULL, 0);
+  }
+
+  result = WaitForSingleObject(handle, milliseconds);
+  TraceCall_Record(&call, result, NULL, 0);
+
+  return result;
+}
+
+BOOL Platform_GetExitCodeThread(HANDLE thread, DWORD* exit_code) {
+  struct TraceCall call;
+  BOOL result;
+
+  if (!IsTracedThread()) {
+    return GetExitCodeThread(thread, exit_code);
+  }
+
+  TraceCall_Begin(&call, kCallId_GetExitCodeThread, (ULONG_PTR) thread, 0, 0);
+
+  if (trace_mode == kTraceMode_Replay) {
+    return (BOOL) TraceCall_Replay(&call, exit_code, sizeof(*exit_code));
+  }
+
+  result = GetExitCodeThread(thread, exit_code);
+  TraceCall_Record(
+      &call,
+      result,
+      result ? exit_code : NULL,
+      sizeof(*exit_code));
+
+  return result;
+}
+
+DWORD Platform_ResumeThread(HANDLE thread) {
+  struct TraceCall call;
+  DWORD result;
+
+  if (!IsTracedThread()) {
+    return ResumeThread(thread);
+  }
+
+  TraceCall_Begin(&call, kCallId_ResumeThread, (ULONG_PTR) thread, 0, 0);
+
+  if (trace_mode == kTraceMode_Replay) {
+    return (DWORD) TraceCall_Replay(&call, NULL, 0);
+  }
+
+  result = ResumeThread(thread);
+  TraceCall_Record(&call, result, NULL, 0);
+
+  return result;
+}
+
+BOOL Platform_SetProcessAffinityMask(
+    HANDLE process,
+    ULONG_PTR affinity_mask) {
+  struct TraceCall call;
+  BOOL result;
+
+  if (!IsTracedThread()) {
+    return SetProcessAffinityMask(process, affinity_mask);
+  }
+
+  TraceCall_Begin(
+      &call,
+      kCallId_SetProcessAffinityMask,
+      (ULONG_PTR) process,
+      affinity_mask,
+      0);
+
+  if (trace_mode == kTraceMode_Replay) {
+    return (BOOL) TraceCall_Replay(&call, NULL, 0);
+  }
+
+  result = SetProcessAffinityMask(process, affinity_mask);
+  TraceCall_Record(&call, result, NULL, 0);
+
+  return result;
+}
+
+BOOL Platform_AssignProcessToJobObject(HANDLE job, HANDLE process) {
+  AssignProcessToJobObjectFuncType* assign_process_to_job_object_func;
+  struct TraceCall call;
+  BOOL result;
+
+  /* Windows 95/98/ME do not have job objects. */
+  assign_process_to_job_object_func =
+      (AssignProcessToJobObjectFuncType*) GetKernel32ProcAddress(
+          "AssignProcessToJobObject");
+
+  if (!IsTracedThread()) {
+    if (assign_process_to_job_object_func == NULL) {
+      SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+      return FALSE;
+    }
+
+    return assign_process_to_job_object_func(job, process);
+  }
+
+  TraceCall_Begin(
+      &call,
+      kCallId_AssignProcessToJobObject,
+      (ULONG_PTR) job,
+      (ULONG_PTR) process,
+      0);
+
+  if (trace_mode == kTraceMode_Replay) {
+    return (BOOL) TraceCall_Replay(&call, NULL, 0);
+  }
+
+  if (assign_process_to_job_object_func == NULL) {
+    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+    result = FALSE;
+  } else {
+    result = assign_process_to_job_object_func(job, process);
+  }
+
+  TraceCall_Record(&call, result, NULL, 0);
+
+  return result;
+}
+
+BOOL Platform_TerminateProcess(HANDLE process, UINT exit_code) {
+  struct TraceCall call;
+  BOOL result;
+
+  if (!IsTracedThread()) {
+    return TerminateProcess(process, exit_code);
+  }
+
+  TraceCall_Begin(
+      &call,
+      kCallId_TerminateProcess,
+      (ULONG_PTR) process,
+      exit_code,
+      0);
+
+  if (trace_mode == kTraceMode_Replay) {
+    return (BOOL) TraceCall_Replay(&call, NULL, 0);
+  }
+
+  result = TerminateProcess(process, exit_code);
+  TraceCall_Record(&call, result, NULL, 0);
+
+  return result;
+}
+
+BOOL Platform_CloseHandle(HANDLE handle) {
+  struct TraceCall call;
+  BOOL result;
+
+  if (!IsTracedThread()) {
+    return CloseHandle(handle);
+  }
+
+  TraceCall_Begin(&call, kCallId_CloseHandle, (ULONG_PTR) handle, 0, 0);
+
+  if (trace_mode == kTraceMode_Replay) {
+    return (BOOL) TraceCall_Replay(&call, NULL, 0);
+  }
+
+  result = CloseHandle(handle);
+  TraceCall_Record(&call, result, NULL, 0);
+
+  return result;
+}
+
+HANDLE Platform_CreateToolhelp32Snapshot(DWORD flags, DWORD process_id) {
+  CreateToolhelp32SnapshotFuncType* create_toolhelp32_snapshot_func;
+  struct TraceCall call;
+  HANDLE result;
+  int is_traced;
+
+  is_traced = IsTracedThread();
+
+  if (is_traced) {
+    TraceCall_Begin(
+        &call,
+        kCallId_CreateToolhelp32Snapshot,
+        flags,
+        process_id,
+        0);
+
+    if (trace_mode == kTraceMode_Replay) {
+      return (HANDLE) TraceCall_Replay(&call, NULL, 0);
+    }
+  }
+
+  /* Windows NT 4.0 does not implement the Toolhelp functions. */
+  create_toolhelp32_snapshot_func =
+      (CreateToolhelp32SnapshotFuncType*) GetKernel32ProcAddress(
+          "CreateToolhelp32Snapshot");
+
+  if (create_toolhelp32_snapshot_func == NULL) {
+    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+    result = INVALID_HANDLE_VALUE;
+  } else {
+    result = create_toolhelp32_snapshot_func(flags, process_id);
+  }
+
+  if (is_traced) {
+    TraceCall_Record(&call, (ULONG_PTR) result, NULL, 0);
+  }
+
+  return result;
+}
+
+BOOL Platform_Module32FirstW(HANDLE snapshot, MODULEENTRY32W* module_entry) {
+  Module32FirstWFuncType* module32_first_w_func;
+  struct TraceCall call;
+  BOOL result;
+  int is_traced;
+
+  is_traced = IsTracedThread();
+
+  if (is_traced) {
+    TraceCall_Begin(&call, kCallId_Module32FirstW, (ULONG_PTR) snapshot, 0, 0);
+
+    if (trace_mode == kTraceMode_Replay) {
+      return (BOOL) TraceCall_Replay(
+          &call,
+          module_entry,
+          sizeof(*module_entry));
+    }
+  }
+
+  module32_first_w_func = (Module32FirstWFuncType*) GetKernel32ProcAddress(
+      "Module32FirstW");
+
+  if (module32_first_w_func == NULL) {
+    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+    result = FALSE;
+  } else {
+    result = module32_first_w_func(snapshot, module_entry);
+  }
+
+  if (is_traced) {
+    TraceCall_Record(
+        &call,
+        result,
+        result ? module_entry : NULL,
+        sizeof(*module_entry));
+  }
+
+  return result;
+}
+
+BOOL Platform_Module32NextW(HANDLE snapshot, MODULEENTRY32W* module_entry) {
+  Module32NextWFuncType* module32_next_w_func;
+  struct TraceCall call;
+  BOOL result;
+  int is_traced;
+
+  is_traced = IsTracedThread();
+
+  if (is_traced) {
+    TraceCall_Begin(&call, kCallId_Module32NextW, (ULONG_PTR) snapshot, 0, 0);
+
+    if (trace_mode == kTraceMode_Replay) {
+      return (BOOL) TraceCall_Replay(
+          &call,
+          module_entry,
+          sizeof(*module_entry));
+    }
+  }
+
+  module32_next_w_func = (Module32NextWFuncType*) GetKernel32ProcAddress(
+      "Module32NextW");
+
+  if (module32_next_w_func == NULL) {
+    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+    result = FALSE;
+  } else {
+    result = module32_next_w_func(snapshot, module_entry);
+  }
+
+  if (is_traced) {
+    TraceCall_Record(
+        &call,
+        result,
+        result ? module_entry : NULL,
+        sizeof(*module_entry));
+  }
+
+  return result;
+}
+
+BOOL Platform_Process32FirstW(
+    HANDLE snapshot,
+    PROCESSENTRY32W* process_entry) {
+  Process32FirstWFuncType* process32_first_w_func;
+  struct TraceCall call;
+  BOOL result;
+  int is_traced;
+
+  is_traced = IsTracedThread();
+
+  if (is_traced) {
+    TraceCall_Begin(&call, kCallId_Process32FirstW, (ULONG_PTR) snapshot, 0, 0);
+
+    if (trace_mode == kTraceMode_Replay) {
+      return (BOOL) TraceCall_Replay(
+          &call,
+          process_entry,
+          sizeof(*process_entry));
+    }
+  }
+
+  process32_first_w_func = (Process32FirstWFuncType*) GetKernel32ProcAddress(
+      "Process32FirstW");
+
+  if (process32_first_w_func == NULL) {
+    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+    result = FALSE;
+  } else {
+    result = process32_first_w_func(snapshot, process_entry);
+  }
+
+  if (is_traced) {
+    TraceCall_Record(
+        &call,
+        result,
+        result ? process_entry : NULL,
+        sizeof(*process_entry));
+  }
+
+  return result;
+}
+
+BOOL Platform_Process32NextW(
+    HANDLE snapshot,
+    PROCESSENTRY32W* process_entry) {
+  Process32NextWFuncType* process32_next_w_func;
+  struct TraceCall call;
+  BOOL result;
+  int is_traced;
+
+  is_traced = IsTracedThread();
+
+  if (is_traced) {
+    TraceCall_Begin(&call, kCallId_Process32NextW, (ULONG_PTR) snapshot, 0, 0);
+
+    if (trace_mode == kTraceMode_Replay) {
+      return (BOOL) TraceCall_Replay(
+          &call,
+          process_entry,
+          sizeof(*process_entry));
+    }
+  }
+
+  process32_next_w_func = (Process32NextWFuncType*) GetKernel32ProcAddress(
+      "Process32NextW");
+
+  if (process32_next_w_func == NULL) {
+    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+    result = FALSE;
+  } else {
+    result = process32_next_w_func(snapshot, process_entry);
+  }
+
+  if (is_traced) {
+    TraceCall_Record(
+        &call,
+        result,
+        result ? process_entry : NULL,
+        sizeof(*process_entry));
+  }
+
+  return result;
+}
@@ -0,0 +1,177 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_PLATFORM_H_
+#define SGGL_PLATFORM_H_
+
+#include <stddef.h>
+#include <windows.h>
+#include <tlhelp32.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Interposition layer for the Win32 functions that operate on game
+ * processes. Calls can be recorded into a binary trace, and a recorded
+ * trace can be replayed in place of the real functions so that the
+ * loader's logic runs with the same responses and timings.
+ */
+
+int Platform_StartRecording(const wchar_t* trace_path);
+int Platform_StartReplay(const wchar_t* trace_path);
+
+/**
+ * Stops recording or replaying. Returns zero if a replayed launch did
+ * not make the same calls as the recording, and nonzero otherwise.
+ */
+int Platform_StopTrace(void);
+
+/**
+ * Returns nonzero if calls are being recorded or replayed. A trace is
+ * a single sequence of calls, so only the calls made by the thread that
+ * started the trace are traced. Calls from any other thread go to the
+ * real functions, and work that must be traced has to stay on the
+ * tracing thread.
+ */
+int Platform_IsTracing(void);
+
+int Platform_IsReplaying(void);
+
+BOOL Platform_CreateProcessW(
+    const wchar_t* application_name,
+    wchar_t* command_line,
+    SECURITY_ATTRIBUTES* process_attributes,
+    SECURITY_ATTRIBUTES* thread_attributes,
+    BOOL inherit_handles,
+    DWORD creation_flags,
+    void* environment,
+    const wchar_t* current_directory,
+    STARTUPINFOW* startup_info,
+    PROCESS_INFORMATION* process_information);
+
+HANDLE Platform_OpenProcess(
+    DWORD desired_access,
+    BOOL inherit_handle,
+    DWORD process_id);
+
+BOOL Platform_IsWow64Process(HANDLE process, BOOL* is_wow64);
+
+/**
+ * Returns an NTSTATUS value. Fails with STATUS_NOT_IMPLEMENTED on
+ * systems without ntdll.
+ */
+LONG Platform_NtQueryInformationProcess(
+    HANDLE process,
+    int information_class,
+    void* information,
+    ULONG information_length,
+    ULONG* return_length);
+
+void* Platform_VirtualAllocEx(
+    HANDLE process,
+    void* address,
+    size_t size,
+    DWORD allocation_type,
+    DWORD protect);
+
+BOOL Platform_VirtualFreeEx(
+    HANDLE process,
+    void* address,
+    size_t size,
+    DWORD free_type);
+
+BOOL Platform_VirtualProtectEx(
+    HANDLE process,
+    void* address,
+    size_t size,
+    DWORD new_protect,
+    DWORD* old_protect);
+
+BOOL Platform_ReadProcessMemory(
+    HANDLE process,
+    const void* base_address,
+    void* buffer,
+    size_t size,
+    SIZE_T* num_bytes_read);
+
+BOOL Platform_WriteProcessMemory(
+    HANDLE process,
+    void* base_address,
+    const void* buffer,
+    size_t size,
+    SIZE_T* num_bytes_written);
+
+HANDLE Platform_CreateRemoteThread(
+    HANDLE process,
+    SECURITY_ATTRIBUTES* thread_attributes,
+    size_t stack_size,
+    LPTHREAD_START_ROUTINE start_address,
+    void* parameter,
+    DWORD creation_flags,
+    DWORD* thread_id);
+
+DWORD Platform_WaitForSingleObject(HANDLE handle, DWORD milliseconds);
+
+BOOL Platform_GetExitCodeThread(HANDLE thread, DWORD* exit_code);
+
+DWORD Platform_ResumeThread(HANDLE thread);
+
+BOOL Platform_AssignProcessToJobObject(HANDLE job, HANDLE process);
+
+BOOL Platform_SetProcessAffinityMask(
+    HANDLE process,
+    ULONG_PTR affinity_mask);
+
+BOOL Platform_TerminateProcess(HANDLE process, UINT exit_code);
+
+BOOL Platform_CloseHandle(HANDLE handle);
+
+HANDLE Platform_CreateToolhelp32Snapshot(DWORD flags, DWORD process_id);
+
+BOOL Platform_Module32FirstW(HANDLE snapshot, MODULEENTRY32W* module_entry);
+
+BOOL Platform_Module32NextW(HANDLE snapshot, MODULEENTRY32W* module_entry);
+
+BOOL Platform_Process32FirstW(
+    HANDLE snapshot,
+    PROCESSENTRY32W* process_entry);
+
+BOOL Platform_Process32NextW(
+    HANDLE snapshot,
+    PROCESSENTRY32W* process_entry);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_PLATFORM_H_ */
@@ -0,0 +1,788 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "prefetch.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+#include <shlwapi.h>
+
+#include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+#include <mdc/wchar_t/filew.h>
+
+#ifndef INVALID_FILE_SIZE
+#define INVALID_FILE_SIZE ((DWORD) 0xFFFFFFFF)
+#endif /* INVALID_FILE_SIZE */
+
+enum {
+  /*
+   * Offsets into the optional header, which differs between PE32 and
+   * PE32+ images. Both are handled, since the game does not have to
+   * match the loader's bitness.
+   */
+  kOptionalHeader32Magic = 0x10B,
+  kOptionalHeader64Magic = 0x20B,
+  kOptionalHeader32NumRvaAndSizesOffset = 92,
+  kOptionalHeader64NumRvaAndSizesOffset = 108
+};
+
+/* Mirror of WIN32_MEMORY_RANGE_ENTRY, which is in the Windows 8 SDK. */
+struct MemoryRangeEntry {
+  void* virtual_address;
+  SIZE_T number_of_bytes;
+};
+
+typedef BOOL WINAPI PrefetchVirtualMemoryFuncType(
+    HANDLE, ULONG_PTR, struct MemoryRangeEntry*, ULONG);
+
+struct FileList {
+  wchar_t (*paths)[MAX_PATH];
+  size_t count;
+};
+
+/**
+ * Buffers and events for the overlapped reads, shared by every file.
+ */
+struct ReadSlots {
+  BYTE* buffers;
+  OVERLAPPED overlappeds[Prefetch_kReadDepth];
+};
+
+static DWORD GetElapsedMicroseconds(const LARGE_INTEGER* start_time) {
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER end_time;
+
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&end_time);
+
+  return (DWORD) ((end_time.QuadPart - start_time->QuadPart)
+      * 1000000 / frequency.QuadPart);
+}
+
+/**
+ * Adds the path to the list, unless it is already in the list or the
+ * list is full. Returns nonzero if the path was added.
+ */
+static int FileList_Add(struct FileList* list, const wchar_t* path) {
+  size_t i_path;
+
+  if (wcslen(path) >= MAX_PATH) {
+    return 0;
+  }
+
+  for (i_path = 0; i_path < list->count; ++i_path) {
+    if (_wcsicmp(list->paths[i_path], path) == 0) {
+      return 0;
+    }
+  }
+
+  if (list->count >= Prefetch_kMaxFiles) {
+    return 0;
+  }
+
+  wcscpy(list->paths[list->count], path);
+  list->count += 1;
+
+  return 1;
+}
+
+static int FileList_AddFullPath(struct FileList* list, const wchar_t* path) {
+  wchar_t full_path[MAX_PATH];
+  DWORD get_full_path_name_result;
+
+  get_full_path_name_result = GetFullPathNameW(
+      path,
+      MAX_PATH,
+      full_path,
+      NULL);
+  if (get_full_path_name_result == 0
+      || get_full_path_name_result >= MAX_PATH) {
+    return 0;
+  }
+
+  return FileList_Add(list, full_path);
+}
+
+/**
+ * Returns the pointer into the raw file at the RVA, or NULL if the
+ * RVA is not backed by size bytes of a section's raw data.
+ */
+static const BYTE* RvaToFilePointer(
+    const BYTE* view,
+    DWORD view_size,
+    const IMAGE_SECTION_HEADER* sections,
+    WORD num_sections,
+    DWORD rva,
+    DWORD size) {
+  WORD i_section;
+  DWORD section_offset;
+  DWORD file_offset;
+
+  for (i_section = 0; i_section < num_sections; ++i_section) {
+    if (rva < sections[i_section].VirtualAddress) {
+      continue;
+    }
+
+    section_offset = rva - sections[i_section].VirtualAddress;
+    if (section_offset >= sections[i_section].SizeOfRawData) {
+      continue;
+    }
+
+    file_offset = sections[i_section].PointerToRawData + section_offset;
+    if (file_offset < sections[i_section].PointerToRawData
+        || file_offset > view_size
+        || view_size - file_offset < size) {
+      return NULL;
+    }
+
+    return &view[file_offset];
+  }
+
+  return NULL;
+}
+
+/**
+ * Adds every library that the file imports and that exists in the
+ * game's directory. System libraries are shared by every process, and
+ * are most likely cached already.
+ */
+static void AddImportsOfFile(
+    struct FileList* list,
+    const wchar_t* path,
+    const wchar_t* game_directory) {
+  HANDLE file;
+  HANDLE mapping;
+  const BYTE* view;
+  DWORD view_size;
+  const IMAGE_DOS_HEADER* dos_header;
+  const IMAGE_FILE_HEADER* file_header;
+  const BYTE* optional_header;
+  WORD magic;
+  DWORD num_rva_and_sizes_offset;
+  DWORD num_rva_and_sizes;
+  const IMAGE_DATA_DIRECTORY* data_directories;
+  const IMAGE_SECTION_HEADER* sections;
+  const IMAGE_IMPORT_DESCRIPTOR* descriptor;
+  DWORD descriptor_rva;
+  const char* name;
+  DWORD max_name_length;
+  DWORD name_length;
+  wchar_t wide_name[MAX_PATH];
+  wchar_t import_path[MAX_PATH];
+  int multi_byte_to_wide_char_result;
+
+  file = CreateFileW(
+      path,
+      GENERIC_READ,
+      FILE_SHARE_READ,
+      NULL,
+      OPEN_EXISTING,
+      0,
+      NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    goto bad_return;
+  }
+
+  view_size = GetFileSize(file, NULL);
+  if (view_size == INVALID_FILE_SIZE
+      || view_size < sizeof(IMAGE_DOS_HEADER)) {
+    goto bad_close_file;
+  }
+
+  mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL) {
+    goto bad_close_file;
+  }
+
+  view = (const BYTE*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == NULL) {
+    goto bad_close_mapping;
+  }
+
+  /* Locate the headers, checking that each lies within the file. */
+  dos_header = (const IMAGE_DOS_HEADER*) view;
+  if (dos_header->e_magic != IMAGE_DOS_SIGNATURE
+      || dos_header->e_lfanew < 0
+      || (DWORD) dos_header->e_lfanew > view_size
+      || view_size - dos_header->e_lfanew
+          < sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER) + sizeof(WORD)
+      || *(const DWORD*) &view[dos_header->e_lfanew]
+          != IMAGE_NT_SIGNATURE) {
+    goto bad_unmap_view;
+  }
+
+  file_header = (const IMAGE_FILE_HEADER*)
+      &view[dos_header->e_lfanew + sizeof(DWORD)];
+  optional_header = (const BYTE*) (file_header + 1);
+
+  if ((DWORD) (optional_header - view) + file_header->SizeOfOptionalHeader
+      + file_header->NumberOfSections * sizeof(IMAGE_SECTION_HEADER)
+      > view_size) {
+    goto bad_unmap_view;
+  }
+
+  magic = *(const WORD*) optional_header;
+  if (magic == kOptionalHeader32Magic) {
+    num_rva_and_sizes_offset = kOptionalHeader32NumRvaAndSizesOffset;
+  } else if (magic == kOptionalHeader64Magic) {
+    num_rva_and_sizes_offset = kOptionalHeader64NumRvaAndSizesOffset;
+  } else {
+    goto bad_unmap_view;
+  }
+
+  if (file_header->SizeOfOptionalHeader
+      < num_rva_and_sizes_offset + sizeof(DWORD)) {
+    goto bad_unmap_view;
+  }
+
+  num_rva_and_sizes =
+      *(const DWORD*) &optional_header[num_rva_and_sizes_offset];
+  data_directories = (const IMAGE_DATA_DIRECTORY*)
+      &optional_header[num_rva_and_sizes_offset + sizeof(DWORD)];
+
+  if (num_rva_and_sizes <= IMAGE_DIRECTORY_ENTRY_IMPORT
+      || file_header->SizeOfOptionalHeader
+          < num_rva_and_sizes_offset + sizeof(DWORD)
+              + (IMAGE_DIRECTORY_ENTRY_IMPORT + 1)
+                  * sizeof(IMAGE_DATA_DIRECTORY)) {
+    goto bad_unmap_view;
+  }
+
+  sections = (const IMAGE_SECTION_HEADER*)
+      &optional_header[file_header->SizeOfOptionalHeader];
+
+  /* Walk the import descriptors until the null descriptor. */
+  for (descriptor_rva =
+          data_directories[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress;
+      descriptor_rva != 0;
+      descriptor_rva += sizeof(IMAGE_IMPORT_DESCRIPTOR)) {
+    descriptor = (const IMAGE_IMPORT_DESCRIPTOR*) RvaToFilePointer(
+        view,
+        view_size,
+        sections,
+        file_header->NumberOfSections,
+        descriptor_rva,
+        sizeof(*descriptor));
+    if (descriptor == NULL || descriptor->Name == 0) {
+      break;
+    }
+
+    name = (const char*) RvaToFilePointer(
+        view,
+        view_size,
+        sections,
+        file_header->NumberOfSections,
+        descriptor->Name,
+        1);
+    if (name == NULL) {
+      continue;
+    }
+
+    /* The name must end within the file. */
+    max_name_length = view_size - (DWORD) ((const BYTE*) name - view);
+    for (name_length = 0;
+        name_length < max_name_length && name[name_length] != '\0';
+        ++name_length) {
+    }
+
+    if (name_length == 0 || name_length >= max_name_length
+        || name_length >= MAX_PATH) {
+      continue;
+    }
+
+    multi_byte_to_wide_char_result = MultiByteToWideChar(
+        CP_ACP,
+        0,
+        name,
+        name_length,
+        wide_name,
+        MAX_PATH - 1);
+    if (multi_byte_to_wide_char_result == 0) {
+      continue;
+    }
+
+    wide_name[multi_byte_to_wide_char_result] = L'\0';
+
+    if (PathCombineW(import_path, game_directory, wide_name) == NULL) {
+      continue;
+    }
+
+    if (PathFileExistsW(import_path)) {
+      FileList_Add(list, import_path);
+    }
+  }
+
+  UnmapViewOfFile(view);
+  CloseHandle(mapping);
+  CloseHandle(file);
+
+  return;
+
+bad_unmap_view:
+  UnmapViewOfFile(view);
+
+bad_close_mapping:
+  CloseHandle(mapping);
+
+bad_close_file:
+  CloseHandle(file);
+
+bad_return:
+  return;
+}
+
+static void AddListedFiles(
+    struct FileList* list,
+    const wchar_t* list_path,
+    const wchar_t* game_directory) {
+  FILE* list_file;
+  wchar_t line[MAX_PATH];
+  wchar_t listed_path[MAX_PATH];
+  size_t line_length;
+
+  list_file = _wfopen(list_path, L"r");
+  if (list_file == NULL) {
+    wprintf(L"Prefetch list %ls could not be opened.\n\n", list_path);
+    return;
+  }
+
+  while (fgetws(line, MAX_PATH, list_file) != NULL) {
+    line_length = wcslen(line);
+    while (line_length > 0
+        && (line[line_length - 1] == L'\n'
+            || line[line_length - 1] == L'\r')) {
+      line_length -= 1;
+      line[line_length] = L'\0';
+    }
+
+    if (line_length == 0 || line[0] == L'#') {
+      continue;
+    }
+
+    /* Absolute paths are kept as they are. */
+    if (PathCombineW(listed_path, game_directory, line) == NULL) {
+      wprintf(L"Listed file %ls could not be resolved.\n", line);
+      continue;
+    }
+
+    FileList_Add(list, listed_path);
+  }
+
+  fclose(list_file);
+}
+
+static int PrefetchFileByMapping(
+    const wchar_t* path,
+    PrefetchVirtualMemoryFuncType* prefetch_virtual_memory_func,
+    ULONGLONG* num_read_bytes) {
+  HANDLE file;
+  HANDLE mapping;
+  void* view;
+  DWORD file_size;
+  struct MemoryRangeEntry range;
+  BOOL is_prefetch_success;
+
+  file = CreateFileW(
+      path,
+      GENERIC_READ,
+      FILE_SHARE_READ,
+      NULL,
+      OPEN_EXISTING,
+      FILE_FLAG_SEQUENTIAL_SCAN,
+      NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    goto bad_return;
+  }
+
+  /* Empty files cannot be mapped, and there is nothing to read. */
+  file_size = GetFileSize(file, NULL);
+  if (file_size == 0) {
+    CloseHandle(file);
+    return 1;
+  }
+
+  if (file_size == INVALID_FILE_SIZE) {
+    goto bad_close_file;
+  }
+
+  mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL) {
+    goto bad_close_file;
+  }
+
+  view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == NULL) {
+    goto bad_close_mapping;
+  }
+
+  /*
+   * The pages are read with large I/Os into the file cache, which
+   * remain there after the view is unmapped.
+   */
+  range.virtual_address = view;
+  range.number_of_bytes = file_size;
+
+  is_prefetch_success = prefetch_virtual_memory_func(
+      GetCurrentProcess(),
+      1,
+      &range,
+      0);
+  if (!is_prefetch_success) {
+    goto bad_unmap_view;
+  }
+
+  *num_read_bytes += file_size;
+
+  UnmapViewOfFile(view);
+  CloseHandle(mapping);
+  CloseHandle(file);
+
+  return 1;
+
+bad_unmap_view:
+  UnmapViewOfFile(view);
+
+bad_close_mapping:
+  CloseHandle(mapping);
+
+bad_close_file:
+  CloseHandle(file);
+
+bad_return:
+  return 0;
+}
+
+/**
+ * Reads the file one chunk at a time, for systems that do not support
+ * overlapped reads from files, such as Windows 9x.
+ */
+static int PrefetchFileBySynchronousReading(
+    const wchar_t* path,
+    BYTE* buffer,
+    ULONGLONG* num_read_bytes) {
+  HANDLE file;
+  DWORD num_chunk_read_bytes;
+  BOOL is_read_success;
+
+  file = CreateFileW(
+      path,
+      GENERIC_READ,
+      FILE_SHARE_READ,
+      NULL,
+      OPEN_EXISTING,
+      FILE_FLAG_SEQUENTIAL_SCAN,
+      NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return 0;
+  }
+
+  do {
+    is_read_success = ReadFile(
+        file,
+        buffer,
+        Prefetch_kReadChunkSize,
+        &num_chunk_read_bytes,
+        NULL);
+    if (!is_read_success) {
+      CloseHandle(file);
+      return 0;
+    }
+
+    *num_read_bytes += num_chunk_read_bytes;
+  } while (num_chunk_read_bytes > 0);
+
+  CloseHandle(file);
+
+  return 1;
+}
+
+static int PrefetchFileByReading(
+    const wchar_t* path,
+    struct ReadSlots* slots,
+    ULONGLONG* num_read_bytes) {
+  HANDLE file;
+  DWORD file_size;
+  DWORD next_offset;
+  size_t i_slot;
+  size_t num_pending;
+  DWORD num_slot_read_bytes;
+  BOOL is_read_success;
+  int is_all_read;
+
+  file = CreateFileW(
+      path,
+      GENERIC_READ,
+      FILE_SHARE_READ,
+      NULL,
+      OPEN_EXISTING,
+      FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+      NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return 0;
+  }
+
+  file_size = GetFileSize(file, NULL);
+  if (file_size == INVALID_FILE_SIZE) {
+    CloseHandle(file);
+    return 0;
+  }
+
+  /*
+   * Keep every slot's read in flight. Slots are issued and completed
+   * in the same order, so the file is read front to back.
+   */
+  is_all_read = 1;
+  next_offset = 0;
+  num_pending = 0;
+
+  for (i_slot = 0;
+      i_slot < Prefetch_kReadDepth && next_offset < file_size;
+      ++i_slot) {
+    slots->overlappeds[i_slot].Offset = next_offset;
+    slots->overlappeds[i_slot].OffsetHigh = 0;
+
+    is_read_success = ReadFile(
+        file,
+        &slots->buffers[i_slot * Prefetch_kReadChunkSize],
+        Prefetch_kReadChunkSize,
+        NULL,
+        &slots->overlappeds[i_slot]);
+    if (!is_read_success && GetLastError() != ERROR_IO_PENDING) {
+      if (num_pending == 0 && GetLastError() == ERROR_INVALID_PARAMETER) {
+        CloseHandle(file);
+
+        return PrefetchFileBySynchronousReading(
+            path,
+            slots->buffers,
+            num_read_bytes);
+      }
+
+      is_all_read = 0;
+      break;
+    }
+
+    next_offset += Prefetch_kReadChunkSize;
+    num_pending += 1;
+  }
+
+  i_slot = 0;
+  while (num_pending > 0) {
+    is_read_success = GetOverlappedResult(
+        file,
+        &slots->overlappeds[i_slot],
+        &num_slot_read_bytes,
+        TRUE);
+    num_pending -= 1;
+
+    if (is_read_success) {
+      *num_read_bytes += num_slot_read_bytes;
+    } else if (GetLastError() != ERROR_HANDLE_EOF) {
+      is_all_read = 0;
+    }
+
+    if (is_all_read && next_offset < file_size) {
+      slots->overlappeds[i_slot].Offset = next_offset;
+      slots->overlappeds[i_slot].OffsetHigh = 0;
+
+      is_read_success = ReadFile(
+          file,
+          &slots->buffers[i_slot * Prefetch_kReadChunkSize],
+          Prefetch_kReadChunkSize,
+          NULL,
+          &slots->overlappeds[i_slot]);
+      if (is_read_success || GetLastError() == ERROR_IO_PENDING) {
+        next_offset += Prefetch_kReadChunkSize;
+        num_pending += 1;
+      } else {
+        is_all_read = 0;
+      }
+    }
+
+    i_slot = (i_slot + 1) % Prefetch_kReadDepth;
+  }
+
+  CloseHandle(file);
+
+  return is_all_read;
+}
+
+/**
+ * External
+ */
+
+int Prefetch_Run(
+    const wchar_t* game_path,
+    const wchar_t** library_paths,
+    size_t num_libraries,
+    const wchar_t* list_path) {
+  struct FileList list;
+  struct ReadSlots slots;
+  PrefetchVirtualMemoryFuncType* prefetch_virtual_memory_func;
+  wchar_t game_directory[MAX_PATH];
+  DWORD get_full_path_name_result;
+  size_t i_path;
+  size_t i_slot;
+  int is_all_prefetched;
+  int is_prefetch_file_success;
+  ULONGLONG num_read_bytes;
+  LARGE_INTEGER start_time;
+
+  QueryPerformanceCounter(&start_time);
+
+  list.count = 0;
+  list.paths = Mdc_malloc(Prefetch_kMaxFiles * sizeof(list.paths[0]));
+  if (list.paths == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_return;
+  }
+
+  get_full_path_name_result = GetFullPathNameW(
+      game_path,
+      MAX_PATH,
+      game_directory,
+      NULL);
+  if (get_full_path_name_result == 0
+      || get_full_path_name_result >= MAX_PATH) {
+    wprintf(L"GetFullPathNameW failed, error 0x%lX.\n\n", GetLastError());
+    goto bad_free_paths;
+  }
+
+  PathRemoveFileSpecW(game_directory);
+
+  /*
+   * Collect the import closure. The list grows while it is walked, so
+   * each added library has its own imports added in turn.
+   */
+  FileList_AddFullPath(&list, game_path);
+  for (i_path = 0; i_path < num_libraries; ++i_path) {
+    FileList_AddFullPath(&list, library_paths[i_path]);
+  }
+
+  for (i_path = 0; i_path < list.count; ++i_path) {
+    AddImportsOfFile(&list, list.paths[i_path], game_directory);
+  }
+
+  if (list_path != NULL) {
+    AddListedFiles(&list, list_path, game_directory);
+  }
+
+  if (list.count >= Prefetch_kMaxFiles) {
+    wprintf(
+        L"Only the first %u files will be prefetched.\n",
+        Prefetch_kMaxFiles);
+  }
+
+  /* PrefetchVirtualMemory is only available from Windows 8. */
+  prefetch_virtual_memory_func =
+      (PrefetchVirtualMemoryFuncType*) GetProcAddress(
+          GetModuleHandleW(L"kernel32.dll"),
+          "PrefetchVirtualMemory");
+
+  slots.buffers = NULL;
+  if (prefetch_virtual_memory_func == NULL) {
+    slots.buffers = Mdc_malloc(
+        Prefetch_kReadDepth * Prefetch_kReadChunkSize);
+    if (slots.buffers == NULL) {
+      Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+      goto bad_free_paths;
+    }
+
+    for (i_slot = 0; i_slot < Prefetch_kReadDepth; ++i_slot) {
+      memset(&slots.overlappeds[i_slot], 0, sizeof(slots.overlappeds[0]));
+      slots.overlappeds[i_slot].hEvent =
+          CreateEventW(NULL, TRUE, FALSE, NULL);
+      if (slots.overlappeds[i_slot].hEvent == NULL) {
+        wprintf(L"CreateEventW failed, error 0x%lX.\n\n", GetLastError());
+        goto bad_close_events;
+      }
+    }
+  }
+
+  wprintf(L"Prefetching %u file(s)...\n", list.count);
+
+  is_all_prefetched = 1;
+  num_read_bytes = 0;
+
+  for (i_path = 0; i_path < list.count; ++i_path) {
+    if (prefetch_virtual_memory_func != NULL) {
+      is_prefetch_file_success = PrefetchFileByMapping(
+          list.paths[i_path],
+          prefetch_virtual_memory_func,
+          &num_read_bytes);
+    } else {
+      is_prefetch_file_success = PrefetchFileByReading(
+          list.paths[i_path],
+          &slots,
+          &num_read_bytes);
+    }
+
+    if (!is_prefetch_file_success) {
+      wprintf(L"File %ls could not be prefetched.\n", list.paths[i_path]);
+      is_all_prefetched = 0;
+    }
+  }
+
+  wprintf(
+      L"Prefetched %lu KB using %ls in %lu microseconds.\n\n",
+      (unsigned long) (num_read_bytes / 1024),
+      (prefetch_virtual_memory_func != NULL)
+          ? L"PrefetchVirtualMemory"
+          : L"overlapped reads",
+      GetElapsedMicroseconds(&start_time));
+
+  if (slots.buffers != NULL) {
+    for (i_slot = 0; i_slot < Prefetch_kReadDepth; ++i_slot) {
+      CloseHandle(slots.overlappeds[i_slot].hEvent);
+    }
+
+    Mdc_free(slots.buffers);
+  }
+
+  Mdc_free(list.paths);
+
+  return is_all_prefetched;
+
+bad_close_events:
+  while (i_slot > 0) {
+    i_slot -= 1;
+    CloseHandle(slots.overlappeds[i_slot].hEvent);
+  }
+
+  Mdc_free(slots.buffers);
+
+bad_free_paths:
+  Mdc_free(list.paths);
+
+bad_return:
+  return 0;
+}
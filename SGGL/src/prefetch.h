@@ -0,0 +1,75 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_PREFETCH_H_
+#define SGGL_PREFETCH_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum {
+  /* Files beyond this count are not prefetched. */
+  Prefetch_kMaxFiles = 1024,
+
+  Prefetch_kReadChunkSize = 1024 * 1024,
+
+  /* Reads kept in flight for each file. */
+  Prefetch_kReadDepth = 4
+};
+
+/**
+ * Reads files into the system file cache before the game instances are
+ * created, so that the instances do not fault them in from disk with
+ * random reads. The files are the game executable, the libraries to
+ * inject, every library in the game's directory that either of them
+ * imports, directly or indirectly, and the files named in the optional
+ * list file. The list file holds one path per line, relative to the
+ * game's directory; empty lines and lines starting with # are skipped.
+ *
+ * Each file is mapped and passed to PrefetchVirtualMemory, or read
+ * sequentially with several large overlapped reads in flight where it
+ * is not available. Returns nonzero if every file was read.
+ */
+int Prefetch_Run(
+    const wchar_t* game_path,
+    const wchar_t** library_paths,
+    size_t num_libraries,
+    const wchar_t* list_path);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_PREFETCH_H_ */
@@ -0,0 +1,522 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "remote_exports.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <windows.h>
+#include <tlhelp32.h>
+
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+
+#include "pe_file.h"
+#include "platform.h"
+
+#ifndef TH32CS_SNAPMODULE32
+#define TH32CS_SNAPMODULE32 0x00000010
+#endif /* TH32CS_SNAPMODULE32 */
+
+enum {
+  kExportCacheCapacity = 16,
+  kMaxForwardDepth = 4,
+  kMaxSnapshotAttempts = 8,
+  kForwarderNameLength = 256
+};
+
+/**
+ * A copy of a module's export data directory, keyed by the module's
+ * base address and image checksum. Both values are identical across all
+ * processes that map the same image at the same address, so one export
+ * walk serves every instance.
+ */
+struct ExportCacheEntry {
+  BYTE* module_base;
+  struct PeFile_ExportData exports;
+};
+
+static struct ExportCacheEntry export_cache[kExportCacheCapacity];
+static size_t export_cache_count;
+static size_t export_cache_next_evict;
+
+/*
+ * Deferred libraries are injected from worker threads, which share the
+ * cache with the launch thread.
+ */
+static volatile LONG export_cache_lock;
+
+static void LockExportCache(void) {
+  while (InterlockedExchange((LONG*) &export_cache_lock, 1) != 0) {
+    Sleep(0);
+  }
+}
+
+static void UnlockExportCache(void) {
+  InterlockedExchange((LONG*) &export_cache_lock, 0);
+}
+
+static int IsWow64(HANDLE process) {
+  BOOL is_wow64;
+
+  /* Systems without IsWow64Process only run one bitness. */
+  if (!Platform_IsWow64Process(process, &is_wow64)) {
+    return 0;
+  }
+
+  return is_wow64;
+}
+
+static int ReadRemote(
+    HANDLE process,
+    const void* remote_address,
+    void* buffer,
+    size_t size) {
+  BOOL is_read_process_memory_success;
+  SIZE_T num_bytes_read;
+
+  is_read_process_memory_success = Platform_ReadProcessMemory(
+      process,
+      remote_address,
+      buffer,
+      size,
+      &num_bytes_read);
+
+  return is_read_process_memory_success && num_bytes_read == size;
+}
+
+static BYTE* FindRemoteModuleBase(
+    DWORD process_id,
+    const wchar_t* module_name) {
+  size_t i_attempt;
+  HANDLE snapshot;
+  MODULEENTRY32W module_entry;
+  BOOL is_module_entry_valid;
+  BYTE* module_base;
+
+  /*
+   * Module snapshots can fail with ERROR_BAD_LENGTH while the target's
+   * loader is modifying its module list, so retry a few times. A target
+   * that is still suspended has no module list to read at all, which
+   * fails with ERROR_PARTIAL_COPY and is not retried.
+   */
+  snapshot = INVALID_HANDLE_VALUE;
+  for (i_attempt = 0; i_attempt < kMaxSnapshotAttempts; ++i_attempt) {
+    snapshot = Platform_CreateToolhelp32Snapshot(
+        TH32CS_SNAPMODULE | TH32CS_SNAPMODULE32,
+        process_id);
+
+    if (snapshot != INVALID_HANDLE_VALUE
+        || GetLastError() != ERROR_BAD_LENGTH) {
+      break;
+    }
+  }
+
+  if (snapshot == INVALID_HANDLE_VALUE) {
+    return NULL;
+  }
+
+  module_base = NULL;
+  module_entry.dwSize = sizeof(module_entry);
+
+  for (is_module_entry_valid = Platform_Module32FirstW(snapshot, &module_entry);
+      is_module_entry_valid;
+      is_module_entry_valid = Platform_Module32NextW(
+          snapshot,
+          &module_entry)) {
+    if (lstrcmpiW(module_entry.szModule, module_name) == 0) {
+      module_base = module_entry.modBaseAddr;
+      break;
+    }
+  }
+
+  Platform_CloseHandle(snapshot);
+
+  return module_base;
+}
+
+/**
+ * Export cache
+ */
+
+static const void* ExportCacheEntry_GetData(
+    const struct ExportCacheEntry* entry,
+    DWORD rva,
+    DWORD size) {
+  return PeFile_ExportData_Get(&entry->exports, rva, size);
+}
+
+static const char* ExportCacheEntry_GetString(
+    const struct ExportCacheEntry* entry,
+    DWORD rva) {
+  const char* str;
+  DWORD max_length;
+
+  str = ExportCacheEntry_GetData(entry, rva, 1);
+  if (str == NULL) {
+    return NULL;
+  }
+
+  /* Strings must be terminated within the cached range. */
+  max_length = entry->exports.export_size
+      - (rva - entry->exports.export_rva);
+  if (memchr(str, '\0', max_length) == NULL) {
+    return NULL;
+  }
+
+  return str;
+}
+
+static void ExportCacheEntry_Deinit(struct ExportCacheEntry* entry) {
+  PeFile_ExportData_Deinit(&entry->exports);
+
+  entry->module_base = NULL;
+}
+
+static struct ExportCacheEntry* AddExportCacheEntry(void) {
+  struct ExportCacheEntry* entry;
+
+  if (export_cache_count < kExportCacheCapacity) {
+    entry = &export_cache[export_cache_count];
+    export_cache_count += 1;
+  } else {
+    entry = &export_cache[export_cache_next_evict];
+    ExportCacheEntry_Deinit(entry);
+
+    export_cache_next_evict = (export_cache_next_evict + 1)
+        % kExportCacheCapacity;
+  }
+
+  return entry;
+}
+
+static int ReadExportDirectoryInfo(
+    HANDLE process,
+    BYTE* module_base,
+    DWORD* checksum,
+    DWORD* export_rva,
+    DWORD* export_size) {
+  IMAGE_DOS_HEADER dos_header;
+  union {
+    IMAGE_NT_HEADERS32 headers32;
+    IMAGE_NT_HEADERS64 headers64;
+  } nt_headers;
+  const IMAGE_DATA_DIRECTORY* export_directory;
+
+  if (!ReadRemote(process, module_base, &dos_header, sizeof(dos_header))) {
+    return 0;
+  }
+
+  if (dos_header.e_magic != IMAGE_DOS_SIGNATURE) {
+    return 0;
+  }
+
+  if (!ReadRemote(
+      process,
+      module_base + dos_header.e_lfanew,
+      &nt_headers,
+      sizeof(nt_headers))) {
+    return 0;
+  }
+
+  if (nt_headers.headers32.Signature != IMAGE_NT_SIGNATURE) {
+    return 0;
+  }
+
+  /* The optional header layout depends on the image's bitness. */
+  switch (nt_headers.headers32.OptionalHeader.Magic) {
+    case IMAGE_NT_OPTIONAL_HDR32_MAGIC: {
+      *checksum = nt_headers.headers32.OptionalHeader.CheckSum;
+      export_directory = &nt_headers.headers32.OptionalHeader
+          .DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+      break;
+    }
+
+    case IMAGE_NT_OPTIONAL_HDR64_MAGIC: {
+      *checksum = nt_headers.headers64.OptionalHeader.CheckSum;
+      export_directory = &nt_headers.headers64.OptionalHeader
+          .DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+      break;
+    }
+
+    default: {
+      return 0;
+    }
+  }
+
+  if (export_directory->VirtualAddress == 0
+      || export_directory->Size < sizeof(IMAGE_EXPORT_DIRECTORY)) {
+    return 0;
+  }
+
+  *export_rva = export_directory->VirtualAddress;
+  *export_size = export_directory->Size;
+
+  return 1;
+}
+
+static const struct ExportCacheEntry* GetExportCacheEntry(
+    HANDLE process,
+    BYTE* module_base) {
+  size_t i;
+
+  DWORD checksum;
+  DWORD export_rva;
+  DWORD export_size;
+  BYTE* export_data;
+  struct ExportCacheEntry* entry;
+
+  if (!ReadExportDirectoryInfo(
+      process,
+      module_base,
+      &checksum,
+      &export_rva,
+      &export_size)) {
+    return NULL;
+  }
+
+  for (i = 0; i < export_cache_count; ++i) {
+    if (export_cache[i].module_base == module_base
+        && export_cache[i].exports.checksum == checksum) {
+      return &export_cache[i];
+    }
+  }
+
+  /*
+   * Cache miss. The directory, its tables, and its name strings are
+   * laid out inside of the export data directory, so the whole walk
+   * needs a single remote read.
+   */
+  export_data = Mdc_malloc(export_size);
+  if (export_data == NULL) {
+    return NULL;
+  }
+
+  if (!ReadRemote(
+      process,
+      module_base + export_rva,
+      export_data,
+      export_size)) {
+    Mdc_free(export_data);
+    return NULL;
+  }
+
+  entry = AddExportCacheEntry();
+  entry->module_base = module_base;
+  entry->exports.checksum = checksum;
+  entry->exports.export_rva = export_rva;
+  entry->exports.export_size = export_size;
+  entry->exports.data = export_data;
+
+  return entry;
+}
+
+static int FindExportFunctionRva(
+    const struct ExportCacheEntry* entry,
+    const char* proc_name,
+    DWORD* function_rva) {
+  const IMAGE_EXPORT_DIRECTORY* directory;
+  const DWORD* name_rvas;
+  const WORD* name_ordinals;
+  const DWORD* function_rvas;
+
+  size_t low;
+  size_t high;
+
+  directory = ExportCacheEntry_GetData(
+      entry,
+      entry->exports.export_rva,
+      sizeof(*directory));
+  if (directory == NULL) {
+    return 0;
+  }
+
+  name_rvas = ExportCacheEntry_GetData(
+      entry,
+      directory->AddressOfNames,
+      directory->NumberOfNames * sizeof(name_rvas[0]));
+  name_ordinals = ExportCacheEntry_GetData(
+      entry,
+      directory->AddressOfNameOrdinals,
+      directory->NumberOfNames * sizeof(name_ordinals[0]));
+  function_rvas = ExportCacheEntry_GetData(
+      entry,
+      directory->AddressOfFunctions,
+      directory->NumberOfFunctions * sizeof(function_rvas[0]));
+
+  if (name_rvas == NULL || name_ordinals == NULL || function_rvas == NULL) {
+    return 0;
+  }
+
+  /* Export names are sorted, which allows for a binary search. */
+  low = 0;
+  high = directory->NumberOfNames;
+
+  while (low < high) {
+    size_t middle;
+    const char* name;
+    int compare_result;
+
+    middle = low + (high - low) / 2;
+
+    name = ExportCacheEntry_GetString(entry, name_rvas[middle]);
+    if (name == NULL) {
+      return 0;
+    }
+
+    compare_result = strcmp(proc_name, name);
+    if (compare_result == 0) {
+      if (name_ordinals[middle] >= directory->NumberOfFunctions) {
+        return 0;
+      }
+
+      *function_rva = function_rvas[name_ordinals[middle]];
+      return 1;
+    } else if (compare_result < 0) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+
+  return 0;
+}
+
+static void* GetProcAddressWithDepth(
+    const PROCESS_INFORMATION* process_info,
+    const wchar_t* module_name,
+    const char* proc_name,
+    size_t depth) {
+  size_t i;
+
+  BYTE* module_base;
+  const struct ExportCacheEntry* entry;
+  DWORD function_rva;
+  const char* forwarder;
+  const char* forwarder_separator;
+
+  wchar_t forward_module_name[kForwarderNameLength];
+  char forward_proc_name[kForwarderNameLength];
+  size_t forward_module_name_length;
+
+  if (depth >= kMaxForwardDepth) {
+    return NULL;
+  }
+
+  /*
+   * Only the modules that the target has mapped can be resolved, which
+   * a suspended target has not done yet for its system libraries.
+   */
+  module_base = FindRemoteModuleBase(process_info->dwProcessId, module_name);
+  if (module_base == NULL) {
+    return NULL;
+  }
+
+  entry = GetExportCacheEntry(process_info->hProcess, module_base);
+  if (entry == NULL) {
+    return NULL;
+  }
+
+  if (!FindExportFunctionRva(entry, proc_name, &function_rva)) {
+    return NULL;
+  }
+
+  /* Functions that point into the export directory are forwarders. */
+  forwarder = ExportCacheEntry_GetString(entry, function_rva);
+  if (forwarder == NULL) {
+    return module_base + function_rva;
+  }
+
+  /* Forwarders are formatted as "MODULE.Function". */
+  forwarder_separator = strrchr(forwarder, '.');
+  if (forwarder_separator == NULL
+      || forwarder_separator[1] == '#'
+      || strlen(forwarder_separator + 1) >= kForwarderNameLength) {
+    return NULL;
+  }
+
+  forward_module_name_length = forwarder_separator - forwarder;
+  if (forward_module_name_length + sizeof(".dll") > kForwarderNameLength) {
+    return NULL;
+  }
+
+  for (i = 0; i < forward_module_name_length; ++i) {
+    forward_module_name[i] = (unsigned char) forwarder[i];
+  }
+  forward_module_name[forward_module_name_length] = L'\0';
+  wcscat(forward_module_name, L".dll");
+
+  strcpy(forward_proc_name, forwarder_separator + 1);
+
+  return GetProcAddressWithDepth(
+      process_info,
+      forward_module_name,
+      forward_proc_name,
+      depth + 1);
+}
+
+/**
+ * External
+ */
+
+int RemoteExports_IsSameBitness(HANDLE process) {
+  return IsWow64(GetCurrentProcess()) == IsWow64(process);
+}
+
+void* RemoteExports_GetProcAddress(
+    const PROCESS_INFORMATION* process_info,
+    const wchar_t* module_name,
+    const char* proc_name) {
+  void* proc_address;
+
+  LockExportCache();
+  proc_address = GetProcAddressWithDepth(
+      process_info,
+      module_name,
+      proc_name,
+      0);
+  UnlockExportCache();
+
+  return proc_address;
+}
+
+void RemoteExports_ClearCache(void) {
+  size_t i;
+
+  LockExportCache();
+
+  for (i = 0; i < export_cache_count; ++i) {
+    ExportCacheEntry_Deinit(&export_cache[i]);
+  }
+
+  export_cache_count = 0;
+  export_cache_next_evict = 0;
+
+  UnlockExportCache();
+}
@@ -0,0 +1,66 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_REMOTE_EXPORTS_H_
+#define SGGL_REMOTE_EXPORTS_H_
+
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Returns nonzero if the target process has the same bitness as this
+ * program, which means that system libraries are mapped at the same
+ * address in both processes.
+ */
+int RemoteExports_IsSameBitness(HANDLE process);
+
+/**
+ * Returns the address of the exported function inside of the target
+ * process, by reading the module's export table directly from the
+ * target's memory. Returns NULL if the target has not mapped the module,
+ * which is the case for a suspended target's system libraries, or if
+ * the module does not export the function.
+ */
+void* RemoteExports_GetProcAddress(
+    const PROCESS_INFORMATION* process_info,
+    const wchar_t* module_name,
+    const char* proc_name);
+
+void RemoteExports_ClearCache(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_REMOTE_EXPORTS_H_ */
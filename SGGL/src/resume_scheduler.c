@@ -0,0 +1,401 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "resume_scheduler.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#include "platform.h"
+
+enum {
+  /* Wave waits use WaitForMultipleObjects, one event per instance. */
+  kMaxWaveSize = MAXIMUM_WAIT_OBJECTS
+};
+
+enum InstanceState {
+  kInstanceState_Pending,
+  kInstanceState_Ready,
+  kInstanceState_Exited
+};
+
+struct WindowSearch {
+  DWORD process_id;
+  int is_found;
+};
+
+typedef BOOL WINAPI GetSystemTimesFuncType(FILETIME*, FILETIME*, FILETIME*);
+
+static ULONGLONG FileTimeToULongLong(const FILETIME* file_time) {
+  return ((ULONGLONG) file_time->dwHighDateTime << 32)
+      | file_time->dwLowDateTime;
+}
+
+static DWORD GetElapsedMicroseconds(const LARGE_INTEGER* start_time) {
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER end_time;
+
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&end_time);
+
+  return (DWORD) ((end_time.QuadPart - start_time->QuadPart)
+      * 1000000 / frequency.QuadPart);
+}
+
+/**
+ * Queries the idle and total CPU time of all processors. Returns zero
+ * if GetSystemTimes is not available, which is before Windows XP SP1.
+ */
+static int QuerySystemTimes(ULONGLONG* idle_time, ULONGLONG* total_time) {
+  GetSystemTimesFuncType* get_system_times_func;
+  FILETIME idle_file_time;
+  FILETIME kernel_file_time;
+  FILETIME user_file_time;
+  BOOL is_get_system_times_success;
+
+  get_system_times_func = (GetSystemTimesFuncType*) GetProcAddress(
+      GetModuleHandleW(L"kernel32.dll"),
+      "GetSystemTimes");
+  if (get_system_times_func == NULL) {
+    return 0;
+  }
+
+  is_get_system_times_success = get_system_times_func(
+      &idle_file_time,
+      &kernel_file_time,
+      &user_file_time);
+  if (!is_get_system_times_success) {
+    return 0;
+  }
+
+  /* Kernel time already includes the idle time. */
+  *idle_time = FileTimeToULongLong(&idle_file_time);
+  *total_time = FileTimeToULongLong(&kernel_file_time)
+      + FileTimeToULongLong(&user_file_time);
+
+  return 1;
+}
+
+static BOOL CALLBACK FindVisibleWindow(HWND window, LPARAM param) {
+  struct WindowSearch* search;
+  DWORD window_process_id;
+
+  search = (struct WindowSearch*) param;
+
+  GetWindowThreadProcessId(window, &window_process_id);
+  if (window_process_id == search->process_id && IsWindowVisible(window)) {
+    search->is_found = 1;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+ * Returns nonzero if the process shows a top-level window and has
+ * finished processing its startup input.
+ */
+static int IsWindowReady(const PROCESS_INFORMATION* process_info) {
+  struct WindowSearch search;
+
+  search.process_id = process_info->dwProcessId;
+  search.is_found = 0;
+
+  EnumWindows(&FindVisibleWindow, (LPARAM) &search);
+  if (!search.is_found) {
+    return 0;
+  }
+
+  return WaitForInputIdle(process_info->hProcess, 0) == 0;
+}
+
+static enum InstanceState PollInstance(
+    const PROCESS_INFORMATION* process_info,
+    struct ControlChannel* control_channel,
+    ControlChannelEventFunc* on_event) {
+  struct ControlChannelEvent event;
+
+  while (ControlChannel_Pop(control_channel, &event)) {
+    if (on_event != NULL) {
+      on_event(control_channel->instance_index, &event);
+    }
+
+    if (event.type == ControlChannel_kEventType_Ready) {
+      return kInstanceState_Ready;
+    }
+  }
+
+  if (IsWindowReady(process_info)) {
+    return kInstanceState_Ready;
+  }
+
+  if (WaitForSingleObject(process_info->hProcess, 0) == WAIT_OBJECT_0) {
+    return kInstanceState_Exited;
+  }
+
+  return kInstanceState_Pending;
+}
+
+/**
+ * Waits until every instance in the wave is ready or has exited, or
+ * until the timeout elapses. Returns the number of ready instances.
+ */
+static size_t WaitForWave(
+    const PROCESS_INFORMATION* processes_infos,
+    struct ControlChannel* control_channels,
+    size_t first_instance_index,
+    size_t num_instances,
+    DWORD timeout_milliseconds,
+    ControlChannelEventFunc* on_event,
+    int* is_ready_instances,
+    int* is_timed_out) {
+  size_t i_wave_instance;
+  size_t i_instance;
+  int is_done_instances[kMaxWaveSize];
+  HANDLE events[kMaxWaveSize];
+  DWORD num_events;
+  size_t num_pending;
+  size_t num_ready;
+  DWORD start_tick_count;
+  DWORD elapsed_milliseconds;
+  DWORD wait_milliseconds;
+  enum InstanceState state;
+
+  for (i_wave_instance = 0;
+      i_wave_instance < num_instances;
+      ++i_wave_instance) {
+    is_done_instances[i_wave_instance] = 0;
+  }
+
+  num_ready = 0;
+  *is_timed_out = 0;
+  start_tick_count = GetTickCount();
+
+  for (;;) {
+    num_pending = 0;
+    num_events = 0;
+
+    for (i_wave_instance = 0;
+        i_wave_instance < num_instances;
+        ++i_wave_instance) {
+      if (is_done_instances[i_wave_instance]) {
+        continue;
+      }
+
+      i_instance = first_instance_index + i_wave_instance;
+
+      state = PollInstance(
+          &processes_infos[i_instance],
+          &control_channels[i_instance],
+          on_event);
+
+      if (state == kInstanceState_Ready) {
+        is_ready_instances[i_instance] = 1;
+        is_done_instances[i_wave_instance] = 1;
+        num_ready += 1;
+      } else if (state == kInstanceState_Exited) {
+        is_done_instances[i_wave_instance] = 1;
+      } else {
+        num_pending += 1;
+
+        if (control_channels[i_instance].event != NULL) {
+          events[num_events] = control_channels[i_instance].event;
+          num_events += 1;
+        }
+      }
+    }
+
+    if (num_pending == 0) {
+      return num_ready;
+    }
+
+    elapsed_milliseconds = GetTickCount() - start_tick_count;
+    if (elapsed_milliseconds >= timeout_milliseconds) {
+      *is_timed_out = 1;
+      return num_ready;
+    }
+
+    /*
+     * Wake up on the next control channel push, or on the next poll for
+     * windows and exits.
+     */
+    wait_milliseconds = timeout_milliseconds - elapsed_milliseconds;
+    if (wait_milliseconds > ResumeScheduler_kPollMilliseconds) {
+      wait_milliseconds = ResumeScheduler_kPollMilliseconds;
+    }
+
+    if (num_events > 0) {
+      WaitForMultipleObjects(num_events, events, FALSE, wait_milliseconds);
+    } else {
+      Sleep(wait_milliseconds);
+    }
+  }
+}
+
+/**
+ * External
+ */
+
+void ResumeScheduler_Run(
+    const PROCESS_INFORMATION* processes_infos,
+    struct ControlChannel* control_channels,
+    size_t num_instances,
+    size_t initial_wave_size,
+    DWORD wave_timeout_milliseconds,
+    ResumeSchedulerResumeFunc* resume_func,
+    ControlChannelEventFunc* on_event,
+    const LARGE_INTEGER* launch_start_time,
+    int* is_ready_instances,
+    DWORD* resume_microseconds) {
+  size_t i_instance;
+  size_t first_instance_index;
+  size_t wave_size;
+  size_t num_wave_instances;
+  size_t num_ready;
+  size_t num_waves;
+  int is_timed_out;
+  LARGE_INTEGER wave_start_time;
+  DWORD wave_elapsed_microseconds;
+  int is_load_measured;
+  ULONGLONG start_idle_time;
+  ULONGLONG start_total_time;
+  ULONGLONG end_idle_time;
+  ULONGLONG end_total_time;
+  DWORD load_percent;
+
+  wave_size = initial_wave_size;
+  if (wave_size < 1) {
+    wave_size = 1;
+  } else if (wave_size > kMaxWaveSize) {
+    wave_size = kMaxWaveSize;
+  }
+
+  wprintf(L"Resuming processes in waves, starting with %u...\n", wave_size);
+
+  num_waves = 0;
+
+  for (first_instance_index = 0;
+      first_instance_index < num_instances;
+      first_instance_index += num_wave_instances) {
+    num_wave_instances = num_instances - first_instance_index;
+    if (num_wave_instances > wave_size) {
+      num_wave_instances = wave_size;
+    }
+
+    QueryPerformanceCounter(&wave_start_time);
+    is_load_measured = QuerySystemTimes(&start_idle_time, &start_total_time);
+
+    for (i_instance = first_instance_index;
+        i_instance < first_instance_index + num_wave_instances;
+        ++i_instance) {
+      resume_func(&processes_infos[i_instance]);
+      resume_microseconds[i_instance] =
+          GetElapsedMicroseconds(launch_start_time);
+    }
+
+    /* Replayed handles do not refer to real processes or windows. */
+    num_ready = 0;
+    is_timed_out = 0;
+    if (!Platform_IsReplaying()) {
+      num_ready = WaitForWave(
+          processes_infos,
+          control_channels,
+          first_instance_index,
+          num_wave_instances,
+          wave_timeout_milliseconds,
+          on_event,
+          is_ready_instances,
+          &is_timed_out);
+    }
+
+    wave_elapsed_microseconds = GetElapsedMicroseconds(&wave_start_time);
+
+    load_percent = 0;
+    if (is_load_measured) {
+      is_load_measured = QuerySystemTimes(&end_idle_time, &end_total_time)
+          && end_total_time > start_total_time;
+    }
+
+    if (is_load_measured
+        && end_idle_time - start_idle_time
+            < end_total_time - start_total_time) {
+      load_percent = (DWORD) (100
+          - (end_idle_time - start_idle_time) * 100
+              / (end_total_time - start_total_time));
+    }
+
+    if (is_load_measured) {
+      wprintf(
+          L"Wave %u: instances %u to %u, %u ready%ls after %lu "
+              L"microseconds, CPU load %lu%%.\n",
+          num_waves,
+          first_instance_index,
+          first_instance_index + num_wave_instances - 1,
+          num_ready,
+          is_timed_out ? L" (timed out)" : L"",
+          wave_elapsed_microseconds,
+          load_percent);
+    } else {
+      wprintf(
+          L"Wave %u: instances %u to %u, %u ready%ls after %lu "
+              L"microseconds.\n",
+          num_waves,
+          first_instance_index,
+          first_instance_index + num_wave_instances - 1,
+          num_ready,
+          is_timed_out ? L" (timed out)" : L"",
+          wave_elapsed_microseconds);
+    }
+
+    num_waves += 1;
+
+    /*
+     * Back off when the wave saturated the system or did not become
+     * ready in time. Otherwise, release more instances at once.
+     */
+    if (is_timed_out
+        || (is_load_measured
+            && load_percent >= ResumeScheduler_kShrinkLoadPercent)) {
+      wave_size = (wave_size > 1) ? wave_size / 2 : 1;
+    } else if (!is_load_measured
+        || load_percent < ResumeScheduler_kGrowLoadPercent) {
+      wave_size = (wave_size * 2 < kMaxWaveSize)
+          ? wave_size * 2
+          : kMaxWaveSize;
+    }
+  }
+
+  wprintf(
+      L"%u instance(s) resumed in %u wave(s).\n\n",
+      num_instances,
+      num_waves);
+}
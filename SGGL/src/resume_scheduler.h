@@ -0,0 +1,94 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_RESUME_SCHEDULER_H_
+#define SGGL_RESUME_SCHEDULER_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#include "control_channel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum {
+  ResumeScheduler_kDefaultWaveTimeoutMilliseconds = 10000,
+
+  /*
+   * The wave size doubles while the system's CPU load stays below the
+   * first percentage, and halves when it reaches the second.
+   */
+  ResumeScheduler_kGrowLoadPercent = 60,
+  ResumeScheduler_kShrinkLoadPercent = 90,
+
+  /* How often instances without a ready event are checked. */
+  ResumeScheduler_kPollMilliseconds = 50
+};
+
+/**
+ * Resumes one suspended instance.
+ */
+typedef void ResumeSchedulerResumeFunc(
+    const PROCESS_INFORMATION* process_info);
+
+/**
+ * Resumes the instances in waves. The first wave holds initial_wave_size
+ * instances. Each next wave starts once every instance in the previous
+ * wave is ready or has exited, or once the wave timeout elapses. An
+ * instance is ready when it pushes a ready event into its control
+ * channel, or when it shows a window and is idle waiting for input.
+ *
+ * The wave size adapts to the CPU load measured during each wave, and
+ * shrinks after a wave times out. The timings of each wave are printed.
+ *
+ * For each instance, is_ready_instances receives whether it became
+ * ready, and resume_microseconds receives the time from launch_start_time
+ * until it was resumed.
+ */
+void ResumeScheduler_Run(
+    const PROCESS_INFORMATION* processes_infos,
+    struct ControlChannel* control_channels,
+    size_t num_instances,
+    size_t initial_wave_size,
+    DWORD wave_timeout_milliseconds,
+    ResumeSchedulerResumeFunc* resume_func,
+    ControlChannelEventFunc* on_event,
+    const LARGE_INTEGER* launch_start_time,
+    int* is_ready_instances,
+    DWORD* resume_microseconds);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_RESUME_SCHEDULER_H_ */
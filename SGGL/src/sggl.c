@@ -0,0 +1,2324 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "sggl.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+#include <mdc/wchar_t/filew.h>
+
+#include "admission.h"
+#include "agent_client.h"
+#include "attach.h"
+#include "args_parser.h"
+#include "args_validator.h"
+#include "control_channel.h"
+#include "deferred_injector.h"
+#include "game_loader.h"
+#include "instance_boxes.h"
+#include "instance_job.h"
+#include "instance_registry.h"
+#include "instance_result.h"
+#include "knowledge_library.h"
+#include "launch_context.h"
+#include "library_injector.h"
+#include "library_set.h"
+#include "metrics.h"
+#include "monitor.h"
+#include "output_capture.h"
+#include "placement.h"
+#include "platform.h"
+#include "prefetch.h"
+#include "remote_exports.h"
+#include "resume_scheduler.h"
+#include "stack_sampler.h"
+#include "startup.h"
+
+enum {
+  kLaunchLockNameLength = 64
+};
+
+/**
+ * Takes the lock that lets only one launch run at a time in the
+ * process. The trace, the metrics and the export cache are shared by
+ * the whole process, so launches that overlap would corrupt each other.
+ * The lock is named after the process, so that every launch finds it
+ * without any setup. Returns NULL on failure.
+ */
+static HANDLE LockLaunches(void) {
+  wchar_t lock_name[kLaunchLockNameLength];
+  HANDLE lock;
+  DWORD wait_result;
+
+  _snwprintf(
+      lock_name,
+      kLaunchLockNameLength,
+      L"SGGL.Launch.%lu",
+      GetCurrentProcessId());
+  lock_name[kLaunchLockNameLength - 1] = L'\0';
+
+  lock = CreateMutexW(NULL, FALSE, lock_name);
+  if (lock == NULL) {
+    return NULL;
+  }
+
+  /* A launch thread that was terminated cannot have left state behind. */
+  wait_result = WaitForSingleObject(lock, INFINITE);
+  if (wait_result != WAIT_OBJECT_0 && wait_result != WAIT_ABANDONED) {
+    CloseHandle(lock);
+    return NULL;
+  }
+
+  return lock;
+}
+
+static void UnlockLaunches(HANDLE lock) {
+  ReleaseMutex(lock);
+  CloseHandle(lock);
+}
+
+static const wchar_t* GetInjectModeName(enum LibraryInjector_Mode mode) {
+  switch (mode) {
+    case LibraryInjector_kMode_ImportTable: {
+      return L"import table";
+    }
+
+    default: {
+      return L"remote thread";
+    }
+  }
+}
+
+static DWORD GetElapsedMicroseconds(const LARGE_INTEGER* start_time) {
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER end_time;
+
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&end_time);
+
+  return (DWORD) ((end_time.QuadPart - start_time->QuadPart)
+      * 1000000 / frequency.QuadPart);
+}
+
+/**
+ * Records the error that stopped the whole launch. Only the first error
+ * is kept, since later ones tend to follow from it.
+ */
+static void SetLaunchError(
+    struct Sggl_Launch* launch,
+    const wchar_t* error_message,
+    DWORD last_error) {
+  if (launch->error_message != NULL) {
+    return;
+  }
+
+  launch->error_message = error_message;
+  launch->last_error = last_error;
+}
+
+static void EmitInstanceEvent(
+    struct Sggl_Launch* launch,
+    enum Sggl_EventType type,
+    const struct InstanceResult* result) {
+  struct Sggl_Event event;
+
+  if (launch->event_func == NULL) {
+    return;
+  }
+
+  event.type = type;
+  event.result = result;
+  event.library_path = NULL;
+  event.is_success = !result->is_failed;
+  event.elapsed_microseconds = GetElapsedMicroseconds(&launch->start_time);
+
+  launch->event_func(&event, launch->user_data);
+}
+
+static void EmitLibraryEvent(
+    void* context,
+    const struct InstanceResult* result,
+    const wchar_t* library_path,
+    int is_success) {
+  struct Sggl_Launch* launch;
+  struct Sggl_Event event;
+
+  launch = context;
+  if (launch->event_func == NULL) {
+    return;
+  }
+
+  event.type = Sggl_kEventType_LibraryInjected;
+  event.result = result;
+  event.library_path = library_path;
+  event.is_success = is_success;
+  event.elapsed_microseconds = GetElapsedMicroseconds(&launch->start_time);
+
+  launch->event_func(&event, launch->user_data);
+}
+
+/**
+ * Stores the results of the running and failed instances in the
+ * launch, in instance number order.
+ */
+static void CollectResults(
+    struct Sggl_Launch* launch,
+    const struct InstanceResult* running_results,
+    size_t num_running,
+    const struct InstanceResult* failed_results,
+    size_t num_failed) {
+  size_t i_running;
+  size_t i_failed;
+
+  i_running = 0;
+  i_failed = 0;
+  launch->num_results = 0;
+  while (i_running < num_running || i_failed < num_failed) {
+    if (i_failed >= num_failed
+        || (i_running < num_running
+            && running_results[i_running].instance_number
+                < failed_results[i_failed].instance_number)) {
+      launch->results[launch->num_results] = running_results[i_running];
+      i_running += 1;
+    } else {
+      launch->results[launch->num_results] = failed_results[i_failed];
+      i_failed += 1;
+    }
+
+    launch->num_results += 1;
+  }
+}
+
+/**
+ * The inputs and outputs of the startup phases that run alongside
+ * process creation. None of the inputs change while the phases run.
+ */
+struct StartupInputs {
+  struct LaunchContext* context;
+  const struct ParsedArgs* args;
+
+  struct InstanceBoxes* instance_boxes;
+  size_t num_instance_boxes;
+  struct InstanceBoxes* init_instance_boxes_result;
+
+  int is_libraries_valid;
+};
+
+/**
+ * Loads the Knowledge library into the launch context. The phase is
+ * joined before any game instance is created, and before anything else
+ * reads the context's Knowledge binding.
+ */
+static void InitKnowledgePhase(void* context) {
+  const struct StartupInputs* inputs;
+
+  inputs = context;
+  Knowledge_Init(
+      &inputs->context->knowledge,
+      inputs->args->knowledge_library_path,
+      inputs->args->game_path);
+}
+
+static void BuildInstanceBoxesPhase(void* context) {
+  struct StartupInputs* inputs;
+
+  inputs = context;
+  inputs->init_instance_boxes_result = InstanceBoxes_Init(
+      inputs->instance_boxes,
+      inputs->args->game_path,
+      inputs->args->box_directory_path,
+      inputs->args->box_writable_list_path,
+      inputs->args->box_environment_path,
+      inputs->num_instance_boxes);
+}
+
+static void PrefetchPhase(void* context) {
+  const struct StartupInputs* inputs;
+
+  inputs = context;
+  Prefetch_Run(
+      inputs->args->game_path,
+      inputs->args->inject_library_paths,
+      inputs->args->inject_library_paths_count,
+      inputs->args->prefetch_list_path);
+}
+
+static void CheckLibrariesPhase(void* context) {
+  struct StartupInputs* inputs;
+  int is_inject_libraries_valid;
+  int is_deferred_libraries_valid;
+
+  inputs = context;
+  is_inject_libraries_valid = LibraryInjector_CheckLibraryFiles(
+      inputs->args->game_path,
+      inputs->args->inject_library_paths,
+      inputs->args->inject_library_paths_count);
+  is_deferred_libraries_valid = LibraryInjector_CheckLibraryFiles(
+      inputs->args->game_path,
+      inputs->args->deferred_library_paths,
+      inputs->args->deferred_library_paths_count);
+
+  inputs->is_libraries_valid = is_inject_libraries_valid
+      && is_deferred_libraries_valid;
+}
+
+/**
+ * Joins the startup phases, which injection depends on, and prints the
+ * game info that the Knowledge library was loaded for.
+ */
+static void FinishStartup(
+    struct Startup* startup,
+    struct LaunchContext* context) {
+  Startup_PrintSummary(startup);
+  Startup_Deinit(startup);
+
+  Knowledge_PrintGameInfo(&context->knowledge);
+}
+
+static void PrintControlChannelEvent(
+    size_t instance_index,
+    const struct ControlChannelEvent* event) {
+  switch (event->type) {
+    case ControlChannel_kEventType_Status: {
+      wprintf(
+          L"Instance %u reported status %lu.\n",
+          instance_index,
+          event->value);
+      break;
+    }
+
+    case ControlChannel_kEventType_Ready: {
+      wprintf(L"Instance %u reported ready.\n", instance_index);
+      break;
+    }
+
+    default: {
+      break;
+    }
+  }
+}
+
+static void InitInstanceChannels(
+    const struct ParsedArgs* args,
+    const PROCESS_INFORMATION* processes_infos,
+    const struct InstanceResult* instance_results,
+    struct ControlChannel* control_channels,
+    struct AgentClient* agent_clients,
+    size_t first_instance_index,
+    size_t num_instances,
+    size_t instance_count) {
+  size_t i;
+
+  /*
+   * Create the control channels before injecting, so that injected
+   * libraries can open them from DllMain.
+   */
+  for (i = first_instance_index;
+      i < first_instance_index + num_instances;
+      ++i) {
+    struct ControlChannel* init_control_channel_result;
+
+    init_control_channel_result = ControlChannel_Init(
+        &control_channels[i],
+        processes_infos[i].dwProcessId,
+        instance_results[i].instance_number,
+        instance_count,
+        args->profile_name);
+    if (init_control_channel_result == NULL) {
+      wprintf(
+          L"Control channel for instance %u could not be created.\n",
+          instance_results[i].instance_number);
+    }
+  }
+
+  /* Set up the agent queues before the agent library is injected. */
+  if (args->agent_library_path != NULL) {
+    for (i = first_instance_index;
+        i < first_instance_index + num_instances;
+        ++i) {
+      struct AgentClient* init_agent_client_result;
+
+      init_agent_client_result = AgentClient_Init(
+          &agent_clients[i],
+          processes_infos[i].dwProcessId);
+      if (init_agent_client_result == NULL) {
+        wprintf(
+            L"Agent queue for instance %u could not be created.\n",
+            instance_results[i].instance_number);
+      }
+    }
+  }
+}
+
+/**
+ * Injects the same libraries into every instance.
+ */
+static int InjectInstanceGroup(
+    struct LaunchContext* context,
+    const struct ParsedArgs* args,
+    const PROCESS_INFORMATION* processes_infos,
+    struct AgentClient* agent_clients,
+    size_t num_instances,
+    struct InstanceResult* results,
+    const wchar_t** library_paths,
+    size_t num_libraries,
+    int* is_knowledge_override_inject) {
+  size_t i;
+  int is_inject_libraries_success;
+  int is_any_agent_failed;
+  const wchar_t* agent_library_path;
+  DWORD agent_timeout_milliseconds;
+
+  *is_knowledge_override_inject = Knowledge_InjectLibrariesToProcesses(
+      &context->knowledge,
+      library_paths,
+      num_libraries,
+      processes_infos,
+      num_instances);
+
+  if (*is_knowledge_override_inject) {
+    return 1;
+  }
+
+  if (args->agent_library_path != NULL) {
+    /*
+     * Only the agent is injected with a remote thread. Every other
+     * library is a command posted to the agent's queue.
+     */
+    agent_library_path = args->agent_library_path;
+    wprintf(L"Injecting agent from %ls\n", agent_library_path);
+
+    /*
+     * An agent that never starts or never answers must not block the
+     * launch, so its instance is failed once the timeout elapses.
+     */
+    agent_timeout_milliseconds = (args->ready_timeout_milliseconds > 0)
+        ? args->ready_timeout_milliseconds
+        : AgentClient_kDefaultTimeoutMilliseconds;
+
+    is_inject_libraries_success = LibraryInjector_InjectToProcesses(
+        &context->injector,
+        &agent_library_path,
+        1,
+        processes_infos,
+        num_instances,
+        results);
+
+    is_any_agent_failed = 0;
+    for (i = 0; i < num_instances; ++i) {
+      is_any_agent_failed = results[i].is_failed || is_any_agent_failed;
+    }
+
+    if (!is_any_agent_failed) {
+      is_inject_libraries_success = AgentClient_LoadLibraries(
+          agent_clients,
+          num_instances,
+          library_paths,
+          num_libraries,
+          agent_timeout_milliseconds,
+          results) && is_inject_libraries_success;
+    } else {
+      /* Instances without an agent would never answer their commands. */
+      for (i = 0; i < num_instances; ++i) {
+        if (results[i].is_failed) {
+          continue;
+        }
+
+        is_inject_libraries_success = AgentClient_LoadLibraries(
+            &agent_clients[i],
+            1,
+            library_paths,
+            num_libraries,
+            agent_timeout_milliseconds,
+            &results[i]) && is_inject_libraries_success;
+      }
+    }
+  } else if (args->inject_mode == LibraryInjector_kMode_ImportTable) {
+    is_inject_libraries_success =
+        LibraryInjector_InjectToProcessesByImportTable(
+            &context->injector,
+            library_paths,
+            num_libraries,
+            processes_infos,
+            num_instances,
+            results);
+  } else {
+    is_inject_libraries_success = LibraryInjector_InjectToProcesses(
+        &context->injector,
+        library_paths,
+        num_libraries,
+        processes_infos,
+        num_instances,
+        results);
+  }
+
+  return is_inject_libraries_success;
+}
+
+/**
+ * Returns nonzero if some library is only injected into some of the
+ * instances.
+ */
+static int IsAnyLibraryPerInstance(const struct ParsedArgs* args) {
+  size_t i;
+
+  for (i = 0; i < args->inject_library_paths_count; ++i) {
+    if (!LibrarySet_IsAll(&args->inject_library_sets[i])) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Injects each instance with the libraries of its set. Instances with
+ * the same libraries are injected together, so that a launch where
+ * every instance has the same libraries is injected as one group.
+ */
+static int InjectInstances(
+    struct LaunchContext* context,
+    const struct ParsedArgs* args,
+    const PROCESS_INFORMATION* processes_infos,
+    struct AgentClient* agent_clients,
+    size_t num_instances,
+    struct InstanceResult* results,
+    int* is_knowledge_override_inject) {
+  size_t i;
+  size_t j;
+  int is_inject_libraries_success;
+  int is_inject_group_success;
+  int is_grouped_instances[GameLoader_kMaxInstances];
+  size_t group_indices[GameLoader_kMaxInstances];
+  PROCESS_INFORMATION group_processes_infos[GameLoader_kMaxInstances];
+  struct AgentClient group_agent_clients[GameLoader_kMaxInstances];
+  struct InstanceResult group_results[GameLoader_kMaxInstances];
+  size_t num_group_instances;
+  const wchar_t** group_library_paths;
+  size_t num_group_libraries;
+  const wchar_t** instance_library_paths;
+  size_t num_instance_libraries;
+
+  if (!IsAnyLibraryPerInstance(args)) {
+    return InjectInstanceGroup(
+        context,
+        args,
+        processes_infos,
+        agent_clients,
+        num_instances,
+        results,
+        args->inject_library_paths,
+        args->inject_library_paths_count,
+        is_knowledge_override_inject);
+  }
+
+  group_library_paths = Mdc_malloc(
+      args->inject_library_paths_count * sizeof(group_library_paths[0]));
+  if (group_library_paths == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_return;
+  }
+
+  instance_library_paths = Mdc_malloc(
+      args->inject_library_paths_count * sizeof(instance_library_paths[0]));
+  if (instance_library_paths == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_group_library_paths;
+  }
+
+  memset(is_grouped_instances, 0, sizeof(is_grouped_instances));
+
+  is_inject_libraries_success = 1;
+  for (i = 0; i < num_instances; ++i) {
+    if (is_grouped_instances[i]) {
+      continue;
+    }
+
+    num_group_libraries = LibrarySet_GetInstanceLibraries(
+        args->inject_library_paths,
+        args->inject_library_sets,
+        args->inject_library_paths_count,
+        results[i].instance_number,
+        group_library_paths);
+
+    /* Gather the remaining instances that have the same libraries. */
+    num_group_instances = 0;
+    for (j = i; j < num_instances; ++j) {
+      if (is_grouped_instances[j]) {
+        continue;
+      }
+
+      num_instance_libraries = LibrarySet_GetInstanceLibraries(
+          args->inject_library_paths,
+          args->inject_library_sets,
+          args->inject_library_paths_count,
+          results[j].instance_number,
+          instance_library_paths);
+      if (num_instance_libraries != num_group_libraries
+          || memcmp(
+              instance_library_paths,
+              group_library_paths,
+              num_instance_libraries * sizeof(instance_library_paths[0]))
+              != 0) {
+        continue;
+      }
+
+      is_grouped_instances[j] = 1;
+      group_indices[num_group_instances] = j;
+      group_processes_infos[num_group_instances] = processes_infos[j];
+      group_agent_clients[num_group_instances] = agent_clients[j];
+      group_results[num_group_instances] = results[j];
+      num_group_instances += 1;
+    }
+
+    is_inject_group_success = InjectInstanceGroup(
+        context,
+        args,
+        group_processes_infos,
+        group_agent_clients,
+        num_group_instances,
+        group_results,
+        group_library_paths,
+        num_group_libraries,
+        is_knowledge_override_inject);
+    is_inject_libraries_success =
+        is_inject_group_success && is_inject_libraries_success;
+
+    for (j = 0; j < num_group_instances; ++j) {
+      agent_clients[group_indices[j]] = group_agent_clients[j];
+      results[group_indices[j]] = group_results[j];
+    }
+  }
+
+  Mdc_free(instance_library_paths);
+  Mdc_free(group_library_paths);
+
+  return is_inject_libraries_success;
+
+bad_free_group_library_paths:
+  Mdc_free(group_library_paths);
+
+bad_return:
+  return 0;
+}
+
+/**
+ * Confirms the libraries that the instances queued in their import
+ * tables, which the OS loader only maps after the instances are
+ * resumed. Returns zero if some library was not loaded.
+ */
+static int ConfirmImportedLibraries(
+    struct LaunchContext* context,
+    const struct ParsedArgs* args,
+    const PROCESS_INFORMATION* processes_infos,
+    const struct InstanceResult* results,
+    size_t num_instances) {
+  size_t i;
+  int is_all_loaded;
+  const wchar_t** instance_library_paths;
+  size_t num_instance_libraries;
+
+  if (args->inject_library_paths_count == 0) {
+    return 1;
+  }
+
+  instance_library_paths = Mdc_malloc(
+      args->inject_library_paths_count * sizeof(instance_library_paths[0]));
+  if (instance_library_paths == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    return 0;
+  }
+
+  is_all_loaded = 1;
+  for (i = 0; i < num_instances; ++i) {
+    num_instance_libraries = LibrarySet_GetInstanceLibraries(
+        args->inject_library_paths,
+        args->inject_library_sets,
+        args->inject_library_paths_count,
+        results[i].instance_number,
+        instance_library_paths);
+
+    is_all_loaded = LibraryInjector_ConfirmImportedLibraries(
+        &context->injector,
+        instance_library_paths,
+        num_instance_libraries,
+        &processes_infos[i],
+        &results[i]) && is_all_loaded;
+  }
+
+  Mdc_free(instance_library_paths);
+
+  return is_all_loaded;
+}
+
+static void ResumeInstance(const PROCESS_INFORMATION* process_info) {
+  struct MetricsTimer resume_timer;
+  DWORD resume_thread_result;
+
+  MetricsTimer_Start(&resume_timer);
+  resume_thread_result = Platform_ResumeThread(process_info->hThread);
+  Metrics_ObserveResume(&resume_timer, resume_thread_result != (DWORD) -1);
+}
+
+/**
+ * Terminates the instances in the range whose launch failed, and moves
+ * the remaining instances down so that the running instances stay
+ * contiguous. The channels and agents are moved with their instances,
+ * unless they are NULL. Returns the number of instances that remain in
+ * the range.
+ */
+static size_t RemoveFailedInstances(
+    struct Sggl_Launch* launch,
+    PROCESS_INFORMATION* processes_infos,
+    struct ControlChannel* control_channels,
+    struct AgentClient* agent_clients,
+    struct InstanceResult* results,
+    size_t first_instance_index,
+    size_t num_instances,
+    struct InstanceResult* failed_results,
+    size_t* num_failed_instances) {
+  size_t i;
+  size_t i_failed;
+  size_t num_running_instances;
+
+  num_running_instances = 0;
+
+  for (i = first_instance_index;
+      i < first_instance_index + num_instances;
+      ++i) {
+    size_t running_index;
+
+    if (!results[i].is_failed) {
+      running_index = first_instance_index + num_running_instances;
+
+      processes_infos[running_index] = processes_infos[i];
+      results[running_index] = results[i];
+
+      if (control_channels != NULL) {
+        control_channels[running_index] = control_channels[i];
+      }
+
+      if (agent_clients != NULL) {
+        agent_clients[running_index] = agent_clients[i];
+      }
+
+      num_running_instances += 1;
+      continue;
+    }
+
+    EmitInstanceEvent(launch, Sggl_kEventType_InstanceFailed, &results[i]);
+    Metrics_RemoveInstance(processes_infos[i].dwProcessId);
+
+    /* The instance is still suspended, so none of its code has run. */
+    if (processes_infos[i].hProcess != NULL) {
+      Platform_TerminateProcess(processes_infos[i].hProcess, 1);
+      Platform_CloseHandle(processes_infos[i].hThread);
+      Platform_CloseHandle(processes_infos[i].hProcess);
+    }
+
+    if (control_channels != NULL) {
+      ControlChannel_Deinit(&control_channels[i]);
+    }
+
+    if (agent_clients != NULL) {
+      AgentClient_Deinit(&agent_clients[i]);
+    }
+
+    /* Keep the failed instances in instance number order. */
+    for (i_failed = *num_failed_instances;
+        i_failed > 0
+            && failed_results[i_failed - 1].instance_number
+                > results[i].instance_number;
+        --i_failed) {
+      failed_results[i_failed] = failed_results[i_failed - 1];
+    }
+
+    failed_results[i_failed] = results[i];
+    *num_failed_instances += 1;
+  }
+
+  return num_running_instances;
+}
+
+/**
+ * Injects the libraries into processes that are already running,
+ * instead of creating game instances. Returns nonzero if every library
+ * is loaded in every process.
+ */
+static int AttachAndInject(
+    struct Sggl_Launch* launch,
+    struct LaunchContext* context,
+    const struct ParsedArgs* args) {
+  size_t i;
+  PROCESS_INFORMATION processes_infos[Attach_kMaxProcesses];
+  struct InstanceResult results[Attach_kMaxProcesses];
+  struct InstanceResult failed_results[Attach_kMaxProcesses];
+  size_t num_processes;
+  size_t num_running_processes;
+  size_t num_failed_processes;
+  int is_inject_libraries_success;
+
+  num_processes = Attach_OpenProcesses(
+      processes_infos,
+      args->attach_process_ids,
+      args->num_attach_process_ids,
+      args->attach_image_name);
+  if (num_processes == 0) {
+    wprintf(L"No process to attach to was found.\n\n");
+    return 0;
+  }
+
+  for (i = 0; i < num_processes; ++i) {
+    InstanceResult_Init(&results[i], i);
+    results[i].process_id = processes_infos[i].dwProcessId;
+  }
+
+  is_inject_libraries_success = Attach_InjectLibraries(
+      &context->injector,
+      args->inject_library_paths,
+      args->inject_library_paths_count,
+      processes_infos,
+      num_processes,
+      results);
+
+  /* Failed processes keep running, so only their results are moved. */
+  num_running_processes = 0;
+  num_failed_processes = 0;
+  for (i = 0; i < num_processes; ++i) {
+    if (results[i].is_failed) {
+      failed_results[num_failed_processes] = results[i];
+      num_failed_processes += 1;
+    } else {
+      results[num_running_processes] = results[i];
+      num_running_processes += 1;
+    }
+  }
+
+  InstanceResult_PrintTable(
+      results,
+      num_running_processes,
+      failed_results,
+      num_failed_processes);
+  wprintf(L"\n");
+
+  CollectResults(
+      launch,
+      results,
+      num_running_processes,
+      failed_results,
+      num_failed_processes);
+
+  Attach_CloseProcesses(processes_infos, num_processes);
+
+  return is_inject_libraries_success && num_failed_processes == 0;
+}
+
+/**
+ * Launch state shared by instances that are taken through every launch
+ * phase one at a time.
+ */
+struct InstanceLauncher {
+  struct Sggl_Launch* launch;
+  struct LaunchContext* context;
+  const struct ParsedArgs* args;
+  size_t instance_count;
+
+  PROCESS_INFORMATION* processes_infos;
+  const struct Placement* placements;
+  const struct InstanceBoxes* instance_boxes;
+  struct OutputCapture* output_capture;
+  struct InstanceJob* instance_job;
+  struct ControlChannel* control_channels;
+  struct AgentClient* agent_clients;
+  struct DeferredInjector* deferred_injector;
+  struct StackSampler* stack_sampler;
+  struct InstanceRegistry* instance_registry;
+
+  struct InstanceResult* results;
+  struct InstanceResult* failed_results;
+  size_t num_failed_instances;
+  size_t num_launched_instances;
+
+  LARGE_INTEGER start_time;
+  DWORD* playable_microseconds;
+
+  int is_inject_libraries_success;
+  int is_knowledge_override_inject;
+  DWORD inject_elapsed_microseconds;
+};
+
+/**
+ * Creates, places, contains, injects and resumes the next instance into
+ * the specified slot. Returns zero if the instance failed, in which case
+ * it is terminated and the slot is left free for the next instance.
+ */
+static int LaunchInstance(
+    struct InstanceLauncher* launcher,
+    size_t instance_index) {
+  PROCESS_INFORMATION* process_info;
+  struct InstanceResult* result;
+  int is_start_game_instance_success;
+  int is_inject_instance_success;
+  LARGE_INTEGER inject_start_time;
+
+  process_info = &launcher->processes_infos[instance_index];
+  result = &launcher->results[instance_index];
+
+  InstanceResult_Init(result, launcher->num_launched_instances);
+  launcher->num_launched_instances += 1;
+
+  is_start_game_instance_success = GameLoader_StartGameInstanceSuspended(
+      process_info,
+      launcher->args,
+      launcher->instance_boxes,
+      launcher->output_capture,
+      result);
+  if (!is_start_game_instance_success) {
+    if (GameLoader_IsFatalError(result)) {
+      SetLaunchError(
+          launcher->launch,
+          L"The game executable could not be found.",
+          result->last_error);
+    }
+
+    goto bad_remove_instance;
+  }
+
+  EmitInstanceEvent(
+      launcher->launch,
+      Sggl_kEventType_InstanceCreated,
+      result);
+
+  if (launcher->placements != NULL) {
+    Placement_ApplyToProcess(
+        &launcher->placements[instance_index],
+        process_info,
+        instance_index);
+  }
+
+  if (launcher->instance_job != NULL) {
+    InstanceJob_AssignProcess(
+        launcher->instance_job,
+        process_info,
+        instance_index);
+  }
+
+  if (launcher->instance_registry != NULL) {
+    InstanceRegistry_Register(
+        launcher->instance_registry,
+        process_info,
+        (launcher->placements != NULL)
+            ? launcher->placements[instance_index].affinity_mask
+            : 0);
+  }
+
+  InitInstanceChannels(
+      launcher->args,
+      launcher->processes_infos,
+      launcher->results,
+      launcher->control_channels,
+      launcher->agent_clients,
+      instance_index,
+      1,
+      launcher->instance_count);
+
+  QueryPerformanceCounter(&inject_start_time);
+  is_inject_instance_success = InjectInstances(
+      launcher->context,
+      launcher->args,
+      process_info,
+      &launcher->agent_clients[instance_index],
+      1,
+      result,
+      &launcher->is_knowledge_override_inject);
+  launcher->inject_elapsed_microseconds +=
+      GetElapsedMicroseconds(&inject_start_time);
+
+  if (!is_inject_instance_success) {
+    wprintf(
+        L"Some or all libraries failed to inject into instance %u.\n",
+        result->instance_number);
+    launcher->is_inject_libraries_success = 0;
+  }
+
+  if (result->is_failed) {
+    goto bad_remove_instance;
+  }
+
+  ResumeInstance(process_info);
+  launcher->playable_microseconds[instance_index] =
+      GetElapsedMicroseconds(&launcher->start_time);
+
+  wprintf(
+      L"Instance %u playable after %lu microseconds.\n\n",
+      result->instance_number,
+      launcher->playable_microseconds[instance_index]);
+
+  EmitInstanceEvent(
+      launcher->launch,
+      Sggl_kEventType_InstancePlayable,
+      result);
+
+  if (launcher->deferred_injector != NULL) {
+    DeferredInjector_Start(
+        launcher->deferred_injector,
+        instance_index,
+        process_info,
+        result);
+  }
+
+  if (launcher->stack_sampler != NULL) {
+    StackSampler_AddInstance(
+        launcher->stack_sampler,
+        process_info,
+        result->instance_number);
+  }
+
+  return 1;
+
+bad_remove_instance:
+  RemoveFailedInstances(
+      launcher->launch,
+      launcher->processes_infos,
+      launcher->control_channels,
+      (launcher->args->agent_library_path != NULL)
+          ? launcher->agent_clients
+          : NULL,
+      launcher->results,
+      instance_index,
+      1,
+      launcher->failed_results,
+      &launcher->num_failed_instances);
+
+  return 0;
+}
+
+/**
+ * Runs every phase of the launch on the calling thread. Once the
+ * instances are launched, the launch stays resident until it is
+ * released, then tears down on the same thread.
+ */
+static void RunLaunch(struct Sggl_Launch* launch) {
+  size_t i;
+
+  struct ParsedArgs args;
+  struct LaunchContext launch_context;
+  struct Startup startup;
+  struct StartupInputs startup_inputs;
+  size_t phase_index;
+  size_t instance_boxes_phase_index;
+  int is_boxed;
+  size_t library_check_phase_index;
+  int is_library_checked;
+  size_t knowledge_phase_index;
+  int is_knowledge_loaded;
+  struct InstanceBoxes instance_boxes;
+  PROCESS_INFORMATION* processes_infos;
+  struct ControlChannel control_channels[GameLoader_kMaxInstances];
+  struct AgentClient agent_clients[GameLoader_kMaxInstances];
+  struct Placement placements[GameLoader_kMaxInstances];
+  struct InstanceJob instance_job;
+  struct InstanceJob* init_instance_job_result;
+  struct OutputCapture output_capture;
+  struct OutputCapture* init_output_capture_result;
+  struct DeferredInjector deferred_injector;
+  struct DeferredInjector* init_deferred_injector_result;
+  struct StackSampler stack_sampler;
+  struct StackSampler* init_stack_sampler_result;
+  struct Monitor monitor;
+  struct Monitor* init_monitor_result;
+  struct InstanceRegistry instance_registry;
+  struct InstanceRegistry* init_instance_registry_result;
+  struct InstanceRegistry_Usage host_usage;
+  struct Admission admission;
+  struct Admission* init_admission_result;
+  size_t num_requested_instances;
+  size_t num_host_instances;
+  size_t num_running_instances;
+  int is_attach_success;
+  struct InstanceLauncher launcher;
+  int is_metrics_enabled;
+  int is_placement_computed;
+  DWORD ready_wait_start_tick_count;
+  DWORD ready_wait_elapsed_milliseconds;
+  LARGE_INTEGER inject_start_time;
+  DWORD playable_microseconds[GameLoader_kMaxInstances];
+  int is_ready_instances[GameLoader_kMaxInstances];
+  struct InstanceResult instance_results[GameLoader_kMaxInstances];
+  struct InstanceResult failed_results[GameLoader_kMaxInstances];
+  DWORD first_playable_microseconds;
+  DWORD all_playable_microseconds;
+  size_t num_opened_instances;
+  int is_success;
+  int is_close_success;
+
+  /*
+   * The launch lowers the instance count as instances are admitted or
+   * fail, so it works on its own copy of the plan's args.
+   */
+  args = launch->plan->args;
+
+  /*
+   * Start recording or replaying a trace, if specified. The trace is
+   * started first and stopped last, so that it covers every call.
+   */
+  if (args.trace_record_path != NULL) {
+    if (!Platform_StartRecording(args.trace_record_path)) {
+      wprintf(
+          L"Trace file %ls could not be opened for recording.\n\n",
+          args.trace_record_path);
+      SetLaunchError(
+          launch,
+          L"The trace file could not be opened.",
+          GetLastError());
+      return;
+    }
+
+    wprintf(L"Recording trace into %ls\n\n", args.trace_record_path);
+  } else if (args.trace_replay_path != NULL) {
+    if (!Platform_StartReplay(args.trace_replay_path)) {
+      wprintf(
+          L"Trace file %ls could not be opened for replay.\n\n",
+          args.trace_replay_path);
+      SetLaunchError(
+          launch,
+          L"The trace file could not be opened.",
+          GetLastError());
+      return;
+    }
+
+    wprintf(L"Replaying trace from %ls\n\n", args.trace_replay_path);
+  }
+
+  /*
+   * Only the instances that are opened and kept have handles for the
+   * cleanup to close.
+   */
+  num_opened_instances = 0;
+  is_success = 0;
+
+  Startup_Init(&startup);
+
+  phase_index = Startup_Begin(&startup, L"Injector setup");
+  LaunchContext_Init(&launch_context);
+  launch_context.injector.library_func = &EmitLibraryEvent;
+  launch_context.injector.library_func_context = launch;
+  processes_infos = launch_context.processes_infos;
+  Startup_End(&startup, phase_index);
+
+  /* Inject into running processes, if specified. */
+  if (args.num_attach_process_ids > 0 || args.attach_image_name != NULL) {
+    is_attach_success = AttachAndInject(launch, &launch_context, &args);
+
+    is_success = is_attach_success;
+    goto deinit_launch_context;
+  }
+
+  /*
+   * Start the phases that only read the args on their own threads, so
+   * that they overlap with admission and process creation. They are
+   * joined before injection, which is the first step that needs them.
+   */
+  startup_inputs.context = &launch_context;
+  startup_inputs.args = &args;
+  startup_inputs.instance_boxes = &instance_boxes;
+  startup_inputs.num_instance_boxes = 0;
+  startup_inputs.init_instance_boxes_result = NULL;
+  startup_inputs.is_libraries_valid = 1;
+
+  /*
+   * Initialize Knowledge library, if specified. Knowledge operates on
+   * real processes, so it is skipped when replaying a trace. It loads
+   * while the launch is set up, and is joined before the first game
+   * instance is created, so that Knowledge is fully loaded before it
+   * can see any instance.
+   */
+  is_knowledge_loaded = (args.knowledge_library_path != NULL)
+      && !Platform_IsReplaying();
+  if (is_knowledge_loaded) {
+    wprintf(
+        L"Loading Knowledge library from %ls\n\n",
+        args.knowledge_library_path);
+    knowledge_phase_index = Startup_Spawn(
+        &startup,
+        L"Knowledge library",
+        &InitKnowledgePhase,
+        &startup_inputs);
+  }
+
+  /*
+   * Read the files the instances need into the file cache, so that the
+   * instances do not compete for random reads from disk.
+   */
+  if (args.is_prefetch_enabled && !Platform_IsReplaying()) {
+    Startup_Spawn(&startup, L"Prefetch", &PrefetchPhase, &startup_inputs);
+  }
+
+  /* Report libraries that cannot load before any instance is created. */
+  is_library_checked = (args.inject_library_paths_count > 0
+          || args.deferred_library_paths_count > 0)
+      && !Platform_IsReplaying();
+  if (is_library_checked) {
+    library_check_phase_index = Startup_Spawn(
+        &startup,
+        L"Library check",
+        &CheckLibrariesPhase,
+        &startup_inputs);
+  }
+
+  /* Print out parsed args to standard out. */
+  wprintf(L"Now loading game from path...\n");
+  wprintf(L"%ls\n\n", args.game_path);
+
+  if (args.game_args != NULL) {
+    wprintf(L"Command line arguments to pass into the game:\n");
+    wprintf(L"%ls\n\n", args.game_args);
+  }
+
+  if (args.inject_library_paths_count > 0) {
+    wprintf(L"Libraries to inject:\n");
+
+    for (i = 0; i < args.inject_library_paths_count; ++i) {
+      wprintf(L"%ls", args.inject_library_paths[i]);
+
+      if (!LibrarySet_IsAll(&args.inject_library_sets[i])) {
+        wprintf(L" (instances ");
+        LibrarySet_Print(&args.inject_library_sets[i]);
+        wprintf(L")");
+      }
+
+      wprintf(L"\n");
+    }
+
+    wprintf(L"\n");
+  }
+
+  if (args.deferred_library_paths_count > 0) {
+    wprintf(L"Libraries to inject after resume:\n");
+
+    for (i = 0; i < args.deferred_library_paths_count; ++i) {
+      wprintf(L"%ls\n", args.deferred_library_paths[i]);
+    }
+
+    wprintf(L"\n");
+  }
+
+  wprintf(L"Number of instances to open: %d\n", args.num_instances);
+
+  /*
+   * Keep the instances of every run in the session under the host's
+   * limit. Replayed handles do not refer to real processes, so nothing
+   * is registered when replaying a trace.
+   */
+  init_instance_registry_result = NULL;
+  if (!Platform_IsReplaying()) {
+    init_instance_registry_result = InstanceRegistry_Init(
+        &instance_registry,
+        args.profile_name);
+  }
+
+  /*
+   * Runs that start together must not all see room for their instances,
+   * so the room is reserved under the same lock that counts it.
+   */
+  num_host_instances = args.num_instances;
+  if (init_instance_registry_result != NULL
+      && !InstanceRegistry_Reserve(
+          &instance_registry,
+          args.host_max_instances,
+          &num_host_instances,
+          &host_usage)) {
+    InstanceRegistry_Deinit(&instance_registry);
+    init_instance_registry_result = NULL;
+  }
+
+  if (init_instance_registry_result != NULL) {
+    if (num_host_instances == 0) {
+      wprintf(
+          L"\n%u instance(s) already run or are starting on the host, "
+              L"which is the limit of %u.\n",
+          host_usage.num_instances + host_usage.num_placeholders,
+          args.host_max_instances);
+      goto deinit_instance_registry;
+    }
+
+    if (num_host_instances < args.num_instances) {
+      args.num_instances = num_host_instances;
+
+      wprintf(
+          L"\n%u instance(s) already run or are starting on the host, so "
+              L"only %u instance(s) are opened.\n",
+          host_usage.num_instances + host_usage.num_placeholders,
+          args.num_instances);
+    }
+  }
+
+  /*
+   * Admit only the instances that fit in memory. Queued instances are
+   * opened later, after the admitted ones are running.
+   */
+  num_requested_instances = args.num_instances;
+
+  init_admission_result = NULL;
+  if (args.memory_headroom_mb > 0 && !Platform_IsReplaying()) {
+    wprintf(L"\n");
+
+    phase_index = Startup_Begin(&startup, L"Admission");
+    init_admission_result = Admission_Init(
+        &admission,
+        args.profile_name,
+        args.memory_headroom_mb,
+        args.admission_policy,
+        init_instance_registry_result);
+    Startup_End(&startup, phase_index);
+  }
+
+  /* Let other runs expect the growth of this run's instances. */
+  if (init_admission_result != NULL
+      && init_instance_registry_result != NULL) {
+    InstanceRegistry_SetFootprint(
+        &instance_registry,
+        admission.profile.peak_commit_size,
+        admission.profile.peak_working_set_size);
+  }
+
+  if (init_admission_result != NULL) {
+    args.num_instances = Admission_ComputeCount(
+        &admission,
+        NULL,
+        0,
+        num_requested_instances);
+
+    if (args.admission_policy == Admission_kPolicy_Cap) {
+      num_requested_instances = args.num_instances;
+    }
+
+    if (args.num_instances == 0) {
+      wprintf(L"No instance can be opened without using the headroom.\n");
+      goto deinit_admission;
+    }
+  }
+
+  /*
+   * Build a working directory and environment for each instance that
+   * may be opened. Boxes work on real files, so they are skipped when
+   * replaying a trace.
+   */
+  is_boxed = (args.box_directory_path != NULL
+          || args.box_environment_path != NULL)
+      && !Platform_IsReplaying();
+  if (is_boxed) {
+    startup_inputs.num_instance_boxes = num_requested_instances;
+    instance_boxes_phase_index = Startup_Spawn(
+        &startup,
+        L"Instance boxes",
+        &BuildInstanceBoxesPhase,
+        &startup_inputs);
+  }
+
+  /* Collect launch metrics, if they are exported. */
+  is_metrics_enabled = (args.metrics_textfile_path != NULL
+      || args.metrics_port != 0);
+  if (is_metrics_enabled) {
+    Metrics_Init(
+        args.inject_library_paths,
+        args.inject_library_paths_count,
+        num_requested_instances,
+        init_instance_registry_result);
+
+    if (args.metrics_port != 0) {
+      Metrics_StartServer(args.metrics_port);
+    }
+  }
+
+  /*
+   * Compute the placements and create the job up front, so that each
+   * instance can be placed and contained before any of its code runs.
+   * The cores that other runs' instances are bound to are avoided.
+   */
+  is_placement_computed = Placement_Compute(
+      args.placement_policy,
+      num_requested_instances,
+      (init_instance_registry_result != NULL)
+          ? host_usage.processor_loads
+          : NULL,
+      placements);
+
+  init_instance_job_result = NULL;
+  if (args.is_job_enabled) {
+    init_instance_job_result = InstanceJob_Init(
+        &instance_job,
+        &args.job_limits);
+  }
+
+  /*
+   * Capture the output of the instances, if specified. The pipes are
+   * real handles, so capture is skipped when replaying a trace.
+   */
+  init_output_capture_result = NULL;
+  if (args.capture_output_directory_path != NULL
+      && !Platform_IsReplaying()) {
+    init_output_capture_result = OutputCapture_Init(
+        &output_capture,
+        args.capture_output_directory_path,
+        num_requested_instances);
+  }
+
+  /*
+   * Sample the stacks of the instances from when they are resumed, if
+   * specified. Replayed handles do not refer to real processes.
+   */
+  init_stack_sampler_result = NULL;
+  if (args.sample_directory_path != NULL && !Platform_IsReplaying()) {
+    init_stack_sampler_result = StackSampler_Init(
+        &stack_sampler,
+        args.sample_directory_path,
+        args.sample_rate,
+        &args.sample_instance_set);
+  }
+
+  memset(is_ready_instances, 0, sizeof(is_ready_instances));
+
+  launcher.launch = launch;
+  launcher.context = &launch_context;
+  launcher.args = &args;
+  launcher.instance_count = num_requested_instances;
+  launcher.processes_infos = processes_infos;
+  launcher.placements = is_placement_computed ? placements : NULL;
+  launcher.instance_boxes = NULL;
+  launcher.output_capture = init_output_capture_result;
+  launcher.instance_job = init_instance_job_result;
+  launcher.control_channels = control_channels;
+  launcher.agent_clients = agent_clients;
+  launcher.deferred_injector = NULL;
+  launcher.stack_sampler = init_stack_sampler_result;
+  launcher.instance_registry = init_instance_registry_result;
+  launcher.results = instance_results;
+  launcher.failed_results = failed_results;
+  launcher.num_failed_instances = 0;
+  launcher.num_launched_instances = 0;
+  launcher.playable_microseconds = playable_microseconds;
+  launcher.is_inject_libraries_success = 1;
+  launcher.is_knowledge_override_inject = 0;
+  launcher.inject_elapsed_microseconds = 0;
+
+  QueryPerformanceCounter(&launcher.start_time);
+
+  /*
+   * Inject the deferred libraries in the background once each resumed
+   * instance reaches the trigger, so that they stay off the path to the
+   * first frame.
+   */
+  init_deferred_injector_result = NULL;
+  if (args.deferred_library_paths_count > 0) {
+    init_deferred_injector_result = DeferredInjector_Init(
+        &deferred_injector,
+        args.deferred_library_paths,
+        args.deferred_library_paths_count,
+        args.defer_trigger,
+        (args.ready_timeout_milliseconds > 0)
+            ? args.ready_timeout_milliseconds
+            : DeferredInjector_kDefaultTimeoutMilliseconds,
+        &EmitLibraryEvent,
+        launch,
+        &launcher.start_time);
+    launcher.deferred_injector = init_deferred_injector_result;
+  }
+
+  /*
+   * Every instance would fail to load a library that did not pass the
+   * check, so none is opened.
+   */
+  if (is_library_checked) {
+    Startup_Join(&startup, library_check_phase_index);
+  }
+
+  /* Knowledge must be loaded before any game instance is created. */
+  if (is_knowledge_loaded) {
+    Startup_Join(&startup, knowledge_phase_index);
+  }
+
+  if (!startup_inputs.is_libraries_valid) {
+    wprintf(L"\nSome libraries cannot be loaded into the game.\n\n");
+    SetLaunchError(
+        launch,
+        L"Some libraries cannot be loaded into the game.",
+        ERROR_SUCCESS);
+    goto bad_print_results;
+  }
+
+  if (args.is_pipelined) {
+    FinishStartup(&startup, &launch_context);
+    launcher.instance_boxes = startup_inputs.init_instance_boxes_result;
+
+    if (is_boxed && launcher.instance_boxes == NULL) {
+      SetLaunchError(
+          launch,
+          L"The instance boxes could not be built.",
+          ERROR_SUCCESS);
+      goto bad_print_results;
+    }
+
+    /*
+     * Take each instance through every launch phase before creating the
+     * next, so that the first instance is playable while the rest are
+     * still being created and injected.
+     */
+    num_running_instances = 0;
+    for (i = 0; i < args.num_instances && launch->error_message == NULL; ++i) {
+      if (LaunchInstance(&launcher, num_running_instances)) {
+        num_running_instances += 1;
+      }
+    }
+
+    args.num_instances = num_running_instances;
+
+    wprintf(L"%u game instance(s) have been opened.\n\n", args.num_instances);
+  } else {
+    /* Create the new processes. */
+    for (i = 0; i < args.num_instances; ++i) {
+      InstanceResult_Init(&instance_results[i], i);
+    }
+
+    launcher.num_launched_instances = args.num_instances;
+
+    /* The instances are created in their boxes. */
+    if (is_boxed) {
+      Startup_Join(&startup, instance_boxes_phase_index);
+      launcher.instance_boxes = startup_inputs.init_instance_boxes_result;
+
+      if (launcher.instance_boxes == NULL) {
+        SetLaunchError(
+            launch,
+            L"The instance boxes could not be built.",
+            ERROR_SUCCESS);
+        FinishStartup(&startup, &launch_context);
+        goto bad_print_results;
+      }
+    }
+
+    phase_index = Startup_Begin(&startup, L"Process creation");
+    GameLoader_StartGameSuspended(
+        processes_infos,
+        &args,
+        launcher.instance_boxes,
+        launcher.output_capture,
+        instance_results);
+    Startup_End(&startup, phase_index);
+
+    /* A fatal error is recorded for every instance after the first. */
+    if (args.num_instances > 0
+        && GameLoader_IsFatalError(&instance_results[args.num_instances - 1])) {
+      SetLaunchError(
+          launch,
+          L"The game executable could not be found.",
+          instance_results[args.num_instances - 1].last_error);
+    }
+
+    args.num_instances = RemoveFailedInstances(
+        launch,
+        processes_infos,
+        NULL,
+        NULL,
+        instance_results,
+        0,
+        args.num_instances,
+        failed_results,
+        &launcher.num_failed_instances);
+
+    wprintf(L"%u game instance(s) have been opened.\n\n", args.num_instances);
+
+    FinishStartup(&startup, &launch_context);
+
+    if (args.num_instances == 0) {
+      goto bad_print_results;
+    }
+
+    for (i = 0; i < args.num_instances; ++i) {
+      EmitInstanceEvent(
+          launch,
+          Sggl_kEventType_InstanceCreated,
+          &instance_results[i]);
+    }
+
+    /* Place the instances on their cores before any of their code runs. */
+    if (is_placement_computed) {
+      Placement_ApplyToProcesses(
+          placements,
+          processes_infos,
+          args.num_instances);
+    }
+
+    /* Contain the instances in a job before any of their code runs. */
+    if (init_instance_job_result != NULL) {
+      InstanceJob_AssignProcesses(
+          &instance_job,
+          processes_infos,
+          args.num_instances);
+    }
+
+    /* Record the instances, so that other runs take them into account. */
+    if (init_instance_registry_result != NULL) {
+      for (i = 0; i < args.num_instances; ++i) {
+        InstanceRegistry_Register(
+            &instance_registry,
+            &processes_infos[i],
+            is_placement_computed ? placements[i].affinity_mask : 0);
+      }
+    }
+
+    InitInstanceChannels(
+        &args,
+        processes_infos,
+        instance_results,
+        control_channels,
+        agent_clients,
+        0,
+        args.num_instances,
+        num_requested_instances);
+
+    /*
+     * Time the injection. The remote thread mode loads the libraries
+     * here, while the import table mode defers loading to the resumed
+     * processes, which shows in the time until they report ready.
+     */
+    QueryPerformanceCounter(&inject_start_time);
+
+    /* Inject the library, after reading all files. */
+    launcher.is_inject_libraries_success = InjectInstances(
+        &launch_context,
+        &args,
+        processes_infos,
+        agent_clients,
+        args.num_instances,
+        instance_results,
+        &launcher.is_knowledge_override_inject);
+
+    launcher.inject_elapsed_microseconds =
+        GetElapsedMicroseconds(&inject_start_time);
+
+    /* Terminate the instances that could not be injected. */
+    args.num_instances = RemoveFailedInstances(
+        launch,
+        processes_infos,
+        control_channels,
+        (args.agent_library_path != NULL) ? agent_clients : NULL,
+        instance_results,
+        0,
+        args.num_instances,
+        failed_results,
+        &launcher.num_failed_instances);
+
+    /* Resume processes. */
+    if (args.resume_wave_size > 0) {
+      ResumeScheduler_Run(
+          processes_infos,
+          control_channels,
+          args.num_instances,
+          args.resume_wave_size,
+          args.resume_wave_timeout_milliseconds,
+          &ResumeInstance,
+          &PrintControlChannelEvent,
+          &launcher.start_time,
+          is_ready_instances,
+          playable_microseconds);
+    } else {
+      wprintf(L"Resuming processes...\n\n");
+
+      for (i = 0; i < args.num_instances; ++i) {
+        ResumeInstance(&processes_infos[i]);
+        playable_microseconds[i] =
+            GetElapsedMicroseconds(&launcher.start_time);
+      }
+    }
+
+    for (i = 0; i < args.num_instances; ++i) {
+      EmitInstanceEvent(
+          launch,
+          Sggl_kEventType_InstancePlayable,
+          &instance_results[i]);
+    }
+
+    if (init_deferred_injector_result != NULL) {
+      for (i = 0; i < args.num_instances; ++i) {
+        DeferredInjector_Start(
+            &deferred_injector,
+            i,
+            &processes_infos[i],
+            &instance_results[i]);
+
+        /* Resume waves have already seen these instances report ready. */
+        if (is_ready_instances[i]) {
+          DeferredInjector_SignalReady(&deferred_injector, i);
+        }
+      }
+    }
+
+    if (init_stack_sampler_result != NULL) {
+      for (i = 0; i < args.num_instances; ++i) {
+        StackSampler_AddInstance(
+            &stack_sampler,
+            &processes_infos[i],
+            instance_results[i].instance_number);
+      }
+    }
+  }
+
+  /* Open the queued instances as memory frees up. */
+  if (init_admission_result != NULL) {
+    while (launcher.num_launched_instances < num_requested_instances
+        && launch->error_message == NULL
+        && Admission_WaitForRoom(
+            &admission,
+            processes_infos,
+            args.num_instances,
+            args.num_instances)) {
+      if (LaunchInstance(&launcher, args.num_instances)) {
+        args.num_instances += 1;
+      }
+    }
+
+    if (launcher.num_launched_instances < num_requested_instances) {
+      wprintf(
+          L"%u queued instance(s) were not opened.\n\n",
+          num_requested_instances - launcher.num_launched_instances);
+    }
+  }
+
+  /* Let other runs have the room of the instances that were not opened. */
+  if (init_instance_registry_result != NULL) {
+    InstanceRegistry_ReleasePlaceholders(&instance_registry);
+  }
+
+  if (args.num_instances == 0) {
+    goto bad_print_results;
+  }
+
+  num_opened_instances = args.num_instances;
+
+  /* Libraries in the import tables are only loaded once resumed. */
+  if (args.inject_mode == LibraryInjector_kMode_ImportTable) {
+    launcher.is_inject_libraries_success = ConfirmImportedLibraries(
+        &launch_context,
+        &args,
+        processes_infos,
+        instance_results,
+        args.num_instances) && launcher.is_inject_libraries_success;
+  }
+
+  if (launcher.is_inject_libraries_success) {
+    wprintf(L"All libraries have been successfully injected.\n\n");
+  } else {
+    wprintf(L"Some or all libraries failed to inject.\n\n");
+  }
+
+  if (!launcher.is_knowledge_override_inject) {
+    wprintf(
+        L"Injection using %ls took %lu microseconds.\n\n",
+        (args.agent_library_path != NULL)
+            ? L"the agent"
+            : GetInjectModeName(args.inject_mode),
+        launcher.inject_elapsed_microseconds);
+  }
+
+  /*
+   * An instance is playable once it is resumed. The first instance
+   * shows the latency of a single launch, and the last shows the
+   * throughput of the whole launch.
+   */
+  first_playable_microseconds = playable_microseconds[0];
+  all_playable_microseconds = playable_microseconds[0];
+  for (i = 1; i < args.num_instances; ++i) {
+    if (playable_microseconds[i] < first_playable_microseconds) {
+      first_playable_microseconds = playable_microseconds[i];
+    }
+
+    if (playable_microseconds[i] > all_playable_microseconds) {
+      all_playable_microseconds = playable_microseconds[i];
+    }
+  }
+
+  wprintf(
+      L"Time to first playable instance: %lu microseconds.\n",
+      first_playable_microseconds);
+  wprintf(
+      L"Time to all playable instances: %lu microseconds.\n\n",
+      all_playable_microseconds);
+
+  InstanceResult_PrintTable(
+      instance_results,
+      args.num_instances,
+      failed_results,
+      launcher.num_failed_instances);
+  wprintf(L"\n");
+
+  /* Wait for the instances to report ready, if requested. */
+  if (args.ready_timeout_milliseconds > 0) {
+    wprintf(L"Waiting for instances to report ready...\n");
+
+    ready_wait_start_tick_count = GetTickCount();
+
+    for (i = 0; i < args.num_instances; ++i) {
+      int is_ready;
+
+      /* Resume waves have already consumed the ready event. */
+      if (is_ready_instances[i]) {
+        continue;
+      }
+
+      ready_wait_elapsed_milliseconds =
+          GetTickCount() - ready_wait_start_tick_count;
+
+      is_ready = ControlChannel_WaitForReady(
+          &control_channels[i],
+          (ready_wait_elapsed_milliseconds < args.ready_timeout_milliseconds)
+              ? args.ready_timeout_milliseconds
+                  - ready_wait_elapsed_milliseconds
+              : 0,
+          &PrintControlChannelEvent);
+
+      if (!is_ready) {
+        wprintf(
+            L"Instance %u did not report ready in time.\n",
+            instance_results[i].instance_number);
+      }
+
+      /* Instances that are late are injected anyway. */
+      if (init_deferred_injector_result != NULL) {
+        DeferredInjector_SignalReady(&deferred_injector, i);
+      }
+    }
+
+    wprintf(
+        L"Ready wait ended %lu microseconds after the instances started "
+            L"to be created.\n",
+        GetElapsedMicroseconds(&launcher.start_time));
+    wprintf(L"\n");
+  }
+
+  /*
+   * Deferred libraries can open the control channel from DllMain too,
+   * so the channels are kept until they are injected.
+   */
+  if (init_deferred_injector_result != NULL) {
+    DeferredInjector_Deinit(&deferred_injector);
+    init_deferred_injector_result = NULL;
+
+    if (DeferredInjector_IsSuccess(&deferred_injector)) {
+      wprintf(L"All deferred libraries have been successfully injected.\n\n");
+    } else {
+      wprintf(L"Some or all deferred libraries failed to inject.\n\n");
+      launcher.is_inject_libraries_success = 0;
+    }
+  }
+
+  /* The deferred injection records its failures into the results. */
+  CollectResults(
+      launch,
+      instance_results,
+      args.num_instances,
+      failed_results,
+      launcher.num_failed_instances);
+
+  for (i = 0; i < args.num_instances; ++i) {
+    ControlChannel_Deinit(&control_channels[i]);
+  }
+
+  if (args.metrics_textfile_path != NULL) {
+    Metrics_WriteTextfile(args.metrics_textfile_path);
+  }
+
+  is_success = launcher.is_inject_libraries_success
+      && launcher.num_failed_instances == 0;
+
+  /*
+   * Hand the instances to the caller, who decides how long to wait for
+   * them. The launch keeps its state until it is released, so that the
+   * job and the observers keep running, and so that the teardown stays
+   * on this thread.
+   */
+  launch->processes_infos = processes_infos;
+  launch->instance_results = instance_results;
+  launch->agent_clients = (args.agent_library_path != NULL)
+      ? agent_clients
+      : NULL;
+  launch->num_instances = args.num_instances;
+  launch->instance_job = init_instance_job_result;
+  launch->is_resident = !Platform_IsReplaying()
+      && (init_instance_job_result != NULL
+          || init_output_capture_result != NULL
+          || init_stack_sampler_result != NULL
+          || args.monitor_csv_path != NULL
+          || args.metrics_port != 0);
+  launch->is_success = is_success;
+  SetEvent(launch->launched_event);
+
+  /*
+   * Sample the instances until they exit or the launch is released.
+   * Replayed handles do not refer to real processes.
+   */
+  if (args.monitor_csv_path != NULL && !Platform_IsReplaying()) {
+    init_monitor_result = Monitor_Init(
+        &monitor,
+        args.monitor_csv_path,
+        args.monitor_interval_milliseconds,
+        processes_infos,
+        args.num_instances);
+    if (init_monitor_result != NULL) {
+      Monitor_Run(&monitor, launch->release_event);
+      Monitor_Deinit(&monitor);
+    }
+  }
+
+  WaitForSingleObject(launch->release_event, INFINITE);
+
+  launch->is_resident = 0;
+  launch->processes_infos = NULL;
+  launch->instance_results = NULL;
+  launch->agent_clients = NULL;
+  launch->num_instances = 0;
+  launch->instance_job = NULL;
+
+  /* The agents keep running and hold their own queue handles. */
+  if (args.agent_library_path != NULL) {
+    for (i = 0; i < args.num_instances; ++i) {
+      AgentClient_Deinit(&agent_clients[i]);
+    }
+  }
+
+  goto deinit_deferred_injector;
+
+bad_print_results:
+  InstanceResult_PrintTable(
+      instance_results,
+      0,
+      failed_results,
+      launcher.num_failed_instances);
+  wprintf(L"No game instance could be opened.\n\n");
+
+  CollectResults(
+      launch,
+      instance_results,
+      0,
+      failed_results,
+      launcher.num_failed_instances);
+
+  /* Everything that was set up is torn down in reverse order. */
+deinit_deferred_injector:
+  if (init_deferred_injector_result != NULL) {
+    DeferredInjector_Deinit(&deferred_injector);
+  }
+
+  if (init_stack_sampler_result != NULL) {
+    StackSampler_Deinit(&stack_sampler);
+  }
+
+  if (init_output_capture_result != NULL) {
+    OutputCapture_Deinit(&output_capture);
+  }
+
+  /* Learn the profile's memory use from the instances that exited. */
+  if (num_opened_instances > 0 && !Platform_IsReplaying()) {
+    Admission_RecordPeaks(
+        args.profile_name,
+        processes_infos,
+        num_opened_instances);
+  }
+
+  if (init_instance_job_result != NULL) {
+    InstanceJob_Deinit(&instance_job);
+  }
+
+  /* Stop the metrics server before the registry that it reads. */
+  if (is_metrics_enabled) {
+    if (num_opened_instances > 0 && args.metrics_textfile_path != NULL) {
+      Metrics_WriteTextfile(args.metrics_textfile_path);
+    }
+
+    Metrics_Deinit();
+  }
+
+deinit_admission:
+  if (init_admission_result != NULL) {
+    Admission_Deinit(&admission);
+  }
+
+  /* The registered instances keep their entries until they exit. */
+deinit_instance_registry:
+  if (init_instance_registry_result != NULL) {
+    InstanceRegistry_Deinit(&instance_registry);
+  }
+
+  /* The startup phases write into the launch context. */
+  Startup_Deinit(&startup);
+
+  if (startup_inputs.init_instance_boxes_result != NULL) {
+    InstanceBoxes_Deinit(&instance_boxes);
+  }
+
+  /*
+   * Have Knowledge cleanup anything it needs to, then close the process
+   * and thread handles.
+   */
+deinit_launch_context:
+  is_close_success = LaunchContext_Deinit(
+      &launch_context,
+      instance_results,
+      num_opened_instances);
+  if (!is_close_success) {
+    is_success = 0;
+
+    /* Keep the failures in the results that the host reads. */
+    CollectResults(
+        launch,
+        instance_results,
+        num_opened_instances,
+        failed_results,
+        launcher.num_failed_instances);
+  }
+
+  RemoteExports_ClearCache();
+
+  if (!Platform_StopTrace()) {
+    is_success = 0;
+    SetLaunchError(
+        launch,
+        L"The replay did not match the recording.",
+        ERROR_INVALID_DATA);
+  }
+
+  launch->is_success = is_success;
+}
+
+/**
+ * Returns the agent client of the running instance, or NULL if the
+ * instance is not running or the launch has no agent.
+ */
+static struct AgentClient* FindAgentClient(
+    const struct Sggl_Launch* launch,
+    size_t instance_number) {
+  size_t i;
+
+  if (launch->agent_clients == NULL) {
+    return NULL;
+  }
+
+  for (i = 0; i < launch->num_instances; ++i) {
+    if (launch->instance_results[i].instance_number == instance_number) {
+      return &launch->agent_clients[i];
+    }
+  }
+
+  return NULL;
+}
+
+static DWORD WINAPI RunLaunchThread(LPVOID parameter) {
+  struct Sggl_Launch* launch;
+  HANDLE launch_lock;
+
+  launch = parameter;
+
+  launch_lock = LockLaunches();
+  if (launch_lock == NULL) {
+    wprintf(L"The launch could not wait for the other launches.\n\n");
+    SetLaunchError(
+        launch,
+        L"The launch could not wait for the other launches.",
+        GetLastError());
+    return 0;
+  }
+
+  RunLaunch(launch);
+
+  UnlockLaunches(launch_lock);
+
+  return 0;
+}
+
+/**
+ * External
+ */
+
+struct Sggl_Plan* Sggl_Plan_InitFromArgv(
+    struct Sggl_Plan* plan,
+    int argc,
+    const wchar_t* const* argv) {
+  size_t num_libraries;
+  struct ParsedArgs* init_args_result;
+
+  plan->args = ParsedArgs_kUninit;
+
+  if (!ArgsValidator_IsValid(argc, argv, &num_libraries)) {
+    return NULL;
+  }
+
+  init_args_result = ParsedArgs_InitFromArgv(
+      &plan->args,
+      argc,
+      argv,
+      num_libraries);
+  if (init_args_result == NULL) {
+    return NULL;
+  }
+
+  return plan;
+}
+
+void Sggl_Plan_Deinit(struct Sggl_Plan* plan) {
+  ParsedArgs_Deinit(&plan->args);
+}
+
+struct Sggl_Launch* Sggl_Launch_Start(
+    struct Sggl_Launch* launch,
+    const struct Sggl_Plan* plan,
+    Sggl_EventFunc* event_func,
+    void* user_data) {
+  DWORD thread_id;
+
+  launch->plan = plan;
+  launch->event_func = event_func;
+  launch->user_data = user_data;
+
+  launch->is_success = 0;
+  launch->error_message = NULL;
+  launch->last_error = ERROR_SUCCESS;
+  launch->num_results = 0;
+
+  launch->is_resident = 0;
+  launch->processes_infos = NULL;
+  launch->instance_results = NULL;
+  launch->agent_clients = NULL;
+  launch->num_instances = 0;
+  launch->instance_job = NULL;
+
+  QueryPerformanceCounter(&launch->start_time);
+
+  launch->launched_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+  if (launch->launched_event == NULL) {
+    goto bad_return;
+  }
+
+  launch->release_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+  if (launch->release_event == NULL) {
+    goto bad_close_launched_event;
+  }
+
+  launch->thread = CreateThread(
+      NULL,
+      0,
+      &RunLaunchThread,
+      launch,
+      0,
+      &thread_id);
+  if (launch->thread == NULL) {
+    goto bad_close_release_event;
+  }
+
+  return launch;
+
+bad_close_release_event:
+  CloseHandle(launch->release_event);
+  launch->release_event = NULL;
+
+bad_close_launched_event:
+  CloseHandle(launch->launched_event);
+  launch->launched_event = NULL;
+
+bad_return:
+  return NULL;
+}
+
+int Sggl_Launch_Wait(struct Sggl_Launch* launch, DWORD timeout_milliseconds) {
+  HANDLE handles[2];
+  DWORD wait_result;
+
+  /* A launch that fails ends its thread without becoming resident. */
+  handles[0] = launch->launched_event;
+  handles[1] = launch->thread;
+
+  wait_result = WaitForMultipleObjects(
+      2,
+      handles,
+      FALSE,
+      timeout_milliseconds);
+
+  return wait_result == WAIT_OBJECT_0 || wait_result == WAIT_OBJECT_0 + 1;
+}
+
+int Sggl_Launch_IsSuccess(const struct Sggl_Launch* launch) {
+  return launch->is_success;
+}
+
+DWORD Sggl_Launch_GetError(
+    const struct Sggl_Launch* launch,
+    const wchar_t** error_message) {
+  *error_message = launch->error_message;
+
+  return launch->last_error;
+}
+
+int Sggl_Launch_IsResident(const struct Sggl_Launch* launch) {
+  return launch->is_resident;
+}
+
+int Sggl_Launch_WaitForExit(
+    const struct Sggl_Launch* launch,
+    DWORD timeout_milliseconds) {
+  HANDLE process_handles[GameLoader_kMaxInstances];
+  size_t i;
+  DWORD wait_result;
+
+  /* Replayed handles do not refer to real processes. */
+  if (launch->num_instances == 0 || Platform_IsReplaying()) {
+    return 1;
+  }
+
+  if (launch->instance_job != NULL) {
+    return InstanceJob_WaitForExit(
+        launch->instance_job,
+        timeout_milliseconds);
+  }
+
+  for (i = 0; i < launch->num_instances; ++i) {
+    process_handles[i] = launch->processes_infos[i].hProcess;
+  }
+
+  wait_result = WaitForMultipleObjects(
+      launch->num_instances,
+      process_handles,
+      TRUE,
+      timeout_milliseconds);
+
+  return wait_result < WAIT_OBJECT_0 + launch->num_instances;
+}
+
+const struct InstanceJob* Sggl_Launch_GetJob(
+    const struct Sggl_Launch* launch) {
+  return launch->instance_job;
+}
+
+DWORD Sggl_Launch_PostLoadLibrary(
+    const struct Sggl_Launch* launch,
+    size_t instance_number,
+    const wchar_t* library_path) {
+  struct AgentClient* agent_client;
+
+  agent_client = FindAgentClient(launch, instance_number);
+  if (agent_client == NULL) {
+    return 0;
+  }
+
+  return AgentClient_PostLoadLibrary(agent_client, library_path);
+}
+
+DWORD Sggl_Launch_PostFreeLibrary(
+    const struct Sggl_Launch* launch,
+    size_t instance_number,
+    ULONGLONG module) {
+  struct AgentClient* agent_client;
+
+  agent_client = FindAgentClient(launch, instance_number);
+  if (agent_client == NULL) {
+    return 0;
+  }
+
+  return AgentClient_PostFreeLibrary(agent_client, module);
+}
+
+DWORD Sggl_Launch_PostGetModuleHandle(
+    const struct Sggl_Launch* launch,
+    size_t instance_number,
+    const wchar_t* module_name) {
+  struct AgentClient* agent_client;
+
+  agent_client = FindAgentClient(launch, instance_number);
+  if (agent_client == NULL) {
+    return 0;
+  }
+
+  return AgentClient_PostGetModuleHandle(agent_client, module_name);
+}
+
+DWORD Sggl_Launch_PostStop(
+    const struct Sggl_Launch* launch,
+    size_t instance_number) {
+  struct AgentClient* agent_client;
+
+  agent_client = FindAgentClient(launch, instance_number);
+  if (agent_client == NULL) {
+    return 0;
+  }
+
+  return AgentClient_PostStop(agent_client);
+}
+
+int Sggl_Launch_PollResult(
+    const struct Sggl_Launch* launch,
+    size_t instance_number,
+    struct AgentResult* result) {
+  struct AgentClient* agent_client;
+
+  agent_client = FindAgentClient(launch, instance_number);
+  if (agent_client == NULL) {
+    return 0;
+  }
+
+  return AgentClient_PopResult(agent_client, result);
+}
+
+const struct InstanceResult* Sggl_Launch_GetResults(
+    const struct Sggl_Launch* launch,
+    size_t* num_results) {
+  *num_results = launch->num_results;
+
+  return launch->results;
+}
+
+void Sggl_Launch_Deinit(struct Sggl_Launch* launch) {
+  if (launch->thread == NULL) {
+    return;
+  }
+
+  SetEvent(launch->release_event);
+
+  WaitForSingleObject(launch->thread, INFINITE);
+  CloseHandle(launch->thread);
+  launch->thread = NULL;
+
+  CloseHandle(launch->release_event);
+  launch->release_event = NULL;
+  CloseHandle(launch->launched_event);
+  launch->launched_event = NULL;
+}
@@ -0,0 +1,242 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_SGGL_H_
+#define SGGL_SGGL_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#include "agent_client.h"
+#include "agent_protocol.h"
+#include "args_parser.h"
+#include "game_loader.h"
+#include "instance_job.h"
+#include "instance_result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * What a launch does, described with the same options as the command
+ * line of SGGL.exe.
+ */
+struct Sggl_Plan {
+  struct ParsedArgs args;
+};
+
+/**
+ * Validates and parses the options. The first element of argv is the
+ * program name and is ignored. Returns NULL if the options are not
+ * valid. The strings in argv must outlive the plan.
+ */
+struct Sggl_Plan* Sggl_Plan_InitFromArgv(
+    struct Sggl_Plan* plan,
+    int argc,
+    const wchar_t* const* argv);
+
+void Sggl_Plan_Deinit(struct Sggl_Plan* plan);
+
+enum Sggl_EventType {
+  Sggl_kEventType_InstanceCreated,
+  Sggl_kEventType_LibraryInjected,
+  Sggl_kEventType_InstanceFailed,
+  Sggl_kEventType_InstancePlayable
+};
+
+/**
+ * A step of a launch. The library path is only set for the library
+ * events, and the pointers are only valid during the callback.
+ */
+struct Sggl_Event {
+  enum Sggl_EventType type;
+  const struct InstanceResult* result;
+  const wchar_t* library_path;
+  int is_success;
+  DWORD elapsed_microseconds;
+};
+
+/**
+ * Called on the launch's thread for every event. Deferred libraries are
+ * injected on threads of their own, which also call it, so the function
+ * must be safe to call from several threads at once.
+ */
+typedef void Sggl_EventFunc(const struct Sggl_Event* event, void* user_data);
+
+struct Sggl_Launch {
+  const struct Sggl_Plan* plan;
+  Sggl_EventFunc* event_func;
+  void* user_data;
+
+  HANDLE thread;
+  HANDLE launched_event;
+  HANDLE release_event;
+  LARGE_INTEGER start_time;
+
+  int is_success;
+  const wchar_t* error_message;
+  DWORD last_error;
+  struct InstanceResult results[GameLoader_kMaxInstances];
+  size_t num_results;
+
+  /* Only set from when the launch finishes until it is released. */
+  int is_resident;
+  const PROCESS_INFORMATION* processes_infos;
+  const struct InstanceResult* instance_results;
+  struct AgentClient* agent_clients;
+  size_t num_instances;
+  const struct InstanceJob* instance_job;
+};
+
+/**
+ * Starts the launch on a new thread and returns right away. The event
+ * function may be NULL. The plan must outlive the launch. Returns NULL
+ * if the thread could not be created.
+ *
+ * Launches in the same process run one at a time, since the trace, the
+ * metrics and the export cache are shared by the whole process. A
+ * launch that is started while another one runs waits for it to finish
+ * before it does anything. A finished launch holds the others until it
+ * is released.
+ */
+struct Sggl_Launch* Sggl_Launch_Start(
+    struct Sggl_Launch* launch,
+    const struct Sggl_Plan* plan,
+    Sggl_EventFunc* event_func,
+    void* user_data);
+
+/**
+ * Waits for the launch to finish launching the instances, or to fail.
+ * Returns nonzero if it finished within the timeout. The launch never
+ * waits for the instances to exit.
+ */
+int Sggl_Launch_Wait(struct Sggl_Launch* launch, DWORD timeout_milliseconds);
+
+/**
+ * Returns nonzero if every instance was launched and every library was
+ * loaded. Only valid once the launch has finished.
+ */
+int Sggl_Launch_IsSuccess(const struct Sggl_Launch* launch);
+
+/**
+ * Returns the error that stopped the whole launch, such as a missing
+ * game executable, and writes its description. The description is NULL
+ * if no such error occurred. Errors of single instances are in their
+ * results instead. Only valid once the launch has finished.
+ */
+DWORD Sggl_Launch_GetError(
+    const struct Sggl_Launch* launch,
+    const wchar_t** error_message);
+
+/**
+ * Returns nonzero if the launch keeps the instances in a job or keeps
+ * observing them, such as with the monitor or the metrics server. Its
+ * caller should then wait for the instances to exit before releasing
+ * it. Only valid once the launch has finished.
+ */
+int Sggl_Launch_IsResident(const struct Sggl_Launch* launch);
+
+/**
+ * Waits for every launched instance to exit. Returns nonzero if they
+ * exited within the timeout. Only valid once the launch has finished,
+ * and until it is released.
+ */
+int Sggl_Launch_WaitForExit(
+    const struct Sggl_Launch* launch,
+    DWORD timeout_milliseconds);
+
+/**
+ * Returns the job that contains the instances, or NULL if they are not
+ * in a job. Only valid once the launch has finished, and until it is
+ * released.
+ */
+const struct InstanceJob* Sggl_Launch_GetJob(
+    const struct Sggl_Launch* launch);
+
+/**
+ * Posts a command to the agent of a running instance, if the launch has
+ * an agent library. Returns the ID of the posted command, or 0 if the
+ * instance has no agent or its command queue is full. Only valid once
+ * the launch has finished, and until it is released. Commands and
+ * results of the same instance must come from one thread at a time.
+ */
+DWORD Sggl_Launch_PostLoadLibrary(
+    const struct Sggl_Launch* launch,
+    size_t instance_number,
+    const wchar_t* library_path);
+
+DWORD Sggl_Launch_PostFreeLibrary(
+    const struct Sggl_Launch* launch,
+    size_t instance_number,
+    ULONGLONG module);
+
+DWORD Sggl_Launch_PostGetModuleHandle(
+    const struct Sggl_Launch* launch,
+    size_t instance_number,
+    const wchar_t* module_name);
+
+/**
+ * Asks the agent to stop. It no longer answers commands after that.
+ */
+DWORD Sggl_Launch_PostStop(
+    const struct Sggl_Launch* launch,
+    size_t instance_number);
+
+/**
+ * Takes the next result from the agent of a running instance, without
+ * waiting. Returns zero if there is no result.
+ */
+int Sggl_Launch_PollResult(
+    const struct Sggl_Launch* launch,
+    size_t instance_number,
+    struct AgentResult* result);
+
+/**
+ * Returns the result of every instance, in instance number order, and
+ * writes their number. Only valid once the launch has finished.
+ */
+const struct InstanceResult* Sggl_Launch_GetResults(
+    const struct Sggl_Launch* launch,
+    size_t* num_results);
+
+/**
+ * Releases the launch, which stops observing the instances and tears
+ * down on its own thread, then waits for the thread. Instances in a job
+ * that kills on close are terminated. Other instances keep running.
+ */
+void Sggl_Launch_Deinit(struct Sggl_Launch* launch);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_SGGL_H_ */
@@ -0,0 +1,752 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "stack_sampler.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+#include <tlhelp32.h>
+
+#include <mdc/error/exit_on_error.h>
+#include <mdc/malloc/malloc.h>
+#include <mdc/std/wchar.h>
+#include <mdc/wchar_t/filew.h>
+
+#include "remote_exports.h"
+
+typedef HANDLE WINAPI OpenThreadFuncType(DWORD, BOOL, DWORD);
+typedef HANDLE WINAPI CreateToolhelp32SnapshotFuncType(DWORD, DWORD);
+typedef BOOL WINAPI Thread32FirstFuncType(HANDLE, THREADENTRY32*);
+typedef BOOL WINAPI Thread32NextFuncType(HANDLE, THREADENTRY32*);
+typedef BOOL WINAPI Module32FirstWFuncType(HANDLE, MODULEENTRY32W*);
+typedef BOOL WINAPI Module32NextWFuncType(HANDLE, MODULEENTRY32W*);
+
+static OpenThreadFuncType* open_thread_func;
+static CreateToolhelp32SnapshotFuncType* create_toolhelp32_snapshot_func;
+static Thread32FirstFuncType* thread32_first_func;
+static Thread32NextFuncType* thread32_next_func;
+static Module32FirstWFuncType* module32_first_w_func;
+static Module32NextWFuncType* module32_next_w_func;
+
+static void* GetKernel32ProcAddress(const char* proc_name) {
+  return GetProcAddress(GetModuleHandleW(L"kernel32.dll"), proc_name);
+}
+
+/**
+ * Resolves the thread and Toolhelp functions, which are missing on
+ * older systems. Returns zero if sampling cannot run without them.
+ */
+static int InitSamplingFuncs(void) {
+  open_thread_func = (OpenThreadFuncType*) GetKernel32ProcAddress(
+      "OpenThread");
+  create_toolhelp32_snapshot_func =
+      (CreateToolhelp32SnapshotFuncType*) GetKernel32ProcAddress(
+          "CreateToolhelp32Snapshot");
+  thread32_first_func = (Thread32FirstFuncType*) GetKernel32ProcAddress(
+      "Thread32First");
+  thread32_next_func = (Thread32NextFuncType*) GetKernel32ProcAddress(
+      "Thread32Next");
+
+  /* Without the module list, frames are named by their address. */
+  module32_first_w_func = (Module32FirstWFuncType*) GetKernel32ProcAddress(
+      "Module32FirstW");
+  module32_next_w_func = (Module32NextWFuncType*) GetKernel32ProcAddress(
+      "Module32NextW");
+
+  return open_thread_func != NULL
+      && create_toolhelp32_snapshot_func != NULL
+      && thread32_first_func != NULL
+      && thread32_next_func != NULL;
+}
+
+static void DeinitSamplingFuncs(void) {
+  open_thread_func = NULL;
+  create_toolhelp32_snapshot_func = NULL;
+  thread32_first_func = NULL;
+  thread32_next_func = NULL;
+  module32_first_w_func = NULL;
+  module32_next_w_func = NULL;
+}
+
+static const struct StackSampler_Module* FindModule(
+    const struct StackSampler_Instance* instance,
+    ULONG_PTR address) {
+  size_t i;
+  const struct StackSampler_Module* module;
+
+  /* Search from the end, so that the latest module at a base wins. */
+  for (i = instance->num_modules; i > 0; --i) {
+    module = &instance->modules[i - 1];
+
+    if (address >= module->base && address - module->base < module->size) {
+      return module;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Adds the modules that the instance has loaded since the last refresh.
+ * Modules are never removed, so that stacks sampled before a library
+ * was unloaded can still be named.
+ */
+static void RefreshModules(struct StackSampler_Instance* instance) {
+  size_t i;
+  HANDLE snapshot;
+  MODULEENTRY32W module_entry;
+  BOOL is_module_entry_valid;
+  struct StackSampler_Module* module;
+  int is_known_module;
+
+  if (module32_first_w_func == NULL || module32_next_w_func == NULL) {
+    return;
+  }
+
+  if (instance->num_modules > 0
+      && GetTickCount() - instance->last_module_refresh_tick_count
+          < StackSampler_kModuleRefreshMilliseconds) {
+    return;
+  }
+
+  instance->last_module_refresh_tick_count = GetTickCount();
+
+  snapshot = create_toolhelp32_snapshot_func(
+      TH32CS_SNAPMODULE,
+      instance->process_info.dwProcessId);
+  if (snapshot == INVALID_HANDLE_VALUE) {
+    return;
+  }
+
+  module_entry.dwSize = sizeof(module_entry);
+  for (is_module_entry_valid = module32_first_w_func(snapshot, &module_entry);
+      is_module_entry_valid;
+      is_module_entry_valid = module32_next_w_func(snapshot, &module_entry)) {
+    is_known_module = 0;
+    for (i = 0; i < instance->num_modules; ++i) {
+      module = &instance->modules[i];
+
+      if (module->base == (ULONG_PTR) module_entry.modBaseAddr
+          && wcscmp(module->name, module_entry.szModule) == 0) {
+        is_known_module = 1;
+        break;
+      }
+    }
+
+    if (is_known_module
+        || instance->num_modules >= StackSampler_kMaxModules) {
+      continue;
+    }
+
+    module = &instance->modules[instance->num_modules];
+    module->base = (ULONG_PTR) module_entry.modBaseAddr;
+    module->size = module_entry.modBaseSize;
+    wcsncpy(module->name, module_entry.szModule, MAX_MODULE_NAME32);
+    module->name[MAX_MODULE_NAME32] = L'\0';
+
+    instance->num_modules += 1;
+  }
+
+  CloseHandle(snapshot);
+}
+
+/**
+ * Follows the frame pointer chain of the suspended thread, reading each
+ * frame record from the instance's memory. Returns the number of frames,
+ * starting with the instruction pointer.
+ */
+static size_t WalkStack(
+    HANDLE process,
+    const CONTEXT* context,
+    ULONG_PTR* frames) {
+  size_t num_frames;
+  ULONG_PTR frame_pointer;
+  ULONG_PTR stack_pointer;
+  ULONG_PTR frame_record[2];
+  BOOL is_read_process_memory_success;
+  SIZE_T num_bytes_read;
+
+#if defined(_WIN64)
+  frames[0] = (ULONG_PTR) context->Rip;
+  frame_pointer = (ULONG_PTR) context->Rbp;
+  stack_pointer = (ULONG_PTR) context->Rsp;
+#else
+  frames[0] = (ULONG_PTR) context->Eip;
+  frame_pointer = (ULONG_PTR) context->Ebp;
+  stack_pointer = (ULONG_PTR) context->Esp;
+#endif /* defined(_WIN64) */
+
+  num_frames = 1;
+  while (num_frames < StackSampler_kMaxFrames) {
+    /* Frame pointers that are not on the stack end the chain. */
+    if (frame_pointer < stack_pointer
+        || frame_pointer % sizeof(ULONG_PTR) != 0) {
+      break;
+    }
+
+    is_read_process_memory_success = ReadProcessMemory(
+        process,
+        (const void*) frame_pointer,
+        frame_record,
+        sizeof(frame_record),
+        &num_bytes_read);
+    if (!is_read_process_memory_success
+        || num_bytes_read != sizeof(frame_record)
+        || frame_record[1] == 0) {
+      break;
+    }
+
+    frames[num_frames] = frame_record[1];
+    num_frames += 1;
+
+    /* The chain must move toward the stack base. */
+    if (frame_record[0] <= frame_pointer) {
+      break;
+    }
+
+    frame_pointer = frame_record[0];
+  }
+
+  return num_frames;
+}
+
+static DWORD HashFrames(const ULONG_PTR* frames, size_t num_frames) {
+  size_t i;
+  const BYTE* bytes;
+  DWORD hash;
+
+  /* FNV-1a */
+  bytes = (const BYTE*) frames;
+  hash = 2166136261UL;
+  for (i = 0; i < num_frames * sizeof(frames[0]); ++i) {
+    hash = (hash ^ bytes[i]) * 16777619UL;
+  }
+
+  return hash;
+}
+
+/**
+ * Counts the stack in the instance's table. Samples of new stacks are
+ * dropped once the table is full.
+ */
+static void AddStack(
+    struct StackSampler_Instance* instance,
+    const ULONG_PTR* frames,
+    size_t num_frames) {
+  size_t i;
+  size_t i_stack;
+  struct StackSampler_Stack* stack;
+
+  instance->num_samples += 1;
+
+  i_stack = HashFrames(frames, num_frames)
+      & (StackSampler_kMaxStacks - 1);
+  for (i = 0; i < StackSampler_kMaxStacks; ++i) {
+    stack = &instance->stacks[i_stack];
+
+    if (stack->count == 0) {
+      stack->count = 1;
+      stack->num_frames = num_frames;
+      memcpy(stack->frames, frames, num_frames * sizeof(frames[0]));
+      return;
+    }
+
+    if (stack->num_frames == num_frames
+        && memcmp(stack->frames, frames, num_frames * sizeof(frames[0]))
+            == 0) {
+      stack->count += 1;
+      return;
+    }
+
+    i_stack = (i_stack + 1) & (StackSampler_kMaxStacks - 1);
+  }
+
+  instance->num_dropped_samples += 1;
+}
+
+static void SampleGameThread(
+    struct StackSampler_Instance* instance,
+    DWORD thread_id) {
+  HANDLE thread;
+  CONTEXT context;
+  ULONG_PTR frames[StackSampler_kMaxFrames];
+  size_t num_frames;
+
+  thread = open_thread_func(
+      THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION,
+      FALSE,
+      thread_id);
+  if (thread == NULL) {
+    return;
+  }
+
+  if (SuspendThread(thread) == (DWORD) -1) {
+    CloseHandle(thread);
+    return;
+  }
+
+  /* Keep the thread suspended only while its stack is read. */
+  num_frames = 0;
+  context.ContextFlags = CONTEXT_FULL;
+  if (GetThreadContext(thread, &context)) {
+    num_frames = WalkStack(instance->process_info.hProcess, &context, frames);
+  }
+
+  ResumeThread(thread);
+  CloseHandle(thread);
+
+  if (num_frames == 0) {
+    return;
+  }
+
+  AddStack(instance, frames, num_frames);
+
+  /* Name the injected libraries that were loaded after the last read. */
+  if (FindModule(instance, frames[0]) == NULL) {
+    RefreshModules(instance);
+  }
+}
+
+static struct StackSampler_Instance* FindInstance(
+    struct StackSampler* sampler,
+    size_t num_instances,
+    DWORD process_id) {
+  size_t i;
+
+  for (i = 0; i < num_instances; ++i) {
+    if (sampler->instances[i].process_info.dwProcessId == process_id) {
+      return &sampler->instances[i];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Samples every thread of the running instances from one thread
+ * snapshot. Returns the number of instances that are still running.
+ */
+static size_t SampleInstances(struct StackSampler* sampler) {
+  size_t i;
+  size_t num_instances;
+  size_t num_running_instances;
+  struct StackSampler_Instance* instance;
+  HANDLE snapshot;
+  THREADENTRY32 thread_entry;
+  BOOL is_thread_entry_valid;
+
+  num_instances = sampler->num_instances;
+
+  num_running_instances = 0;
+  for (i = 0; i < num_instances; ++i) {
+    instance = &sampler->instances[i];
+    if (instance->is_exited) {
+      continue;
+    }
+
+    if (WaitForSingleObject(instance->process_info.hProcess, 0)
+        == WAIT_OBJECT_0) {
+      instance->is_exited = 1;
+      continue;
+    }
+
+    num_running_instances += 1;
+  }
+
+  if (num_running_instances == 0) {
+    return 0;
+  }
+
+  snapshot = create_toolhelp32_snapshot_func(TH32CS_SNAPTHREAD, 0);
+  if (snapshot == INVALID_HANDLE_VALUE) {
+    return num_running_instances;
+  }
+
+  thread_entry.dwSize = sizeof(thread_entry);
+  for (is_thread_entry_valid = thread32_first_func(snapshot, &thread_entry);
+      is_thread_entry_valid;
+      is_thread_entry_valid = thread32_next_func(snapshot, &thread_entry)) {
+    instance = FindInstance(
+        sampler,
+        num_instances,
+        thread_entry.th32OwnerProcessID);
+    if (instance == NULL || instance->is_exited) {
+      continue;
+    }
+
+    SampleGameThread(instance, thread_entry.th32ThreadID);
+  }
+
+  CloseHandle(snapshot);
+
+  return num_running_instances;
+}
+
+static DWORD WINAPI RunSamplerThread(LPVOID parameter) {
+  struct StackSampler* sampler;
+
+  DWORD start_tick_count;
+  DWORD elapsed_milliseconds;
+  DWORD next_sample_milliseconds;
+  DWORD wait_milliseconds;
+
+  LARGE_INTEGER sampling_start_time;
+  LARGE_INTEGER sampling_end_time;
+
+  sampler = parameter;
+
+  start_tick_count = GetTickCount();
+  next_sample_milliseconds = 0;
+
+  for (;;) {
+    QueryPerformanceCounter(&sampling_start_time);
+    SampleInstances(sampler);
+    QueryPerformanceCounter(&sampling_end_time);
+
+    sampler->sampling_ticks += sampling_end_time.QuadPart
+        - sampling_start_time.QuadPart;
+    sampler->num_ticks += 1;
+
+    /* Sample on a fixed schedule, skipping samples if falling behind. */
+    next_sample_milliseconds += sampler->interval_milliseconds;
+
+    elapsed_milliseconds = GetTickCount() - start_tick_count;
+    wait_milliseconds = 0;
+    if (next_sample_milliseconds > elapsed_milliseconds) {
+      wait_milliseconds = next_sample_milliseconds - elapsed_milliseconds;
+    } else {
+      next_sample_milliseconds = elapsed_milliseconds;
+    }
+
+    /* The sampler is closed when the launch is released. */
+    if (WaitForSingleObject(sampler->close_event, wait_milliseconds)
+        == WAIT_OBJECT_0) {
+      break;
+    }
+  }
+
+  sampler->elapsed_milliseconds = GetTickCount() - start_tick_count;
+
+  return 0;
+}
+
+static void WriteFrame(
+    FILE* file,
+    const struct StackSampler_Instance* instance,
+    ULONG_PTR address) {
+  const struct StackSampler_Module* module;
+  char module_name[MAX_MODULE_NAME32 + 1];
+
+  module = FindModule(instance, address);
+  if (module != NULL) {
+    /* Flame graph tools read the stacks as bytes. */
+    if (WideCharToMultiByte(
+            CP_ACP,
+            0,
+            module->name,
+            -1,
+            module_name,
+            sizeof(module_name),
+            NULL,
+            NULL) == 0) {
+      module_name[0] = '\0';
+    }
+
+    module_name[MAX_MODULE_NAME32] = '\0';
+
+    fprintf(
+        file,
+        "%s+0x%lx",
+        module_name,
+        (unsigned long) (address - module->base));
+  } else if ((ULONGLONG) address >> 32 != 0) {
+    fprintf(
+        file,
+        "0x%lx%08lx",
+        (unsigned long) ((ULONGLONG) address >> 32),
+        (unsigned long) address);
+  } else {
+    fprintf(file, "0x%lx", (unsigned long) address);
+  }
+}
+
+/**
+ * Writes the instance's stacks in the collapsed format, with the frames
+ * of each stack from the root to the leaf, followed by its count.
+ */
+static void WriteStacks(
+    const struct StackSampler* sampler,
+    const struct StackSampler_Instance* instance) {
+  size_t i_stack;
+  size_t i_frame;
+  const struct StackSampler_Stack* stack;
+  wchar_t file_path[MAX_PATH];
+  FILE* file;
+
+  _snwprintf(
+      file_path,
+      MAX_PATH,
+      L"%ls\\%u.folded",
+      sampler->directory_path,
+      instance->instance_number);
+  file_path[MAX_PATH - 1] = L'\0';
+
+  file = _wfopen(file_path, L"w");
+  if (file == NULL) {
+    wprintf(L"Stack file %ls could not be opened.\n", file_path);
+    return;
+  }
+
+  for (i_stack = 0; i_stack < StackSampler_kMaxStacks; ++i_stack) {
+    stack = &instance->stacks[i_stack];
+    if (stack->count == 0) {
+      continue;
+    }
+
+    for (i_frame = stack->num_frames; i_frame > 0; --i_frame) {
+      WriteFrame(file, instance, stack->frames[i_frame - 1]);
+
+      if (i_frame > 1) {
+        fputc(';', file);
+      }
+    }
+
+    fprintf(file, " %lu\n", stack->count);
+  }
+
+  /* Keep the totals right when the table ran out of room. */
+  if (instance->num_dropped_samples > 0) {
+    fprintf(file, "[dropped] %lu\n", instance->num_dropped_samples);
+  }
+
+  fclose(file);
+
+  wprintf(
+      L"Wrote %lu sample(s) of instance %u into %ls\n",
+      instance->num_samples,
+      instance->instance_number,
+      file_path);
+}
+
+/**
+ * External
+ */
+
+struct StackSampler* StackSampler_Init(
+    struct StackSampler* sampler,
+    const wchar_t* directory_path,
+    DWORD rate,
+    const struct LibrarySet* instance_set) {
+  DWORD get_full_path_name_result;
+  DWORD thread_id;
+
+  if (!InitSamplingFuncs()) {
+    wprintf(L"Stack sampling is not supported on this system.\n\n");
+    goto bad_deinit_sampling_funcs;
+  }
+
+  get_full_path_name_result = GetFullPathNameW(
+      directory_path,
+      MAX_PATH,
+      sampler->directory_path,
+      NULL);
+  if (get_full_path_name_result == 0
+      || get_full_path_name_result >= MAX_PATH) {
+    wprintf(L"Sample directory %ls could not be resolved.\n\n", directory_path);
+    goto bad_deinit_sampling_funcs;
+  }
+
+  if (!CreateDirectoryW(sampler->directory_path, NULL)
+      && GetLastError() != ERROR_ALREADY_EXISTS) {
+    wprintf(L"CreateDirectoryW failed, error 0x%lX.\n\n", GetLastError());
+    goto bad_deinit_sampling_funcs;
+  }
+
+  sampler->interval_milliseconds = 1000 / rate;
+  sampler->instance_set = *instance_set;
+  sampler->num_instances = 0;
+  sampler->num_ticks = 0;
+  sampler->sampling_ticks = 0;
+  sampler->elapsed_milliseconds = 0;
+
+  sampler->close_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+  if (sampler->close_event == NULL) {
+    wprintf(L"CreateEventW failed, error 0x%lX.\n\n", GetLastError());
+    goto bad_deinit_sampling_funcs;
+  }
+
+  sampler->thread = CreateThread(
+      NULL,
+      0,
+      &RunSamplerThread,
+      sampler,
+      0,
+      &thread_id);
+  if (sampler->thread == NULL) {
+    wprintf(L"CreateThread failed, error 0x%lX.\n\n", GetLastError());
+    goto bad_close_close_event;
+  }
+
+  wprintf(
+      L"Sampling stacks every %lu ms into %ls\n\n",
+      sampler->interval_milliseconds,
+      sampler->directory_path);
+
+  return sampler;
+
+bad_close_close_event:
+  CloseHandle(sampler->close_event);
+  sampler->close_event = NULL;
+
+bad_deinit_sampling_funcs:
+  DeinitSamplingFuncs();
+
+  return NULL;
+}
+
+void StackSampler_Deinit(struct StackSampler* sampler) {
+  size_t i;
+  struct StackSampler_Instance* instance;
+  unsigned long sampling_microseconds;
+  unsigned long overhead_percent_x100;
+  LARGE_INTEGER performance_frequency;
+
+  SetEvent(sampler->close_event);
+  WaitForSingleObject(sampler->thread, INFINITE);
+
+  CloseHandle(sampler->thread);
+  sampler->thread = NULL;
+  CloseHandle(sampler->close_event);
+  sampler->close_event = NULL;
+
+  QueryPerformanceFrequency(&performance_frequency);
+  sampling_microseconds = (unsigned long) (
+      sampler->sampling_ticks * 1000000 / performance_frequency.QuadPart);
+
+  wprintf(
+      L"Sampled stacks %lu time(s). Sampling took %lu us over %lu ms",
+      sampler->num_ticks,
+      sampling_microseconds,
+      sampler->elapsed_milliseconds);
+
+  if (sampler->elapsed_milliseconds > 0) {
+    /* Microseconds * 10 / milliseconds is a percentage times 100. */
+    overhead_percent_x100 = (unsigned long) (
+        (ULONGLONG) sampling_microseconds * 10
+            / sampler->elapsed_milliseconds);
+
+    wprintf(
+        L" (%lu.%02lu%% of one core)",
+        overhead_percent_x100 / 100,
+        overhead_percent_x100 % 100);
+  }
+
+  wprintf(L".\n");
+
+  for (i = 0; i < (size_t) sampler->num_instances; ++i) {
+    instance = &sampler->instances[i];
+
+    WriteStacks(sampler, instance);
+
+    Mdc_free(instance->modules);
+    instance->modules = NULL;
+    Mdc_free(instance->stacks);
+    instance->stacks = NULL;
+  }
+
+  wprintf(L"\n");
+
+  sampler->num_instances = 0;
+
+  DeinitSamplingFuncs();
+}
+
+void StackSampler_AddInstance(
+    struct StackSampler* sampler,
+    const PROCESS_INFORMATION* process_info,
+    size_t instance_number) {
+  struct StackSampler_Instance* instance;
+
+  if (!LibrarySet_Contains(&sampler->instance_set, instance_number)
+      || sampler->num_instances >= StackSampler_kMaxInstances) {
+    return;
+  }
+
+  /* Frame records and module lists are read in the loader's layout. */
+  if (!RemoteExports_IsSameBitness(process_info->hProcess)) {
+    wprintf(
+        L"Instance %u is not sampled, since its bitness differs from the "
+            L"loader's.\n",
+        instance_number);
+    return;
+  }
+
+  instance = &sampler->instances[sampler->num_instances];
+
+  instance->stacks = Mdc_malloc(
+      StackSampler_kMaxStacks * sizeof(instance->stacks[0]));
+  if (instance->stacks == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_return;
+  }
+
+  memset(
+      instance->stacks,
+      0,
+      StackSampler_kMaxStacks * sizeof(instance->stacks[0]));
+
+  instance->modules = Mdc_malloc(
+      StackSampler_kMaxModules * sizeof(instance->modules[0]));
+  if (instance->modules == NULL) {
+    Mdc_Error_ExitOnMemoryAllocError(__FILEW__, __LINE__);
+    goto bad_free_stacks;
+  }
+
+  instance->process_info = *process_info;
+  instance->instance_number = instance_number;
+  instance->is_exited = 0;
+  instance->num_samples = 0;
+  instance->num_dropped_samples = 0;
+  instance->num_modules = 0;
+  instance->last_module_refresh_tick_count = 0;
+
+  /* Publish the instance to the sampling thread once it is filled in. */
+  InterlockedIncrement((LONG*) &sampler->num_instances);
+
+  return;
+
+bad_free_stacks:
+  Mdc_free(instance->stacks);
+  instance->stacks = NULL;
+
+bad_return:
+  return;
+}
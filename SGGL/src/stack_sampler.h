@@ -0,0 +1,148 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_STACK_SAMPLER_H_
+#define SGGL_STACK_SAMPLER_H_
+
+#include <stddef.h>
+#include <windows.h>
+#include <tlhelp32.h>
+
+#include <mdc/std/wchar.h>
+
+#include "library_set.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum {
+  StackSampler_kDefaultRate = 100,
+  StackSampler_kMaxRate = 1000,
+
+  StackSampler_kMaxInstances = 64,
+
+  /* Frames beyond this depth are cut off from the root side. */
+  StackSampler_kMaxFrames = 32,
+
+  /* Distinct stacks kept per instance. Must be a power of two. */
+  StackSampler_kMaxStacks = 4096,
+
+  StackSampler_kMaxModules = 256,
+
+  /* Least time between two reads of an instance's module list. */
+  StackSampler_kModuleRefreshMilliseconds = 1000
+};
+
+/**
+ * A distinct call stack and the number of times it was sampled. The
+ * frames are stored from the leaf to the root.
+ */
+struct StackSampler_Stack {
+  DWORD count;
+  DWORD num_frames;
+  ULONG_PTR frames[StackSampler_kMaxFrames];
+};
+
+struct StackSampler_Module {
+  ULONG_PTR base;
+  DWORD size;
+  wchar_t name[MAX_MODULE_NAME32 + 1];
+};
+
+struct StackSampler_Instance {
+  PROCESS_INFORMATION process_info;
+  size_t instance_number;
+  int is_exited;
+
+  struct StackSampler_Stack* stacks;
+  DWORD num_samples;
+  DWORD num_dropped_samples;
+
+  /* Every module seen in the instance, including unloaded ones. */
+  struct StackSampler_Module* modules;
+  size_t num_modules;
+  DWORD last_module_refresh_tick_count;
+};
+
+/**
+ * Samples the call stack of every thread of the chosen instances at a
+ * fixed rate, on a thread of its own. Each thread is suspended while
+ * its context is captured and its frame pointer chain is read, so the
+ * cost to the instances is bounded by the rate. The stacks are written
+ * in the collapsed format that flame graph tools read, one file per
+ * instance, with each frame named after its module and offset.
+ */
+struct StackSampler {
+  wchar_t directory_path[MAX_PATH];
+  DWORD interval_milliseconds;
+  struct LibrarySet instance_set;
+
+  struct StackSampler_Instance instances[StackSampler_kMaxInstances];
+  volatile LONG num_instances;
+
+  HANDLE thread;
+  HANDLE close_event;
+
+  DWORD num_ticks;
+  ULONGLONG sampling_ticks;
+  DWORD elapsed_milliseconds;
+};
+
+/**
+ * Creates the directory and starts the sampling thread. Only the
+ * instances in the set are sampled. Returns NULL if sampling is not
+ * supported, which is the case on Windows 9x and NT 4.0.
+ */
+struct StackSampler* StackSampler_Init(
+    struct StackSampler* sampler,
+    const wchar_t* directory_path,
+    DWORD rate,
+    const struct LibrarySet* instance_set);
+
+/**
+ * Stops sampling, then writes the stacks and prints the time spent
+ * sampling. Instances that still run are no longer sampled.
+ */
+void StackSampler_Deinit(struct StackSampler* sampler);
+
+/**
+ * Starts sampling the resumed instance, if it is in the set. The
+ * process handle must stay open until the sampler is deinitialized.
+ */
+void StackSampler_AddInstance(
+    struct StackSampler* sampler,
+    const PROCESS_INFORMATION* process_info,
+    size_t instance_number);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_STACK_SAMPLER_H_ */
@@ -0,0 +1,230 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#include "startup.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <windows.h>
+
+#include <mdc/std/assert.h>
+#include <mdc/std/wchar.h>
+
+#include "platform.h"
+
+static DWORD GetMicroseconds(
+    const LARGE_INTEGER* start_time,
+    const LARGE_INTEGER* end_time) {
+  LARGE_INTEGER frequency;
+
+  QueryPerformanceFrequency(&frequency);
+
+  return (DWORD) ((end_time->QuadPart - start_time->QuadPart)
+      * 1000000 / frequency.QuadPart);
+}
+
+static void RunPhase(struct Startup_Phase* phase) {
+  QueryPerformanceCounter(&phase->start_time);
+  phase->func(phase->context);
+  QueryPerformanceCounter(&phase->end_time);
+}
+
+static DWORD WINAPI RunPhaseThread(LPVOID parameter) {
+  RunPhase(parameter);
+
+  return 0;
+}
+
+static size_t AddPhase(
+    struct Startup* startup,
+    const wchar_t* name,
+    Startup_PhaseFunc* func,
+    void* context) {
+  struct Startup_Phase* phase;
+
+  /* The launch has a fixed set of phases. */
+  assert(startup->num_phases < Startup_kMaxPhases);
+
+  phase = &startup->phases[startup->num_phases];
+  phase->name = name;
+  phase->func = func;
+  phase->context = context;
+  phase->thread = NULL;
+
+  startup->num_phases += 1;
+
+  return startup->num_phases - 1;
+}
+
+/**
+ * External
+ */
+
+struct Startup* Startup_Init(struct Startup* startup) {
+  startup->num_phases = 0;
+  QueryPerformanceCounter(&startup->start_time);
+
+  return startup;
+}
+
+void Startup_Deinit(struct Startup* startup) {
+  size_t i;
+
+  for (i = 0; i < startup->num_phases; ++i) {
+    Startup_Join(startup, i);
+  }
+
+  startup->num_phases = 0;
+}
+
+size_t Startup_Spawn(
+    struct Startup* startup,
+    const wchar_t* name,
+    Startup_PhaseFunc* func,
+    void* context) {
+  size_t phase_index;
+  struct Startup_Phase* phase;
+  DWORD thread_id;
+
+  phase_index = AddPhase(startup, name, func, context);
+  phase = &startup->phases[phase_index];
+
+  /* Only calls from the tracing thread are traced. */
+  if (Platform_IsTracing()) {
+    RunPhase(phase);
+    return phase_index;
+  }
+
+  phase->thread = CreateThread(
+      NULL,
+      0,
+      &RunPhaseThread,
+      phase,
+      0,
+      &thread_id);
+
+  /* Without a thread, the phase only loses its overlap. */
+  if (phase->thread == NULL) {
+    RunPhase(phase);
+  }
+
+  return phase_index;
+}
+
+size_t Startup_Begin(struct Startup* startup, const wchar_t* name) {
+  size_t phase_index;
+
+  phase_index = AddPhase(startup, name, NULL, NULL);
+  QueryPerformanceCounter(&startup->phases[phase_index].start_time);
+
+  return phase_index;
+}
+
+void Startup_End(struct Startup* startup, size_t phase_index) {
+  QueryPerformanceCounter(&startup->phases[phase_index].end_time);
+}
+
+void Startup_Join(struct Startup* startup, size_t phase_index) {
+  struct Startup_Phase* phase;
+  DWORD wait_result;
+  BOOL is_close_handle_success;
+
+  phase = &startup->phases[phase_index];
+  if (phase->thread == NULL) {
+    return;
+  }
+
+  wait_result = WaitForSingleObject(phase->thread, INFINITE);
+  if (wait_result == WAIT_FAILED) {
+    wprintf(L"WaitForSingleObject failed, error 0x%lX.\n\n", GetLastError());
+    goto bad_return;
+  }
+
+  is_close_handle_success = CloseHandle(phase->thread);
+  if (!is_close_handle_success) {
+    wprintf(L"CloseHandle failed, error 0x%lX.\n\n", GetLastError());
+    goto bad_return;
+  }
+
+  phase->thread = NULL;
+
+  return;
+
+bad_return:
+  return;
+}
+
+void Startup_PrintSummary(struct Startup* startup) {
+  size_t i;
+  const struct Startup_Phase* phase;
+  DWORD phase_microseconds;
+  DWORD sequential_microseconds;
+  DWORD critical_path_microseconds;
+  DWORD end_microseconds;
+
+  sequential_microseconds = 0;
+  critical_path_microseconds = 0;
+
+  wprintf(L"Startup phases:\n");
+
+  for (i = 0; i < startup->num_phases; ++i) {
+    Startup_Join(startup, i);
+
+    phase = &startup->phases[i];
+    phase_microseconds = GetMicroseconds(
+        &phase->start_time,
+        &phase->end_time);
+    end_microseconds = GetMicroseconds(
+        &startup->start_time,
+        &phase->end_time);
+
+    sequential_microseconds += phase_microseconds;
+    if (end_microseconds > critical_path_microseconds) {
+      critical_path_microseconds = end_microseconds;
+    }
+
+    wprintf(
+        L"%ls started after %lu microseconds and took %lu microseconds.\n",
+        phase->name,
+        GetMicroseconds(&startup->start_time, &phase->start_time),
+        phase_microseconds);
+  }
+
+  /*
+   * Work between the timed phases counts towards the startup but not
+   * towards any phase, so the time saved is a lower bound.
+   */
+  wprintf(
+      L"Startup took %lu microseconds, %lu less than its phases in "
+          L"sequence.\n\n",
+      critical_path_microseconds,
+      (sequential_microseconds > critical_path_microseconds)
+          ? sequential_microseconds - critical_path_microseconds
+          : 0);
+}
@@ -0,0 +1,115 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+#ifndef SGGL_STARTUP_H_
+#define SGGL_STARTUP_H_
+
+#include <stddef.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum {
+  Startup_kMaxPhases = 8
+};
+
+typedef void Startup_PhaseFunc(void* context);
+
+struct Startup_Phase {
+  const wchar_t* name;
+  Startup_PhaseFunc* func;
+  void* context;
+
+  /* NULL for phases that run on the calling thread. */
+  HANDLE thread;
+
+  LARGE_INTEGER start_time;
+  LARGE_INTEGER end_time;
+};
+
+/**
+ * The phases of a launch's startup, timed from when the startup began.
+ * Phases that do not depend on each other run on their own threads, and
+ * the launch joins a phase right before it needs the phase's output.
+ */
+struct Startup {
+  LARGE_INTEGER start_time;
+
+  struct Startup_Phase phases[Startup_kMaxPhases];
+  size_t num_phases;
+};
+
+struct Startup* Startup_Init(struct Startup* startup);
+
+/**
+ * Joins every phase and closes their threads.
+ */
+void Startup_Deinit(struct Startup* startup);
+
+/**
+ * Starts the phase on a new thread and returns its index. The phase is
+ * run on the calling thread instead if the thread cannot be created, or
+ * if Win32 calls are being traced, so that the phase's calls are part
+ * of the trace.
+ */
+size_t Startup_Spawn(
+    struct Startup* startup,
+    const wchar_t* name,
+    Startup_PhaseFunc* func,
+    void* context);
+
+/**
+ * Starts timing a phase that runs on the calling thread, and returns its
+ * index.
+ */
+size_t Startup_Begin(struct Startup* startup, const wchar_t* name);
+
+void Startup_End(struct Startup* startup, size_t phase_index);
+
+/**
+ * Waits for the phase to finish. Does nothing for phases that have
+ * already been joined, or that run on the calling thread.
+ */
+void Startup_Join(struct Startup* startup, size_t phase_index);
+
+/**
+ * Joins every phase, then prints how long each phase took and how much
+ * shorter the startup was than running its phases one after another.
+ */
+void Startup_PrintSummary(struct Startup* startup);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* SGGL_STARTUP_H_ */
@@ -0,0 +1,121 @@
+/**
+ * SlashGaming Game Loader
+ * Copyright (C) 2018-2021  Mir Drualga
+ *
+ * This file is part of SlashGaming Game Loader.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Additional permissions under GNU Affero General Public License version 3
+ *  section 7
+ *
+ *  If you modify this Program, or any covered work, by linking or combining
+ *  it with any program (or a modified version of that program and its
+ *  libraries), containing parts covered by the terms of an incompatible
+ *  license, the licensors of this Program grant you additional permission
+ *  to convey the resulting work.
+ */
+
+/**
+ * Stand-in library for the trace tests. It reports its instance ready
+ * from DllMain, so that the time until the instances are ready can be
+ * compared between the injection modes. It exports a function, so that
+ * it can be injected through the import table.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <windows.h>
+
+#include <mdc/std/wchar.h>
+
+#include "control_channel.h"
+
+enum {
+  kObjectNameLength = 64
+};
+
+static void FormatObjectName(
+    wchar_t* object_name,
+    const wchar_t* name_format,
+    DWORD process_id) {
+  _snwprintf(object_name, kObjectNameLength, name_format, process_id);
+  object_name[kObjectNameLength - 1] = L'\0';
+}
+
+static void ReportReady(void) {
+  wchar_t object_name[kObjectNameLength];
+  HANDLE ring_mapping;
+  struct ControlChannelRing* ring;
+  HANDLE event;
+  struct ControlChannelEvent ready_event;
+
+  FormatObjectName(
+      object_name,
+      CONTROL_CHANNEL_RING_NAME_FORMAT,
+      GetCurrentProcessId());
+  ring_mapping = OpenFileMappingW(FILE_MAP_WRITE, FALSE, object_name);
+  if (ring_mapping == NULL) {
+    goto bad_return;
+  }
+
+  ring = MapViewOfFile(ring_mapping, FILE_MAP_WRITE, 0, 0, sizeof(*ring));
+  if (ring == NULL) {
+    goto bad_close_ring_mapping;
+  }
+
+  ready_event.type = ControlChannel_kEventType_Ready;
+  ready_event.value = 0;
+  ready_event.tick_count = GetTickCount();
+  ready_event.reserved = 0;
+
+  ControlChannelRing_Push(ring, &ready_event);
+
+  FormatObjectName(
+      object_name,
+      CONTROL_CHANNEL_EVENT_NAME_FORMAT,
+      GetCurrentProcessId());
+  event = OpenEventW(EVENT_MODIFY_STATE, FALSE, object_name);
+  if (event != NULL) {
+    SetEvent(event);
+    CloseHandle(event);
+  }
+
+  UnmapViewOfFile(ring);
+
+bad_close_ring_mapping:
+  CloseHandle(ring_mapping);
+
+bad_return:
+  return;
+}
+
+/**
+ * External
+ */
+
+__declspec(dllexport) int ReplayTestLibrary_GetVersion(void) {
+  return 1;
+}
+
+BOOL WINAPI DllMain(HINSTANCE instance, DWORD reason, void* reserved) {
+  if (reason != DLL_PROCESS_ATTACH) {
+    return TRUE;
+  }
+
+  DisableThreadLibraryCalls(instance);
+  ReportReady();
+
+  return TRUE;
+}